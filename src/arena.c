@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "arena.h"
+#include <stdlib.h>
+
+#define ARENA_ALIGNMENT 16
+#define ARENA_ALIGN(x) (((x) + ARENA_ALIGNMENT - 1) & ~((size_t)ARENA_ALIGNMENT - 1))
+#define ARENA_HEADER ARENA_ALIGN(sizeof(ArenaBlock_t))
+#define ARENA_DATA(block) ((char *)(block) + ARENA_HEADER)
+
+static ArenaBlock_t *blockCreate(Arena_t *self, size_t size)
+{
+    ArenaBlock_t *block = malloc(ARENA_HEADER + size);
+
+    if (block)
+    {
+        block->next = NULL;
+        block->size = size;
+        block->used = 0;
+        self->blocksAllocated++;
+    }
+    return block;
+}
+
+void arenaInit(Arena_t *self, size_t blockSize)
+{
+    self->blocks = NULL;
+    self->large = NULL;
+    self->blockSize = ARENA_ALIGN(blockSize);
+    self->allocations = 0;
+    self->releases = 0;
+    self->bytes = 0;
+    self->blocksAllocated = 0;
+}
+
+void *arenaAlloc(Arena_t *self, size_t size)
+{
+    ArenaBlock_t *block = self->blocks;
+
+    size = ARENA_ALIGN(size ? size : 1);
+    self->allocations++;
+    self->bytes += size;
+
+    if (size > self->blockSize / 4)
+    {
+        block = blockCreate(self, size);
+        if (block == NULL)
+        {
+            return NULL;
+        }
+        block->used = size;
+        block->next = self->large;
+        self->large = block;
+        return ARENA_DATA(block);
+    }
+
+    if (block == NULL || block->used + size > block->size)
+    {
+        block = blockCreate(self, self->blockSize);
+        if (block == NULL)
+        {
+            return NULL;
+        }
+        block->next = self->blocks;
+        self->blocks = block;
+    }
+
+    block->used += size;
+    return ARENA_DATA(block) + block->used - size;
+}
+
+void arenaReset(Arena_t *self)
+{
+    ArenaBlock_t *keep = self->blocks;
+
+    while (self->large)
+    {
+        ArenaBlock_t *next = self->large->next;
+        free(self->large);
+        self->large = next;
+    }
+
+    if (keep)
+    {
+        ArenaBlock_t *block = keep->next;
+        while (block)
+        {
+            ArenaBlock_t *next = block->next;
+            free(block);
+            block = next;
+        }
+        keep->next = NULL;
+        keep->used = 0;
+    }
+}
+
+void arenaFree(Arena_t *self)
+{
+    arenaReset(self);
+    free(self->blocks);
+    self->blocks = NULL;
+}
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct ArenaBlock
+{
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+} ArenaBlock_t;
+
+// Bump allocator. Allocations are carved from blocks of blockSize bytes,
+// allocations larger than a quarter of a block get a block of their own.
+// Nothing is freed one by one: arenaReset() and arenaFree() walk the two
+// block chains, independent of the number of allocations.
+typedef struct
+{
+    ArenaBlock_t *blocks;
+    ArenaBlock_t *large;
+    size_t blockSize;
+    uint64_t allocations;
+    uint64_t releases;
+    uint64_t bytes;
+    uint64_t blocksAllocated;
+} Arena_t;
+
+void arenaInit(Arena_t *self, size_t blockSize);
+void *arenaAlloc(Arena_t *self, size_t size);
+void arenaReset(Arena_t *self);
+void arenaFree(Arena_t *self);
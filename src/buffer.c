@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "buffer.h"
+#include "numberformat.h"
+#include <stdlib.h>
+#include <string.h>
+
+void bufferInit(Buffer_t *self)
+{
+    self->data = NULL;
+    self->size = 0;
+    self->capacity = 0;
+    self->file = NULL;
+}
+
+void bufferFree(Buffer_t *self)
+{
+    free(self->data);
+    bufferInit(self);
+}
+
+void bufferClear(Buffer_t *self)
+{
+    self->size = 0;
+    if (self->data)
+    {
+        self->data[0] = '\0';
+    }
+}
+
+void bufferAttach(Buffer_t *self, FILE *file)
+{
+    self->file = file;
+}
+
+bool bufferFlush(Buffer_t *self)
+{
+    bool ok = true;
+
+    if (self->file && self->size > 0)
+    {
+        ok = fwrite(self->data, 1, self->size, self->file) == self->size;
+        bufferClear(self);
+    }
+    return ok;
+}
+
+bool bufferReserve(Buffer_t *self, size_t additional)
+{
+    size_t needed = self->size + additional + 1;
+    size_t capacity = self->capacity ? self->capacity : 4096;
+    char *data;
+
+    if (needed <= self->capacity)
+    {
+        return true;
+    }
+
+    if (self->file && self->size > 0)
+    {
+        if (!bufferFlush(self))
+        {
+            return false;
+        }
+        needed = additional + 1;
+        if (needed <= self->capacity)
+        {
+            return true;
+        }
+    }
+
+    while (capacity < needed)
+    {
+        capacity *= 2;
+    }
+
+    data = realloc(self->data, capacity);
+    if (data == NULL)
+    {
+        return false;
+    }
+    self->data = data;
+    self->capacity = capacity;
+    return true;
+}
+
+bool bufferAppend(Buffer_t *self, const char *data, size_t size)
+{
+    if (!bufferReserve(self, size))
+    {
+        return false;
+    }
+    memcpy(self->data + self->size, data, size);
+    self->size += size;
+    self->data[self->size] = '\0';
+    return true;
+}
+
+bool bufferAppendString(Buffer_t *self, const char *s)
+{
+    return bufferAppend(self, s, strlen(s));
+}
+
+bool bufferAppendChar(Buffer_t *self, char c)
+{
+    return bufferAppend(self, &c, 1);
+}
+
+bool bufferAppendUint32(Buffer_t *self, uint32_t value)
+{
+    if (!bufferReserve(self, NUMBER_FORMAT_BUFFER_SIZE))
+    {
+        return false;
+    }
+    self->size += formatUint32(self->data + self->size, value);
+    return true;
+}
+
+bool bufferAppendInt64(Buffer_t *self, int64_t value)
+{
+    if (!bufferReserve(self, NUMBER_FORMAT_BUFFER_SIZE))
+    {
+        return false;
+    }
+    self->size += formatInt64(self->data + self->size, value);
+    return true;
+}
+
+bool bufferAppendDouble(Buffer_t *self, double value)
+{
+    if (!bufferReserve(self, NUMBER_FORMAT_BUFFER_SIZE))
+    {
+        return false;
+    }
+    self->size += formatDouble(self->data + self->size, value);
+    return true;
+}
+
+bool bufferAppendFixed(Buffer_t *self, double value)
+{
+    if (!bufferReserve(self, NUMBER_FORMAT_BUFFER_SIZE))
+    {
+        return false;
+    }
+    self->size += formatFixed(self->data + self->size, value);
+    return true;
+}
@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Growable character buffer. The content is always zero terminated.
+// With a file attached the buffer is written to the file whenever it is
+// full instead of growing, so it only grows for single large appends.
+typedef struct
+{
+    char *data;
+    size_t size;
+    size_t capacity;
+    FILE *file;
+} Buffer_t;
+
+void bufferInit(Buffer_t *self);
+void bufferFree(Buffer_t *self);
+void bufferClear(Buffer_t *self);
+void bufferAttach(Buffer_t *self, FILE *file);
+bool bufferFlush(Buffer_t *self);
+bool bufferReserve(Buffer_t *self, size_t additional);
+bool bufferAppend(Buffer_t *self, const char *data, size_t size);
+bool bufferAppendString(Buffer_t *self, const char *s);
+bool bufferAppendChar(Buffer_t *self, char c);
+bool bufferAppendUint32(Buffer_t *self, uint32_t value);
+bool bufferAppendInt64(Buffer_t *self, int64_t value);
+bool bufferAppendDouble(Buffer_t *self, double value);
+bool bufferAppendFixed(Buffer_t *self, double value);
@@ -0,0 +1,351 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "catalog.h"
+#include "system.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CATALOG_MAX_FIELDS 8
+
+void catalogInit(Catalog_t *self)
+{
+    memset(self, 0, sizeof(Catalog_t));
+    bufferInit(&self->strings);
+}
+
+void catalogFree(Catalog_t *self)
+{
+    free(self->files);
+    free(self->records);
+    bufferFree(&self->strings);
+    catalogInit(self);
+}
+
+static uint32_t addString(Catalog_t *self, const char *s, size_t length)
+{
+    uint32_t offset = (uint32_t)self->strings.size;
+
+    if (!bufferAppend(&self->strings, s, length) || !bufferAppendChar(&self->strings, '\0'))
+    {
+        return CATALOG_NO_STRING;
+    }
+    return offset;
+}
+
+uint32_t catalogAddString(Catalog_t *self, const char *s)
+{
+    return s ? addString(self, s, strlen(s)) : CATALOG_NO_STRING;
+}
+
+const char *catalogString(const Catalog_t *self, uint32_t offset)
+{
+    return offset == CATALOG_NO_STRING ? NULL : self->strings.data + offset;
+}
+
+CatalogFile_t *catalogAddFile(Catalog_t *self, const char *name)
+{
+    CatalogFile_t *file;
+
+    if (self->fileCount == self->fileCapacity)
+    {
+        size_t capacity = self->fileCapacity ? 2 * self->fileCapacity : 64;
+        CatalogFile_t *files = realloc(self->files, capacity * sizeof(CatalogFile_t));
+
+        if (files == NULL)
+        {
+            return NULL;
+        }
+        self->files = files;
+        self->fileCapacity = capacity;
+    }
+
+    file = &self->files[self->fileCount++];
+    memset(file, 0, sizeof(CatalogFile_t));
+    file->name = catalogAddString(self, name);
+    file->serialNumber = CATALOG_NO_STRING;
+    file->firmwareVersion = CATALOG_NO_STRING;
+    file->first = self->recordCount;
+
+    return file;
+}
+
+CatalogRecord_t *catalogAddRecord(Catalog_t *self)
+{
+    CatalogRecord_t *record;
+
+    if (self->recordCount == self->recordCapacity)
+    {
+        size_t capacity = self->recordCapacity ? 2 * self->recordCapacity : 1024;
+        CatalogRecord_t *records = realloc(self->records, capacity * sizeof(CatalogRecord_t));
+
+        if (records == NULL)
+        {
+            return NULL;
+        }
+        self->records = records;
+        self->recordCapacity = capacity;
+    }
+
+    record = &self->records[self->recordCount++];
+    record->offset = 0;
+    record->timestamp = CATALOG_NO_STRING;
+    record->comment = CATALOG_NO_STRING;
+    self->files[self->fileCount - 1].count++;
+
+    return record;
+}
+
+const CatalogFile_t *catalogFindFile(const Catalog_t *self, const char *name)
+{
+    size_t low = 0;
+    size_t high = self->fileCount;
+
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        int cmp = strcmp(catalogString(self, self->files[middle].name), name);
+
+        if (cmp == 0)
+        {
+            return &self->files[middle];
+        }
+        if (cmp < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return NULL;
+}
+
+// Unescapes a field in place and returns the new length.
+static size_t unescape(char *field, size_t length)
+{
+    size_t out = 0;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        if (field[i] == '\\' && i + 1 < length)
+        {
+            i++;
+            field[out++] = field[i] == 't' ? '\t' : field[i] == 'n' ? '\n' : field[i] == 'r' ? '\r' : field[i];
+        }
+        else
+        {
+            field[out++] = field[i];
+        }
+    }
+    return out;
+}
+
+static uint32_t addField(Catalog_t *self, char *field, size_t length)
+{
+    if (length == 2 && field[0] == '\\' && field[1] == '-')
+    {
+        return CATALOG_NO_STRING;
+    }
+    return addString(self, field, unescape(field, length));
+}
+
+static bool parseLine(Catalog_t *self, char *line, size_t length)
+{
+    char *fields[CATALOG_MAX_FIELDS];
+    size_t lengths[CATALOG_MAX_FIELDS];
+    size_t count = 0;
+    char *start = line;
+
+    for (size_t i = 0; i <= length && count < CATALOG_MAX_FIELDS; i++)
+    {
+        if (i == length || line[i] == '\t')
+        {
+            fields[count] = start;
+            lengths[count] = line + i - start;
+            count++;
+            start = line + i + 1;
+        }
+    }
+
+    if (count == 8 && lengths[0] == 1 && fields[0][0] == 'F')
+    {
+        CatalogFile_t *file;
+
+        fields[1][unescape(fields[1], lengths[1])] = '\0';
+        file = catalogAddFile(self, fields[1]);
+        if (file == NULL)
+        {
+            return false;
+        }
+        file->mtime = strtoll(fields[2], NULL, 10);
+        file->size = strtoull(fields[3], NULL, 10);
+        file->isArchive = lengths[5] == 7 && strncmp(fields[5], "archive", 7) == 0;
+        file->serialNumber = addField(self, fields[6], lengths[6]);
+        file->firmwareVersion = addField(self, fields[7], lengths[7]);
+        return true;
+    }
+    else if (count == 4 && lengths[0] == 1 && fields[0][0] == 'R' && self->fileCount > 0)
+    {
+        CatalogRecord_t *record = catalogAddRecord(self);
+
+        if (record == NULL)
+        {
+            return false;
+        }
+        record->offset = strtoull(fields[1], NULL, 10);
+        record->timestamp = addField(self, fields[2], lengths[2]);
+        record->comment = addField(self, fields[3], lengths[3]);
+        return true;
+    }
+
+    return false;
+}
+
+bool catalogLoad(Catalog_t *self, const char *file)
+{
+    FILE *fin = fopen(file, "rb");
+    char *text;
+    long size;
+    bool ok;
+
+    catalogInit(self);
+
+    if (fin == NULL)
+    {
+        return false;
+    }
+
+    fseek(fin, 0, SEEK_END);
+    size = ftell(fin);
+    fseek(fin, 0, SEEK_SET);
+    text = malloc(size + 1);
+    ok = text != NULL && size >= 0 && fread(text, 1, size, fin) == (size_t)size;
+    fclose(fin);
+
+    if (ok)
+    {
+        char *line = text;
+        char *end = text + size;
+
+        text[size] = '\0';
+        ok = strncmp(line, CATALOG_HEADER "\n", sizeof(CATALOG_HEADER)) == 0;
+        line += sizeof(CATALOG_HEADER);
+
+        while (ok && line < end)
+        {
+            char *newline = memchr(line, '\n', end - line);
+            size_t length = newline ? (size_t)(newline - line) : (size_t)(end - line);
+
+            ok = parseLine(self, line, length);
+            line += length + 1;
+        }
+    }
+
+    free(text);
+    if (!ok)
+    {
+        catalogFree(self);
+    }
+    return ok;
+}
+
+static bool appendField(Buffer_t *out, const char *s)
+{
+    bool ok = bufferAppendChar(out, '\t');
+
+    if (s == NULL)
+    {
+        return ok && bufferAppend(out, "\\-", 2);
+    }
+
+    for (; *s && ok; s++)
+    {
+        switch (*s)
+        {
+            case '\t':
+                ok = bufferAppend(out, "\\t", 2);
+                break;
+            case '\n':
+                ok = bufferAppend(out, "\\n", 2);
+                break;
+            case '\r':
+                ok = bufferAppend(out, "\\r", 2);
+                break;
+            case '\\':
+                ok = bufferAppend(out, "\\\\", 2);
+                break;
+            default:
+                ok = bufferAppendChar(out, *s);
+                break;
+        }
+    }
+    return ok;
+}
+
+// Written to FILE.tmp which then replaces FILE.
+bool catalogSave(const Catalog_t *self, const char *file)
+{
+    size_t size = strlen(file) + sizeof(".tmp");
+    char *tempFile = malloc(size);
+    Buffer_t out;
+    FILE *fout;
+    bool ok;
+
+    if (tempFile == NULL)
+    {
+        return false;
+    }
+    snprintf(tempFile, size, "%s.tmp", file);
+
+    fout = fopen(tempFile, "wb");
+    if (fout == NULL)
+    {
+        free(tempFile);
+        return false;
+    }
+
+    bufferInit(&out);
+    bufferAttach(&out, fout);
+    ok = bufferAppendString(&out, CATALOG_HEADER "\n");
+
+    for (size_t i = 0; i < self->fileCount && ok; i++)
+    {
+        const CatalogFile_t *catalogFile = &self->files[i];
+
+        ok = bufferAppendChar(&out, 'F') &&
+             appendField(&out, catalogString(self, catalogFile->name)) &&
+             bufferAppendChar(&out, '\t') && bufferAppendInt64(&out, catalogFile->mtime) &&
+             bufferAppendChar(&out, '\t') && bufferAppendInt64(&out, (int64_t)catalogFile->size) &&
+             bufferAppendChar(&out, '\t') && bufferAppendInt64(&out, (int64_t)catalogFile->count) &&
+             appendField(&out, catalogFile->isArchive ? "archive" : "json") &&
+             appendField(&out, catalogString(self, catalogFile->serialNumber)) &&
+             appendField(&out, catalogString(self, catalogFile->firmwareVersion)) &&
+             bufferAppendChar(&out, '\n');
+
+        for (size_t r = catalogFile->first; r < catalogFile->first + catalogFile->count && ok; r++)
+        {
+            const CatalogRecord_t *record = &self->records[r];
+
+            ok = bufferAppendChar(&out, 'R') &&
+                 bufferAppendChar(&out, '\t') && bufferAppendInt64(&out, (int64_t)record->offset) &&
+                 appendField(&out, catalogString(self, record->timestamp)) &&
+                 appendField(&out, catalogString(self, record->comment)) &&
+                 bufferAppendChar(&out, '\n');
+        }
+    }
+
+    ok = ok && bufferFlush(&out);
+    bufferFree(&out);
+    ok = (fclose(fout) == 0) && ok;
+    ok = ok && systemReplaceFile(tempFile, file);
+    if (!ok)
+    {
+        remove(tempFile);
+    }
+
+    free(tempFile);
+    return ok;
+}
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#pragma once
+
+#include "buffer.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Catalog of the data files in a directory, stored as CATALOG_FILE_NAME in
+// the directory. It is a text file with one line per file followed by one
+// line per record of the file:
+//
+//   F  NAME  MTIME  SIZE  RECORDS  FORMAT  SERIALNUMBER  FIRMWAREVERSION
+//   R  OFFSET  TIMESTAMP  COMMENT
+//
+// The fields are separated by tabs. Tabs, line breaks and backslashes in
+// strings are escaped with a backslash, a missing string is written as \-.
+// FORMAT is json or archive.
+// OFFSET is the byte offset of the record in a JSON file and the record
+// index in an archive.
+
+#define CATALOG_FILE_NAME ".colibri-catalog"
+#define CATALOG_HEADER "colibri-catalog 1"
+#define CATALOG_NO_STRING UINT32_MAX
+
+typedef struct
+{
+    uint32_t name;
+    int64_t mtime;
+    uint64_t size;
+    uint32_t serialNumber;
+    uint32_t firmwareVersion;
+    bool isArchive;
+    size_t first;
+    size_t count;
+} CatalogFile_t;
+
+typedef struct
+{
+    uint64_t offset;
+    uint32_t timestamp;
+    uint32_t comment;
+} CatalogRecord_t;
+
+// The files are sorted by name, the records of a file are the count records
+// starting at first.
+typedef struct
+{
+    CatalogFile_t *files;
+    size_t fileCount;
+    size_t fileCapacity;
+    CatalogRecord_t *records;
+    size_t recordCount;
+    size_t recordCapacity;
+    Buffer_t strings;
+} Catalog_t;
+
+void catalogInit(Catalog_t *self);
+void catalogFree(Catalog_t *self);
+uint32_t catalogAddString(Catalog_t *self, const char *s);
+const char *catalogString(const Catalog_t *self, uint32_t offset);
+CatalogFile_t *catalogAddFile(Catalog_t *self, const char *name);
+// Adds a record to the file added last.
+CatalogRecord_t *catalogAddRecord(Catalog_t *self);
+const CatalogFile_t *catalogFindFile(const Catalog_t *self, const char *name);
+bool catalogLoad(Catalog_t *self, const char *file);
+bool catalogSave(const Catalog_t *self, const char *file);
@@ -2,30 +2,60 @@
 // SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
 
 #include "cmdmeasure.h"
+#include "cmdbaseline.h"
+#include "levellingpolicy.h"
 #include "printerror.h"
 #include "colibri.h"
 #include <stdlib.h>
 #include <stdio.h>
 
-Error_t cmdBaseline(Colibri_t * self)
+// With --auto-levelling the policy decides over one open port whether a
+// levelling is run in front of the baseline.
+static Error_t policyBaseline(Colibri_t * self, LevellingPolicy_t * policy, uint32_t * values)
 {
-    uint32_t sample230 = 0;
-    uint32_t reference230 = 0;
-    uint32_t sample260 = 0;
-    uint32_t reference260 = 0;
-    uint32_t sample280 = 0;
-    uint32_t reference280 = 0;
-    uint32_t sample340 = 0;
-    uint32_t reference340 = 0;
+    Levelling_t levelling[4];
+    bool isLevelled;
+    Error_t ret = colibriOpen(self);
 
-    Error_t ret = colibriBaseline(self, &sample230, &reference230, &sample260, &reference260, &sample280, &reference280, &sample340, &reference340);
     if (ret == ERROR_COLIBRI_OK)
     {
-        fprintf(stdout, "%i %i %i %i %i %i %i %i\n", sample230, reference230, sample260, reference260, sample280, reference280, sample340, reference340);
+        ret = levellingPolicyBaseline(self, policy, levelling, values, &isLevelled);
+        colibriClose(self);
+    }
+    return ret;
+}
+
+Error_t cmdBaseline(Colibri_t * self, int argcCmd, char **argvCmd)
+{
+    LevellingPolicy_t policy;
+    uint32_t values[8] = {0};
+    Error_t ret;
+
+    levellingPolicyInit(&policy);
+    for (int i = 1; i < argcCmd; i++)
+    {
+        if (!levellingPolicyParse(&policy, argcCmd, argvCmd, &i))
+        {
+            return printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION, "Unknown option: %s\n", argvCmd[i]);
+        }
+    }
+
+    if (policy.isEnabled)
+    {
+        ret = policyBaseline(self, &policy, values);
+    }
+    else
+    {
+        ret = colibriBaseline(self, &values[0], &values[1], &values[2], &values[3], &values[4], &values[5], &values[6], &values[7]);
+    }
+
+    if (ret == ERROR_COLIBRI_OK)
+    {
+        measurePrint(OUTPUT_BASELINE, values);
     }
     else
     {
         printError(ret, NULL);
     }
     return ret;
-}
\ No newline at end of file
+}
@@ -5,4 +5,4 @@
 
 #include "colibri.h"
 
-Error_t cmdBaseline(Colibri_t * self);
+Error_t cmdBaseline(Colibri_t * self, int argcCmd, char **argvCmd);
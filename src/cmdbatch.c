@@ -0,0 +1,764 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "cmdbatch.h"
+#include "cmdsave.h"
+#include "levellingpolicy.h"
+#include "printerror.h"
+#include "colibri.h"
+#include "colibriJson.h"
+#include "colibriCalc.h"
+#include "buffer.h"
+#include "output.h"
+#include "system.h"
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// One line of the manifest. comment is the comment the measurement is saved
+// with: the sample id, followed by the comment of the manifest if there is one.
+typedef struct
+{
+    const char *id;
+    char *comment;
+    bool hasAir;
+} BatchSample_t;
+
+typedef struct
+{
+    char *text;
+    BatchSample_t *samples;
+    size_t count;
+    size_t capacity;
+} Manifest_t;
+
+// The measurement handed to the background thread, which saves it and
+// calculates it while the device measures the next sample. The result is
+// printed by the main thread, which owns the output.
+typedef struct
+{
+    const Manifest_t *manifest;
+    const SaveDevice_t *device;
+    const char *file;
+    bool verbose;
+    double pathLength;
+    double a260Unit;
+    uint32_t blanks;
+    CalcBlanks_t blanksSums;
+    size_t first;
+    struct timespec start;
+    size_t index;
+    SaveMeasurement_t measurement;
+    SystemThread_t thread;
+    bool isRunning;
+    Error_t ret;
+    bool hasResult;
+    double od[WAVELENGTH_COUNT];
+    double concentration;
+    double elapsed;
+} Batch_t;
+
+static void manifestFree(Manifest_t *self)
+{
+    for (size_t i = 0; i < self->count; i++)
+    {
+        free(self->samples[i].comment);
+    }
+    free(self->samples);
+    free(self->text);
+    memset(self, 0, sizeof(Manifest_t));
+}
+
+// Parses the field at *position in place and moves *position behind its
+// separator. Returns the separator, which is '\n' at the end of a line and
+// '\0' at the end of the text. Fields may be quoted, "" is a quote in a
+// quoted field.
+static char manifestField(char **position, char **field)
+{
+    char *in = *position;
+    char *out = in;
+    bool isQuoted = false;
+    char separator;
+
+    while (*in == ' ' || *in == '\t')
+    {
+        in++;
+    }
+    *field = out;
+
+    while (*in != '\0')
+    {
+        if (isQuoted && in[0] == '"' && in[1] == '"')
+        {
+            *out++ = '"';
+            in += 2;
+        }
+        else if (*in == '"')
+        {
+            isQuoted = !isQuoted;
+            in++;
+        }
+        else if (!isQuoted && (*in == ',' || *in == '\n'))
+        {
+            break;
+        }
+        else if (!isQuoted && *in == '\r')
+        {
+            in++;
+        }
+        else
+        {
+            *out++ = *in++;
+        }
+    }
+
+    separator = *in;
+    if (separator != '\0')
+    {
+        in++;
+    }
+    while (out > *field && (out[-1] == ' ' || out[-1] == '\t'))
+    {
+        out--;
+    }
+    *out = '\0';
+    *position = in;
+
+    return separator;
+}
+
+static bool equalsIgnoreCase(const char *a, const char *b)
+{
+    while (*a && tolower((unsigned char)*a) == tolower((unsigned char)*b))
+    {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+static bool manifestAir(const char *value, bool *hasAir)
+{
+    static const char *yes[] = {"1", "yes", "y", "true"};
+    static const char *no[] = {"", "0", "no", "n", "false"};
+
+    for (size_t i = 0; i < sizeof(yes) / sizeof(yes[0]); i++)
+    {
+        if (equalsIgnoreCase(value, yes[i]))
+        {
+            *hasAir = true;
+            return true;
+        }
+    }
+    for (size_t i = 0; i < sizeof(no) / sizeof(no[0]); i++)
+    {
+        if (equalsIgnoreCase(value, no[i]))
+        {
+            *hasAir = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+// A header is told apart by the name of its first column, a sample id is
+// free text and may look like anything else.
+static bool manifestHeader(const char *id)
+{
+    static const char *names[] = {"sampleid", "sample", "id"};
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        if (equalsIgnoreCase(id, names[i]))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static Error_t manifestAdd(Manifest_t *self, const char *id, const char *comment, bool hasAir)
+{
+    BatchSample_t *sample;
+    size_t size = strlen(id) + strlen(comment) + 3;
+
+    if (self->count == self->capacity)
+    {
+        size_t capacity = self->capacity ? 2 * self->capacity : 96;
+        BatchSample_t *samples = realloc(self->samples, capacity * sizeof(BatchSample_t));
+
+        if (samples == NULL)
+        {
+            return ERROR_COLIBRI_OUT_OF_MEMORY;
+        }
+        self->samples = samples;
+        self->capacity = capacity;
+    }
+
+    sample = &self->samples[self->count];
+    sample->id = id;
+    sample->hasAir = hasAir;
+    sample->comment = malloc(size);
+    if (sample->comment == NULL)
+    {
+        return ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+    snprintf(sample->comment, size, comment[0] ? "%s: %s" : "%s", id, comment);
+    self->count++;
+
+    return ERROR_COLIBRI_OK;
+}
+
+// Lines are SAMPLEID,COMMENT,AIR, where COMMENT and AIR may be left out.
+// Empty lines and lines starting with # are skipped. The first other line
+// is a header if its first field is SAMPLEID, SAMPLE or ID in any case,
+// other headers have to start with #.
+static Error_t manifestLoad(Manifest_t *self, const char *file)
+{
+    FILE *fin = fopen(file, "rb");
+    Error_t ret = ERROR_COLIBRI_OK;
+    char *position;
+    long size;
+    int line = 0;
+    bool isFirst = true;
+
+    memset(self, 0, sizeof(Manifest_t));
+
+    if (fin == NULL)
+    {
+        return printError(ERROR_COLIBRI_FILE_NOT_FOUND, "File %s not found.\n", file);
+    }
+
+    fseek(fin, 0, SEEK_END);
+    size = ftell(fin);
+    fseek(fin, 0, SEEK_SET);
+    self->text = size >= 0 ? malloc(size + 1) : NULL;
+    if (self->text == NULL || fread(self->text, 1, size, fin) != (size_t)size)
+    {
+        fclose(fin);
+        manifestFree(self);
+        return printError(ERROR_COLIBRI_OUT_OF_MEMORY, NULL);
+    }
+    fclose(fin);
+    self->text[size] = '\0';
+
+    position = self->text;
+    while (*position != '\0' && ret == ERROR_COLIBRI_OK)
+    {
+        char *fields[3] = {"", "", ""};
+        size_t count = 0;
+        char separator;
+        bool hasAir;
+
+        line++;
+        do
+        {
+            char *field;
+
+            separator = manifestField(&position, &field);
+            if (count < 3)
+            {
+                fields[count] = field;
+            }
+            count++;
+        } while (separator == ',');
+
+        if ((count == 1 && fields[0][0] == '\0') || fields[0][0] == '#')
+        {
+            continue;
+        }
+
+        if (isFirst)
+        {
+            isFirst = false;
+            if (manifestHeader(fields[0]))
+            {
+                continue;
+            }
+        }
+
+        if (!manifestAir(fields[2], &hasAir))
+        {
+            ret = printError(ERROR_COLIBRI_INVALID_FILE_FORMAT, "%s:%i: invalid air value %s\n", file, line, fields[2]);
+        }
+        else if (count > 3 || fields[0][0] == '\0')
+        {
+            ret = printError(ERROR_COLIBRI_INVALID_FILE_FORMAT, "%s:%i: expected SAMPLEID,COMMENT,AIR\n", file, line);
+        }
+        else
+        {
+            ret = manifestAdd(self, fields[0], fields[1], hasAir);
+        }
+    }
+
+    if (ret == ERROR_COLIBRI_OK && self->count == 0)
+    {
+        ret = printError(ERROR_COLIBRI_INVALID_FILE_FORMAT, "%s: no samples\n", file);
+    }
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        manifestFree(self);
+    }
+    return ret;
+}
+
+// Continues behind the measurements already saved to the file, which have
+// to be the first samples of the manifest. Their blanks are added.
+static Error_t batchResume(Batch_t *batch)
+{
+    FILE *fin = fopen(batch->file, "rb");
+    ColibriJsonFormat_t format;
+    ColibriJsonScope_t scope;
+    Error_t ret = ERROR_COLIBRI_OK;
+    DataFile_t data;
+    cJSON *json;
+
+    batch->first = 0;
+    if (fin == NULL)
+    {
+        return ERROR_COLIBRI_OK;
+    }
+    fclose(fin);
+
+    colibriJsonScopeBegin(&scope, batch->verbose);
+    json = colibriJsonLoad((char *)batch->file, &format);
+    if (json == NULL)
+    {
+        ret = printError(ERROR_COLIBRI_INVALID_FILE_FORMAT, "File %s is not a data file.\n", batch->file);
+    }
+    else if (!colibriJsonDecode(json, &data))
+    {
+        ret = printError(ERROR_COLIBRI_OUT_OF_MEMORY, NULL);
+    }
+    else
+    {
+        if (data.count > batch->manifest->count)
+        {
+            ret = printError(ERROR_COLIBRI_INVALID_FILE_FORMAT, "File %s has more measurements than the manifest.\n", batch->file);
+        }
+        for (size_t i = 0; i < data.count && ret == ERROR_COLIBRI_OK; i++)
+        {
+            const char *comment = dataFileString(&data, data.records[i].comment);
+
+            if (comment == NULL || strcmp(comment, batch->manifest->samples[i].comment) != 0)
+            {
+                ret = printError(ERROR_COLIBRI_INVALID_FILE_FORMAT, "Measurement %zu of %s is not sample %s of the manifest.\n", i, batch->file, batch->manifest->samples[i].id);
+            }
+        }
+        if (ret == ERROR_COLIBRI_OK)
+        {
+            calcBlanksAdd(&batch->blanksSums, &data.measurements, data.count, 0, batch->blanks);
+            batch->first = data.count;
+        }
+        dataFileFree(&data);
+    }
+    colibriJsonRelease(json);
+    colibriJsonScopeEnd(&scope);
+
+    return ret;
+}
+
+static void formatDuration(double seconds, char *text, size_t size)
+{
+    long s = (long)(seconds + 0.5);
+
+    snprintf(text, size, "%02ld:%02ld:%02ld", s / 3600, (s / 60) % 60, s % 60);
+}
+
+static double elapsedSeconds(const struct timespec *start)
+{
+    struct timespec now;
+
+    timespec_get(&now, TIME_UTC);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Calculates the saved measurement with the blanks saved up to it.
+static Error_t batchCalculate(Batch_t *batch)
+{
+    const SaveMeasurement_t *measurement = &batch->measurement;
+    double factors[WAVELENGTH_COUNT];
+    Measurements_t m;
+    Results_t results;
+    bool ok;
+
+    if (!measurementsCreate(&m, 1))
+    {
+        return ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+    if (!resultsCreate(&results, 1))
+    {
+        measurementsFree(&m);
+        return ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+
+    m.hasAir[0] = measurement->hasAir;
+    for (int w = 0; w < WAVELENGTH_COUNT; w++)
+    {
+        m.sample[ROLE_BASELINE][w][0] = measurement->baseline[2 * w];
+        m.reference[ROLE_BASELINE][w][0] = measurement->baseline[2 * w + 1];
+        m.sample[ROLE_AIR][w][0] = measurement->hasAir ? measurement->air[2 * w] : 1.0;
+        m.reference[ROLE_AIR][w][0] = measurement->hasAir ? measurement->air[2 * w + 1] : 1.0;
+        m.sample[ROLE_SAMPLE][w][0] = measurement->sample[2 * w];
+        m.reference[ROLE_SAMPLE][w][0] = measurement->sample[2 * w + 1];
+    }
+
+    calcBlanksAdd(&batch->blanksSums, &m, 1, batch->index, batch->blanks);
+    calcBlanksFactors(&batch->blanksSums, factors);
+    ok = calcResults(&m, factors, batch->pathLength, batch->a260Unit, &results);
+
+    if (ok)
+    {
+        for (int w = 0; w < WAVELENGTH_COUNT; w++)
+        {
+            batch->od[w] = results.od[w][0];
+        }
+        batch->concentration = measurement->hasAir ? results.concentration[0] : NAN;
+    }
+
+    resultsFree(&results);
+    measurementsFree(&m);
+    return ok ? ERROR_COLIBRI_OK : ERROR_COLIBRI_OUT_OF_MEMORY;
+}
+
+// Runs in the background: saves and calculates.
+static void batchCommit(void *argument)
+{
+    Batch_t *batch = argument;
+
+    batch->ret = saveDeviceMeasurement(batch->device, batch->verbose, batch->file, batch->manifest->samples[batch->index].comment, &batch->measurement);
+    if (batch->ret == ERROR_COLIBRI_OK)
+    {
+        batch->ret = batchCalculate(batch);
+    }
+    batch->hasResult = batch->ret == ERROR_COLIBRI_OK;
+    batch->elapsed = elapsedSeconds(&batch->start);
+}
+
+// Prints the result of the last save like data watch, with --format as a
+// calculated record, and reports the progress.
+static void batchPrint(Batch_t *batch)
+{
+    const BatchSample_t *sample = &batch->manifest->samples[batch->index];
+    size_t done = batch->index + 1 - batch->first;
+    size_t left = batch->manifest->count - batch->index - 1;
+    static const char *names[WAVELENGTH_COUNT] = {"od230", "od260", "od280", "od340"};
+    char textElapsed[32];
+    char textEta[32];
+
+    if (outputFormat() == OUTPUT_TEXT)
+    {
+        Buffer_t *out = outputBuffer();
+
+        bufferAppendUint32(out, (uint32_t)batch->index);
+        bufferAppendChar(out, ' ');
+        for (int w = 0; w < WAVELENGTH_COUNT; w++)
+        {
+            bufferAppendFixed(out, batch->od[w]);
+            bufferAppendChar(out, ' ');
+        }
+        if (batch->measurement.hasAir)
+        {
+            bufferAppendFixed(out, batch->concentration);
+            bufferAppendChar(out, ' ');
+        }
+        bufferAppendString(out, sample->comment);
+        bufferAppendString(out, " \n");
+    }
+    else
+    {
+        outputBegin(OUTPUT_CALCULATED);
+        outputUint32("index", (uint32_t)batch->index);
+        for (int w = 0; w < WAVELENGTH_COUNT; w++)
+        {
+            outputDouble(names[w], batch->od[w]);
+        }
+        outputDouble("concentration", batch->concentration);
+        outputString("comment", sample->comment);
+        outputEnd();
+    }
+    outputFlush();
+
+    // The estimate is the mean time per sample of this session, waiting
+    // for the operator included.
+    formatDuration(batch->elapsed, textElapsed, sizeof(textElapsed));
+    formatDuration(batch->elapsed / (double)done * (double)left, textEta, sizeof(textEta));
+    fprintf(stderr, "Saved sample %zu/%zu %s, elapsed %s, remaining %s\n", batch->index + 1, batch->manifest->count, sample->id, textElapsed, textEta);
+}
+
+// Waits for the background thread, prints its result and returns the
+// result of its save.
+static Error_t batchJoin(Batch_t *batch)
+{
+    if (batch->isRunning)
+    {
+        systemThreadJoin(&batch->thread);
+        batch->isRunning = false;
+    }
+    if (batch->hasResult)
+    {
+        batchPrint(batch);
+        batch->hasResult = false;
+    }
+    return batch->ret;
+}
+
+static void batchStart(Batch_t *batch, size_t index, const SaveMeasurement_t *measurement)
+{
+    batch->index = index;
+    batch->measurement = *measurement;
+    batch->isRunning = systemThreadStart(&batch->thread, batchCommit, batch);
+    if (!batch->isRunning)
+    {
+        batchCommit(batch);
+    }
+}
+
+static void batchWait(bool wait, const char *format, const char *id)
+{
+    char line[100];
+
+    if (!wait)
+    {
+        return;
+    }
+    fprintf(stderr, format, id);
+    fprintf(stderr, " and press enter.\n");
+    if (fgets(line, sizeof(line), stdin) == NULL)
+    {
+        clearerr(stdin);
+    }
+}
+
+static Error_t batchLevelling(Colibri_t *self, Levelling_t *levelling)
+{
+    Error_t ret = colibriLevelling(self, &levelling[0], &levelling[1], &levelling[2], &levelling[3]);
+
+    for (int i = 0; i < 4 && ret == ERROR_COLIBRI_OK; i++)
+    {
+        if (levelling[i].result != 0)
+        {
+            ret = ERROR_COLIBRI_LEVELLING_FAILED;
+        }
+    }
+    return ret;
+}
+
+static Error_t batchMeasure(Colibri_t *self, bool isBaseline, uint32_t *values)
+{
+    if (isBaseline)
+    {
+        return colibriBaseline(self, &values[0], &values[1], &values[2], &values[3], &values[4], &values[5], &values[6], &values[7]);
+    }
+    return colibriMeasure(self, &values[0], &values[1], &values[2], &values[3], &values[4], &values[5], &values[6], &values[7]);
+}
+
+// Measures the samples of the manifest over one open port. The device
+// measures sample N+1 while sample N is saved in the background; with
+// wait the result of N is printed after the baseline of N+1. Without a
+// levelling policy the levelling runs once in front of the first sample.
+static Error_t batchRun(Colibri_t *self, Batch_t *batch, LevellingPolicy_t *policy, bool wait)
+{
+    const Manifest_t *manifest = batch->manifest;
+    Levelling_t levelling[4];
+    Error_t ret = ERROR_COLIBRI_OK;
+
+    if (!policy->isEnabled)
+    {
+        ret = batchLevelling(self, levelling);
+        if (ret != ERROR_COLIBRI_OK)
+        {
+            return printError(ret, NULL);
+        }
+    }
+
+    timespec_get(&batch->start, TIME_UTC);
+
+    for (size_t i = batch->first; i < manifest->count && ret == ERROR_COLIBRI_OK; i++)
+    {
+        const BatchSample_t *sample = &manifest->samples[i];
+        SaveMeasurement_t measurement;
+
+        memset(&measurement, 0, sizeof(measurement));
+        if (!policy->isEnabled)
+        {
+            memcpy(measurement.levelling, levelling, sizeof(levelling));
+        }
+        measurement.hasAir = sample->hasAir;
+        fprintf(stderr, "Sample %zu/%zu %s\n", i + 1, manifest->count, sample->id);
+
+        batchWait(wait, "Remove the cuvette for the baseline of %s", sample->id);
+        if (policy->isEnabled)
+        {
+            bool isLevelled;
+
+            ret = levellingPolicyBaseline(self, policy, measurement.levelling, measurement.baseline, &isLevelled);
+        }
+        else
+        {
+            ret = batchMeasure(self, true, measurement.baseline);
+        }
+
+        // With --wait the operator gets the result of the previous sample
+        // after the baseline, the save overlapped the prompt and the baseline
+        if (ret == ERROR_COLIBRI_OK && wait)
+        {
+            ret = batchJoin(batch);
+        }
+
+        if (ret == ERROR_COLIBRI_OK && sample->hasAir)
+        {
+            batchWait(wait, "Move the empty cuvette for %s into the cuvette holder", sample->id);
+            ret = batchMeasure(self, false, measurement.air);
+        }
+
+        if (ret == ERROR_COLIBRI_OK)
+        {
+            batchWait(wait, "Dispense sample %s into the cuvette", sample->id);
+            ret = batchMeasure(self, false, measurement.sample);
+        }
+
+        if (ret != ERROR_COLIBRI_OK)
+        {
+            printError(ret, "Sample %s: %s\n", sample->id, colibriError2String(ret));
+        }
+        else
+        {
+            // Only one measurement is handed over at a time
+            ret = batchJoin(batch);
+            if (ret == ERROR_COLIBRI_OK)
+            {
+                batchStart(batch, i, &measurement);
+            }
+        }
+    }
+
+    return ret;
+}
+
+// Steps through the samples of a manifest over one session and saves every
+// sample as soon as it is measured. A batch which was interrupted continues
+// behind the last saved sample when it is started again.
+Error_t cmdBatch(Colibri_t *self, int argcCmd, char **argvCmd)
+{
+    Manifest_t manifest;
+    SaveDevice_t device;
+    LevellingPolicy_t policy;
+    Batch_t batch;
+    const char *manifestFile = NULL;
+    const char *file = NULL;
+    char *defaultFile = NULL;
+    bool wait = false;
+    Error_t ret = ERROR_COLIBRI_OK;
+    Error_t retSave;
+
+    memset(&batch, 0, sizeof(batch));
+    batch.verbose = self->verbose;
+    batch.pathLength = 1.0;
+    batch.a260Unit = 50.0;
+    batch.blanks = 1;
+    calcBlanksInit(&batch.blanksSums);
+    levellingPolicyInit(&policy);
+
+    for (int i = 1; i < argcCmd; i++)
+    {
+        if (strcmp(argvCmd[i], "--wait") == 0)
+        {
+            wait = true;
+        }
+        else if (strcmp(argvCmd[i], "--out") == 0 && i + 1 < argcCmd)
+        {
+            file = argvCmd[++i];
+        }
+        else if (strcmp(argvCmd[i], "--pathLength") == 0 && i + 1 < argcCmd)
+        {
+            batch.pathLength = atof(argvCmd[++i]);
+        }
+        else if (strcmp(argvCmd[i], "--a260unit") == 0 && i + 1 < argcCmd)
+        {
+            batch.a260Unit = atof(argvCmd[++i]);
+        }
+        else if (strcmp(argvCmd[i], "--blanks") == 0 && i + 1 < argcCmd)
+        {
+            batch.blanks = atoi(argvCmd[++i]);
+        }
+        else if (argvCmd[i][0] != '-' && manifestFile == NULL)
+        {
+            manifestFile = argvCmd[i];
+        }
+        else if (!levellingPolicyParse(&policy, argcCmd, argvCmd, &i))
+        {
+            return printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION, "Unknown option: %s\n", argvCmd[i]);
+        }
+    }
+
+    if (manifestFile == NULL)
+    {
+        return printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_ARGUMENT, "Missing MANIFEST\n");
+    }
+
+    // Without --out the measurements go to MANIFEST with the extension .json
+    if (file == NULL)
+    {
+        const char *dot = strrchr(manifestFile, '.');
+        const char *slash = strrchr(manifestFile, '/');
+        size_t length = (dot && (slash == NULL || dot > slash)) ? (size_t)(dot - manifestFile) : strlen(manifestFile);
+
+        defaultFile = malloc(length + sizeof(".json"));
+        if (defaultFile == NULL)
+        {
+            return printError(ERROR_COLIBRI_OUT_OF_MEMORY, NULL);
+        }
+        memcpy(defaultFile, manifestFile, length);
+        strcpy(defaultFile + length, ".json");
+        file = defaultFile;
+    }
+
+    ret = manifestLoad(&manifest, manifestFile);
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        free(defaultFile);
+        return ret;
+    }
+
+    batch.manifest = &manifest;
+    batch.device = &device;
+    batch.file = file;
+
+    ret = batchResume(&batch);
+    if (ret == ERROR_COLIBRI_OK && batch.first == manifest.count)
+    {
+        fprintf(stderr, "All %zu samples are saved in %s\n", manifest.count, file);
+    }
+    else if (ret == ERROR_COLIBRI_OK)
+    {
+        if (batch.first > 0)
+        {
+            fprintf(stderr, "Resuming behind sample %zu/%zu %s saved in %s\n", batch.first, manifest.count, manifest.samples[batch.first - 1].id, file);
+        }
+
+        ret = colibriOpen(self);
+        if (ret == ERROR_COLIBRI_OK)
+        {
+            saveReadDevice(self, &device);
+            ret = batchRun(self, &batch, &policy, wait);
+        }
+        else
+        {
+            printError(ret, NULL);
+        }
+
+        retSave = batchJoin(&batch);
+        ret = ret == ERROR_COLIBRI_OK ? retSave : ret;
+        colibriClose(self);
+    }
+
+    manifestFree(&manifest);
+    free(defaultFile);
+
+    return ret;
+}
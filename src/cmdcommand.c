@@ -4,8 +4,10 @@
 #include "cmdcommand.h"
 #include "printerror.h"
 #include "colibri.h"
+#include "output.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 Error_t cmdCommand(Colibri_t * self, const char * command)
 {   
@@ -14,12 +16,19 @@ Error_t cmdCommand(Colibri_t * self, const char * command)
 
     if (ret == ERROR_COLIBRI_OK)
     {
+        char line[COLIBRI_MAX_LINE_LENGTH + 1] = "";
+
         for(uint32_t i=0; i<response->argc; i++)
         {
-            fprintf(stdout, "%s%s", i==0 ? "":" ", response->argv[i]);
+            if(i > 0)
+            {
+                strncat(line, " ", sizeof(line) - strlen(line) - 1);
+            }
+            strncat(line, response->argv[i], sizeof(line) - strlen(line) - 1);
         }
-        fprintf(stdout, "\n");
-        
+        outputBegin(OUTPUT_VALUE);
+        outputString("value", line);
+        outputEnd();
     }
     else
     {
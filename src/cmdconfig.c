@@ -0,0 +1,364 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "cmdconfig.h"
+#include "colibriJson.h"
+#include "printerror.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DICT_DEVICE "device"
+#define DICT_VALUES "values"
+#define DICT_INDEX "index"
+#define DICT_NAME "name"
+#define DICT_VALUE "value"
+
+#define CONFIG_VALUE_SIZE 100
+
+// The indices of a configuration. Settings are dumped to values and
+// restored, the others are read-only and dumped to device to tell where a
+// configuration comes from. INDEX_LAST_MEASUREMENT_COUNT is a read-only
+// status value which changes with every measurement, it is left out.
+static const struct
+{
+    uint32_t index;
+    const char *name;
+    bool isSetting;
+} configIndices[] = {
+    {INDEX_VERSION, "firmwareVersion", false},
+    {INDEX_SERIALNUMBER, "serialNumber", false},
+    {INDEX_HARDWARETYPE, "hardwareType", false},
+    {INDEX_LED230NM_MAX_CURRENT, "led230MaxCurrent", true},
+    {INDEX_LED260NM_MAX_CURRENT, "led260MaxCurrent", true},
+    {INDEX_LED280NM_MAX_CURRENT, "led280MaxCurrent", true},
+    {INDEX_LED340NM_MAX_CURRENT, "led340MaxCurrent", true},
+    {INDEX_AMPLIFIER_SAMPLEFACTOR___1_1, "sampleFactor1.1", true},
+    {INDEX_AMPLIFIER_SAMPLEFACTOR__11_0, "sampleFactor11.0", true},
+    {INDEX_AMPLIFIER_SAMPLEFACTOR_111_0, "sampleFactor111.0", true},
+    {INDEX_AMPLIFIER_REFERENCEFACTOR___1_1, "referenceFactor1.1", true},
+    {INDEX_AMPLIFIER_REFERENCEFACTOR__11_0, "referenceFactor11.0", true},
+    {INDEX_AMPLIFIER_REFERENCEFACTOR_111_0, "referenceFactor111.0", true},
+    {INDEX_SETUP_TARGET230, "setupTarget230", true},
+    {INDEX_SETUP_TARGET260, "setupTarget260", true},
+    {INDEX_SETUP_TARGET280, "setupTarget280", true},
+    {INDEX_SETUP_TARGET340, "setupTarget340", true},
+};
+
+#define CONFIG_COUNT (sizeof(configIndices) / sizeof(configIndices[0]))
+
+static int configFind(uint32_t index)
+{
+    for (size_t i = 0; i < CONFIG_COUNT; i++)
+    {
+        if (configIndices[i].index == index)
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static bool configIsReadOnly(uint32_t index)
+{
+    int i = configFind(index);
+
+    return index == INDEX_LAST_MEASUREMENT_COUNT || (i >= 0 && !configIndices[i].isSetting);
+}
+
+// Values are equal as text or as numbers, e.g. 11.0 and 11
+static bool configEqual(const char *a, const char *b)
+{
+    char *endA;
+    char *endB;
+    double numberA = strtod(a, &endA);
+    double numberB = strtod(b, &endB);
+
+    if (strcmp(a, b) == 0)
+    {
+        return true;
+    }
+    return endA != a && *endA == '\0' && endB != b && *endB == '\0' && numberA == numberB;
+}
+
+// A value is sent to the device as is, so it must be one word
+static bool configIsWord(const char *value)
+{
+    if (value[0] == '\0' || strlen(value) >= CONFIG_VALUE_SIZE)
+    {
+        return false;
+    }
+    for (const char *c = value; *c; c++)
+    {
+        if (isspace((unsigned char)*c) || iscntrl((unsigned char)*c))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads count indices with one pipelined batch per COLIBRI_PIPELINE_DEPTH
+// indices.
+static Error_t configRead(Colibri_t *self, const uint32_t *indices, size_t count, char (*values)[CONFIG_VALUE_SIZE])
+{
+    Error_t errors[CONFIG_COUNT];
+    Error_t ret = colibriGetValues(self, indices, count, values[0], CONFIG_VALUE_SIZE, errors);
+
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        return printError(ret, NULL);
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        if (errors[i] != ERROR_COLIBRI_OK)
+        {
+            return printError(errors[i], "Could not read index %u.\n", indices[i]);
+        }
+    }
+    return ERROR_COLIBRI_OK;
+}
+
+// Loads the entries of one array of a configuration file, every index must
+// be known. device holds the read-only indices, values the settings.
+static Error_t configLoadArray(const char *file, const cJSON *json, const char *name, uint32_t *indices, char (*values)[CONFIG_VALUE_SIZE], size_t *count)
+{
+    const cJSON *array = cJSON_GetObjectItem(json, name);
+    const cJSON *entry = array ? array->child : NULL;
+    bool isSettings = strcmp(name, DICT_VALUES) == 0;
+
+    for (size_t i = 0; entry != NULL; i++, entry = entry->next)
+    {
+        cJSON *index = cJSON_GetObjectItem(entry, DICT_INDEX);
+        cJSON *value = cJSON_GetObjectItem(entry, DICT_VALUE);
+
+        if (cJSON_IsNumber(index) && isSettings && configIsReadOnly((uint32_t)index->valueint))
+        {
+            return printError(ERROR_COLIBRI_INVALID_FILE_FORMAT, "File %s: index %i is read-only and cannot be restored.\n", file, index->valueint);
+        }
+        if (!cJSON_IsNumber(index) || !cJSON_IsString(value) || configFind((uint32_t)index->valueint) < 0 || *count == CONFIG_COUNT ||
+            isSettings != !configIsReadOnly((uint32_t)index->valueint))
+        {
+            return printError(ERROR_COLIBRI_INVALID_FILE_FORMAT, "File %s: entry %zu of %s is not a known index with a value.\n", file, i, name);
+        }
+        if (!configIsWord(value->valuestring))
+        {
+            return printError(ERROR_COLIBRI_INVALID_FILE_FORMAT, "File %s: invalid value of index %i.\n", file, index->valueint);
+        }
+        indices[*count] = (uint32_t)index->valueint;
+        strcpy(values[(*count)++], value->valuestring);
+    }
+    return ERROR_COLIBRI_OK;
+}
+
+// Loads the read-only values followed by the settings of a configuration
+// file.
+static Error_t configLoad(char *file, uint32_t *indices, char (*values)[CONFIG_VALUE_SIZE], size_t *count)
+{
+    cJSON *json = colibriJsonLoad(file, NULL);
+    Error_t ret;
+
+    *count = 0;
+    if (json == NULL)
+    {
+        return printError(ERROR_COLIBRI_FILE_NOT_FOUND, "File %s not found or not a JSON file.\n", file);
+    }
+
+    ret = configLoadArray(file, json, DICT_DEVICE, indices, values, count);
+    if (ret == ERROR_COLIBRI_OK)
+    {
+        ret = configLoadArray(file, json, DICT_VALUES, indices, values, count);
+    }
+    if (ret == ERROR_COLIBRI_OK && *count == 0)
+    {
+        ret = printError(ERROR_COLIBRI_INVALID_FILE_FORMAT, "File %s has no values.\n", file);
+    }
+    colibriJsonRelease(json);
+    return ret;
+}
+
+// Reads all indices, saves them and checks the saved file against them.
+static Error_t configDump(Colibri_t *self, char *file)
+{
+    uint32_t indices[CONFIG_COUNT];
+    char values[CONFIG_COUNT][CONFIG_VALUE_SIZE];
+    uint32_t savedIndices[CONFIG_COUNT];
+    char saved[CONFIG_COUNT][CONFIG_VALUE_SIZE];
+    size_t savedCount;
+    cJSON *json;
+    cJSON *device;
+    cJSON *settings;
+    Error_t ret;
+
+    for (size_t i = 0; i < CONFIG_COUNT; i++)
+    {
+        indices[i] = configIndices[i].index;
+    }
+
+    ret = colibriOpen(self);
+    if (ret == ERROR_COLIBRI_OK)
+    {
+        ret = configRead(self, indices, CONFIG_COUNT, values);
+        colibriClose(self);
+    }
+    else
+    {
+        printError(ret, NULL);
+    }
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        return ret;
+    }
+
+    json = cJSON_CreateObject();
+    device = cJSON_AddArrayToObject(json, DICT_DEVICE);
+    settings = cJSON_AddArrayToObject(json, DICT_VALUES);
+    for (size_t i = 0; i < CONFIG_COUNT; i++)
+    {
+        cJSON *entry = cJSON_CreateObject();
+
+        cJSON_AddNumberToObject(entry, DICT_INDEX, indices[i]);
+        cJSON_AddStringToObject(entry, DICT_NAME, configIndices[i].name);
+        cJSON_AddStringToObject(entry, DICT_VALUE, values[i]);
+        cJSON_AddItemToArray(configIndices[i].isSetting ? settings : device, entry);
+    }
+    if (!colibriJsonSave(file, json, COLIBRI_JSON_PRETTY))
+    {
+        ret = printError(ERROR_COLIBRI_FILE_WRITE_ERROR, "Could not write %s.\n", file);
+    }
+    colibriJsonRelease(json);
+
+    if (ret == ERROR_COLIBRI_OK)
+    {
+        ret = configLoad(file, savedIndices, saved, &savedCount);
+    }
+    for (size_t i = 0; i < CONFIG_COUNT && ret == ERROR_COLIBRI_OK; i++)
+    {
+        if (savedCount != CONFIG_COUNT || savedIndices[i] != indices[i] || strcmp(saved[i], values[i]) != 0)
+        {
+            ret = printError(ERROR_COLIBRI_VERIFY_FAILED, "File %s differs from the values read.\n", file);
+        }
+    }
+    return ret;
+}
+
+// Writes the settings of the file which differ from the device and reads
+// them back.
+static Error_t configRestore(Colibri_t *self, char *file)
+{
+    uint32_t indices[CONFIG_COUNT];
+    char values[CONFIG_COUNT][CONFIG_VALUE_SIZE];
+    char current[CONFIG_COUNT][CONFIG_VALUE_SIZE];
+    char readBack[CONFIG_COUNT][CONFIG_VALUE_SIZE];
+    uint32_t changedIndices[CONFIG_COUNT];
+    const char *changedValues[CONFIG_COUNT];
+    const char *previousValues[CONFIG_COUNT];
+    Error_t errors[CONFIG_COUNT];
+    size_t count;
+    size_t settings = 0;
+    size_t changed = 0;
+    Error_t ret;
+
+    ret = configLoad(file, indices, values, &count);
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        return ret;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (configIndices[configFind(indices[i])].isSetting)
+        {
+            indices[settings] = indices[i];
+            memmove(values[settings++], values[i], CONFIG_VALUE_SIZE);
+        }
+    }
+    if (settings == 0)
+    {
+        return printError(ERROR_COLIBRI_INVALID_FILE_FORMAT, "File %s has no settings.\n", file);
+    }
+
+    ret = colibriOpen(self);
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        return printError(ret, NULL);
+    }
+
+    ret = configRead(self, indices, settings, current);
+    for (size_t i = 0; i < settings && ret == ERROR_COLIBRI_OK; i++)
+    {
+        if (!configEqual(values[i], current[i]))
+        {
+            changedIndices[changed] = indices[i];
+            changedValues[changed] = values[i];
+            previousValues[changed++] = current[i];
+        }
+    }
+
+    if (ret == ERROR_COLIBRI_OK && changed > 0)
+    {
+        ret = colibriSetValues(self, changedIndices, changedValues, changed, errors);
+        if (ret != ERROR_COLIBRI_OK)
+        {
+            printError(ret, NULL);
+        }
+        for (size_t i = 0; i < changed && ret == ERROR_COLIBRI_OK; i++)
+        {
+            if (errors[i] != ERROR_COLIBRI_OK)
+            {
+                ret = printError(errors[i], "Could not set index %u to %s.\n", changedIndices[i], changedValues[i]);
+            }
+        }
+    }
+
+    if (ret == ERROR_COLIBRI_OK && changed > 0)
+    {
+        ret = configRead(self, changedIndices, changed, readBack);
+    }
+    for (size_t i = 0; i < changed && ret == ERROR_COLIBRI_OK; i++)
+    {
+        if (!configEqual(readBack[i], changedValues[i]))
+        {
+            ret = printError(ERROR_COLIBRI_VERIFY_FAILED, "Index %u is %s instead of %s.\n", changedIndices[i], readBack[i], changedValues[i]);
+        }
+    }
+    colibriClose(self);
+
+    if (ret == ERROR_COLIBRI_OK)
+    {
+        for (size_t i = 0; i < changed; i++)
+        {
+            fprintf(stderr, "%u %s: %s -> %s\n", changedIndices[i], configIndices[configFind(changedIndices[i])].name, previousValues[i], changedValues[i]);
+        }
+        fprintf(stderr, "Changed %zu of %zu settings\n", changed, settings);
+    }
+    return ret;
+}
+
+Error_t cmdConfig(Colibri_t * self, int argcCmd, char **argvCmd)
+{
+    ColibriJsonScope_t scope;
+    Error_t ret;
+
+    if (argcCmd != 3)
+    {
+        return printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_ARGUMENT, "Usage: colibri config dump|restore FILE\n");
+    }
+
+    colibriJsonScopeBegin(&scope, self->verbose);
+    if (strcmp(argvCmd[1], "dump") == 0)
+    {
+        ret = configDump(self, argvCmd[2]);
+    }
+    else if (strcmp(argvCmd[1], "restore") == 0)
+    {
+        ret = configRestore(self, argvCmd[2]);
+    }
+    else
+    {
+        ret = printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_ARGUMENT, "'%s' is not a config command. See 'colibri help config'.\n", argvCmd[1]);
+    }
+    colibriJsonScopeEnd(&scope);
+    return ret;
+}
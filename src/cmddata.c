@@ -5,10 +5,19 @@
 #include "printerror.h"
 #include "colibri.h"
 #include "colibriJson.h"
+#include "colibriArchive.h"
+#include "system.h"
+#include "catalog.h"
+#include "colibriReader.h"
+#include "expression.h"
+#include "output.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <ctype.h>
+#include <time.h>
+#include <sys/stat.h>
 
 typedef struct Parameters
 {
@@ -29,314 +38,2908 @@ Parameters_t parametersCreate()
     return ret;
 }
 
+// Parses the option at argvCmd[*i] if it is a calculation parameter. *i is
+// left at the value of the option.
+static bool parametersParse(Parameters_t *parameters, int argcCmd, char **argvCmd, int *i)
+{
+    if (*i + 1 >= argcCmd)
+    {
+        return false;
+    }
+
+    if (strcmp(argvCmd[*i], "--pathLength") == 0)
+    {
+        parameters->pathLength = atof(argvCmd[++(*i)]);
+    }
+    else if (strcmp(argvCmd[*i], "--a260unit") == 0)
+    {
+        parameters->a260Unit = atof(argvCmd[++(*i)]);
+    }
+    else if (strcmp(argvCmd[*i], "--blanks") == 0)
+    {
+        parameters->blanks = atoi(argvCmd[++(*i)]);
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+static Error_t calculate(DataFile_t *data, Parameters_t parameters)
+{
+    double factors[WAVELENGTH_COUNT];
+
+    calcFactors(&data->measurements, parameters.blanks, factors);
+    if (!calcResults(&data->measurements, factors, parameters.pathLength, parameters.a260Unit, &data->calculated))
+    {
+        return ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+
+    for (size_t i = 0; i < data->count; i++)
+    {
+        data->records[i].hasCalculated = true;
+        data->records[i].hasOD = true;
+        data->records[i].hasConcentration = data->measurements.hasAir[i];
+    }
+
+    return ERROR_COLIBRI_OK;
+}
+
+static Error_t blanksCalculate(const CalcBlanks_t *self, DataFile_t *batch, Parameters_t parameters)
+{
+    const Measurements_t *m = &batch->measurements;
+    double factors[WAVELENGTH_COUNT];
+
+    calcBlanksFactors(self, factors);
+
+    if (!calcResults(m, factors, parameters.pathLength, parameters.a260Unit, &batch->calculated))
+    {
+        return ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+    for (size_t i = 0; i < batch->count; i++)
+    {
+        batch->records[i].hasCalculated = true;
+        batch->records[i].hasOD = true;
+        batch->records[i].hasConcentration = m->hasAir[i];
+    }
+    return ERROR_COLIBRI_OK;
+}
+
+#define CALCULATE_MAX_EXPRESSIONS 16
+#define CALCULATE_VARIABLE_COUNT (WAVELENGTH_COUNT + 1 + 6 * WAVELENGTH_COUNT)
+
+// Columns the expressions of data calculate --expr can use, in the order of
+// calculateColumns(). Every expression can also use the ones before it.
+static const char *calculateVariables[CALCULATE_VARIABLE_COUNT] = {
+    "od230", "od260", "od280", "od340", "concentration",
+    "sample230", "sample260", "sample280", "sample340",
+    "reference230", "reference260", "reference280", "reference340",
+    "baselineSample230", "baselineSample260", "baselineSample280", "baselineSample340",
+    "baselineReference230", "baselineReference260", "baselineReference280", "baselineReference340",
+    "airSample230", "airSample260", "airSample280", "airSample340",
+    "airReference230", "airReference260", "airReference280", "airReference340",
+};
+
+typedef struct
+{
+    size_t count;
+    const char *names[CALCULATE_VARIABLE_COUNT + CALCULATE_MAX_EXPRESSIONS];
+    Expression_t code[CALCULATE_MAX_EXPRESSIONS];
+} Expressions_t;
+
+static void calculateColumns(const DataFile_t *data, const double **columns)
+{
+    const Measurements_t *measurements = &data->measurements;
+
+    for (int w = 0; w < WAVELENGTH_COUNT; w++)
+    {
+        columns[w] = data->calculated.od[w];
+        columns[WAVELENGTH_COUNT + 1 + w] = measurements->sample[ROLE_SAMPLE][w];
+        columns[2 * WAVELENGTH_COUNT + 1 + w] = measurements->reference[ROLE_SAMPLE][w];
+        columns[3 * WAVELENGTH_COUNT + 1 + w] = measurements->sample[ROLE_BASELINE][w];
+        columns[4 * WAVELENGTH_COUNT + 1 + w] = measurements->reference[ROLE_BASELINE][w];
+        columns[5 * WAVELENGTH_COUNT + 1 + w] = measurements->sample[ROLE_AIR][w];
+        columns[6 * WAVELENGTH_COUNT + 1 + w] = measurements->reference[ROLE_AIR][w];
+    }
+    columns[WAVELENGTH_COUNT] = data->calculated.concentration;
+}
+
+// Parses NAME=EXPRESSION and compiles the expression.
+static bool expressionsAdd(Expressions_t *expressions, char *definition)
+{
+    char *text = strchr(definition, '=');
+    size_t nameCount = CALCULATE_VARIABLE_COUNT + expressions->count;
+    Expression_t *code = &expressions->code[expressions->count];
+
+    if (expressions->count == CALCULATE_MAX_EXPRESSIONS)
+    {
+        printError(ERROR_COLIBRI_INVALID_PARAMETER, "At most %d expressions are supported.\n", CALCULATE_MAX_EXPRESSIONS);
+        return false;
+    }
+    if (text == NULL || text == definition)
+    {
+        printError(ERROR_COLIBRI_INVALID_PARAMETER, "Expected NAME=EXPRESSION: %s\n", definition);
+        return false;
+    }
+    *text++ = '\0';
+    while (isspace((unsigned char)*definition))
+    {
+        definition++;
+    }
+    for (char *end = text - 1; end > definition && isspace((unsigned char)end[-1]); end--)
+    {
+        end[-1] = '\0';
+    }
+
+    for (char *c = definition; *c; c++)
+    {
+        if (!(isalnum((unsigned char)*c) || *c == '_') || isdigit((unsigned char)definition[0]))
+        {
+            printError(ERROR_COLIBRI_INVALID_PARAMETER, "Invalid name: %s\n", definition);
+            return false;
+        }
+    }
+    for (size_t n = 0; n < nameCount; n++)
+    {
+        if (strcmp(expressions->names[n], definition) == 0)
+        {
+            printError(ERROR_COLIBRI_INVALID_PARAMETER, "Name already used: %s\n", definition);
+            return false;
+        }
+    }
+    if (strcmp(definition, DICT_OD) == 0 || strcmp(definition, DICT_CONCENTRATION) == 0)
+    {
+        printError(ERROR_COLIBRI_INVALID_PARAMETER, "Name already used: %s\n", definition);
+        return false;
+    }
+
+    if (!expressionCompile(code, text, expressions->names, nameCount))
+    {
+        printError(ERROR_COLIBRI_INVALID_PARAMETER, "%s: %s\n", definition, code->error);
+        return false;
+    }
+
+    expressions->names[nameCount] = definition;
+    expressions->count++;
+    return true;
+}
+
+// Evaluates all expressions, values holds one column per expression.
+static Error_t expressionsEvaluate(const Expressions_t *expressions, const DataFile_t *data, double *values)
+{
+    const double *columns[CALCULATE_VARIABLE_COUNT + CALCULATE_MAX_EXPRESSIONS];
+
+    calculateColumns(data, columns);
+    for (size_t e = 0; e < expressions->count; e++)
+    {
+        double *result = values + e * data->count;
+
+        if (!expressionEvaluate(&expressions->code[e], columns, data->count, result))
+        {
+            return ERROR_COLIBRI_OUT_OF_MEMORY;
+        }
+        columns[CALCULATE_VARIABLE_COUNT + e] = result;
+    }
+    return ERROR_COLIBRI_OK;
+}
+
+static void writeCalculated(const DataFile_t *data, const Expressions_t *expressions, const double *values)
+{
+    for (size_t i = 0; i < data->count; i++)
+    {
+        cJSON *node = data->records[i].node;
+        cJSON *oCalculated = colibriJsonCalculated(data, i);
+
+        for (size_t e = 0; e < expressions->count; e++)
+        {
+            cJSON_AddItemToObject(oCalculated, expressions->names[CALCULATE_VARIABLE_COUNT + e], cJSON_CreateNumber(values[e * data->count + i]));
+        }
+
+        colibriJsonRelease(cJSON_DetachItemFromObject(node, DICT_CALCULATED));
+        cJSON_AddItemToObject(node, DICT_CALCULATED, oCalculated);
+    }
+}
+
+// Loads a JSON data file or an archive. For JSON files json holds the parsed
+// file which the records refer to, for archives it is NULL.
+static Error_t loadDataFile(char *file, DataFile_t *data, cJSON **json, ColibriJsonFormat_t *format)
+{
+    Error_t ret = ERROR_COLIBRI_OK;
+
+    *json = NULL;
+
+    if (colibriArchiveProbe(file))
+    {
+        ret = colibriArchiveLoad(file, data);
+    }
+    else
+    {
+        *json = colibriJsonLoad(file, format);
+        if (*json == NULL)
+        {
+            ret = ERROR_COLIBRI_FILE_NOT_FOUND;
+        }
+        else if (!colibriJsonDecode(*json, data))
+        {
+            colibriJsonRelease(*json);
+            *json = NULL;
+            ret = ERROR_COLIBRI_OUT_OF_MEMORY;
+        }
+    }
+
+    if (ret == ERROR_COLIBRI_FILE_NOT_FOUND)
+    {
+        printError(ret, "File %s not found.", file);
+    }
+
+    return ret;
+}
+
+#define CALCULATE_BATCH_SIZE 256
+
+// Reads the next batch of records into batch, batch->count is 0 after the
+// last record.
+static bool calculateReadBatch(ColibriJsonStream_t *stream, DataFile_t *batch)
+{
+    size_t count = 0;
+
+    batch->stringsSize = 0;
+    while (count < CALCULATE_BATCH_SIZE)
+    {
+        cJSON *record;
+
+        if (!colibriJsonStreamRecord(stream, &record))
+        {
+            batch->count = count;
+            return false;
+        }
+        if (record == NULL)
+        {
+            break;
+        }
+        colibriJsonDecodeRecord(record, batch, count);
+        count++;
+    }
+
+    batch->count = count;
+    return true;
+}
+
+static void calculateFreeBatch(DataFile_t *batch)
+{
+    for (size_t i = 0; i < batch->count; i++)
+    {
+        colibriJsonRelease(batch->records[i].node);
+        batch->records[i].node = NULL;
+    }
+}
+
+// Calculates a JSON file batch by batch instead of loading its whole tree.
+// The first pass over stream reads only the leading blanks records for the
+// factors, the second one writes every record with its results to FILE.tmp.
+// The records are written like colibriJsonSave() does, the text in front of
+// and behind the measurements is copied as it is.
+static Error_t calculateStream(char *file, ColibriJsonStream_t *stream, Parameters_t parameters, const Expressions_t *expressions)
+{
+    size_t size = strlen(file) + sizeof(".tmp");
+    char *tempFile = malloc(size);
+    double *values = malloc(CALCULATE_BATCH_SIZE * (expressions->count ? expressions->count : 1) * sizeof(double));
+    ColibriJsonScope_t scope;
+    CalcBlanks_t blanks;
+    DataFile_t batch = {0};
+    Buffer_t out;
+    FILE *fout = NULL;
+    bool pretty = true;
+    size_t index = 0;
+    Error_t ret = ERROR_COLIBRI_OK;
+
+    bufferInit(&out);
+    calcBlanksInit(&blanks);
+    colibriJsonScopeBegin(&scope, false);
+
+    if (tempFile == NULL || values == NULL || !dataFileCreate(&batch, CALCULATE_BATCH_SIZE))
+    {
+        ret = ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+
+    while (ret == ERROR_COLIBRI_OK && index < parameters.blanks)
+    {
+        if (!calculateReadBatch(stream, &batch))
+        {
+            ret = ERROR_COLIBRI_INVALID_FILE_FORMAT;
+        }
+        calcBlanksAdd(&blanks, &batch.measurements, batch.count, index, parameters.blanks);
+        calculateFreeBatch(&batch);
+        colibriJsonScopeReset(&scope);
+        if (batch.count == 0)
+        {
+            break;
+        }
+        index += batch.count;
+    }
+    colibriJsonStreamClose(stream);
+
+    if (ret == ERROR_COLIBRI_OK)
+    {
+        snprintf(tempFile, size, "%s.tmp", file);
+        fout = fopen(tempFile, "wb");
+        ret = fout ? ERROR_COLIBRI_OK : ERROR_COLIBRI_FILE_WRITE_ERROR;
+    }
+
+    if (ret == ERROR_COLIBRI_OK)
+    {
+        bufferReserve(&out, COLIBRI_JSON_WRITE_BUFFER_SIZE);
+        bufferAttach(&out, fout);
+        index = 0;
+        if (!colibriJsonStreamOpen(stream, file, &batch, &out))
+        {
+            ret = ERROR_COLIBRI_INVALID_FILE_FORMAT;
+        }
+        // Pretty printed files start with "{\n", compact files with "{\""
+        pretty = !(out.size > 1 && out.data[1] == '"');
+
+        while (ret == ERROR_COLIBRI_OK)
+        {
+            if (!calculateReadBatch(stream, &batch))
+            {
+                ret = ERROR_COLIBRI_INVALID_FILE_FORMAT;
+            }
+            if (ret == ERROR_COLIBRI_OK && batch.count > 0)
+            {
+                ret = blanksCalculate(&blanks, &batch, parameters);
+            }
+            if (ret == ERROR_COLIBRI_OK && batch.count > 0 && expressions->count > 0)
+            {
+                ret = expressionsEvaluate(expressions, &batch, values);
+            }
+            if (ret == ERROR_COLIBRI_OK)
+            {
+                writeCalculated(&batch, expressions, values);
+            }
+            for (size_t i = 0; i < batch.count && ret == ERROR_COLIBRI_OK; i++, index++)
+            {
+                if ((index > 0 && !bufferAppendString(&out, pretty ? ", " : ",")) ||
+                    !colibriJsonAppend(batch.records[i].node, 1, pretty, &out))
+                {
+                    ret = ERROR_COLIBRI_FILE_WRITE_ERROR;
+                }
+            }
+            calculateFreeBatch(&batch);
+            colibriJsonScopeReset(&scope);
+            if (batch.count == 0)
+            {
+                break;
+            }
+        }
+
+        if (ret == ERROR_COLIBRI_OK && !(colibriJsonStreamTail(stream, &out) && bufferFlush(&out)))
+        {
+            ret = ERROR_COLIBRI_FILE_WRITE_ERROR;
+        }
+        bufferAttach(&out, NULL);
+        colibriJsonStreamClose(stream);
+    }
+
+    if (fout && fclose(fout) != 0 && ret == ERROR_COLIBRI_OK)
+    {
+        ret = ERROR_COLIBRI_FILE_WRITE_ERROR;
+    }
+    if (ret == ERROR_COLIBRI_OK && !systemReplaceFile(tempFile, file))
+    {
+        ret = ERROR_COLIBRI_FILE_WRITE_ERROR;
+    }
+    if (fout && ret != ERROR_COLIBRI_OK)
+    {
+        remove(tempFile);
+    }
+    if (ret == ERROR_COLIBRI_INVALID_FILE_FORMAT)
+    {
+        printError(ret, "File %s is not a valid data file.\n", file);
+    }
+
+    colibriJsonScopeEnd(&scope);
+    dataFileFree(&batch);
+    bufferFree(&out);
+    free(values);
+    free(tempFile);
+    return ret;
+}
+
+// The values of the expressions are stored next to the optical densities,
+// which only JSON files can hold.
+static Error_t calculateFile(char *file, Parameters_t parameters, const Expressions_t *expressions)
+{
+    ColibriJsonFormat_t format;
+    ColibriJsonStream_t stream;
+    DataFile_t data;
+    double *values = NULL;
+    cJSON *json;
+    Error_t ret;
+
+    // JSON files are streamed, only files without measurements or with an
+    // unusual layout are loaded as a whole
+    if (!colibriArchiveProbe(file) && dataFileCreate(&data, 0))
+    {
+        bool ok = colibriJsonStreamOpen(&stream, file, &data, NULL);
+
+        dataFileFree(&data);
+        if (ok)
+        {
+            return calculateStream(file, &stream, parameters, expressions);
+        }
+    }
+
+    ret = loadDataFile(file, &data, &json, &format);
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        return ret;
+    }
+
+    if (json == NULL && expressions->count > 0)
+    {
+        ret = printError(ERROR_COLIBRI_INVALID_FILE_FORMAT, "File %s: expressions can only be stored in JSON files.\n", file);
+    }
+
+    if (ret == ERROR_COLIBRI_OK)
+    {
+        ret = calculate(&data, parameters);
+    }
+
+    if (ret == ERROR_COLIBRI_OK && expressions->count > 0)
+    {
+        values = malloc((data.count ? data.count : 1) * expressions->count * sizeof(double));
+        ret = values ? expressionsEvaluate(expressions, &data, values) : ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+
+    if (ret == ERROR_COLIBRI_OK && json)
+    {
+        writeCalculated(&data, expressions, values);
+        if (!colibriJsonSave(file, json, format))
+        {
+            ret = ERROR_COLIBRI_FILE_WRITE_ERROR;
+        }
+    }
+    else if (ret == ERROR_COLIBRI_OK)
+    {
+        ret = colibriArchiveSave(file, &data);
+    }
+
+    free(values);
+    dataFileFree(&data);
+    colibriJsonRelease(json);
+    return ret;
+}
+
+typedef struct
+{
+    char **files;
+    size_t count;
+    size_t capacity;
+    bool isOutOfMemory;
+} FileList_t;
+
+static bool fileListAdd(const char *path, void *context)
+{
+    FileList_t *list = context;
+    size_t size = strlen(path) + 1;
+    char *copy;
+
+    if (list->count == list->capacity)
+    {
+        size_t capacity = list->capacity ? 2 * list->capacity : 16;
+        char **files = realloc(list->files, capacity * sizeof(char *));
+
+        if (files == NULL)
+        {
+            list->isOutOfMemory = true;
+            return false;
+        }
+        list->files = files;
+        list->capacity = capacity;
+    }
+
+    copy = malloc(size);
+    if (copy == NULL)
+    {
+        list->isOutOfMemory = true;
+        return false;
+    }
+    memcpy(copy, path, size);
+    list->files[list->count++] = copy;
+    return true;
+}
+
+static void fileListAddDataFile(const char *path, void *context)
+{
+    size_t length = strlen(path);
+
+    if ((length > 5 && strcmp(path + length - 5, ".json") == 0) || colibriArchiveProbe(path))
+    {
+        fileListAdd(path, context);
+    }
+}
+
+static int fileListCompare(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Adds files as given and the data files of directories sorted by name.
+// Returns false with the error printed if a directory cannot be read or
+// the memory runs out, isOutOfMemory tells the two apart.
+static bool fileListAddArguments(FileList_t *list, int argc, char **argv)
+{
+    for (int i = 0; i < argc && !list->isOutOfMemory; i++)
+    {
+        if (systemIsDirectory(argv[i]))
+        {
+            size_t first = list->count;
+
+            if (!systemListDirectory(argv[i], fileListAddDataFile, list))
+            {
+                printError(ERROR_COLIBRI_FILE_NOT_FOUND, "Directory %s not found.\n", argv[i]);
+                return false;
+            }
+            qsort(list->files + first, list->count - first, sizeof(char *), fileListCompare);
+        }
+        else
+        {
+            fileListAdd(argv[i], list);
+        }
+    }
+
+    if (list->isOutOfMemory)
+    {
+        printError(ERROR_COLIBRI_OUT_OF_MEMORY, NULL);
+        return false;
+    }
+    return true;
+}
+
+static void fileListFree(FileList_t *list)
+{
+    for (size_t i = 0; i < list->count; i++)
+    {
+        free(list->files[i]);
+    }
+    free(list->files);
+}
+
+// Shared by the workers. Each worker takes the next file until all files
+// are done.
+typedef struct
+{
+    const FileList_t *files;
+    Parameters_t parameters;
+    const Expressions_t *expressions;
+    Error_t *errors;
+    volatile long next;
+    bool verbose;
+} CalculateJob_t;
+
+static void calculateWorker(void *argument)
+{
+    CalculateJob_t *job = argument;
+    ColibriJsonScope_t scope;
+    long index;
+
+    colibriJsonScopeBegin(&scope, job->verbose);
+    while ((index = systemAtomicIncrement(&job->next) - 1) < (long)job->files->count)
+    {
+        job->errors[index] = calculateFile(job->files->files[index], job->parameters, job->expressions);
+        colibriJsonScopeReset(&scope);
+    }
+    colibriJsonScopeEnd(&scope);
+}
+
+static Error_t calculateFiles(const FileList_t *files, Parameters_t parameters, const Expressions_t *expressions, int jobs, bool verbose)
+{
+    Error_t ret = ERROR_COLIBRI_OK;
+    CalculateJob_t job;
+    SystemThread_t *threads;
+    struct timespec start;
+    struct timespec end;
+
+    timespec_get(&start, TIME_UTC);
+
+    job.files = files;
+    job.parameters = parameters;
+    job.expressions = expressions;
+    job.next = 0;
+    job.verbose = verbose;
+    job.errors = malloc(files->count * sizeof(Error_t));
+    threads = calloc(jobs, sizeof(SystemThread_t));
+    if (job.errors == NULL || threads == NULL)
+    {
+        free(job.errors);
+        free(threads);
+        return ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+
+    for (int i = 1; i < jobs; i++)
+    {
+        systemThreadStart(&threads[i], calculateWorker, &job);
+    }
+    calculateWorker(&job);
+    for (int i = 1; i < jobs; i++)
+    {
+        systemThreadJoin(&threads[i]);
+    }
+
+    for (size_t i = 0; i < files->count; i++)
+    {
+        if (job.errors[i] != ERROR_COLIBRI_OK)
+        {
+            if (files->count > 1 && job.errors[i] != ERROR_COLIBRI_FILE_NOT_FOUND)
+            {
+                printError(job.errors[i], "File %s: %s\n", files->files[i], colibriError2String(job.errors[i]));
+            }
+            if (ret == ERROR_COLIBRI_OK)
+            {
+                ret = job.errors[i];
+            }
+        }
+    }
+
+    if (verbose)
+    {
+        timespec_get(&end, TIME_UTC);
+        fprintf(stderr, "Calculated %zu files with %d jobs, %.3f ms\n", files->count, jobs,
+                (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0);
+    }
+
+    free(job.errors);
+    free(threads);
+    return ret;
+}
+
+static Error_t cmdCalculate(Colibri_t *self, int argcCmd, char **argvCmd)
+{
+    Error_t ret = ERROR_COLIBRI_OK;
+    Parameters_t parameters = parametersCreate();
+    Expressions_t *expressions = calloc(1, sizeof(Expressions_t));
+    FileList_t files = {0};
+    bool options = true;
+    int jobs = 1;
+    int i = 0;
+
+    if (expressions == NULL)
+    {
+        return ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+    memcpy(expressions->names, calculateVariables, sizeof(calculateVariables));
+
+    while (i < argcCmd && options)
+    {
+        if (strncmp(argvCmd[i], "--", 2) == 0 || strncmp(argvCmd[i], "-", 1) == 0)
+        {
+            if ((strcmp(argvCmd[i], "--jobs") == 0) && (i + 1 < argcCmd))
+            {
+                i++;
+                jobs = atoi(argvCmd[i]);
+            }
+            else if ((strcmp(argvCmd[i], "--expr") == 0) && (i + 1 < argcCmd))
+            {
+                i++;
+                if (!expressionsAdd(expressions, argvCmd[i]))
+                {
+                    free(expressions);
+                    return ERROR_COLIBRI_INVALID_PARAMETER;
+                }
+            }
+            else if (!parametersParse(&parameters, argcCmd, argvCmd, &i))
+            {
+                free(expressions);
+                return printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION, "Unknown option: %s\n", argvCmd[i]);
+            }
+            i++;
+        }
+        else
+        {
+            options = false;
+        }
+    }
+
+    if (!fileListAddArguments(&files, argcCmd - i, argvCmd + i))
+    {
+        ret = files.isOutOfMemory ? ERROR_COLIBRI_OUT_OF_MEMORY : ERROR_COLIBRI_FILE_NOT_FOUND;
+    }
+    else if (files.count > 0)
+    {
+        if (jobs <= 0)
+        {
+            jobs = systemCpuCount();
+        }
+        if ((size_t)jobs > files.count)
+        {
+            jobs = (int)files.count;
+        }
+        ret = calculateFiles(&files, parameters, expressions, jobs, self->verbose);
+    }
+
+    free(expressions);
+    fileListFree(&files);
+    return ret;
+}
+
+#define PRINT_FLUSH_SIZE (64 * 1024)
+
+static void printRecord(const DataFile_t *data, size_t index, Buffer_t *out)
+{
+    const Record_t *record = &data->records[index];
+    const char *comment = dataFileString(data, record->comment);
+
+    if (record->hasOD)
+    {
+        for (int w = 0; w < WAVELENGTH_COUNT; w++)
+        {
+            bufferAppendFixed(out, data->calculated.od[w][index]);
+            bufferAppendChar(out, ' ');
+        }
+    }
+
+    if (record->hasConcentration)
+    {
+        bufferAppendFixed(out, data->calculated.concentration[index]);
+        bufferAppendChar(out, ' ');
+    }
+
+    if (comment)
+    {
+        bufferAppendString(out, comment);
+        bufferAppendChar(out, ' ');
+    }
+    bufferAppendChar(out, '\n');
+}
+
+// The text format keeps the lines of printRecord(), the other formats get
+// a record with all fields, NAN for the missing ones.
+static void printCalculated(const DataFile_t *data, size_t index)
+{
+    const Record_t *record = &data->records[index];
+    static const char *const names[WAVELENGTH_COUNT] = {"od230", "od260", "od280", "od340"};
+
+    if (outputFormat() == OUTPUT_TEXT)
+    {
+        printRecord(data, index, outputBuffer());
+        return;
+    }
+
+    outputBegin(OUTPUT_CALCULATED);
+    outputUint32("index", (uint32_t)index);
+    for (int w = 0; w < WAVELENGTH_COUNT; w++)
+    {
+        outputDouble(names[w], record->hasOD ? data->calculated.od[w][index] : NAN);
+    }
+    outputDouble("concentration", record->hasConcentration ? data->calculated.concentration[index] : NAN);
+    outputString("comment", dataFileString(data, record->comment));
+    outputEnd();
+}
+
+static Error_t cmdDataPrint(Colibri_t *self, char *file)
+{
+    Error_t ret;
+    DataFile_t data;
+    cJSON *json;
+
+    ret = loadDataFile(file, &data, &json, NULL);
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        return ret;
+    }
+
+    outputOpen();
+    for (size_t i = 0; i < data.count; i++)
+    {
+        if (data.records[i].hasCalculated)
+        {
+            printCalculated(&data, i);
+        }
+    }
+    dataFileFree(&data);
+    colibriJsonRelease(json);
+
+    return ERROR_COLIBRI_OK;
+}
+
+static Error_t cmdReformat(Colibri_t *self, int argcCmd, char **argvCmd)
+{
+    ColibriJsonFormat_t format;
+    cJSON *json;
+    char *file = argvCmd[1];
+
+    if (strcmp(argvCmd[0], "--compact") == 0)
+    {
+        format = COLIBRI_JSON_COMPACT;
+    }
+    else if (strcmp(argvCmd[0], "--pretty") == 0)
+    {
+        format = COLIBRI_JSON_PRETTY;
+    }
+    else
+    {
+        return printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION, "Unknown option: %s\n", argvCmd[0]);
+    }
+
+    json = colibriJsonLoad(file, NULL);
+    if (json == NULL)
+    {
+        printError(ERROR_COLIBRI_FILE_NOT_FOUND, "File %s not found.", file);
+        return ERROR_COLIBRI_FILE_NOT_FOUND;
+    }
+
+    if (!colibriJsonSave(file, json, format))
+    {
+        colibriJsonRelease(json);
+        return ERROR_COLIBRI_FILE_WRITE_ERROR;
+    }
+
+    colibriJsonRelease(json);
+    return ERROR_COLIBRI_OK;
+}
+
+static Error_t cmdConvert(Colibri_t *self, int argcCmd, char **argvCmd)
+{
+    Error_t ret;
+    ColibriJsonFormat_t format = COLIBRI_JSON_PRETTY;
+    DataFile_t data;
+    cJSON *json;
+    char *input;
+    char *output;
+
+    if (argcCmd == 3 && strcmp(argvCmd[0], "--compact") == 0)
+    {
+        format = COLIBRI_JSON_COMPACT;
+    }
+    else if (argcCmd != 2)
+    {
+        return printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION, "Unknown option: %s\n", argvCmd[0]);
+    }
+    input = argvCmd[argcCmd - 2];
+    output = argvCmd[argcCmd - 1];
+
+    ret = loadDataFile(input, &data, &json, NULL);
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        return ret;
+    }
+
+    if (json)
+    {
+        ret = colibriArchiveSave(output, &data);
+        if (ret == ERROR_COLIBRI_INVALID_NUMBER)
+        {
+            printError(ret, "File %s contains raw values which are not unsigned 32 bit integers.\n", input);
+        }
+    }
+    else
+    {
+        json = colibriJsonEncode(&data);
+        if (!colibriJsonSave(output, json, format))
+        {
+            ret = ERROR_COLIBRI_FILE_WRITE_ERROR;
+        }
+    }
+
+    dataFileFree(&data);
+    colibriJsonRelease(json);
+    return ret;
+}
+
+static char *catalogPath(const char *directory)
+{
+    size_t size = strlen(directory) + sizeof(CATALOG_FILE_NAME) + 1;
+    char *path = malloc(size);
+
+    if (path)
+    {
+        snprintf(path, size, "%s/%s", directory, CATALOG_FILE_NAME);
+    }
+    return path;
+}
+
+static bool catalogCopyFile(Catalog_t *catalog, const Catalog_t *old, const CatalogFile_t *oldFile)
+{
+    CatalogFile_t *file = catalogAddFile(catalog, catalogString(old, oldFile->name));
+
+    if (file == NULL)
+    {
+        return false;
+    }
+    file->mtime = oldFile->mtime;
+    file->size = oldFile->size;
+    file->isArchive = oldFile->isArchive;
+    file->serialNumber = catalogAddString(catalog, catalogString(old, oldFile->serialNumber));
+    file->firmwareVersion = catalogAddString(catalog, catalogString(old, oldFile->firmwareVersion));
+
+    for (size_t i = oldFile->first; i < oldFile->first + oldFile->count; i++)
+    {
+        CatalogRecord_t *record = catalogAddRecord(catalog);
+
+        if (record == NULL)
+        {
+            return false;
+        }
+        record->offset = old->records[i].offset;
+        record->timestamp = catalogAddString(catalog, catalogString(old, old->records[i].timestamp));
+        record->comment = catalogAddString(catalog, catalogString(old, old->records[i].comment));
+    }
+    return true;
+}
+
+// JSON records are found again by their byte offset, archive records by
+// their index.
+static Error_t catalogIndexFile(Catalog_t *catalog, char *path, const char *name, const struct stat *st)
+{
+    ColibriJsonScope_t scope;
+    CatalogFile_t *file;
+    MappedFile_t map = {0};
+    uint64_t *offsets = NULL;
+    DataFile_t data;
+    cJSON *json;
+    Error_t ret;
+
+    colibriJsonScopeBegin(&scope, false);
+
+    ret = loadDataFile(path, &data, &json, NULL);
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        colibriJsonScopeEnd(&scope);
+        return ret;
+    }
+
+    if (json)
+    {
+        offsets = malloc((data.count ? data.count : 1) * sizeof(uint64_t));
+        if (offsets == NULL)
+        {
+            ret = ERROR_COLIBRI_OUT_OF_MEMORY;
+        }
+        else if (!systemMapFile(&map, path) || colibriJsonRecordOffsets(map.data, map.size, offsets, data.count) != data.count)
+        {
+            ret = ERROR_COLIBRI_INVALID_FILE_FORMAT;
+        }
+        systemUnmapFile(&map);
+    }
+
+    file = ret == ERROR_COLIBRI_OK ? catalogAddFile(catalog, name) : NULL;
+    if (file)
+    {
+        file->mtime = (int64_t)st->st_mtime;
+        file->size = (uint64_t)st->st_size;
+        file->isArchive = json == NULL;
+        file->serialNumber = catalogAddString(catalog, dataFileString(&data, data.serialNumber));
+        file->firmwareVersion = catalogAddString(catalog, dataFileString(&data, data.firmwareVersion));
+
+        for (size_t i = 0; i < data.count && ret == ERROR_COLIBRI_OK; i++)
+        {
+            CatalogRecord_t *record = catalogAddRecord(catalog);
+
+            if (record == NULL)
+            {
+                ret = ERROR_COLIBRI_OUT_OF_MEMORY;
+                break;
+            }
+            record->offset = offsets ? offsets[i] : i;
+            record->timestamp = catalogAddString(catalog, dataFileString(&data, data.records[i].timestamp));
+            record->comment = catalogAddString(catalog, dataFileString(&data, data.records[i].comment));
+        }
+    }
+    else if (ret == ERROR_COLIBRI_OK)
+    {
+        ret = ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+
+    free(offsets);
+    dataFileFree(&data);
+    colibriJsonRelease(json);
+    colibriJsonScopeEnd(&scope);
+    return ret;
+}
+
+static Error_t cmdIndex(Colibri_t *self, char *directory)
+{
+    Error_t ret = ERROR_COLIBRI_OK;
+    char *path = catalogPath(directory);
+    FileList_t files = {0};
+    Catalog_t old;
+    Catalog_t catalog;
+    size_t unchanged = 0;
+    size_t indexed = 0;
+    size_t matched = 0;
+
+    if (path == NULL)
+    {
+        return ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+
+    if (!systemListDirectory(directory, fileListAddDataFile, &files))
+    {
+        free(path);
+        fileListFree(&files);
+        printError(ERROR_COLIBRI_FILE_NOT_FOUND, "Directory %s not found.\n", directory);
+        return ERROR_COLIBRI_FILE_NOT_FOUND;
+    }
+    if (files.isOutOfMemory)
+    {
+        free(path);
+        fileListFree(&files);
+        return printError(ERROR_COLIBRI_OUT_OF_MEMORY, NULL);
+    }
+    qsort(files.files, files.count, sizeof(char *), fileListCompare);
+
+    // A missing or damaged catalog is rebuilt from scratch
+    catalogLoad(&old, path);
+    catalogInit(&catalog);
+
+    for (size_t i = 0; i < files.count; i++)
+    {
+        const char *name = files.files[i] + strlen(directory) + 1;
+        const CatalogFile_t *oldFile = catalogFindFile(&old, name);
+        struct stat st;
+        Error_t err;
+
+        if (stat(files.files[i], &st) != 0)
+        {
+            continue;
+        }
+
+        if (oldFile)
+        {
+            matched++;
+        }
+
+        if (oldFile && oldFile->mtime == (int64_t)st.st_mtime && oldFile->size == (uint64_t)st.st_size)
+        {
+            err = catalogCopyFile(&catalog, &old, oldFile) ? ERROR_COLIBRI_OK : ERROR_COLIBRI_OUT_OF_MEMORY;
+            unchanged++;
+        }
+        else
+        {
+            err = catalogIndexFile(&catalog, files.files[i], name, &st);
+            indexed++;
+        }
+
+        if (err != ERROR_COLIBRI_OK)
+        {
+            printError(err, "File %s: %s\n", files.files[i], colibriError2String(err));
+            if (ret == ERROR_COLIBRI_OK)
+            {
+                ret = err;
+            }
+        }
+    }
+
+    if (!catalogSave(&catalog, path))
+    {
+        ret = ERROR_COLIBRI_FILE_WRITE_ERROR;
+    }
+    else
+    {
+        fprintf(stdout, "%zu files, %zu records, %zu indexed, %zu unchanged, %zu removed\n",
+                catalog.fileCount, catalog.recordCount, indexed, unchanged, old.fileCount - matched);
+    }
+
+    catalogFree(&old);
+    catalogFree(&catalog);
+    fileListFree(&files);
+    free(path);
+    return ret;
+}
+
+typedef struct
+{
+    const char *comment;
+    const char *serialNumber;
+    const char *firmwareVersion;
+    const char *after;
+    const char *before;
+    bool print;
+} Query_t;
+
+static bool queryMatchesFile(const Query_t *query, const Catalog_t *catalog, const CatalogFile_t *file)
+{
+    const char *serialNumber = catalogString(catalog, file->serialNumber);
+    const char *firmwareVersion = catalogString(catalog, file->firmwareVersion);
+
+    return (query->serialNumber == NULL || (serialNumber && strcmp(serialNumber, query->serialNumber) == 0)) &&
+           (query->firmwareVersion == NULL || (firmwareVersion && strcmp(firmwareVersion, query->firmwareVersion) == 0));
+}
+
+// Timestamps are ISO 8601, so they compare as strings. --after 2024-05 also
+// matches all of May 2024.
+static bool queryMatchesRecord(const Query_t *query, const Catalog_t *catalog, const CatalogRecord_t *record)
+{
+    const char *comment = catalogString(catalog, record->comment);
+    const char *timestamp = catalogString(catalog, record->timestamp);
+
+    return (query->comment == NULL || (comment && strstr(comment, query->comment))) &&
+           (query->after == NULL || (timestamp && strcmp(timestamp, query->after) >= 0)) &&
+           (query->before == NULL || (timestamp && strcmp(timestamp, query->before) < 0));
+}
+
+// Reads only the matching records. From JSON files every record is parsed
+// on its own at its offset.
+static Error_t queryReadRecords(const Catalog_t *catalog, const CatalogFile_t *file, char *path, const size_t *matches, size_t count, DataFile_t *data)
+{
+    MappedFile_t map;
+    struct stat st;
+
+    if (stat(path, &st) != 0 || (int64_t)st.st_mtime != file->mtime || (uint64_t)st.st_size != file->size)
+    {
+        printError(ERROR_COLIBRI_INVALID_FILE_FORMAT, "File %s changed since the last data index.\n", path);
+        return ERROR_COLIBRI_INVALID_FILE_FORMAT;
+    }
+
+    // Archives are read as a whole, the matching records keep their index
+    if (file->isArchive)
+    {
+        return colibriArchiveLoad(path, data);
+    }
+
+    if (!dataFileCreate(data, count))
+    {
+        return ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+    if (!systemMapFile(&map, path))
+    {
+        dataFileFree(data);
+        return ERROR_COLIBRI_FILE_NOT_FOUND;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t offset = catalog->records[file->first + matches[i]].offset;
+        cJSON *obj = offset < map.size ? cJSON_ParseWithLengthOpts((const char *)map.data + offset, map.size - offset, NULL, false) : NULL;
+
+        if (obj == NULL)
+        {
+            systemUnmapFile(&map);
+            dataFileFree(data);
+            return ERROR_COLIBRI_INVALID_FILE_FORMAT;
+        }
+        colibriJsonDecodeRecord(obj, data, i);
+        data->records[i].node = NULL;
+        colibriJsonRelease(obj);
+    }
+
+    systemUnmapFile(&map);
+    return ERROR_COLIBRI_OK;
+}
+
+static Error_t queryPrintFile(const Catalog_t *catalog, const CatalogFile_t *file, char *path, const size_t *matches, size_t count, Buffer_t *out)
+{
+    ColibriJsonScope_t scope;
+    DataFile_t data;
+    Error_t ret;
+
+    colibriJsonScopeBegin(&scope, false);
+    ret = queryReadRecords(catalog, file, path, matches, count, &data);
+    if (ret == ERROR_COLIBRI_OK)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            size_t index = file->isArchive ? matches[i] : i;
+
+            if (data.records[index].hasCalculated)
+            {
+                bufferAppendString(out, catalogString(catalog, file->name));
+                bufferAppendChar(out, ' ');
+                bufferAppendUint32(out, (uint32_t)matches[i]);
+                bufferAppendChar(out, ' ');
+                printRecord(&data, index, out);
+            }
+        }
+        dataFileFree(&data);
+    }
+    colibriJsonScopeEnd(&scope);
+    return ret;
+}
+
+static void queryListRecords(const Catalog_t *catalog, const CatalogFile_t *file, const size_t *matches, size_t count, Buffer_t *out)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const CatalogRecord_t *record = &catalog->records[file->first + matches[i]];
+        const char *timestamp = catalogString(catalog, record->timestamp);
+        const char *comment = catalogString(catalog, record->comment);
+
+        bufferAppendString(out, catalogString(catalog, file->name));
+        bufferAppendChar(out, ' ');
+        bufferAppendUint32(out, (uint32_t)matches[i]);
+        bufferAppendChar(out, ' ');
+        bufferAppendString(out, timestamp ? timestamp : "-");
+        if (comment)
+        {
+            bufferAppendChar(out, ' ');
+            bufferAppendString(out, comment);
+        }
+        bufferAppendChar(out, '\n');
+    }
+}
+
+static Error_t cmdQuery(Colibri_t *self, int argcCmd, char **argvCmd)
+{
+    Error_t ret = ERROR_COLIBRI_OK;
+    Query_t query = {0};
+    Catalog_t catalog;
+    char *directory;
+    char *path;
+    size_t *matches = NULL;
+    Buffer_t out;
+    int i = 0;
+
+    while (i < argcCmd - 1)
+    {
+        if ((strcmp(argvCmd[i], "--comment") == 0) && (i + 2 < argcCmd))
+        {
+            query.comment = argvCmd[++i];
+        }
+        else if ((strcmp(argvCmd[i], "--serialnumber") == 0) && (i + 2 < argcCmd))
+        {
+            query.serialNumber = argvCmd[++i];
+        }
+        else if ((strcmp(argvCmd[i], "--firmware") == 0) && (i + 2 < argcCmd))
+        {
+            query.firmwareVersion = argvCmd[++i];
+        }
+        else if ((strcmp(argvCmd[i], "--after") == 0) && (i + 2 < argcCmd))
+        {
+            query.after = argvCmd[++i];
+        }
+        else if ((strcmp(argvCmd[i], "--before") == 0) && (i + 2 < argcCmd))
+        {
+            query.before = argvCmd[++i];
+        }
+        else if (strcmp(argvCmd[i], "--print") == 0)
+        {
+            query.print = true;
+        }
+        else
+        {
+            return printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION, "Unknown option: %s\n", argvCmd[i]);
+        }
+        i++;
+    }
+    directory = argvCmd[argcCmd - 1];
+
+    path = catalogPath(directory);
+    if (path == NULL)
+    {
+        return ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+    if (!catalogLoad(&catalog, path))
+    {
+        printError(ERROR_COLIBRI_FILE_NOT_FOUND, "No catalog in %s, run data index first.\n", directory);
+        free(path);
+        return ERROR_COLIBRI_FILE_NOT_FOUND;
+    }
+    free(path);
+
+    bufferInit(&out);
+    for (size_t f = 0; f < catalog.fileCount; f++)
+    {
+        const CatalogFile_t *file = &catalog.files[f];
+        size_t count = 0;
+
+        if (!queryMatchesFile(&query, &catalog, file))
+        {
+            continue;
+        }
+
+        free(matches);
+        matches = malloc((file->count ? file->count : 1) * sizeof(size_t));
+        if (matches == NULL)
+        {
+            ret = ERROR_COLIBRI_OUT_OF_MEMORY;
+            break;
+        }
+
+        for (size_t r = 0; r < file->count; r++)
+        {
+            if (queryMatchesRecord(&query, &catalog, &catalog.records[file->first + r]))
+            {
+                matches[count++] = r;
+            }
+        }
+
+        if (count > 0 && query.print)
+        {
+            char *filePath = malloc(strlen(directory) + strlen(catalogString(&catalog, file->name)) + 2);
+            Error_t err = ERROR_COLIBRI_OUT_OF_MEMORY;
+
+            if (filePath)
+            {
+                sprintf(filePath, "%s/%s", directory, catalogString(&catalog, file->name));
+                err = queryPrintFile(&catalog, file, filePath, matches, count, &out);
+                free(filePath);
+            }
+            if (err != ERROR_COLIBRI_OK && ret == ERROR_COLIBRI_OK)
+            {
+                ret = err;
+            }
+        }
+        else if (count > 0)
+        {
+            queryListRecords(&catalog, file, matches, count, &out);
+        }
+
+        if (out.size >= PRINT_FLUSH_SIZE)
+        {
+            fwrite(out.data, out.size, 1, stdout);
+            bufferClear(&out);
+        }
+    }
+    fwrite(out.data, out.size, 1, stdout);
+
+    bufferFree(&out);
+    free(matches);
+    catalogFree(&catalog);
+    return ret;
+}
+
+#define STATS_QUANTITY_COUNT (WAVELENGTH_COUNT + 1)
+#define STATS_CONCENTRATION WAVELENGTH_COUNT
+
+typedef enum
+{
+    STATS_GROUP_NONE,
+    STATS_GROUP_COMMENT,
+    STATS_GROUP_SERIALNUMBER,
+    STATS_GROUP_ROLE,
+} StatsGroupBy_t;
+
+typedef struct
+{
+    char *key;
+    Statistics_t quantities[STATS_QUANTITY_COUNT];
+} StatsGroup_t;
+
+// One group per distinct key, so the memory does not depend on the number
+// of records.
+typedef struct
+{
+    StatsGroupBy_t groupBy;
+    int prefixLength;
+    bool calculate;
+    Parameters_t parameters;
+    StatsGroup_t *groups;
+    size_t count;
+    size_t capacity;
+    uint64_t records;
+} Stats_t;
+
+static Statistics_t *statsGroup(Stats_t *stats, const char *key, size_t length)
+{
+    StatsGroup_t *group;
+
+    for (size_t i = 0; i < stats->count; i++)
+    {
+        if (strncmp(stats->groups[i].key, key, length) == 0 && stats->groups[i].key[length] == '\0')
+        {
+            return stats->groups[i].quantities;
+        }
+    }
+
+    if (stats->count == stats->capacity)
+    {
+        size_t capacity = stats->capacity ? 2 * stats->capacity : 16;
+        StatsGroup_t *groups = realloc(stats->groups, capacity * sizeof(StatsGroup_t));
+
+        if (groups == NULL)
+        {
+            return NULL;
+        }
+        stats->groups = groups;
+        stats->capacity = capacity;
+    }
+
+    group = &stats->groups[stats->count];
+    group->key = malloc(length + 1);
+    if (group->key == NULL)
+    {
+        return NULL;
+    }
+    memcpy(group->key, key, length);
+    group->key[length] = '\0';
+    for (int q = 0; q < STATS_QUANTITY_COUNT; q++)
+    {
+        statisticsInit(&group->quantities[q]);
+    }
+    stats->count++;
+
+    return group->quantities;
+}
+
+// Without --prefix the prefix of a comment is the comment without a
+// trailing number, e.g. "BSA" for "BSA 12" and "BSA-3".
+static size_t commentPrefix(const char *comment, int prefixLength)
+{
+    size_t length = strlen(comment);
+
+    if (prefixLength > 0)
+    {
+        return length < (size_t)prefixLength ? length : (size_t)prefixLength;
+    }
+
+    while (length > 0 && isdigit((unsigned char)comment[length - 1]))
+    {
+        length--;
+    }
+    while (length > 0 && strchr(" \t_-#.:", comment[length - 1]))
+    {
+        length--;
+    }
+    return length;
+}
+
+// index is the record in data, position the record in the file.
+static const char *statsKey(const Stats_t *stats, const DataFile_t *data, size_t index, size_t position, size_t *length)
+{
+    const char *key = NULL;
+
+    switch (stats->groupBy)
+    {
+        case STATS_GROUP_NONE:
+            key = "all";
+            break;
+        case STATS_GROUP_COMMENT:
+            key = dataFileString(data, data->records[index].comment);
+            if (key)
+            {
+                *length = commentPrefix(key, stats->prefixLength);
+                return key;
+            }
+            break;
+        case STATS_GROUP_SERIALNUMBER:
+            key = dataFileString(data, data->serialNumber);
+            break;
+        case STATS_GROUP_ROLE:
+            key = position < stats->parameters.blanks ? "blank" : "sample";
+            break;
+    }
+
+    key = key ? key : "-";
+    *length = strlen(key);
+    return key;
+}
+
+static Error_t statsChunk(Stats_t *stats, const DataFile_t *data, size_t first)
+{
+    for (size_t i = 0; i < data->count; i++)
+    {
+        const Record_t *record = &data->records[i];
+        Statistics_t *quantities;
+        const char *key;
+        size_t length;
+
+        if (!record->hasCalculated)
+        {
+            continue;
+        }
+
+        key = statsKey(stats, data, i, first + i, &length);
+        quantities = statsGroup(stats, key, length);
+        if (quantities == NULL)
+        {
+            return ERROR_COLIBRI_OUT_OF_MEMORY;
+        }
+
+        if (record->hasOD)
+        {
+            for (int w = 0; w < WAVELENGTH_COUNT; w++)
+            {
+                statisticsAdd(&quantities[w], data->calculated.od[w][i]);
+            }
+        }
+        if (record->hasConcentration && !isnan(data->calculated.concentration[i]))
+        {
+            statisticsAdd(&quantities[STATS_CONCENTRATION], data->calculated.concentration[i]);
+        }
+        stats->records++;
+    }
+    return ERROR_COLIBRI_OK;
+}
+
+// Reads the file a chunk at a time. With --calculate the leading blanks
+// records are read first for the factors. The file is only read a second
+// time if they do not fit into the first chunk.
+static Error_t statsFile(Stats_t *stats, char *file)
+{
+    ColibriReader_t reader;
+    CalcBlanks_t blanks;
+    bool isLoaded = false;
+    Error_t ret = colibriReaderOpen(&reader, file, COLIBRI_READER_CHUNK_SIZE);
+
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        return printError(ret, "File %s could not be read.\n", file);
+    }
+
+    calcBlanksInit(&blanks);
+    while (stats->calculate && ret == ERROR_COLIBRI_OK && reader.next < stats->parameters.blanks)
+    {
+        ret = colibriReaderNext(&reader);
+        if (ret != ERROR_COLIBRI_OK || reader.chunk.count == 0)
+        {
+            break;
+        }
+        calcBlanksAdd(&blanks, &reader.chunk.measurements, reader.chunk.count, reader.first, stats->parameters.blanks);
+    }
+    if (ret == ERROR_COLIBRI_OK && reader.first > 0)
+    {
+        colibriReaderClose(&reader);
+        ret = colibriReaderOpen(&reader, file, COLIBRI_READER_CHUNK_SIZE);
+        if (ret != ERROR_COLIBRI_OK)
+        {
+            return printError(ret, "File %s could not be read.\n", file);
+        }
+    }
+    else
+    {
+        isLoaded = reader.chunk.count > 0;
+    }
+
+    while (ret == ERROR_COLIBRI_OK)
+    {
+        if (!isLoaded)
+        {
+            ret = colibriReaderNext(&reader);
+        }
+        isLoaded = false;
+        if (ret != ERROR_COLIBRI_OK || reader.chunk.count == 0)
+        {
+            break;
+        }
+        if (stats->calculate)
+        {
+            ret = blanksCalculate(&blanks, &reader.chunk, stats->parameters);
+        }
+        if (ret == ERROR_COLIBRI_OK)
+        {
+            ret = statsChunk(stats, &reader.chunk, reader.first);
+        }
+    }
+    colibriReaderClose(&reader);
+
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        printError(ret, "File %s could not be read.\n", file);
+    }
+    return ret;
+}
+
+static int statsGroupCompare(const void *a, const void *b)
+{
+    return strcmp(((const StatsGroup_t *)a)->key, ((const StatsGroup_t *)b)->key);
+}
+
+static void statsPrint(Stats_t *stats)
+{
+    static const char *names[STATS_QUANTITY_COUNT] = {"OD_230", "OD_260", "OD_280", "OD_340", "CONCENTRATION"};
+
+    qsort(stats->groups, stats->count, sizeof(StatsGroup_t), statsGroupCompare);
+
+    for (size_t i = 0; i < stats->count; i++)
+    {
+        for (int q = 0; q < STATS_QUANTITY_COUNT; q++)
+        {
+            const Statistics_t *statistics = &stats->groups[i].quantities[q];
+            double stdDev = statisticsStdDev(statistics);
+
+            if (statistics->count == 0)
+            {
+                continue;
+            }
+            fprintf(stdout, "%s %s %llu %f %f %f\n", stats->groups[i].key, names[q], (unsigned long long)statistics->count,
+                    statistics->mean, stdDev, stdDev / fabs(statistics->mean) * 100.0);
+        }
+    }
+}
+
+static Error_t cmdStats(Colibri_t *self, int argcCmd, char **argvCmd)
+{
+    Error_t ret = ERROR_COLIBRI_OK;
+    Stats_t stats = {0};
+    FileList_t files = {0};
+    bool options = true;
+    int i = 0;
+
+    stats.parameters = parametersCreate();
+
+    while (i < argcCmd && options)
+    {
+        if (strncmp(argvCmd[i], "--", 2) == 0 || strncmp(argvCmd[i], "-", 1) == 0)
+        {
+            if ((strcmp(argvCmd[i], "--group") == 0) && (i + 1 < argcCmd))
+            {
+                i++;
+                if (strcmp(argvCmd[i], "comment") == 0)
+                    stats.groupBy = STATS_GROUP_COMMENT;
+                else if (strcmp(argvCmd[i], "serialnumber") == 0)
+                    stats.groupBy = STATS_GROUP_SERIALNUMBER;
+                else if (strcmp(argvCmd[i], "role") == 0)
+                    stats.groupBy = STATS_GROUP_ROLE;
+                else
+                    return printError(ERROR_COLIBRI_INVALID_PARAMETER, "Unknown group: %s\n", argvCmd[i]);
+            }
+            else if ((strcmp(argvCmd[i], "--prefix") == 0) && (i + 1 < argcCmd))
+            {
+                i++;
+                stats.prefixLength = atoi(argvCmd[i]);
+            }
+            else if (strcmp(argvCmd[i], "--calculate") == 0)
+            {
+                stats.calculate = true;
+            }
+            else if (!parametersParse(&stats.parameters, argcCmd, argvCmd, &i))
+            {
+                return printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION, "Unknown option: %s\n", argvCmd[i]);
+            }
+            i++;
+        }
+        else
+        {
+            options = false;
+        }
+    }
+
+    if (!fileListAddArguments(&files, argcCmd - i, argvCmd + i))
+    {
+        ret = files.isOutOfMemory ? ERROR_COLIBRI_OUT_OF_MEMORY : ERROR_COLIBRI_FILE_NOT_FOUND;
+        fileListFree(&files);
+        return ret;
+    }
+
+    for (size_t f = 0; f < files.count; f++)
+    {
+        Error_t err = statsFile(&stats, files.files[f]);
+
+        if (err != ERROR_COLIBRI_OK && ret == ERROR_COLIBRI_OK)
+        {
+            ret = err;
+        }
+    }
+
+    statsPrint(&stats);
+    if (self->verbose)
+    {
+        fprintf(stderr, "Statistics: %zu files, %llu records, %zu groups\n", files.count, (unsigned long long)stats.records, stats.count);
+    }
+
+    for (size_t g = 0; g < stats.count; g++)
+    {
+        free(stats.groups[g].key);
+    }
+    free(stats.groups);
+    fileListFree(&files);
+    return ret;
+}
+
+#define EXPORT_BUFFER_SIZE (4 * 1024 * 1024)
+#define EXPORT_NAME_SIZE 40
+#define EXPORT_MAX_COLUMNS 256
+#define EXPORT_DEFAULT_COLUMNS "index,comment,od,concentration"
+
+typedef enum
+{
+    COLUMN_INDEX,
+    COLUMN_COMMENT,
+    COLUMN_TIMESTAMP,
+    COLUMN_SERIALNUMBER,
+    COLUMN_FIRMWARE,
+    COLUMN_OD,
+    COLUMN_CONCENTRATION,
+    COLUMN_RAW_SAMPLE,
+    COLUMN_RAW_REFERENCE,
+    COLUMN_AMPLIFICATION_SAMPLE,
+    COLUMN_AMPLIFICATION_REFERENCE,
+    COLUMN_CURRENT,
+    COLUMN_RESULT,
+    COLUMN_RESULT_TEXT,
+} ColumnKind_t;
+
+typedef struct
+{
+    char name[EXPORT_NAME_SIZE];
+    const char *group;
+    ColumnKind_t kind;
+    Role_t role;
+    int wavelength;
+} Column_t;
+
+#define EXPORT_COLUMN_COUNT (6 + WAVELENGTH_COUNT + ROLE_COUNT * WAVELENGTH_COUNT * 2 + 5 * WAVELENGTH_COUNT)
+
+static const char *exportWavelengths[WAVELENGTH_COUNT] = {"230", "260", "280", "340"};
+
+static size_t exportAddColumn(Column_t *columns, size_t count, const char *group, ColumnKind_t kind, Role_t role, int w, const char *name)
+{
+    Column_t *column = &columns[count];
+
+    if (w < 0)
+    {
+        snprintf(column->name, EXPORT_NAME_SIZE, "%s", name);
+    }
+    else
+    {
+        snprintf(column->name, EXPORT_NAME_SIZE, "%s_%s", name, exportWavelengths[w]);
+    }
+    column->group = group;
+    column->kind = kind;
+    column->role = role;
+    column->wavelength = w;
+    return count + 1;
+}
+
+// All columns, the names follow the keys of the data file.
+static void exportColumns(Column_t *columns)
+{
+    static const char *roles[ROLE_COUNT] = {"baseline", "air", "sample"};
+    char name[EXPORT_NAME_SIZE / 2];
+    size_t count = 0;
+
+    count = exportAddColumn(columns, count, NULL, COLUMN_INDEX, 0, -1, "index");
+    count = exportAddColumn(columns, count, NULL, COLUMN_COMMENT, 0, -1, "comment");
+    count = exportAddColumn(columns, count, NULL, COLUMN_TIMESTAMP, 0, -1, "timestamp");
+    count = exportAddColumn(columns, count, NULL, COLUMN_SERIALNUMBER, 0, -1, "serialnumber");
+    count = exportAddColumn(columns, count, NULL, COLUMN_FIRMWARE, 0, -1, "firmware");
+    for (int w = 0; w < WAVELENGTH_COUNT; w++)
+    {
+        count = exportAddColumn(columns, count, "od", COLUMN_OD, 0, w, "od");
+    }
+    count = exportAddColumn(columns, count, NULL, COLUMN_CONCENTRATION, 0, -1, "concentration");
+
+    for (int role = 0; role < ROLE_COUNT; role++)
+    {
+        for (int w = 0; w < WAVELENGTH_COUNT; w++)
+        {
+            snprintf(name, sizeof(name), "%s_sample", roles[role]);
+            count = exportAddColumn(columns, count, "raw", COLUMN_RAW_SAMPLE, (Role_t)role, w, name);
+            snprintf(name, sizeof(name), "%s_reference", roles[role]);
+            count = exportAddColumn(columns, count, "raw", COLUMN_RAW_REFERENCE, (Role_t)role, w, name);
+        }
+    }
+
+    for (int w = 0; w < WAVELENGTH_COUNT; w++)
+    {
+        count = exportAddColumn(columns, count, "levelling", COLUMN_AMPLIFICATION_SAMPLE, 0, w, "amplificationSample");
+        count = exportAddColumn(columns, count, "levelling", COLUMN_AMPLIFICATION_REFERENCE, 0, w, "amplificationReference");
+        count = exportAddColumn(columns, count, "levelling", COLUMN_CURRENT, 0, w, "current");
+        count = exportAddColumn(columns, count, "levelling", COLUMN_RESULT, 0, w, "result");
+        count = exportAddColumn(columns, count, "levelling", COLUMN_RESULT_TEXT, 0, w, "resultText");
+    }
+}
+
+// Parses the comma separated list of column and group names, all selects
+// every column.
+static bool exportSelect(const Column_t *columns, char *list, const Column_t **selected, size_t *count)
+{
+    char *name = list;
+
+    *count = 0;
+    while (name)
+    {
+        char *next = strchr(name, ',');
+        bool found = false;
+
+        if (next)
+        {
+            *next++ = '\0';
+        }
+
+        for (size_t c = 0; c < EXPORT_COLUMN_COUNT; c++)
+        {
+            if (strcmp(name, "all") == 0 || strcmp(name, columns[c].name) == 0 || (columns[c].group && strcmp(name, columns[c].group) == 0))
+            {
+                if (*count == EXPORT_MAX_COLUMNS)
+                {
+                    return false;
+                }
+                selected[(*count)++] = &columns[c];
+                found = true;
+            }
+        }
+
+        if (!found)
+        {
+            printError(ERROR_COLIBRI_INVALID_PARAMETER, "Unknown column: %s\n", name);
+            return false;
+        }
+        name = next;
+    }
+    return true;
+}
+
+// CSV fields are quoted when needed, in TSV fields tabs and line breaks are
+// escaped with a backslash.
+static void exportString(Buffer_t *out, const char *s, char separator)
+{
+    if (s == NULL)
+    {
+        return;
+    }
+
+    if (separator == '\t')
+    {
+        for (; *s; s++)
+        {
+            switch (*s)
+            {
+                case '\t':
+                    bufferAppend(out, "\\t", 2);
+                    break;
+                case '\n':
+                    bufferAppend(out, "\\n", 2);
+                    break;
+                case '\r':
+                    bufferAppend(out, "\\r", 2);
+                    break;
+                case '\\':
+                    bufferAppend(out, "\\\\", 2);
+                    break;
+                default:
+                    bufferAppendChar(out, *s);
+                    break;
+            }
+        }
+    }
+    else if (strpbrk(s, ",\"\r\n") == NULL)
+    {
+        bufferAppendString(out, s);
+    }
+    else
+    {
+        bufferAppendChar(out, '"');
+        for (; *s; s++)
+        {
+            if (*s == '"')
+            {
+                bufferAppendChar(out, '"');
+            }
+            bufferAppendChar(out, *s);
+        }
+        bufferAppendChar(out, '"');
+    }
+}
+
+static void exportNumber(Buffer_t *out, double value, bool valid)
+{
+    if (valid && !isnan(value))
+    {
+        bufferAppendDouble(out, value);
+    }
+}
+
+static void exportRecord(const DataFile_t *data, size_t index, size_t fileIndex, const Column_t **columns, size_t count, char separator, Buffer_t *out)
+{
+    const Record_t *record = &data->records[index];
+    const Measurements_t *measurements = &data->measurements;
+
+    for (size_t c = 0; c < count; c++)
+    {
+        const Column_t *column = columns[c];
+        const LevellingChannel_t *levelling = column->wavelength >= 0 ? &record->levelling[column->wavelength] : NULL;
+        bool raw = column->role != ROLE_AIR || measurements->hasAir[index];
+
+        if (c > 0)
+        {
+            bufferAppendChar(out, separator);
+        }
+
+        switch (column->kind)
+        {
+            case COLUMN_INDEX:
+                bufferAppendInt64(out, (int64_t)fileIndex);
+                break;
+            case COLUMN_COMMENT:
+                exportString(out, dataFileString(data, record->comment), separator);
+                break;
+            case COLUMN_TIMESTAMP:
+                exportString(out, dataFileString(data, record->timestamp), separator);
+                break;
+            case COLUMN_SERIALNUMBER:
+                exportString(out, dataFileString(data, data->serialNumber), separator);
+                break;
+            case COLUMN_FIRMWARE:
+                exportString(out, dataFileString(data, data->firmwareVersion), separator);
+                break;
+            case COLUMN_OD:
+                exportNumber(out, data->calculated.od[column->wavelength][index], record->hasOD);
+                break;
+            case COLUMN_CONCENTRATION:
+                exportNumber(out, data->calculated.concentration[index], record->hasConcentration);
+                break;
+            case COLUMN_RAW_SAMPLE:
+                exportNumber(out, measurements->sample[column->role][column->wavelength][index], raw);
+                break;
+            case COLUMN_RAW_REFERENCE:
+                exportNumber(out, measurements->reference[column->role][column->wavelength][index], raw);
+                break;
+            case COLUMN_AMPLIFICATION_SAMPLE:
+                exportNumber(out, levelling->amplificationSample, record->hasLevelling);
+                break;
+            case COLUMN_AMPLIFICATION_REFERENCE:
+                exportNumber(out, levelling->amplificationReference, record->hasLevelling);
+                break;
+            case COLUMN_CURRENT:
+                exportNumber(out, levelling->current, record->hasLevelling);
+                break;
+            case COLUMN_RESULT:
+                exportNumber(out, levelling->result, record->hasLevelling);
+                break;
+            case COLUMN_RESULT_TEXT:
+                exportString(out, record->hasLevelling ? dataFileString(data, levelling->resultText) : NULL, separator);
+                break;
+        }
+    }
+    bufferAppendChar(out, '\n');
+}
+
+// The records are read a chunk at a time and written through one large
+// buffer, neither depends on the size of the file.
+static Error_t cmdExport(Colibri_t *self, int argcCmd, char **argvCmd)
+{
+    static Column_t columns[EXPORT_COLUMN_COUNT];
+    const Column_t *selected[EXPORT_MAX_COLUMNS];
+    char defaultColumns[] = EXPORT_DEFAULT_COLUMNS;
+    char *columnList = defaultColumns;
+    char *output = NULL;
+    char separator = ',';
+    size_t count;
+    ColibriReader_t reader;
+    Buffer_t out;
+    FILE *fout = stdout;
+    Error_t ret;
+    bool ok;
+    int i = 0;
+
+    while (i + 1 < argcCmd)
+    {
+        if ((strcmp(argvCmd[i], "--format") == 0) && (i + 2 < argcCmd))
+        {
+            i++;
+            if (strcmp(argvCmd[i], "csv") == 0)
+                separator = ',';
+            else if (strcmp(argvCmd[i], "tsv") == 0)
+                separator = '\t';
+            else
+                return printError(ERROR_COLIBRI_INVALID_PARAMETER, "Unknown format: %s\n", argvCmd[i]);
+        }
+        else if ((strcmp(argvCmd[i], "--columns") == 0) && (i + 2 < argcCmd))
+        {
+            columnList = argvCmd[++i];
+        }
+        else if ((strcmp(argvCmd[i], "--output") == 0) && (i + 2 < argcCmd))
+        {
+            output = argvCmd[++i];
+        }
+        else
+        {
+            return printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION, "Unknown option: %s\n", argvCmd[i]);
+        }
+        i++;
+    }
+    if (i + 1 != argcCmd)
+    {
+        return ERROR_COLIBRI_INVALID_PARAMETER;
+    }
+
+    exportColumns(columns);
+    if (!exportSelect(columns, columnList, selected, &count))
+    {
+        return ERROR_COLIBRI_INVALID_PARAMETER;
+    }
+
+    ret = colibriReaderOpen(&reader, argvCmd[i], COLIBRI_READER_CHUNK_SIZE);
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        return printError(ret, "File %s could not be read.\n", argvCmd[i]);
+    }
+
+    if (output)
+    {
+        fout = fopen(output, "wb");
+        if (fout == NULL)
+        {
+            colibriReaderClose(&reader);
+            return printError(ERROR_COLIBRI_FILE_WRITE_ERROR, "File %s could not be created.\n", output);
+        }
+    }
+
+    bufferInit(&out);
+    ok = bufferReserve(&out, EXPORT_BUFFER_SIZE);
+    bufferAttach(&out, fout);
+
+    for (size_t c = 0; c < count && ok; c++)
+    {
+        if (c > 0)
+        {
+            bufferAppendChar(&out, separator);
+        }
+        bufferAppendString(&out, selected[c]->name);
+    }
+    ok = ok && bufferAppendChar(&out, '\n');
+
+    while (ok && ret == ERROR_COLIBRI_OK)
+    {
+        ret = colibriReaderNext(&reader);
+        if (ret != ERROR_COLIBRI_OK || reader.chunk.count == 0)
+        {
+            break;
+        }
+        for (size_t r = 0; r < reader.chunk.count; r++)
+        {
+            exportRecord(&reader.chunk, r, reader.first + r, selected, count, separator, &out);
+        }
+    }
+
+    ok = bufferFlush(&out) && ok;
+    bufferFree(&out);
+    colibriReaderClose(&reader);
+    if (output)
+    {
+        ok = (fclose(fout) == 0) && ok;
+    }
+    else
+    {
+        ok = (fflush(fout) == 0) && ok;
+    }
+
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        return printError(ret, "File %s could not be read.\n", argvCmd[i]);
+    }
+    if (!ok)
+    {
+        return printError(ERROR_COLIBRI_FILE_WRITE_ERROR, NULL);
+    }
+    return ERROR_COLIBRI_OK;
+}
+
+#define SWEEP_MAX_VALUES 256
+
+// Parses a comma separated list of values and ranges FROM:TO:STEP.
+static bool sweepValues(const char *text, double *values, size_t *count)
+{
+    const char *position = text;
+    char *end;
+
+    *count = 0;
+    while (*position)
+    {
+        double from = strtod(position, &end);
+
+        if (end == position)
+        {
+            return false;
+        }
+        position = end;
+
+        if (*position == ':')
+        {
+            double to = strtod(position + 1, &end);
+            double step;
+
+            if (end == position + 1 || *end != ':')
+            {
+                return false;
+            }
+            position = end + 1;
+            step = strtod(position, &end);
+            if (end == position || !(step > 0.0))
+            {
+                return false;
+            }
+            position = end;
+
+            // The tolerance keeps TO in the range despite rounding of the steps
+            for (size_t k = 0; from + k * step <= to + step * 1e-9; k++)
+            {
+                if (*count == SWEEP_MAX_VALUES)
+                {
+                    return false;
+                }
+                values[(*count)++] = from + k * step;
+            }
+        }
+        else
+        {
+            if (*count == SWEEP_MAX_VALUES)
+            {
+                return false;
+            }
+            values[(*count)++] = from;
+        }
+
+        if (*position == ',')
+        {
+            position++;
+        }
+        else if (*position != '\0')
+        {
+            return false;
+        }
+    }
+    return *count > 0;
+}
+
 typedef struct
 {
-    double value230nm;
-    double value260nm;
-    double value280nm;
-    double value340nm;
-} Quadruple_t;
+    double blanks[SWEEP_MAX_VALUES];
+    double pathLengths[SWEEP_MAX_VALUES];
+    double a260Units[SWEEP_MAX_VALUES];
+    size_t blanksCount;
+    size_t pathLengthCount;
+    size_t a260UnitCount;
+    char separator;
+} Sweep_t;
+
+static void sweepRows(const Sweep_t *sweep, const DataFile_t *data, const Results_t *results, uint32_t blanks, double pathLength, double a260Unit, Buffer_t *out)
+{
+    for (size_t i = 0; i < data->count; i++)
+    {
+        bufferAppendUint32(out, blanks);
+        bufferAppendChar(out, sweep->separator);
+        bufferAppendDouble(out, pathLength);
+        bufferAppendChar(out, sweep->separator);
+        bufferAppendDouble(out, a260Unit);
+        bufferAppendChar(out, sweep->separator);
+        bufferAppendInt64(out, (int64_t)i);
+        bufferAppendChar(out, sweep->separator);
+        exportString(out, dataFileString(data, data->records[i].comment), sweep->separator);
+        for (int w = 0; w < WAVELENGTH_COUNT; w++)
+        {
+            bufferAppendChar(out, sweep->separator);
+            bufferAppendDouble(out, results->od[w][i]);
+        }
+        bufferAppendChar(out, sweep->separator);
+        exportNumber(out, results->concentration[i], data->measurements.hasAir[i]);
+        bufferAppendChar(out, '\n');
+    }
+}
+
+// The optical densities against the baseline are calculated once. Every
+// number of blanks only needs its factors and the air correction, every
+// path length and unit only the concentration.
+static Error_t sweepFile(const Sweep_t *sweep, char *file, Buffer_t *out, bool verbose)
+{
+    static const char *header[] = {"blanks", "pathLength", "a260unit", "index", "comment", "od_230", "od_260", "od_280", "od_340", "concentration"};
+    Error_t ret;
+    DataFile_t data;
+    CalcSweep_t calcSweep;
+    Results_t results;
+    cJSON *json;
+
+    ret = loadDataFile(file, &data, &json, NULL);
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        return ret;
+    }
+
+    if (!calcSweepCreate(&calcSweep, &data.measurements))
+    {
+        dataFileFree(&data);
+        colibriJsonRelease(json);
+        return ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+    if (!resultsCreate(&results, data.count))
+    {
+        calcSweepFree(&calcSweep);
+        dataFileFree(&data);
+        colibriJsonRelease(json);
+        return ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
 
-Quadruple_t quadrupleCreate(double value)
-{
-    Quadruple_t ret = {0};
+    for (size_t h = 0; h < sizeof(header) / sizeof(header[0]); h++)
+    {
+        if (h > 0)
+        {
+            bufferAppendChar(out, sweep->separator);
+        }
+        bufferAppendString(out, header[h]);
+    }
+    bufferAppendChar(out, '\n');
 
-    ret.value230nm = value;
-    ret.value260nm = value;
-    ret.value280nm = value;
-    ret.value340nm = value;
+    for (size_t b = 0; b < sweep->blanksCount; b++)
+    {
+        uint32_t blanks = (uint32_t)sweep->blanks[b];
+        double factors[WAVELENGTH_COUNT];
 
-    return ret;
+        calcSweepFactors(&calcSweep, blanks, factors);
+        calcSweepODs(&calcSweep, factors, &results);
+
+        for (size_t p = 0; p < sweep->pathLengthCount; p++)
+        {
+            for (size_t u = 0; u < sweep->a260UnitCount; u++)
+            {
+                calcSweepConcentration(&calcSweep, sweep->pathLengths[p], sweep->a260Units[u], &results);
+                sweepRows(sweep, &data, &results, blanks, sweep->pathLengths[p], sweep->a260Units[u], out);
+            }
+        }
+    }
+
+    if (verbose)
+    {
+        fprintf(stderr, "Sweep: %zu parameter sets, %zu measurements\n",
+                sweep->blanksCount * sweep->pathLengthCount * sweep->a260UnitCount, data.count);
+    }
+
+    resultsFree(&results);
+    calcSweepFree(&calcSweep);
+    dataFileFree(&data);
+    colibriJsonRelease(json);
+    return ERROR_COLIBRI_OK;
 }
 
-Quadruple_t quadrupleAdd(Quadruple_t a, Quadruple_t b)
+static Error_t cmdSweep(Colibri_t *self, int argcCmd, char **argvCmd)
 {
-    Quadruple_t ret;
+    Sweep_t *sweep = calloc(1, sizeof(Sweep_t));
+    Parameters_t parameters = parametersCreate();
+    char *output = NULL;
+    FILE *fout = stdout;
+    Buffer_t out;
+    Error_t ret = ERROR_COLIBRI_OK;
+    bool ok;
+    int i = 0;
+
+    if (sweep == NULL)
+    {
+        return ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+    sweep->separator = ',';
+    sweep->blanks[0] = parameters.blanks;
+    sweep->pathLengths[0] = parameters.pathLength;
+    sweep->a260Units[0] = parameters.a260Unit;
+    sweep->blanksCount = 1;
+    sweep->pathLengthCount = 1;
+    sweep->a260UnitCount = 1;
+
+    while (i + 1 < argcCmd && ret == ERROR_COLIBRI_OK)
+    {
+        char *option = argvCmd[i];
+        char *value = i + 2 < argcCmd ? argvCmd[i + 1] : NULL;
+
+        if (value == NULL)
+        {
+            ret = printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION, "Unknown option: %s\n", option);
+        }
+        else if (strcmp(option, "--blanks") == 0)
+        {
+            ok = sweepValues(value, sweep->blanks, &sweep->blanksCount);
+            for (size_t b = 0; b < sweep->blanksCount && ok; b++)
+            {
+                ok = sweep->blanks[b] >= 0.0 && sweep->blanks[b] <= UINT32_MAX && sweep->blanks[b] == floor(sweep->blanks[b]);
+            }
+            ret = ok ? ERROR_COLIBRI_OK : printError(ERROR_COLIBRI_INVALID_PARAMETER, "Invalid values: %s\n", value);
+        }
+        else if (strcmp(option, "--pathLength") == 0)
+        {
+            ok = sweepValues(value, sweep->pathLengths, &sweep->pathLengthCount);
+            ret = ok ? ERROR_COLIBRI_OK : printError(ERROR_COLIBRI_INVALID_PARAMETER, "Invalid values: %s\n", value);
+        }
+        else if (strcmp(option, "--a260unit") == 0)
+        {
+            ok = sweepValues(value, sweep->a260Units, &sweep->a260UnitCount);
+            ret = ok ? ERROR_COLIBRI_OK : printError(ERROR_COLIBRI_INVALID_PARAMETER, "Invalid values: %s\n", value);
+        }
+        else if (strcmp(option, "--format") == 0 && (strcmp(value, "csv") == 0 || strcmp(value, "tsv") == 0))
+        {
+            sweep->separator = value[0] == 't' ? '\t' : ',';
+        }
+        else if (strcmp(option, "--output") == 0)
+        {
+            output = value;
+        }
+        else
+        {
+            ret = printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION, "Unknown option: %s\n", option);
+        }
+        i += 2;
+    }
+
+    if (ret == ERROR_COLIBRI_OK && i + 1 != argcCmd)
+    {
+        ret = ERROR_COLIBRI_INVALID_PARAMETER;
+    }
+
+    if (ret == ERROR_COLIBRI_OK && output)
+    {
+        fout = fopen(output, "wb");
+        if (fout == NULL)
+        {
+            ret = printError(ERROR_COLIBRI_FILE_WRITE_ERROR, "File %s could not be created.\n", output);
+        }
+    }
+
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        free(sweep);
+        return ret;
+    }
+
+    bufferInit(&out);
+    ok = bufferReserve(&out, EXPORT_BUFFER_SIZE);
+    bufferAttach(&out, fout);
+
+    ret = ok ? sweepFile(sweep, argvCmd[i], &out, self->verbose) : ERROR_COLIBRI_OUT_OF_MEMORY;
 
-    ret.value230nm = a.value230nm + b.value230nm;
-    ret.value260nm = a.value260nm + b.value260nm;
-    ret.value280nm = a.value280nm + b.value280nm;
-    ret.value340nm = a.value340nm + b.value340nm;
+    ok = bufferFlush(&out);
+    bufferFree(&out);
+    ok = (output ? fclose(fout) == 0 : fflush(fout) == 0) && ok;
+    if (ret == ERROR_COLIBRI_OK && !ok)
+    {
+        ret = ERROR_COLIBRI_FILE_WRITE_ERROR;
+    }
 
+    free(sweep);
     return ret;
 }
 
-Quadruple_t quadrupleSub(Quadruple_t a, Quadruple_t b)
+#define WATCH_BATCH_SIZE 1024
+#define WATCH_TAIL_SIZE 64
+
+// State of data watch between two changes of the file. offset is the end of
+// the last record read and tail the bytes before it, which have to be the
+// same in the new file to continue reading at offset.
+typedef struct
 {
-    Quadruple_t ret;
+    Parameters_t parameters;
+    size_t count;
+    size_t offset;
+    char tail[WATCH_TAIL_SIZE];
+    size_t tailSize;
+    CalcBlanks_t blanks;
+} Watch_t;
 
-    ret.value230nm = a.value230nm - b.value230nm;
-    ret.value260nm = a.value260nm - b.value260nm;
-    ret.value280nm = a.value280nm - b.value280nm;
-    ret.value340nm = a.value340nm - b.value340nm;
+static void watchReset(Watch_t *watch)
+{
+    watch->count = 0;
+    watch->offset = 0;
+    watch->tailSize = 0;
+    calcBlanksInit(&watch->blanks);
+}
 
-    return ret;
+// Calculates a batch of new records with the blanks seen so far.
+static Error_t watchCalculate(Watch_t *watch, DataFile_t *batch)
+{
+    calcBlanksAdd(&watch->blanks, &batch->measurements, batch->count, watch->count, watch->parameters.blanks);
+    return blanksCalculate(&watch->blanks, batch, watch->parameters);
 }
 
-Quadruple_t quadrupleMul(Quadruple_t a, Quadruple_t b)
+// Reads the records behind watch->offset and prints the ones after the
+// first printFrom records. The text in front of offset is not read again.
+static Error_t watchRead(Watch_t *watch, const MappedFile_t *map, size_t printFrom, ColibriJsonScope_t *scope, Buffer_t *out)
 {
-    Quadruple_t ret;
+    const char *text = map->data;
+    Error_t ret = ERROR_COLIBRI_OK;
+    DataFile_t batch;
+    bool done = false;
+
+    if (!dataFileCreate(&batch, WATCH_BATCH_SIZE))
+    {
+        return ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+
+    while (!done && ret == ERROR_COLIBRI_OK)
+    {
+        size_t count = 0;
+
+        colibriJsonScopeReset(scope);
+        batch.stringsSize = 0;
+        while (count < WATCH_BATCH_SIZE)
+        {
+            size_t offset = watch->offset;
+            cJSON *record;
+
+            // A record which does not parse yet ends the update
+            if (!colibriJsonReadRecord(text, map->size, &offset, &record) || record == NULL)
+            {
+                done = true;
+                break;
+            }
+            colibriJsonDecodeRecord(record, &batch, count);
+            batch.records[count].node = NULL;
+            colibriJsonRelease(record);
+            watch->offset = offset;
+            count++;
+        }
 
-    ret.value230nm = a.value230nm * b.value230nm;
-    ret.value260nm = a.value260nm * b.value260nm;
-    ret.value280nm = a.value280nm * b.value280nm;
-    ret.value340nm = a.value340nm * b.value340nm;
+        batch.count = count;
+        ret = watchCalculate(watch, &batch);
+        for (size_t i = 0; i < count && ret == ERROR_COLIBRI_OK; i++)
+        {
+            if (watch->count + i >= printFrom)
+            {
+                bufferAppendUint32(out, (uint32_t)(watch->count + i));
+                bufferAppendChar(out, ' ');
+                printRecord(&batch, i, out);
+            }
+        }
+        watch->count += count;
+    }
+
+    watch->tailSize = watch->offset < WATCH_TAIL_SIZE ? watch->offset : WATCH_TAIL_SIZE;
+    memcpy(watch->tail, text + watch->offset - watch->tailSize, watch->tailSize);
 
+    dataFileFree(&batch);
     return ret;
 }
 
-Quadruple_t quadrupleDiv(Quadruple_t a, Quadruple_t b)
+static Error_t watchUpdate(Watch_t *watch, const char *file, ColibriJsonScope_t *scope, Buffer_t *out)
 {
-    Quadruple_t ret;
+    MappedFile_t map;
+    size_t printFrom = watch->count;
+    Error_t ret;
+
+    // The file may be missing for a moment while it is replaced
+    if (!systemMapFile(&map, file))
+    {
+        return ERROR_COLIBRI_OK;
+    }
+
+    // If the text in front of the last record changed, e.g. by data
+    // calculate, the file is read from the beginning once more
+    if (watch->offset == 0 || map.size < watch->offset ||
+        memcmp((const char *)map.data + watch->offset - watch->tailSize, watch->tail, watch->tailSize) != 0)
+    {
+        DataFile_t header;
+
+        watchReset(watch);
+        if (!dataFileCreate(&header, 0) || !colibriJsonReadHeader(map.data, map.size, &header, &watch->offset))
+        {
+            dataFileFree(&header);
+            systemUnmapFile(&map);
+            return printError(ERROR_COLIBRI_INVALID_FILE_FORMAT, "File %s is not a data file.\n", file);
+        }
+        dataFileFree(&header);
+    }
 
-    ret.value230nm = a.value230nm / b.value230nm;
-    ret.value260nm = a.value260nm / b.value260nm;
-    ret.value280nm = a.value280nm / b.value280nm;
-    ret.value340nm = a.value340nm / b.value340nm;
+    ret = watch->offset ? watchRead(watch, &map, printFrom, scope, out) : ERROR_COLIBRI_OK;
 
+    systemUnmapFile(&map);
     return ret;
 }
 
-typedef struct
+static Error_t cmdWatch(Colibri_t *self, int argcCmd, char **argvCmd)
 {
-    double sample;
-    double reference;
-} SingleMeasurement_t;
+    ColibriJsonScope_t scope;
+    SystemWatch_t systemWatch;
+    Watch_t watch;
+    Buffer_t out;
+    Error_t ret = ERROR_COLIBRI_OK;
+    char *file = argvCmd[argcCmd - 1];
 
-SingleMeasurement_t singleMeasurement(cJSON *obj)
-{
-    SingleMeasurement_t ret = {0};
+    watch.parameters = parametersCreate();
+    for (int i = 0; i < argcCmd - 1; i++)
+    {
+        if (!parametersParse(&watch.parameters, argcCmd - 1, argvCmd, &i))
+        {
+            return printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION, "Unknown option: %s\n", argvCmd[i]);
+        }
+    }
+    watchReset(&watch);
+
+    if (colibriArchiveProbe(file))
+    {
+        return printError(ERROR_COLIBRI_INVALID_FILE_FORMAT, "Only JSON files can be watched.\n");
+    }
+    if (!systemWatchStart(&systemWatch, file))
+    {
+        return printError(ERROR_COLIBRI_FILE_NOT_FOUND, "Could not watch %s.\n", file);
+    }
 
-    cJSON *oSample = cJSON_GetObjectItem(obj, DICT_SAMPLE);
-    cJSON *oReference = cJSON_GetObjectItem(obj, DICT_REFERENCE);
+    bufferInit(&out);
+    colibriJsonScopeBegin(&scope, false);
 
-    ret.sample = cJSON_GetNumberValue(oSample);
-    ret.reference = cJSON_GetNumberValue(oReference);
+    do
+    {
+        ret = watchUpdate(&watch, file, &scope, &out);
+        fwrite(out.data, 1, out.size, stdout);
+        fflush(stdout);
+        bufferClear(&out);
+    } while (ret == ERROR_COLIBRI_OK && systemWatchWait(&systemWatch));
 
+    colibriJsonScopeEnd(&scope);
+    bufferFree(&out);
+    systemWatchStop(&systemWatch);
     return ret;
 }
 
-static double calculateOneOD(cJSON *baseline, cJSON *measurement, char *key)
+#define GENERATE_BATCH_SIZE 1024
+
+typedef enum
+{
+    NOISE_NONE,
+    NOISE_UNIFORM,
+    NOISE_GAUSSIAN,
+} Noise_t;
+
+typedef enum
 {
-    double ret = 0.0;
+    GENERATE_PRETTY,
+    GENERATE_COMPACT,
+    GENERATE_ARCHIVE,
+} GenerateFormat_t;
 
-    SingleMeasurement_t b = singleMeasurement(cJSON_GetObjectItem(baseline, key));
-    SingleMeasurement_t m = singleMeasurement(cJSON_GetObjectItem(measurement, key));
+// Settings and state of data generate. The measurements only depend on the
+// settings and the seed, not on the format.
+typedef struct
+{
+    size_t count;
+    size_t blanks;
+    double air;
+    Noise_t noise;
+    double level;
+    GenerateFormat_t format;
+    uint64_t state;
+} Generate_t;
 
-    ret = log10(b.sample / b.reference * m.reference / m.sample);
+// Counts of the baseline per wavelength, about those of a real device
+static const double generateSampleCounts[WAVELENGTH_COUNT] = {950000.0, 1050000.0, 1000000.0, 950000.0};
+static const double generateReferenceCounts[WAVELENGTH_COUNT] = {980000.0, 1020000.0, 1000000.0, 960000.0};
 
-    return ret;
+// splitmix64
+static uint64_t generateNext(Generate_t *g)
+{
+    uint64_t z = (g->state += 0x9E3779B97F4A7C15ull);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1)
+static double generateUniform(Generate_t *g)
+{
+    return (double)(generateNext(g) >> 11) * (1.0 / 9007199254740992.0);
 }
 
-static Quadruple_t calculateOD(cJSON *baseline, cJSON *measurement)
+static double generateNoise(Generate_t *g)
 {
-    Quadruple_t ods = quadrupleCreate(0.0);
+    double u;
+    double v;
 
-    ods.value230nm = calculateOneOD(baseline, measurement, DICT_230);
-    ods.value260nm = calculateOneOD(baseline, measurement, DICT_260);
-    ods.value280nm = calculateOneOD(baseline, measurement, DICT_280);
-    ods.value340nm = calculateOneOD(baseline, measurement, DICT_340);
+    switch (g->noise)
+    {
+        case NOISE_UNIFORM:
+            return g->level * (2.0 * generateUniform(g) - 1.0);
+        case NOISE_GAUSSIAN:
+            u = 1.0 - generateUniform(g);
+            v = generateUniform(g);
+            return g->level * sqrt(-2.0 * log(u)) * cos(6.283185307179586 * v);
+        default:
+            return 0.0;
+    }
+}
 
-    return ods;
+static double generateCount(Generate_t *g, double count)
+{
+    return round(count * (1.0 + generateNoise(g)));
 }
 
-static cJSON *calculate(cJSON *measurement, Quadruple_t factors, Parameters_t parameters)
+// Generates the measurement number of the file into index of data. Blanks
+// have an air measurement and a sample like the baseline, the other samples
+// have an OD 260 between 0.05 and 2 with typical ratios for DNA.
+static void generateRecord(Generate_t *g, DataFile_t *data, size_t index, size_t number, uint32_t ok)
 {
-    cJSON *obj = cJSON_CreateObject();
+    static const double ratios[WAVELENGTH_COUNT] = {1.0 / 2.1, 1.0, 1.0 / 1.85, 0.005};
+    Measurements_t *m = &data->measurements;
+    Record_t *record = &data->records[index];
+    bool isBlank = number < g->blanks;
+    double od260 = isBlank ? 0.0 : 0.05 + 1.95 * generateUniform(g);
+    time_t time = 1704067200 + (time_t)number * 60;
+    char text[32];
 
-    cJSON *baseline = cJSON_GetObjectItem(measurement, DICT_BASELINE);
-    cJSON *air = cJSON_GetObjectItem(measurement, DICT_AIR);
-    cJSON *sample = cJSON_GetObjectItem(measurement, DICT_SAMPLE);
+    memset(record, 0, sizeof(Record_t));
+    m->hasAir[index] = isBlank || generateUniform(g) < g->air;
 
-    Quadruple_t ods;
+    for (int w = 0; w < WAVELENGTH_COUNT; w++)
+    {
+        m->sample[ROLE_BASELINE][w][index] = generateCount(g, generateSampleCounts[w]);
+        m->reference[ROLE_BASELINE][w][index] = generateCount(g, generateReferenceCounts[w]);
+        m->sample[ROLE_AIR][w][index] = m->hasAir[index] ? generateCount(g, generateSampleCounts[w]) : 1.0;
+        m->reference[ROLE_AIR][w][index] = m->hasAir[index] ? generateCount(g, generateReferenceCounts[w]) : 1.0;
+        m->sample[ROLE_SAMPLE][w][index] = generateCount(g, generateSampleCounts[w] * pow(10.0, -od260 * ratios[w]));
+        m->reference[ROLE_SAMPLE][w][index] = generateCount(g, generateReferenceCounts[w]);
+
+        record->levelling[w].amplificationSample = 11.02;
+        record->levelling[w].amplificationReference = 1.1;
+        record->levelling[w].current = round(3000.0 + 17000.0 * generateUniform(g));
+        record->levelling[w].result = 0.0;
+        record->levelling[w].resultText = ok;
+    }
+    record->hasLevelling = true;
 
-    if (air)
+    if (isBlank)
     {
-        Quadruple_t odsSample = calculateOD(baseline, sample);
-        Quadruple_t odsAir = calculateOD(baseline, air);
-        ods = quadrupleSub(odsSample, quadrupleMul(odsAir, factors));
-        cJSON_AddItemToObject(obj, DICT_CONCENTRATION, cJSON_CreateNumber(ods.value260nm * 10.0 / parameters.pathLength * parameters.a260Unit));
+        snprintf(text, sizeof(text), "blank %zu", number + 1);
     }
     else
     {
-        ods = calculateOD(baseline, sample);
+        snprintf(text, sizeof(text), "sample %zu", number - g->blanks + 1);
     }
+    record->comment = dataFileAddString(data, text);
+    strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", gmtime(&time));
+    record->timestamp = dataFileAddString(data, text);
+}
 
-    cJSON *oOD = cJSON_CreateObject();
-    cJSON_AddItemToObject(oOD, DICT_230, cJSON_CreateNumber(ods.value230nm));
-    cJSON_AddItemToObject(oOD, DICT_260, cJSON_CreateNumber(ods.value260nm));
-    cJSON_AddItemToObject(oOD, DICT_280, cJSON_CreateNumber(ods.value280nm));
-    cJSON_AddItemToObject(oOD, DICT_340, cJSON_CreateNumber(ods.value340nm));
-    cJSON_AddItemToObject(obj, DICT_OD, oOD);
+static void generateBatch(Generate_t *g, DataFile_t *data, size_t first, size_t count)
+{
+    uint32_t ok;
 
-    return obj;
+    data->stringsSize = 0;
+    data->serialNumber = dataFileAddString(data, "GENERATED");
+    data->firmwareVersion = dataFileAddString(data, "0.0.0");
+    ok = dataFileAddString(data, "OK");
+    data->count = count;
+    for (size_t i = 0; i < count; i++)
+    {
+        generateRecord(g, data, i, first + i, ok);
+    }
 }
 
-static Quadruple_t calculateFactors(cJSON *oMeasurments, uint32_t nrOfBlanks)
+// Archives are written as a whole, JSON files a batch at a time. The text
+// around the records is taken from the printed file without measurements.
+static Error_t generateFile(Generate_t *g, const char *file)
 {
-    Quadruple_t factors = quadrupleCreate(0.0);
+    size_t size = strlen(file) + sizeof(".tmp");
+    char *tempFile = malloc(size);
+    bool pretty = g->format == GENERATE_PRETTY;
+    ColibriJsonScope_t scope;
+    DataFile_t data;
+    Buffer_t document;
+    Buffer_t out;
+    FILE *fout = NULL;
+    cJSON *json;
+    char *tail = NULL;
+    Error_t ret = ERROR_COLIBRI_OK;
+
+    if (tempFile == NULL || !dataFileCreate(&data, g->format == GENERATE_ARCHIVE ? g->count : GENERATE_BATCH_SIZE))
+    {
+        free(tempFile);
+        return ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+
+    if (g->format == GENERATE_ARCHIVE)
+    {
+        generateBatch(g, &data, 0, g->count);
+        ret = colibriArchiveSave(file, &data);
+        dataFileFree(&data);
+        free(tempFile);
+        return ret;
+    }
+
+    bufferInit(&document);
+    bufferInit(&out);
+    colibriJsonScopeBegin(&scope, false);
+
+    generateBatch(g, &data, 0, 0);
+    json = colibriJsonEncode(&data);
+    if (!colibriJsonPrint(json, pretty, &document) || (tail = strrchr(document.data, ']')) == NULL)
+    {
+        ret = ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+    colibriJsonRelease(json);
+    colibriJsonScopeReset(&scope);
+
+    if (ret == ERROR_COLIBRI_OK)
+    {
+        snprintf(tempFile, size, "%s.tmp", file);
+        fout = fopen(tempFile, "wb");
+        ret = fout ? ERROR_COLIBRI_OK : printError(ERROR_COLIBRI_FILE_WRITE_ERROR, "File %s could not be created.\n", tempFile);
+    }
 
-    cJSON *iterator = NULL;
-    uint32_t index = 0;
-    uint32_t count = 0;
-    cJSON_ArrayForEach(iterator, oMeasurments)
+    if (ret == ERROR_COLIBRI_OK)
     {
-        if (index < nrOfBlanks)
+        bufferReserve(&out, COLIBRI_JSON_WRITE_BUFFER_SIZE);
+        bufferAttach(&out, fout);
+        if (!bufferAppend(&out, document.data, tail - document.data))
+        {
+            ret = ERROR_COLIBRI_FILE_WRITE_ERROR;
+        }
+
+        for (size_t first = 0; first < g->count && ret == ERROR_COLIBRI_OK; first += GENERATE_BATCH_SIZE)
         {
-            cJSON *oBaseline = cJSON_GetObjectItem(iterator, DICT_BASELINE);
-            cJSON *oAir = cJSON_GetObjectItem(iterator, DICT_AIR);
-            cJSON *oSample = cJSON_GetObjectItem(iterator, DICT_SAMPLE);
-            if (oAir)
+            size_t count = g->count - first < GENERATE_BATCH_SIZE ? g->count - first : GENERATE_BATCH_SIZE;
+            const cJSON *measurements;
+            const cJSON *record;
+
+            generateBatch(g, &data, first, count);
+            json = colibriJsonEncode(&data);
+            measurements = cJSON_GetObjectItem(json, DICT_MEASUREMENTS);
+            // A failed encoding misses the measurements or some records
+            if (measurements == NULL || (size_t)cJSON_GetArraySize(measurements) != count)
+            {
+                ret = printError(ERROR_COLIBRI_OUT_OF_MEMORY, NULL);
+            }
+            record = measurements ? measurements->child : NULL;
+            for (size_t i = 0; record != NULL && ret == ERROR_COLIBRI_OK; i++, record = record->next)
             {
-                Quadruple_t odsAir = calculateOD(oBaseline, oAir);
-                Quadruple_t odsSample = calculateOD(oBaseline, oSample);
-                factors = quadrupleAdd(factors, quadrupleDiv(odsSample, odsAir));
-                count++;
+                if ((first + i > 0 && !bufferAppendString(&out, pretty ? ", " : ",")) ||
+                    !colibriJsonAppend(record, 1, pretty, &out))
+                {
+                    ret = ERROR_COLIBRI_FILE_WRITE_ERROR;
+                }
             }
+            colibriJsonRelease(json);
+            colibriJsonScopeReset(&scope);
+        }
+
+        if (ret == ERROR_COLIBRI_OK && !(bufferAppendString(&out, tail) && bufferFlush(&out)))
+        {
+            ret = ERROR_COLIBRI_FILE_WRITE_ERROR;
         }
-        index++;
+        bufferAttach(&out, NULL);
     }
-    if (count == 0)
+
+    if (fout && fclose(fout) != 0 && ret == ERROR_COLIBRI_OK)
     {
-        return quadrupleCreate(1.0);
+        ret = ERROR_COLIBRI_FILE_WRITE_ERROR;
     }
-    else
+    if (ret == ERROR_COLIBRI_OK && !systemReplaceFile(tempFile, file))
+    {
+        ret = ERROR_COLIBRI_FILE_WRITE_ERROR;
+    }
+    if (fout && ret != ERROR_COLIBRI_OK)
     {
-        Quadruple_t c = quadrupleCreate(count);
-        return quadrupleDiv(factors, c);
+        remove(tempFile);
     }
-    return factors;
+
+    colibriJsonScopeEnd(&scope);
+    dataFileFree(&data);
+    bufferFree(&document);
+    bufferFree(&out);
+    free(tempFile);
+    return ret;
 }
 
-static Error_t cmdCalculate(Colibri_t *self, int argcCmd, char **argvCmd)
+static Error_t cmdGenerate(Colibri_t *self, int argcCmd, char **argvCmd)
 {
+    Generate_t g;
     Error_t ret = ERROR_COLIBRI_OK;
-    Parameters_t parameters = parametersCreate();
-    bool options = true;
+    char *end;
     int i = 0;
 
-    while (i < argcCmd && options)
+    g.count = 1000;
+    g.blanks = 1;
+    g.air = 0.0;
+    g.noise = NOISE_GAUSSIAN;
+    g.level = 0.01;
+    g.format = GENERATE_PRETTY;
+    g.state = 1;
+
+    for (int j = 0; j < argcCmd; j++)
     {
-        if (strncmp(argvCmd[i], "--", 2) == 0 || strncmp(argvCmd[i], "-", 1) == 0)
+        if (strcmp(argvCmd[j], "--help") == 0 || strcmp(argvCmd[j], "-h") == 0)
+        {
+            fprintf(stdout, "Usage: colibri data generate [OPTIONS] FILE\nSee 'colibri help data' for the options.\n");
+            return ERROR_COLIBRI_OK;
+        }
+    }
+
+    while (i + 1 < argcCmd && ret == ERROR_COLIBRI_OK)
+    {
+        char *option = argvCmd[i];
+        char *value = i + 2 < argcCmd ? argvCmd[i + 1] : NULL;
+
+        if (value == NULL)
+        {
+            ret = printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION, "Unknown option: %s\n", option);
+        }
+        else if (strcmp(option, "--count") == 0 || strcmp(option, "--blanks") == 0 || strcmp(option, "--seed") == 0)
         {
-            if ((strcmp(argvCmd[i], "--pathLength") == 0) && (i + 1 < argcCmd))
+            unsigned long long number = strtoull(value, &end, 10);
+
+            if (*end != '\0' || end == value || value[0] == '-')
             {
-                i++;
-                parameters.pathLength = atof(argvCmd[i]);
+                ret = printError(ERROR_COLIBRI_INVALID_NUMBER, "Invalid number: %s\n", value);
             }
-            else if ((strcmp(argvCmd[i], "--a260unit") == 0) && (i + 1 < argcCmd))
+            else if (option[2] == 'c')
             {
-                i++;
-                parameters.a260Unit = atof(argvCmd[i]);
+                g.count = (size_t)number;
             }
-            else if ((strcmp(argvCmd[i], "--blanks") == 0) && (i + 1 < argcCmd))
+            else if (option[2] == 'b')
             {
-                i++;
-                parameters.blanks = atoi(argvCmd[i]);
+                g.blanks = (size_t)number;
             }
             else
             {
-                return printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION, "Unknown option: %s\n", argvCmd[i]);
+                g.state = number;
             }
-            i++;
-        }
-        else
-        {
-            options = false;
         }
-    }
-
-    if (i < argcCmd)
-    {
-        char *file = argvCmd[i];
-
-        cJSON *json = colibriJsonLoad(file);
-
-        if (json != NULL)
+        else if (strcmp(option, "--air") == 0 || strcmp(option, "--level") == 0)
         {
-            cJSON *oMeasurments = cJSON_GetObjectItem(json, DICT_MEASUREMENTS);
+            double number = strtod(value, &end);
 
-            if (oMeasurments)
+            if (*end != '\0' || end == value || !(number >= 0.0) || (option[2] == 'a' && number > 1.0))
             {
-                Quadruple_t factors = calculateFactors(oMeasurments, parameters.blanks);
-                cJSON *iterator = NULL;
-                cJSON_ArrayForEach(iterator, oMeasurments)
-                {
-                    cJSON_DeleteItemFromObject(iterator, DICT_CALCULATED);
-                    cJSON_AddItemToObject(iterator, DICT_CALCULATED, calculate(iterator, factors, parameters));
-                }
+                ret = printError(ERROR_COLIBRI_INVALID_NUMBER, "Invalid number: %s\n", value);
             }
-
-            colibriJsonSave(file, json);
-
-            cJSON_Delete(json);
+            else if (option[2] == 'a')
+            {
+                g.air = number;
+            }
+            else
+            {
+                g.level = number;
+            }
+        }
+        else if (strcmp(option, "--noise") == 0 && strcmp(value, "none") == 0)
+        {
+            g.noise = NOISE_NONE;
+        }
+        else if (strcmp(option, "--noise") == 0 && strcmp(value, "uniform") == 0)
+        {
+            g.noise = NOISE_UNIFORM;
+        }
+        else if (strcmp(option, "--noise") == 0 && strcmp(value, "gaussian") == 0)
+        {
+            g.noise = NOISE_GAUSSIAN;
+        }
+        else if (strcmp(option, "--format") == 0 && strcmp(value, "pretty") == 0)
+        {
+            g.format = GENERATE_PRETTY;
+        }
+        else if (strcmp(option, "--format") == 0 && strcmp(value, "compact") == 0)
+        {
+            g.format = GENERATE_COMPACT;
+        }
+        else if (strcmp(option, "--format") == 0 && strcmp(value, "archive") == 0)
+        {
+            g.format = GENERATE_ARCHIVE;
         }
         else
         {
-            ret = ERROR_COLIBRI_FILE_NOT_FOUND;
-            printError(ret, "File %s not found.", file);
+            ret = printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION, "Unknown option: %s\n", option);
         }
+        i += 2;
+    }
+
+    if (ret == ERROR_COLIBRI_OK && i + 1 != argcCmd)
+    {
+        ret = printError(ERROR_COLIBRI_INVALID_PARAMETER, "Expected options with a value each followed by FILE.\n");
     }
+    // An option in place of FILE is a mistake, not a file name
+    else if (ret == ERROR_COLIBRI_OK && argvCmd[argcCmd - 1][0] == '-')
+    {
+        ret = printError(ERROR_COLIBRI_INVALID_PARAMETER, "Expected FILE instead of %s.\n", argvCmd[argcCmd - 1]);
+    }
+
+    if (ret == ERROR_COLIBRI_OK)
+    {
+        ret = generateFile(&g, argvCmd[argcCmd - 1]);
+    }
+
     return ret;
 }
 
-static Error_t cmdDataPrint(Colibri_t *self, char *file)
+// Commands which print tables of their own instead of records
+static bool isTableCommand(const char *command)
 {
-    cJSON *json = colibriJsonLoad(file);
+    static const char *tables[] = {"stats", "export", "sweep", "index", "query"};
 
-    if (json != NULL)
+    for (size_t i = 0; i < sizeof(tables) / sizeof(tables[0]); i++)
     {
-        cJSON *oMeasurments = cJSON_GetObjectItem(json, DICT_MEASUREMENTS);
-        if (oMeasurments)
+        if (strcmp(command, tables[i]) == 0)
         {
-            cJSON *iterator = NULL;
-            cJSON_ArrayForEach(iterator, oMeasurments)
-            {
-                cJSON *oCalculated = cJSON_GetObjectItem(iterator, DICT_CALCULATED);
-                cJSON *oComment = cJSON_GetObjectItem(iterator, DICT_COMMENT);
-                if (oCalculated)
-                {
-                    cJSON *oOd = cJSON_GetObjectItem(oCalculated, DICT_OD);
-                    if (oOd)
-                    {
-                        cJSON *o230 = cJSON_GetObjectItem(oOd, DICT_230);
-                        cJSON *o260 = cJSON_GetObjectItem(oOd, DICT_260);
-                        cJSON *o280 = cJSON_GetObjectItem(oOd, DICT_280);
-                        cJSON *o340 = cJSON_GetObjectItem(oOd, DICT_340);
-
-                        fprintf(stdout, "%f %f %f %f ", o230 ? cJSON_GetNumberValue(o230) : 0.0,
-                                o260 ? cJSON_GetNumberValue(o260) : 0.0,
-                                o280 ? cJSON_GetNumberValue(o280) : 0.0,
-                                o340 ? cJSON_GetNumberValue(o340) : 0.0);
-                    }
-
-                    cJSON *oConcentration = cJSON_GetObjectItem(oCalculated, DICT_CONCENTRATION);
-                    if (oConcentration)
-                    {
-                        fprintf(stdout, "%f ", cJSON_GetNumberValue(oConcentration));
-                    }
-
-                    if (oComment)
-                    {
-                        fprintf(stdout, "%s ", cJSON_GetStringValue(oComment));
-                    }
-                    fprintf(stdout, "\n");
-                }
-            }
+            return true;
         }
-        cJSON_Delete(json);
-        return ERROR_COLIBRI_OK;
-    }
-    else
-    {
-        printError(ERROR_COLIBRI_FILE_NOT_FOUND, "File %s not found.", file);
-        return ERROR_COLIBRI_FILE_NOT_FOUND;
     }
+    return false;
 }
 
 Error_t cmdData(Colibri_t *self, int argcCmd, char **argvCmd)
 {
     Error_t ret = ERROR_COLIBRI_OK;
+    ColibriJsonScope_t scope;
+
+    if (argcCmd >= 2 && outputFormat() != OUTPUT_TEXT && isTableCommand(argvCmd[1]))
+    {
+        return printError(ERROR_COLIBRI_INVALID_PARAMETER, "data %s only prints text, --format is not supported.\n", argvCmd[1]);
+    }
+
+    colibriJsonScopeBegin(&scope, self->verbose);
 
     if ((argcCmd >= 3) && (strcmp(argvCmd[1], "calculate") == 0))
     {
@@ -346,11 +2949,49 @@ Error_t cmdData(Colibri_t *self, int argcCmd, char **argvCmd)
     {
         ret = cmdDataPrint(self, argvCmd[2]);
     }
+    else if ((argcCmd == 4) && (strcmp(argvCmd[1], "reformat") == 0))
+    {
+        ret = cmdReformat(self, argcCmd - 2, argvCmd + 2);
+    }
+    else if ((argcCmd == 4 || argcCmd == 5) && (strcmp(argvCmd[1], "convert") == 0))
+    {
+        ret = cmdConvert(self, argcCmd - 2, argvCmd + 2);
+    }
+    else if ((argcCmd >= 3) && (strcmp(argvCmd[1], "stats") == 0))
+    {
+        ret = cmdStats(self, argcCmd - 2, argvCmd + 2);
+    }
+    else if ((argcCmd >= 3) && (strcmp(argvCmd[1], "export") == 0))
+    {
+        ret = cmdExport(self, argcCmd - 2, argvCmd + 2);
+    }
+    else if ((argcCmd >= 3) && (strcmp(argvCmd[1], "sweep") == 0))
+    {
+        ret = cmdSweep(self, argcCmd - 2, argvCmd + 2);
+    }
+    else if ((argcCmd >= 3) && (strcmp(argvCmd[1], "watch") == 0))
+    {
+        ret = cmdWatch(self, argcCmd - 2, argvCmd + 2);
+    }
+    else if ((argcCmd >= 3) && (strcmp(argvCmd[1], "generate") == 0))
+    {
+        ret = cmdGenerate(self, argcCmd - 2, argvCmd + 2);
+    }
+    else if ((argcCmd == 3) && (strcmp(argvCmd[1], "index") == 0))
+    {
+        ret = cmdIndex(self, argvCmd[2]);
+    }
+    else if ((argcCmd >= 3) && (strcmp(argvCmd[1], "query") == 0))
+    {
+        ret = cmdQuery(self, argcCmd - 2, argvCmd + 2);
+    }
     else
     {
         ret = ERROR_COLIBRI_INVALID_PARAMETER;
     }
 
+    colibriJsonScopeEnd(&scope);
+
     if (ret != ERROR_COLIBRI_OK)
     {
         printError(ret, NULL);
@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "cmdfeed.h"
+#include "cmdmeasure.h"
+#include "colibriFeed.h"
+#include "printerror.h"
+#include "output.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FEED_POLL_INTERVAL 10
+
+// Prints the records published to the feed NAME until count records are
+// printed, or forever with count 0.
+Error_t cmdFeed(Colibri_t * self, int argcCmd, char **argvCmd)
+{
+    ColibriFeed_t feed;
+    const char *name = NULL;
+    uint32_t count = 0;
+    uint32_t printed = 0;
+    Error_t ret;
+
+    for (int i = 1; i < argcCmd; i++)
+    {
+        if (strcmp(argvCmd[i], "--count") == 0 && i + 1 < argcCmd)
+        {
+            count = (uint32_t)atoi(argvCmd[++i]);
+        }
+        else if (argvCmd[i][0] != '-' && name == NULL)
+        {
+            name = argvCmd[i];
+        }
+        else
+        {
+            return printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION, "Unknown option: %s\n", argvCmd[i]);
+        }
+    }
+    if (name == NULL)
+    {
+        return printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_ARGUMENT, "Missing feed name\n");
+    }
+
+    ret = colibriFeedOpen(&feed, name);
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        return printError(ret, "Could not open the feed %s\n", name);
+    }
+
+    outputOpen();
+    while (count == 0 || printed < count)
+    {
+        const ColibriFeedRecord_t *record;
+        uint64_t lost = 0;
+
+        while ((record = colibriFeedNext(&feed, &lost)) != NULL && (count == 0 || printed < count))
+        {
+            uint32_t values[MEASURE_CHANNELS];
+            uint32_t type = record->type;
+
+            memcpy(values, record->values, sizeof(values));
+            if (!colibriFeedIsValid(&feed, record))
+            {
+                lost++;
+                continue;
+            }
+            measurePrint(type == COLIBRI_FEED_BASELINE ? OUTPUT_BASELINE : OUTPUT_MEASUREMENT, values);
+            printed++;
+        }
+        if (lost > 0)
+        {
+            fprintf(stderr, "Lost %llu records\n", (unsigned long long)lost);
+        }
+        outputFlush();
+        Sleep(FEED_POLL_INTERVAL);
+    }
+
+    colibriFeedClose(&feed);
+    return ERROR_COLIBRI_OK;
+}
@@ -0,0 +1,8 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#pragma once
+
+#include "colibri.h"
+
+Error_t cmdFeed(Colibri_t * self, int argcCmd, char **argvCmd);
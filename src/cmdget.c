@@ -4,10 +4,11 @@
 #include "cmdget.h"
 #include "printerror.h"
 #include "colibri.h"
+#include "output.h"
 #include <stdlib.h>
 #include <stdio.h>
 
-Error_t cmdGet(Colibri_t *self, const char *sIndex)
+static Error_t getSingle(Colibri_t *self, const char *sIndex)
 {
     char value[COLIBRI_MAX_LINE_LENGTH];
     uint32_t valueSize = COLIBRI_MAX_LINE_LENGTH;
@@ -22,7 +23,9 @@ Error_t cmdGet(Colibri_t *self, const char *sIndex)
 
         if (ret == ERROR_COLIBRI_OK)
         {
-            fprintf(stdout, "%s\n", value);
+            outputBegin(OUTPUT_VALUE);
+            outputString("value", value);
+            outputEnd();
         }
         else
         {
@@ -36,4 +39,107 @@ Error_t cmdGet(Colibri_t *self, const char *sIndex)
     }
 
     return ret;
-}
\ No newline at end of file
+}
+
+// Adds the index INDEX or the indices of the range FIRST-LAST.
+static Error_t getParse(const char *sIndex, uint32_t *indices, size_t *count)
+{
+    char *endptr;
+    unsigned long first = strtoul(sIndex, &endptr, 10);
+    unsigned long last = first;
+
+    if (endptr != sIndex && *endptr == '-')
+    {
+        const char *sLast = endptr + 1;
+
+        last = strtoul(sLast, &endptr, 10);
+        if (endptr == sLast)
+        {
+            endptr = (char *)sIndex;
+        }
+    }
+    if (endptr == sIndex || *endptr != '\0' || sIndex[0] == '-' || last < first)
+    {
+        return printError(ERROR_COLIBRI_INVALID_NUMBER, "'%s' is not a valid index or range.\n", sIndex);
+    }
+    if (last - first >= GET_MAX_INDICES - *count)
+    {
+        return printError(ERROR_COLIBRI_INVALID_PARAMETER, "More than %d indices.\n", GET_MAX_INDICES);
+    }
+
+    for (unsigned long index = first; index <= last; index++)
+    {
+        indices[(*count)++] = (uint32_t)index;
+    }
+    return ERROR_COLIBRI_OK;
+}
+
+// Reads all indices in one pipelined session. The values which could be
+// read are printed, the first error is returned.
+static Error_t getList(Colibri_t *self, int argcCmd, char **argvCmd)
+{
+    uint32_t indices[GET_MAX_INDICES];
+    Error_t errors[GET_MAX_INDICES];
+    char (*values)[COLIBRI_MAX_LINE_LENGTH];
+    size_t count = 0;
+    Error_t ret = ERROR_COLIBRI_OK;
+
+    for (int i = 1; i < argcCmd && ret == ERROR_COLIBRI_OK; i++)
+    {
+        ret = getParse(argvCmd[i], indices, &count);
+    }
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        return ret;
+    }
+
+    values = malloc(count * COLIBRI_MAX_LINE_LENGTH);
+    if (values == NULL)
+    {
+        return printError(ERROR_COLIBRI_OUT_OF_MEMORY, NULL);
+    }
+
+    ret = colibriGetValues(self, indices, count, values[0], COLIBRI_MAX_LINE_LENGTH, errors);
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        printError(ret, NULL);
+    }
+    else
+    {
+        outputOpen();
+        for (size_t i = 0; i < count; i++)
+        {
+            if (errors[i] == ERROR_COLIBRI_OK)
+            {
+                outputBegin(OUTPUT_INDEX_VALUE);
+                outputUint32("index", indices[i]);
+                outputString("value", values[i]);
+                outputEnd();
+            }
+            else
+            {
+                printError(errors[i], "Could not read index %u.\n", indices[i]);
+                ret = ret == ERROR_COLIBRI_OK ? errors[i] : ret;
+            }
+        }
+    }
+
+    free(values);
+    return ret;
+}
+
+Error_t cmdGet(Colibri_t *self, int argcCmd, char **argvCmd)
+{
+    bool isRange = false;
+
+    for (const char *c = argvCmd[1]; *c; c++)
+    {
+        isRange = isRange || (*c == '-' && c != argvCmd[1]);
+    }
+
+    if (argcCmd == 2 && !isRange)
+    {
+        return getSingle(self, argvCmd[1]);
+    }
+    return getList(self, argcCmd, argvCmd);
+}
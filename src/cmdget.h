@@ -5,4 +5,8 @@
 
 #include "colibri.h"
 
-Error_t cmdGet(Colibri_t * self, const char * sIndex);
+#define GET_MAX_INDICES 256
+
+// get INDEX prints the value, get INDEX|FIRST-LAST ... prints the index and
+// the value of every index.
+Error_t cmdGet(Colibri_t * self, int argcCmd, char **argvCmd);
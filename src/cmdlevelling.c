@@ -4,26 +4,40 @@
 #include "cmdlevelling.h"
 #include "printerror.h"
 #include "colibri.h"
+#include "output.h"
 #include <stdlib.h>
 #include <stdio.h>
 
+void levellingPrint(const Levelling_t *levelling)
+{
+    static const char *const names[4][4] = {
+        {"result230", "current230", "amplificationSample230", "amplificationReference230"},
+        {"result260", "current260", "amplificationSample260", "amplificationReference260"},
+        {"result280", "current280", "amplificationSample280", "amplificationReference280"},
+        {"result340", "current340", "amplificationSample340", "amplificationReference340"},
+    };
+
+    outputBegin(OUTPUT_LEVELLING);
+    for (int w = 0; w < 4; w++)
+    {
+        outputUint32(names[w][0], levelling[w].result);
+        outputUint32(names[w][1], levelling[w].current);
+        outputUint32(names[w][2], levelling[w].amplificationSample);
+        outputUint32(names[w][3], levelling[w].amplificationReference);
+    }
+    outputEnd();
+}
+
 Error_t cmdLevelling(Colibri_t * self)
 {
-    Levelling_t levelling230 = {0};
-    Levelling_t levelling260 = {0};
-    Levelling_t levelling280 = {0};
-    Levelling_t levelling340 = {0};
+    Levelling_t levelling[4] = {0};
 
-    Error_t ret = colibriLevelling (self, &levelling230, &levelling260, &levelling280, &levelling340);
+    Error_t ret = colibriLevelling (self, &levelling[0], &levelling[1], &levelling[2], &levelling[3]);
     if (ret == ERROR_COLIBRI_OK)
     {
-          fprintf(stdout, "%i %i %i %i %i %i %i %i %i %i %i %i %i %i %i %i\n", 
-                                                     levelling230.result, levelling230.current, levelling230.amplificationSample, levelling230.amplificationReference, 
-                                                     levelling260.result, levelling260.current, levelling260.amplificationSample, levelling260.amplificationReference,
-                                                     levelling280.result, levelling280.current, levelling280.amplificationSample, levelling280.amplificationReference,
-                                                     levelling340.result, levelling340.current, levelling340.amplificationSample, levelling340.amplificationReference);
+        levellingPrint(levelling);
 
-        if(levelling230.result == 0 && levelling260.result == 0 && levelling280.result == 0 && levelling340.result == 0)
+        if(levelling[0].result == 0 && levelling[1].result == 0 && levelling[2].result == 0 && levelling[3].result == 0)
         {
         }
         else
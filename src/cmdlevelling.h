@@ -6,3 +6,5 @@
 #include "colibri.h"
 
 Error_t cmdLevelling(Colibri_t * self);
+// Prints the levelling of the four LEDs 230, 260, 280 and 340.
+void levellingPrint(const Levelling_t *levelling);
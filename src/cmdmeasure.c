@@ -4,10 +4,243 @@
 #include "cmdmeasure.h"
 #include "printerror.h"
 #include "colibri.h"
+#include "colibriCalc.h"
+#include <ctype.h>
+#include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
-Error_t cmdMeasure(Colibri_t * self)
+// The median absolute deviation times this estimates the standard deviation
+// of normally distributed values.
+#define MEASURE_MAD_SCALE 1.4826
+// The counts are integers, so more than half of the measurements may be
+// equal and the deviation 0. The spread is at least one count then, else
+// nothing would be rejected.
+#define MEASURE_MIN_SPREAD 1.0
+
+Error_t measureAverageParse(int argcCmd, char **argvCmd, int *i, uint32_t *count, double *limit)
+{
+    const char *option = argvCmd[*i];
+    const char *value;
+    char *end;
+
+    if (*i + 1 >= argcCmd || (strcmp(option, "--average") != 0 && strcmp(option, "--outlier-limit") != 0))
+    {
+        return ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION;
+    }
+
+    value = argvCmd[++(*i)];
+    if (strcmp(option, "--average") == 0)
+    {
+        unsigned long number = strtoul(value, &end, 10);
+
+        if (!isdigit((unsigned char)value[0]) || *end != '\0' || number < 1 || number > MEASURE_AVERAGE_MAX)
+        {
+            return printError(ERROR_COLIBRI_INVALID_NUMBER, "--average needs a count from 1 to %u: %s\n", MEASURE_AVERAGE_MAX, value);
+        }
+        *count = (uint32_t)number;
+    }
+    else
+    {
+        double number = strtod(value, &end);
+
+        if (end == value || *end != '\0' || !(number > 0.0) || isinf(number))
+        {
+            return printError(ERROR_COLIBRI_INVALID_NUMBER, "--outlier-limit needs a positive number: %s\n", value);
+        }
+        *limit = number;
+    }
+    return ERROR_COLIBRI_OK;
+}
+
+static int compareDouble(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+// Sorts values.
+static double median(double *values, size_t count)
+{
+    qsort(values, count, sizeof(double), compareDouble);
+    return count % 2 ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2.0;
+}
+
+// The medians need every value of a channel, so the rejection works on all
+// count measurements. Only the accepted ones are then fed to the running
+// statistics.
+Error_t measureAverageValues(const uint32_t *values, uint32_t count, double limit, MeasureAverage_t *average)
+{
+    double *column = malloc((count ? count : 1) * sizeof(double));
+    bool *isRejected = calloc(count ? count : 1, sizeof(bool));
+    Statistics_t statistics[MEASURE_CHANNELS];
+
+    if (column == NULL || isRejected == NULL)
+    {
+        free(column);
+        free(isRejected);
+        return ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+
+    // With less than three measurements there is no majority to compare to
+    for (int c = 0; c < MEASURE_CHANNELS && count >= 3; c++)
+    {
+        double center;
+        double spread;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            column[i] = values[i * MEASURE_CHANNELS + c];
+        }
+        center = median(column, count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            column[i] = fabs(column[i] - center);
+        }
+        spread = fmax(MEASURE_MAD_SCALE * median(column, count), MEASURE_MIN_SPREAD);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (fabs(values[i * MEASURE_CHANNELS + c] - center) > limit * spread)
+            {
+                isRejected[i] = true;
+            }
+        }
+    }
+
+    average->count = count;
+    average->rejected = 0;
+    for (int c = 0; c < MEASURE_CHANNELS; c++)
+    {
+        statisticsInit(&statistics[c]);
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (isRejected[i])
+        {
+            average->rejected++;
+            continue;
+        }
+        for (int c = 0; c < MEASURE_CHANNELS; c++)
+        {
+            statisticsAdd(&statistics[c], values[i * MEASURE_CHANNELS + c]);
+        }
+    }
+    for (int c = 0; c < MEASURE_CHANNELS; c++)
+    {
+        average->mean[c] = statistics[c].mean;
+        average->stdDev[c] = statisticsStdDev(&statistics[c]);
+    }
+
+    free(column);
+    free(isRejected);
+    // Zero means and undefined deviations are no measurement
+    return average->rejected < count ? ERROR_COLIBRI_OK : ERROR_COLIBRI_ALL_REJECTED;
+}
+
+Error_t measureAverage(Colibri_t * self, uint32_t count, double limit, MeasureAverage_t *average)
+{
+    uint32_t *values = malloc((count ? count : 1) * MEASURE_CHANNELS * sizeof(uint32_t));
+    Error_t ret = ERROR_COLIBRI_OK;
+
+    if (values == NULL)
+    {
+        return ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+
+    for (uint32_t i = 0; i < count && ret == ERROR_COLIBRI_OK; i++)
+    {
+        uint32_t *v = values + i * MEASURE_CHANNELS;
+
+        ret = colibriMeasure(self, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]);
+    }
+
+    if (ret == ERROR_COLIBRI_OK)
+    {
+        ret = measureAverageValues(values, count, limit, average);
+    }
+
+    free(values);
+    return ret;
+}
+
+void measureAverageRound(const MeasureAverage_t *average, uint32_t *values)
+{
+    for (int c = 0; c < MEASURE_CHANNELS; c++)
+    {
+        values[c] = (uint32_t)llround(average->mean[c]);
+    }
+}
+
+void measurePrint(OutputRecord_t record, const uint32_t *values)
+{
+    outputBegin(record);
+    for (int c = 0; c < MEASURE_CHANNELS; c++)
+    {
+        outputUint32(outputChannelNames[c], values[c]);
+    }
+    outputEnd();
+}
+
+// The text format keeps the rounded means and the standard deviations on
+// two lines.
+static void measureAveragePrint(const MeasureAverage_t *average)
+{
+    if (outputFormat() == OUTPUT_TEXT)
+    {
+        uint32_t values[MEASURE_CHANNELS];
+
+        measureAverageRound(average, values);
+        measurePrint(OUTPUT_MEASUREMENT, values);
+        for (int c = 0; c < MEASURE_CHANNELS; c++)
+        {
+            char text[32];
+
+            snprintf(text, sizeof(text), "%.1f%s", average->stdDev[c], c < MEASURE_CHANNELS - 1 ? " " : "\n");
+            bufferAppendString(outputBuffer(), text);
+        }
+        return;
+    }
+
+    outputBegin(OUTPUT_AVERAGE);
+    outputUint32("count", average->count);
+    outputUint32("rejected", average->rejected);
+    for (int c = 0; c < MEASURE_CHANNELS; c++)
+    {
+        char name[32];
+
+        snprintf(name, sizeof(name), "%sStdDev", outputChannelNames[c]);
+        outputDouble(outputChannelNames[c], average->mean[c]);
+        outputDouble(name, average->stdDev[c]);
+    }
+    outputEnd();
+}
+
+// Measures count times over one open port and prints the means and the
+// standard deviations.
+static Error_t measureAveraged(Colibri_t * self, uint32_t count, double limit)
+{
+    MeasureAverage_t average;
+    Error_t ret = colibriOpen(self);
+
+    if (ret == ERROR_COLIBRI_OK)
+    {
+        ret = measureAverage(self, count, limit, &average);
+        colibriClose(self);
+    }
+
+    if (ret == ERROR_COLIBRI_OK)
+    {
+        measureAveragePrint(&average);
+        fprintf(stderr, "Averaged %u of %u measurements, %u rejected as outliers\n", average.count - average.rejected, average.count, average.rejected);
+    }
+    return ret;
+}
+
+Error_t cmdMeasure(Colibri_t * self, int argcCmd, char **argvCmd)
 {
     uint32_t sample230 = 0;
     uint32_t reference230 = 0;
@@ -17,15 +250,59 @@ Error_t cmdMeasure(Colibri_t * self)
     uint32_t reference280 = 0;
     uint32_t sample340 = 0;
     uint32_t reference340 = 0;
+    uint32_t count = 0;
+    double limit = MEASURE_OUTLIER_LIMIT;
+    int last = -1;
+    Error_t ret;
+
+    for (int i = 1; i < argcCmd; i++)
+    {
+        if (argvCmd[i][0] >= '0' && argvCmd[i][0] <= '9' && last < 0)
+        {
+            last = atoi(argvCmd[i]);
+        }
+        else
+        {
+            ret = measureAverageParse(argcCmd, argvCmd, &i, &count, &limit);
+            if (ret == ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION)
+            {
+                return printError(ret, "Unknown option: %s\n", argvCmd[i]);
+            }
+            if (ret != ERROR_COLIBRI_OK)
+            {
+                return ret;
+            }
+        }
+    }
+
+    if (count > 0)
+    {
+        ret = measureAveraged(self, count, limit);
+        if (ret != ERROR_COLIBRI_OK)
+        {
+            printError(ret, NULL);
+        }
+        return ret;
+    }
+
+    if (last >= 0)
+    {
+        ret = colibriLastMeasurements(self, (uint32_t)last, &sample230, &reference230, &sample260, &reference260, &sample280, &reference280, &sample340, &reference340);
+    }
+    else
+    {
+        ret = colibriMeasure(self, &sample230, &reference230, &sample260, &reference260, &sample280, &reference280, &sample340, &reference340);
+    }
 
-    Error_t ret = colibriMeasure(self, &sample230, &reference230, &sample260, &reference260, &sample280, &reference280, &sample340, &reference340);
     if (ret == ERROR_COLIBRI_OK)
     {
-        fprintf(stdout, "%i %i %i %i %i %i %i %i\n", sample230, reference230, sample260, reference260, sample280, reference280, sample340, reference340);
+        uint32_t values[MEASURE_CHANNELS] = {sample230, reference230, sample260, reference260, sample280, reference280, sample340, reference340};
+
+        measurePrint(OUTPUT_MEASUREMENT, values);
     }
     else
     {
         printError(ret, NULL);
     }
     return ret;
-}
\ No newline at end of file
+}
@@ -4,5 +4,36 @@
 #pragma once
 
 #include "colibri.h"
+#include "output.h"
 
-Error_t cmdMeasure(Colibri_t * self);
+#define MEASURE_CHANNELS 8
+#define MEASURE_OUTLIER_LIMIT 3.5
+#define MEASURE_AVERAGE_MAX 10000
+
+// Mean and standard deviation of repeated measurements per channel, in the
+// order sample230 reference230 ... sample340 reference340. A measurement is
+// rejected if one of its channels is more than limit times the scaled median
+// absolute deviation, but at least limit counts, away from the median of the
+// channel.
+typedef struct
+{
+    uint32_t count;
+    uint32_t rejected;
+    double mean[MEASURE_CHANNELS];
+    double stdDev[MEASURE_CHANNELS];
+} MeasureAverage_t;
+
+Error_t cmdMeasure(Colibri_t * self, int argcCmd, char **argvCmd);
+// Parses --average N and --outlier-limit K at argvCmd[*i]. *i is left at the
+// value of the option. Returns ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION for
+// other arguments and prints an error for an invalid value.
+Error_t measureAverageParse(int argcCmd, char **argvCmd, int *i, uint32_t *count, double *limit);
+// values holds count measurements of MEASURE_CHANNELS values each. Fails with
+// ERROR_COLIBRI_ALL_REJECTED if no measurement is left.
+Error_t measureAverageValues(const uint32_t *values, uint32_t count, double limit, MeasureAverage_t *average);
+// Takes count measurements back to back and averages them.
+Error_t measureAverage(Colibri_t * self, uint32_t count, double limit, MeasureAverage_t *average);
+// The means rounded to the values of a single measurement.
+void measureAverageRound(const MeasureAverage_t *average, uint32_t *values);
+// Prints the MEASURE_CHANNELS values of a measurement or a baseline.
+void measurePrint(OutputRecord_t record, const uint32_t *values);
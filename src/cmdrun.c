@@ -0,0 +1,255 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "cmdrun.h"
+#include "cmdsave.h"
+#include "cmdmeasure.h"
+#include "cmdlevelling.h"
+#include "levellingpolicy.h"
+#include "printerror.h"
+#include "colibri.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define RUN_MAX_STEPS 6
+
+// Duration of every step, the time waiting for the user is not counted.
+typedef struct
+{
+    const char *names[RUN_MAX_STEPS];
+    double ms[RUN_MAX_STEPS];
+    size_t count;
+    struct timespec start;
+} RunTiming_t;
+
+static void timingStart(RunTiming_t *timing)
+{
+    timespec_get(&timing->start, TIME_UTC);
+}
+
+static void timingStop(RunTiming_t *timing, const char *name)
+{
+    struct timespec end;
+
+    timespec_get(&end, TIME_UTC);
+    timing->names[timing->count] = name;
+    timing->ms[timing->count] = (end.tv_sec - timing->start.tv_sec) * 1000.0 + (end.tv_nsec - timing->start.tv_nsec) / 1000000.0;
+    timing->count++;
+    timing->start = end;
+}
+
+static void timingPrint(const RunTiming_t *timing)
+{
+    double total = 0.0;
+
+    for (size_t i = 0; i < timing->count; i++)
+    {
+        fprintf(stderr, "%-10s: %10.3f ms\n", timing->names[i], timing->ms[i]);
+        total += timing->ms[i];
+    }
+    fprintf(stderr, "%-10s: %10.3f ms\n", "total", total);
+}
+
+// Waits for a line on stdin, e.g. while the cuvette is moved.
+static void waitForUser(const char *message)
+{
+    char line[100];
+
+    fprintf(stderr, "%s and press enter.\n", message);
+    if (fgets(line, sizeof(line), stdin) == NULL)
+    {
+        clearerr(stdin);
+    }
+}
+
+// Every step is written at once, the user may be waiting for it.
+static void printValues(OutputRecord_t record, const uint32_t *values)
+{
+    measurePrint(record, values);
+    outputFlush();
+}
+
+static void printLevelling(const Levelling_t *levelling)
+{
+    levellingPrint(levelling);
+    outputFlush();
+}
+
+static Error_t runLevelling(Colibri_t *self, Levelling_t *levelling)
+{
+    Error_t ret = colibriLevelling(self, &levelling[0], &levelling[1], &levelling[2], &levelling[3]);
+
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        return ret;
+    }
+
+    printLevelling(levelling);
+    for (int i = 0; i < 4; i++)
+    {
+        if (levelling[i].result != 0)
+        {
+            ret = ERROR_COLIBRI_LEVELLING_FAILED;
+        }
+    }
+    return ret;
+}
+
+// Levelling only if the policy asks for it, followed by the baseline.
+static Error_t runPolicyBaseline(Colibri_t *self, LevellingPolicy_t *policy, SaveMeasurement_t *measurement)
+{
+    bool isLevelled;
+    Error_t ret = levellingPolicyBaseline(self, policy, measurement->levelling, measurement->baseline, &isLevelled);
+
+    if (ret == ERROR_COLIBRI_OK)
+    {
+        printLevelling(measurement->levelling);
+        printValues(OUTPUT_BASELINE, measurement->baseline);
+    }
+    return ret;
+}
+
+// Measurements other than the baseline are averaged over average
+// measurements with --average.
+static Error_t runMeasure(Colibri_t *self, bool isBaseline, uint32_t average, double limit, uint32_t *values)
+{
+    Error_t ret;
+
+    if (isBaseline)
+    {
+        ret = colibriBaseline(self, &values[0], &values[1], &values[2], &values[3], &values[4], &values[5], &values[6], &values[7]);
+    }
+    else if (average > 1)
+    {
+        MeasureAverage_t result;
+
+        ret = measureAverage(self, average, limit, &result);
+        if (ret == ERROR_COLIBRI_OK)
+        {
+            measureAverageRound(&result, values);
+            fprintf(stderr, "Averaged %u of %u measurements, %u rejected as outliers\n", result.count - result.rejected, result.count, result.rejected);
+        }
+    }
+    else
+    {
+        ret = colibriMeasure(self, &values[0], &values[1], &values[2], &values[3], &values[4], &values[5], &values[6], &values[7]);
+    }
+
+    if (ret == ERROR_COLIBRI_OK)
+    {
+        printValues(isBaseline ? OUTPUT_BASELINE : OUTPUT_MEASUREMENT, values);
+    }
+    return ret;
+}
+
+// Runs levelling, baseline, the optional air measurement, the measurement
+// and the save over one open port. The measured values are saved as they
+// are, without reading them back from the device.
+Error_t cmdRun(Colibri_t * self, int argcCmd, char **argvCmd)
+{
+    SaveMeasurement_t measurement;
+    LevellingPolicy_t policy;
+    RunTiming_t timing;
+    const char *comment = NULL;
+    const char *file = NULL;
+    bool wait = false;
+    uint32_t average = 1;
+    double limit = MEASURE_OUTLIER_LIMIT;
+    Error_t ret = ERROR_COLIBRI_OK;
+
+    memset(&measurement, 0, sizeof(measurement));
+    memset(&timing, 0, sizeof(timing));
+    levellingPolicyInit(&policy);
+
+    for (int i = 1; i < argcCmd; i++)
+    {
+        if (strcmp(argvCmd[i], "--air") == 0)
+        {
+            measurement.hasAir = true;
+        }
+        else if (strcmp(argvCmd[i], "--wait") == 0)
+        {
+            wait = true;
+        }
+        else if (strcmp(argvCmd[i], "--comment") == 0 && i + 1 < argcCmd)
+        {
+            comment = argvCmd[++i];
+        }
+        else if (strcmp(argvCmd[i], "--out") == 0 && i + 1 < argcCmd)
+        {
+            file = argvCmd[++i];
+        }
+        else if (!levellingPolicyParse(&policy, argcCmd, argvCmd, &i))
+        {
+            ret = measureAverageParse(argcCmd, argvCmd, &i, &average, &limit);
+            if (ret == ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION)
+            {
+                return printError(ret, "Unknown option: %s\n", argvCmd[i]);
+            }
+            if (ret != ERROR_COLIBRI_OK)
+            {
+                return ret;
+            }
+        }
+    }
+
+    timingStart(&timing);
+    ret = colibriOpen(self);
+    timingStop(&timing, "open");
+
+    if (ret == ERROR_COLIBRI_OK && policy.isEnabled)
+    {
+        ret = runPolicyBaseline(self, &policy, &measurement);
+        timingStop(&timing, "baseline");
+    }
+    else if (ret == ERROR_COLIBRI_OK)
+    {
+        ret = runLevelling(self, measurement.levelling);
+        timingStop(&timing, "levelling");
+
+        if (ret == ERROR_COLIBRI_OK)
+        {
+            ret = runMeasure(self, true, 1, limit, measurement.baseline);
+            timingStop(&timing, "baseline");
+        }
+    }
+
+    if (ret == ERROR_COLIBRI_OK && measurement.hasAir)
+    {
+        if (wait)
+        {
+            waitForUser("Move the empty cuvette into the cuvette holder");
+            timingStart(&timing);
+        }
+        ret = runMeasure(self, false, average, limit, measurement.air);
+        timingStop(&timing, "air");
+    }
+
+    if (ret == ERROR_COLIBRI_OK)
+    {
+        if (wait)
+        {
+            waitForUser("Dispense the sample into the cuvette");
+            timingStart(&timing);
+        }
+        ret = runMeasure(self, false, average, limit, measurement.sample);
+        timingStop(&timing, "measure");
+    }
+
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        printError(ret, NULL);
+    }
+    else if (file)
+    {
+        ret = saveMeasurement(self, file, comment, &measurement);
+        timingStop(&timing, "save");
+    }
+
+    colibriClose(self);
+    timingPrint(&timing);
+
+    return ret;
+}
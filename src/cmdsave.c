@@ -2,6 +2,7 @@
 // SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
 
 #include "cmdsave.h"
+#include "cmdmeasure.h"
 #include "colibriJson.h"
 #include "colibri.h"
 #include "printerror.h"
@@ -13,52 +14,42 @@
 #include <time.h>
 
 
-static double amplification2number(Colibri_t* self, bool isSample, uint32_t value)
+static double amplification2number(Colibri_t* self, int index)
 {
-    int  index;
     char buffer[100];
 
-    if (isSample)
+    if (colibriGet(self, index, buffer, sizeof(buffer)) != ERROR_COLIBRI_OK)
     {
-        switch (value)
-        {
-            case 0:
-                index = INDEX_AMPLIFIER_SAMPLEFACTOR___1_1;
-                break;
-            case 1:
-                index = INDEX_AMPLIFIER_SAMPLEFACTOR__11_0;
-                break;
-            case 2:
-                index = INDEX_AMPLIFIER_SAMPLEFACTOR_111_0;
-                break;
-            default:
-                return 0.0;
-        }
+        return 0.0;
     }
-    else
+
+    return atof(buffer);
+}
+
+void saveReadDevice(Colibri_t* self, SaveDevice_t* device)
+{
+    static const int sampleIndices[3]    = {INDEX_AMPLIFIER_SAMPLEFACTOR___1_1, INDEX_AMPLIFIER_SAMPLEFACTOR__11_0, INDEX_AMPLIFIER_SAMPLEFACTOR_111_0};
+    static const int referenceIndices[3] = {INDEX_AMPLIFIER_REFERENCEFACTOR___1_1, INDEX_AMPLIFIER_REFERENCEFACTOR__11_0, INDEX_AMPLIFIER_REFERENCEFACTOR_111_0};
+
+    if (colibriGet(self, INDEX_SERIALNUMBER, device->serialNumber, sizeof(device->serialNumber)) != ERROR_COLIBRI_OK)
     {
-        switch (value)
-        {
-            case 0:
-                index = INDEX_AMPLIFIER_REFERENCEFACTOR___1_1;
-                break;
-            case 1:
-                index = INDEX_AMPLIFIER_REFERENCEFACTOR__11_0;
-                break;
-            case 2:
-                index = INDEX_AMPLIFIER_REFERENCEFACTOR_111_0;
-                break;
-            default:
-                return 0.0;
-        }
+        device->serialNumber[0] = '\0';
+    }
+    if (colibriGet(self, INDEX_VERSION, device->firmwareVersion, sizeof(device->firmwareVersion)) != ERROR_COLIBRI_OK)
+    {
+        device->firmwareVersion[0] = '\0';
     }
 
-    if (colibriGet(self, index, buffer, sizeof(buffer)) != ERROR_COLIBRI_OK)
+    for (int i = 0; i < 3; i++)
     {
-        return 0.0;
+        device->sampleFactors[i]    = amplification2number(self, sampleIndices[i]);
+        device->referenceFactors[i] = amplification2number(self, referenceIndices[i]);
     }
+}
 
-    return atof(buffer);
+static double amplificationFactor(const double* factors, uint32_t value)
+{
+    return value < 3 ? factors[value] : 0.0;
 }
 
 static char* result2text(uint32_t value)
@@ -90,49 +81,35 @@ static cJSON* channelObject(uint32_t sample, uint32_t reference)
     return obj;
 }
 
-static cJSON* measuremtObject(uint32_t sample230, uint32_t reference230, uint32_t sample260, uint32_t reference260, uint32_t sample280, uint32_t reference280, uint32_t sample340, uint32_t reference340)
+static cJSON* measuremtObject(const uint32_t* values)
 {
     cJSON* obj = cJSON_CreateObject();
 
-    cJSON_AddItemToObject(obj, DICT_230, channelObject(sample230, reference230));
-    cJSON_AddItemToObject(obj, DICT_260, channelObject(sample260, reference260));
-    cJSON_AddItemToObject(obj, DICT_280, channelObject(sample280, reference280));
-    cJSON_AddItemToObject(obj, DICT_340, channelObject(sample340, reference340));
+    cJSON_AddItemToObject(obj, DICT_230, channelObject(values[0], values[1]));
+    cJSON_AddItemToObject(obj, DICT_260, channelObject(values[2], values[3]));
+    cJSON_AddItemToObject(obj, DICT_280, channelObject(values[4], values[5]));
+    cJSON_AddItemToObject(obj, DICT_340, channelObject(values[6], values[7]));
 
     return obj;
 }
 
-static Error_t addSingleMeasurement(Colibri_t* self, char* key, int index, cJSON* obj)
+static Error_t readSingleMeasurement(Colibri_t* self, int index, uint32_t* values)
 {
-    Error_t  ret = ERROR_COLIBRI_OK;
-    uint32_t sample230;
-    uint32_t reference230;
-    uint32_t sample260;
-    uint32_t reference260;
-    uint32_t sample280;
-    uint32_t reference280;
-    uint32_t sample340;
-    uint32_t reference340;
-
-    ret = colibriLastMeasurements(self, index, &sample230, &reference230, &sample260, &reference260, &sample280, &reference280, &sample340, &reference340);
-    if (ret == ERROR_COLIBRI_OK)
-    {
-        cJSON_AddItemToObject(obj, key, measuremtObject(sample230, reference230, sample260, reference260, sample280, reference280, sample340, reference340));
-        return ret;
-    }
-    else
+    Error_t ret = colibriLastMeasurements(self, index, &values[0], &values[1], &values[2], &values[3], &values[4], &values[5], &values[6], &values[7]);
+
+    if (ret != ERROR_COLIBRI_OK)
     {
         printError(ret, "Could not read measurement");
-        return ret;
     }
+    return ret;
 }
 
-static cJSON* levellingChannel(Colibri_t* self, Levelling_t levelling)
+static cJSON* levellingChannel(const SaveDevice_t* device, Levelling_t levelling)
 {
     cJSON* obj = cJSON_CreateObject();
 
-    cJSON_AddItemToObject(obj, DICT_AMPLIFICATION_SAMPLE, cJSON_CreateNumber(amplification2number(self, true, levelling.amplificationSample)));
-    cJSON_AddItemToObject(obj, DICT_AMPLIFICATION_REFERENCE, cJSON_CreateNumber(amplification2number(self, false, levelling.amplificationReference)));
+    cJSON_AddItemToObject(obj, DICT_AMPLIFICATION_SAMPLE, cJSON_CreateNumber(amplificationFactor(device->sampleFactors, levelling.amplificationSample)));
+    cJSON_AddItemToObject(obj, DICT_AMPLIFICATION_REFERENCE, cJSON_CreateNumber(amplificationFactor(device->referenceFactors, levelling.amplificationReference)));
     cJSON_AddItemToObject(obj, DICT_CURRENT, cJSON_CreateNumber(levelling.current));
     cJSON_AddItemToObject(obj, DICT_RESULT, cJSON_CreateNumber(levelling.result));
     cJSON_AddItemToObject(obj, DICT_RESULT_TEXT, cJSON_CreateString(result2text(levelling.result)));
@@ -140,116 +117,144 @@ static cJSON* levellingChannel(Colibri_t* self, Levelling_t levelling)
     return obj;
 }
 
-static Error_t addLevelling(Colibri_t* self, cJSON* obj)
+static void addLevelling(const SaveDevice_t* device, const SaveMeasurement_t* measurement, cJSON* obj)
 {
-    Error_t     ret = ERROR_COLIBRI_OK;
-    Levelling_t levelling230;
-    Levelling_t levelling260;
-    Levelling_t levelling280;
-    Levelling_t levelling340;
-
-    ret = colibriLastLevelling(self, &levelling230, &levelling260, &levelling280, &levelling340);
-    if (ret != ERROR_COLIBRI_OK)
-    {
-        printError(ret, "Could not read levelling info");
-        return ret;
-    }
-
     cJSON* objLevelling = cJSON_CreateObject();
 
-    cJSON_AddItemToObject(objLevelling, DICT_230, levellingChannel(self, levelling230));
-    cJSON_AddItemToObject(objLevelling, DICT_260, levellingChannel(self, levelling260));
-    cJSON_AddItemToObject(objLevelling, DICT_280, levellingChannel(self, levelling280));
-    cJSON_AddItemToObject(objLevelling, DICT_340, levellingChannel(self, levelling340));
+    cJSON_AddItemToObject(objLevelling, DICT_230, levellingChannel(device, measurement->levelling[0]));
+    cJSON_AddItemToObject(objLevelling, DICT_260, levellingChannel(device, measurement->levelling[1]));
+    cJSON_AddItemToObject(objLevelling, DICT_280, levellingChannel(device, measurement->levelling[2]));
+    cJSON_AddItemToObject(objLevelling, DICT_340, levellingChannel(device, measurement->levelling[3]));
 
     cJSON_AddItemToObject(obj, DICT_LEVELLING, objLevelling);
-
-    return ERROR_COLIBRI_OK;
 }
 
-static Error_t addMeasurement(Colibri_t* self, int argcCmd, char** argvCmd, cJSON* json)
+// Reads the last levelling and the last measurements from the device. The
+// last average measurements are the sample, averaged if there are more than
+// one, in front of them are the air measurement, if any, and the baseline.
+static Error_t readMeasurement(Colibri_t* self, uint32_t average, double limit, SaveMeasurement_t* measurement)
 {
     Error_t ret = ERROR_COLIBRI_OK;
     char    value[20];
+    int     lastMeasurementsCount;
 
-    cJSON* oMeasurements = cJSON_GetObjectItem(json, DICT_MEASUREMENTS);
-
-    cJSON* obj = cJSON_CreateObject();
-
-    if (argcCmd == 3)
+    ret = colibriGet(self, INDEX_LAST_MEASUREMENT_COUNT, value, sizeof(value));
+    if (ret != ERROR_COLIBRI_OK)
     {
-        cJSON_AddItemToObject(obj, DICT_COMMENT, cJSON_CreateString(argvCmd[2]));
+        printError(ret, "Could not read measurement count");
+        return ret;
     }
 
-    ret = colibriGet(self, INDEX_LAST_MEASUREMENT_COUNT, value, sizeof(value));
+    ret = colibriLastLevelling(self, &measurement->levelling[0], &measurement->levelling[1], &measurement->levelling[2], &measurement->levelling[3]);
     if (ret != ERROR_COLIBRI_OK)
     {
-        printError(ret, "Could not read measurement count");
+        printError(ret, "Could not read levelling info");
         return ret;
     }
 
-    ret = addLevelling(self, obj);
+    lastMeasurementsCount = atoi(value);
+    if (lastMeasurementsCount == (int)average + 1)
+    {
+        measurement->hasAir = false;
+    }
+    else if (lastMeasurementsCount == (int)average + 2)
+    {
+        measurement->hasAir = true;
+    }
+    else
+    {
+        fprintf(stderr, "Colibri error : Expected %u or %u measurements\n", average + 1, average + 2);
+        return ERROR_COLIBRI_NUMBER_OF_MEASUREMENTS;
+    }
+
+    ret = readSingleMeasurement(self, lastMeasurementsCount - 1, measurement->baseline);
     if (ret != ERROR_COLIBRI_OK)
         return ret;
 
-    int lastMeasurementsCount = atoi(value);
-    if (lastMeasurementsCount == 2)
+    if (measurement->hasAir)
     {
-        ret = addSingleMeasurement(self, DICT_BASELINE, 1, obj);
+        ret = readSingleMeasurement(self, average, measurement->air);
         if (ret != ERROR_COLIBRI_OK)
             return ret;
+    }
 
-        ret = addSingleMeasurement(self, DICT_SAMPLE, 0, obj);
-        if (ret != ERROR_COLIBRI_OK)
-            return ret;
+    if (average == 1)
+    {
+        return readSingleMeasurement(self, 0, measurement->sample);
     }
-    else if (lastMeasurementsCount == 3)
+    else
     {
-        ret = addSingleMeasurement(self, DICT_BASELINE, 2, obj);
-        if (ret != ERROR_COLIBRI_OK)
-            return ret;
+        uint32_t         values[10 * MEASURE_CHANNELS];
+        MeasureAverage_t result;
 
-        ret = addSingleMeasurement(self, DICT_AIR, 1, obj);
-        if (ret != ERROR_COLIBRI_OK)
-            return ret;
+        for (uint32_t i = 0; i < average; i++)
+        {
+            ret = readSingleMeasurement(self, i, values + i * MEASURE_CHANNELS);
+            if (ret != ERROR_COLIBRI_OK)
+                return ret;
+        }
 
-        ret = addSingleMeasurement(self, DICT_SAMPLE, 0, obj);
+        ret = measureAverageValues(values, average, limit, &result);
         if (ret != ERROR_COLIBRI_OK)
+        {
+            printError(ret, NULL);
             return ret;
+        }
+        measureAverageRound(&result, measurement->sample);
+        fprintf(stderr, "Averaged %u of %u measurements, %u rejected as outliers\n", result.count - result.rejected, result.count, result.rejected);
     }
-    else
+
+    return ERROR_COLIBRI_OK;
+}
+
+static void addMeasurement(const SaveDevice_t* device, const char* comment, const SaveMeasurement_t* measurement, cJSON* json)
+{
+    char   timestamp[32];
+    time_t now = time(NULL);
+
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    cJSON* oMeasurements = cJSON_GetObjectItem(json, DICT_MEASUREMENTS);
+
+    cJSON* obj = cJSON_CreateObject();
+
+    if (comment)
     {
-        fprintf(stderr, "Colibri error : Expected 2 or 3 measurements");
-        return ERROR_COLIBRI_NUMBER_OF_MEASUREMENTS;
+        cJSON_AddItemToObject(obj, DICT_COMMENT, cJSON_CreateString(comment));
     }
 
-    cJSON_AddItemToArray(oMeasurements, obj);
+    cJSON_AddItemToObject(obj, DICT_TIMESTAMP, cJSON_CreateString(timestamp));
 
-    return ERROR_COLIBRI_OK;
+    addLevelling(device, measurement, obj);
+
+    cJSON_AddItemToObject(obj, DICT_BASELINE, measuremtObject(measurement->baseline));
+    if (measurement->hasAir)
+    {
+        cJSON_AddItemToObject(obj, DICT_AIR, measuremtObject(measurement->air));
+    }
+    cJSON_AddItemToObject(obj, DICT_SAMPLE, measuremtObject(measurement->sample));
+
+    cJSON_AddItemToArray(oMeasurements, obj);
 }
 
-static cJSON* loadJson(Colibri_t* self, int argcCmd, char** argvCmd)
+static cJSON* loadJson(const SaveDevice_t* device, const char* file, ColibriJsonFormat_t* format)
 {
-    cJSON* json = colibriJsonLoad(argvCmd[1]);
+    cJSON* json = colibriJsonLoad((char*)file, format);
 
     // create new JSON file
     if (json == NULL)
     {
-        Error_t ret = ERROR_COLIBRI_OK;
-        char    value[100];
-
-        json = cJSON_CreateObject();
+        json    = cJSON_CreateObject();
+        *format = COLIBRI_JSON_PRETTY;
 
-        ret = colibriGet(self, INDEX_SERIALNUMBER, value, sizeof(value));
-        if (ret == ERROR_COLIBRI_OK)
+        if (device->serialNumber[0] != '\0')
         {
-            cJSON_AddItemToObject(json, DICT_SERIALNUMBER, cJSON_CreateString(value));
+            cJSON_AddItemToObject(json, DICT_SERIALNUMBER, cJSON_CreateString(device->serialNumber));
         }
 
-        ret = colibriGet(self, INDEX_VERSION, value, sizeof(value));
-        if (ret == ERROR_COLIBRI_OK)
+        if (device->firmwareVersion[0] != '\0')
         {
-            cJSON_AddItemToObject(json, DICT_FIRMWAREVERSION, cJSON_CreateString(value));
+            cJSON_AddItemToObject(json, DICT_FIRMWAREVERSION, cJSON_CreateString(device->firmwareVersion));
         }
 
         cJSON_AddItemToObject(json, DICT_MEASUREMENTS, cJSON_CreateArray());
@@ -258,28 +263,82 @@ static cJSON* loadJson(Colibri_t* self, int argcCmd, char** argvCmd)
     return json;
 }
 
-Error_t cmdSave(Colibri_t* self, int argcCmd, char** argvCmd)
+Error_t saveDeviceMeasurement(const SaveDevice_t* device, bool verbose, const char* file, const char* comment, const SaveMeasurement_t* measurement)
 {
-    cJSON*  json = NULL;
-    Error_t ret  = ERROR_COLIBRI_OK;
+    cJSON*              json   = NULL;
+    Error_t             ret    = ERROR_COLIBRI_OK;
+    ColibriJsonFormat_t format = COLIBRI_JSON_PRETTY;
+    ColibriJsonScope_t  scope;
 
-    if (argcCmd == 2 || argcCmd == 3)
+    colibriJsonScopeBegin(&scope, verbose);
+
+    json = loadJson(device, file, &format);
+    addMeasurement(device, comment, measurement, json);
+    if (!colibriJsonSave((char*)file, json, format))
     {
-        json = loadJson(self, argcCmd, argvCmd);
-        ret  = addMeasurement(self, argcCmd, argvCmd, json);
+        ret = ERROR_COLIBRI_FILE_WRITE_ERROR;
+        printError(ret, NULL);
+    }
+
+    colibriJsonRelease(json);
+
+    colibriJsonScopeEnd(&scope);
+
+    return ret;
+}
+
+Error_t saveMeasurement(Colibri_t* self, const char* file, const char* comment, const SaveMeasurement_t* measurement)
+{
+    SaveDevice_t device;
+
+    saveReadDevice(self, &device);
+
+    return saveDeviceMeasurement(&device, self->verbose, file, comment, measurement);
+}
+
+Error_t cmdSave(Colibri_t* self, int argcCmd, char** argvCmd)
+{
+    Error_t           ret       = ERROR_COLIBRI_OK;
+    SaveMeasurement_t measurement;
+    const char*       arguments[2];
+    int               argumentCount = 0;
+    uint32_t          average       = 1;
+    double            limit         = MEASURE_OUTLIER_LIMIT;
+
+    for (int i = 1; i < argcCmd; i++)
+    {
+        ret = measureAverageParse(argcCmd, argvCmd, &i, &average, &limit);
         if (ret == ERROR_COLIBRI_OK)
         {
-            colibriJsonSave(argvCmd[1], json);
+            continue;
+        }
+        if (ret != ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION)
+        {
+            return ret;
+        }
+        ret = ERROR_COLIBRI_OK;
+        if (argumentCount == 2)
+        {
+            argumentCount = 0;
+            break;
         }
+        arguments[argumentCount++] = argvCmd[i];
     }
-    else
+
+    // The device stores up to ten measurements, one is the baseline
+    if (argumentCount == 0 || average < 1 || average > 9)
     {
         ret = ERROR_COLIBRI_UNKOWN_COMMAND_LINE_ARGUMENT;
         printError(ret, NULL);
     }
-
-    if (json)
-        cJSON_Delete(json);
+    else
+    {
+        ret = readMeasurement(self, average, limit, &measurement);
+        if (ret == ERROR_COLIBRI_OK)
+        {
+            ret = saveMeasurement(self, arguments[0], argumentCount == 2 ? arguments[1] : NULL, &measurement);
+        }
+    }
 
     return ret;
 }
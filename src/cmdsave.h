@@ -5,4 +5,33 @@
 
 #include "colibri.h"
 
+// One measurement as stored in a data file. The values of baseline, air and
+// sample are in the order sample230 reference230 ... sample340 reference340,
+// air is only stored with hasAir.
+typedef struct
+{
+    Levelling_t levelling[4];
+    uint32_t baseline[8];
+    uint32_t air[8];
+    uint32_t sample[8];
+    bool hasAir;
+} SaveMeasurement_t;
+
+// What a data file stores about the device, read once so that measurements
+// can be saved without access to the device, e.g. from a background thread.
+// Missing strings are empty. The amplification factors are indexed by the
+// amplification of a levelling.
+typedef struct
+{
+    char   serialNumber[100];
+    char   firmwareVersion[100];
+    double sampleFactors[3];
+    double referenceFactors[3];
+} SaveDevice_t;
+
 Error_t cmdSave(Colibri_t * self, int argcCmd, char **argvCmd);
+// Adds measurement to the data file, which is created if it does not exist.
+Error_t saveMeasurement(Colibri_t * self, const char *file, const char *comment, const SaveMeasurement_t *measurement);
+void saveReadDevice(Colibri_t * self, SaveDevice_t *device);
+// Same as saveMeasurement without access to the device.
+Error_t saveDeviceMeasurement(const SaveDevice_t *device, bool verbose, const char *file, const char *comment, const SaveMeasurement_t *measurement);
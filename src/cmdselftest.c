@@ -4,6 +4,7 @@
 #include "cmdselftest.h"
 #include "printerror.h"
 #include "colibri.h"
+#include "output.h"
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -14,73 +15,79 @@ Error_t cmdSelftest(Colibri_t *self)
 
     ret = colibriSelftest(self, &result);
 
-    if (ret == ERROR_COLIBRI_OK)
+    if (ret == ERROR_COLIBRI_OK && outputFormat() != OUTPUT_TEXT)
+    {
+        outputBegin(OUTPUT_SELFTEST);
+        outputUint32("result", result);
+        outputEnd();
+    }
+    else if (ret == ERROR_COLIBRI_OK)
     {
         if(result == 0)
         {
-            fprintf(stdout, "Selftest passed.\n");
+            bufferAppendString(outputBuffer(), "Selftest passed.\n");
         }
         else
         {
-            fprintf(stdout, "Selftest failed:\n");
+            bufferAppendString(outputBuffer(), "Selftest failed:\n");
             if(result & SELFTEST_ILED_230)
             {
-                fprintf(stdout, "  - ILED_230\n");
+                bufferAppendString(outputBuffer(), "  - ILED_230\n");
             }
             if(result & SELFTEST_ILED_260)
             {
-                fprintf(stdout, "  - ILED_260\n");
+                bufferAppendString(outputBuffer(), "  - ILED_260\n");
             }
             if(result & SELFTEST_ILED_280)
             {
-                fprintf(stdout, "  - ILED_280\n");
+                bufferAppendString(outputBuffer(), "  - ILED_280\n");
             }
             if(result & SELFTEST_ILED_340)
             {
-                fprintf(stdout, "  - ILED_340\n");
+                bufferAppendString(outputBuffer(), "  - ILED_340\n");
             }
 
             if(result & SELFTEST_SAMPLE_230)
             {
-                fprintf(stdout, "  - SAMPLE_230\n");
+                bufferAppendString(outputBuffer(), "  - SAMPLE_230\n");
             }
             if(result & SELFTEST_SAMPLE_260)
             {
-                fprintf(stdout, "  - SAMPLE_260\n");
+                bufferAppendString(outputBuffer(), "  - SAMPLE_260\n");
             }
             if(result & SELFTEST_SAMPLE_280)
             {
-                fprintf(stdout, "  - SAMPLE_280\n");
+                bufferAppendString(outputBuffer(), "  - SAMPLE_280\n");
             }
             if(result & SELFTEST_SAMPLE_340)
             {
-                fprintf(stdout, "  - SAMPLE_340\n");
+                bufferAppendString(outputBuffer(), "  - SAMPLE_340\n");
             }
 
             if(result & SELFTEST_REFERENCE_230)
             {
-                fprintf(stdout, "  - REFERENCE_230\n");
+                bufferAppendString(outputBuffer(), "  - REFERENCE_230\n");
             }
             if(result & SELFTEST_REFERENCE_260)
             {
-                fprintf(stdout, "  - REFERENCE_260\n");
+                bufferAppendString(outputBuffer(), "  - REFERENCE_260\n");
             }
             if(result & SELFTEST_REFERENCE_280)
             {
-                fprintf(stdout, "  - REFERENCE_280\n");
+                bufferAppendString(outputBuffer(), "  - REFERENCE_280\n");
             }
             if(result & SELFTEST_REFERENCE_340)
             {
-                fprintf(stdout, "  - REFERENCE_340\n");
+                bufferAppendString(outputBuffer(), "  - REFERENCE_340\n");
             }
 
             if(result & SELFTEST_REFERENCE)
             {
-                fprintf(stdout, "  - REFERENCE CHANNEL AMPLIFICATION\n");
+                bufferAppendString(outputBuffer(), "  - REFERENCE CHANNEL AMPLIFICATION\n");
             }
             if(result & SELFTEST_SAMPLE)
             {
-                fprintf(stdout, "  - SAMPLE CHANNEL AMPLIFICATION\n");
+                bufferAppendString(outputBuffer(), "  - SAMPLE CHANNEL AMPLIFICATION\n");
             }
         }
     }
@@ -4,10 +4,12 @@
 #include "cmdset.h"
 #include "printerror.h"
 #include "colibri.h"
+#include <ctype.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
-Error_t cmdSet(Colibri_t *self, const char *sIndex, const char *sValue)
+static Error_t setSingle(Colibri_t *self, const char *sIndex, const char *sValue)
 {
     char *endptr;
     long index = strtol(sIndex, &endptr, 10);
@@ -28,4 +30,62 @@ Error_t cmdSet(Colibri_t *self, const char *sIndex, const char *sValue)
         printError(ret, "'%s' is not a valid number.", sIndex);
     }
     return ret;
-}
\ No newline at end of file
+}
+
+// Writes all INDEX=VALUE pairs in one pipelined session. Every value is
+// written, the first error is returned.
+static Error_t setList(Colibri_t *self, int argcCmd, char **argvCmd)
+{
+    uint32_t indices[SET_MAX_VALUES];
+    const char *values[SET_MAX_VALUES];
+    Error_t errors[SET_MAX_VALUES];
+    size_t count = 0;
+    Error_t ret;
+
+    if (argcCmd < 2 || argcCmd - 1 > SET_MAX_VALUES)
+    {
+        return printError(ERROR_COLIBRI_INVALID_PARAMETER, "Expected 1 to %d values.\n", SET_MAX_VALUES);
+    }
+
+    for (int i = 1; i < argcCmd; i++)
+    {
+        char *separator = strchr(argvCmd[i], '=');
+        char *endptr = NULL;
+        unsigned long index = 0;
+
+        if (isdigit((unsigned char)argvCmd[i][0]))
+        {
+            index = strtoul(argvCmd[i], &endptr, 10);
+        }
+        if (separator == NULL || endptr != separator || separator[1] == '\0' || strpbrk(separator + 1, " \t\r\n") != NULL)
+        {
+            return printError(ERROR_COLIBRI_INVALID_NUMBER, "'%s' is not INDEX=VALUE.\n", argvCmd[i]);
+        }
+        indices[count] = (uint32_t)index;
+        values[count++] = separator + 1;
+    }
+
+    ret = colibriSetValues(self, indices, values, count, errors);
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        return printError(ret, NULL);
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        if (errors[i] != ERROR_COLIBRI_OK)
+        {
+            printError(errors[i], "Could not set index %u to %s.\n", indices[i], values[i]);
+            ret = ret == ERROR_COLIBRI_OK ? errors[i] : ret;
+        }
+    }
+    return ret;
+}
+
+Error_t cmdSet(Colibri_t *self, int argcCmd, char **argvCmd)
+{
+    if (argcCmd == 3 && strchr(argvCmd[1], '=') == NULL)
+    {
+        return setSingle(self, argvCmd[1], argvCmd[2]);
+    }
+    return setList(self, argcCmd, argvCmd);
+}
@@ -5,4 +5,7 @@
 
 #include "colibri.h"
 
-Error_t cmdSet(Colibri_t * self, const char * sIndex, const char * sValue);
+#define SET_MAX_VALUES 256
+
+// set INDEX VALUE or set INDEX=VALUE ...
+Error_t cmdSet(Colibri_t * self, int argcCmd, char **argvCmd);
@@ -2,13 +2,14 @@
 // SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
 
 #include "colibri.h"
-#include "crc-16-ccitt.h"
+#include "colibriFeed.h"
 #include <stdio.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdlib.h>
 
-#define VERSION_DLL "1.0.0"
+#define VERSION_DLL "2.0.0"
 
 typedef struct
 {
@@ -76,6 +77,16 @@ const char * colibriError2String(Error_t e)
 		  return "Colibri file not found";
 		case ERROR_COLIBRI_LEVELLING_FAILED:
 		  return "Colibri levelling failed. Cuvette holder blocked?";
+		case ERROR_COLIBRI_OUT_OF_MEMORY:
+		  return "Out of memory";
+		case ERROR_COLIBRI_FILE_WRITE_ERROR:
+		  return "File write error";
+		case ERROR_COLIBRI_INVALID_FILE_FORMAT:
+		  return "Invalid file format";
+		case ERROR_COLIBRI_VERIFY_FAILED:
+		  return "Values read back differ from the values written";
+		case ERROR_COLIBRI_ALL_REJECTED:
+		  return "Every measurement was rejected as an outlier";
 		default:
 		  return "?";
 	}
@@ -92,83 +103,160 @@ void colibriFreeResponse(ColibriResponse_t *response)
 	free(response);
 }
 
-Error_t colibriCommandComm(Colibri_t *self, HANDLE hComm, const char * command, ColibriResponse_t *response)
+// Splits response->response into the arguments.
+static void colibriSplitResponse(ColibriResponse_t *response)
 {
-	Error_t ret = ERROR_COLIBRI_OK;
+	int lastWasSpace;
+	int isSpace;
+
+	for (int i = 0; i < COLIBRI_MAX_ARGS; i++)
+	{
+		response->argv[i] = 0;
+	}
+	response->argc = 0;
+	lastWasSpace = 1;
+
+	char *d = response->response;
 
-		uint32_t txSize = COLIBRI_MAX_LINE_LENGTH;
-		char * tx = (char *)calloc(1, txSize);
-		char s[20] = {0};
-		if(self->useChecksum)
+	for (int i = 0; (i < COLIBRI_MAX_LINE_LENGTH) && (d[i] != 0) && (response->argc < COLIBRI_MAX_ARGS); i++)
+	{
+		isSpace = isspace(d[i]);
+		if (lastWasSpace != 0 && isSpace == 0)
 		{
-			s[0] = COLIBRI_START_WITH_CHK;
-			strncat_s(tx, txSize, s, 1);
-			strncat_s(tx, txSize, command, strlen(command));
-			s[0] = COLIBRI_CHECKSUM_SEPARATOR;
-			strncat_s(tx, txSize, s, 1);
-  		    crc_t crc = crc_init();
-            crc = crc_update(crc, command, strlen(command));
-            crc = crc_finalize(crc);
-			snprintf(s, sizeof(s), "%d", (uint32_t)crc);
-			strncat_s(tx, txSize, s, strlen(s));
+			response->argv[response->argc] = d + i;
+			response->argc++;
 		}
-		else
+		else if (lastWasSpace == 0 && isSpace != 0)
 		{
-      	  s[0] = COLIBRI_START_NO_CHK;
-		  strncat_s(tx, txSize, s, 1);
-		  strncat_s(tx, txSize, command, strlen(command));
+			d[i] = 0;
 		}
-		strncat_s(tx, txSize, "\n", 1);
+		lastWasSpace = isSpace;
+	}
+}
 
-		if (hComm != INVALID_HANDLE_VALUE)
+// Reads the responses of count commands sent at once, the data after the
+// end of a response belongs to the next one.
+static Error_t colibriReceive(Colibri_t *self, ColibriTransport_t *transport, ColibriResponse_t *responses, size_t count, uint32_t timeout)
+{
+	char rx[COLIBRI_MAX_LINE_LENGTH];
+	char line[COLIBRI_MAX_LINE_LENGTH];
+	size_t length = 0;
+	size_t received = 0;
+	bool inFrame = false;
+	uint64_t deadline = colibriMilliseconds() + timeout;
+
+	while (received < count)
+	{
+		int32_t size = transport->ops->read(transport, rx, sizeof(rx), deadline);
+		if (size < 0)
 		{
-			colibriPortWrite(hComm, tx, self->verbose);
-			if (colibriPortRead(hComm, response->response, COLIBRI_MAX_LINE_LENGTH, self->verbose) > 0)
-			{
-				int lastWasSpace;
-				int isSpace;
+			return ERROR_COLIBRI_PROTOCOL_ERROR;
+		}
+		if (size == 0)
+		{
+			return ERROR_COLIBRI_TIMEOUT;
+		}
+		if (self->verbose)
+		{
+			fprintf(stderr, "RX: %.*s\n", (int)size, rx);
+		}
 
-				for (int i = 0; i < COLIBRI_MAX_ARGS; i++)
+		for (int32_t i = 0; i < size && received < count; i++)
+		{
+			if (!inFrame)
+			{
+				if (rx[i] == COLIBRI_START_NO_CHK || rx[i] == COLIBRI_START_WITH_CHK)
 				{
-					response->argv[i] = 0;
+					inFrame = true;
+					line[0] = rx[i];
+					length = 1;
 				}
-				response->argc = 0;
-				lastWasSpace = 1;
-
-				char *d = response->response;
+			}
+			else if (rx[i] == COLIBRI_STOP1 || rx[i] == COLIBRI_STOP2)
+			{
+				char * payload;
 
-				for (int i = 0; (i < COLIBRI_MAX_LINE_LENGTH) && (d[i] != 0) && (response->argc < COLIBRI_MAX_ARGS); i++)
+				inFrame = false;
+				line[length] = 0;
+				payload = colibriUnframe(line);
+				if (payload == NULL)
 				{
-					isSpace = isspace(d[i]);
-					if (lastWasSpace != 0 && isSpace == 0)
-					{
-						response->argv[response->argc] = d + i;
-						response->argc++;
-					}
-					else if (lastWasSpace == 0 && isSpace != 0)
-					{
-						d[i] = 0;
-					}
-					lastWasSpace = isSpace;
+					return ERROR_COLIBRI_PROTOCOL_ERROR;
 				}
-				ret = ERROR_COLIBRI_OK;
+				strncpy_s(responses[received].response, COLIBRI_MAX_LINE_LENGTH, payload, COLIBRI_MAX_LINE_LENGTH);
+				colibriSplitResponse(&responses[received++]);
+			}
+			else if (length < sizeof(line) - 1)
+			{
+				line[length++] = rx[i];
 			}
 		}
-		else
+	}
+	return ERROR_COLIBRI_OK;
+}
+
+static Error_t colibriSend(Colibri_t *self, ColibriTransport_t *transport, const char * tx)
+{
+	if (self->verbose)
+	{
+		fprintf(stderr, "TX: %s\n", tx);
+	}
+	return transport->ops->write(transport, tx) ? ERROR_COLIBRI_OK : ERROR_COLIBRI_PROTOCOL_ERROR;
+}
+
+static Error_t colibriCommandComm(Colibri_t *self, ColibriTransport_t *transport, const char * command, ColibriResponse_t *response)
+{
+	char tx[COLIBRI_MAX_LINE_LENGTH] = "";
+	Error_t ret;
+
+	colibriFrame(command, self->useChecksum, tx, sizeof(tx));
+	ret = colibriSend(self, transport, tx);
+	if (ret == ERROR_COLIBRI_OK)
+	{
+		ret = colibriReceive(self, transport, response, 1, COLIBRI_COMMAND_TIMEOUT);
+	}
+	return ret;
+}
+
+static Error_t colibriCommandsComm(Colibri_t *self, ColibriTransport_t *transport, const char ** commands, size_t count, ColibriResponse_t *responses)
+{
+	Error_t ret = ERROR_COLIBRI_OK;
+	size_t txSize = COLIBRI_PIPELINE_DEPTH * COLIBRI_MAX_LINE_LENGTH;
+	char * tx = (char *)malloc(txSize);
+
+	if (tx == NULL)
+	{
+		return ERROR_COLIBRI_OUT_OF_MEMORY;
+	}
+
+	for (size_t first = 0; first < count && ret == ERROR_COLIBRI_OK; first += COLIBRI_PIPELINE_DEPTH)
+	{
+		size_t batch = count - first < COLIBRI_PIPELINE_DEPTH ? count - first : COLIBRI_PIPELINE_DEPTH;
+
+		tx[0] = 0;
+		for (size_t i = 0; i < batch; i++)
 		{
-			ret = ERROR_COLIBRI_NOT_FOUND;
+			colibriFrame(commands[first + i], self->useChecksum, tx, txSize);
 		}
+		ret = colibriSend(self, transport, tx);
+		if (ret == ERROR_COLIBRI_OK)
+		{
+			ret = colibriReceive(self, transport, responses + first, batch, COLIBRI_PIPELINE_TIMEOUT);
+		}
+	}
 
-		free(tx);
-return ret;
+	free(tx);
+	return ret;
 }
 
-Error_t colibriCommand(Colibri_t *self, const char * command, ColibriResponse_t *response)
+// Opens the transport of the port, the first device found without portName.
+static Error_t colibriTransportOpen(Colibri_t *self, ColibriTransport_t *transport)
 {
 	char portNameBuffer[1024];
 	size_t portNameBufferSize = sizeof(portNameBuffer);
-
+	const char * address;
 	Error_t ret = ERROR_COLIBRI_OK;
+
 	if (self->portName)
 	{
 		strcpy_s(portNameBuffer, portNameBufferSize, self->portName);
@@ -180,38 +268,102 @@ Error_t colibriCommand(Colibri_t *self, const char * command, ColibriResponse_t
 
 	if (ret == ERROR_COLIBRI_OK)
 	{
-		HANDLE hComm = colibriPortOpen(portNameBuffer);
-        ret = colibriCommandComm(self, hComm, command, response);
-		colibriPortClose(hComm);
+		memset(transport, 0, sizeof(ColibriTransport_t));
+		transport->ops = colibriTransportFind(portNameBuffer, &address);
+		transport->device = self->loopbackDevice;
+		transport->user = self->loopbackUser;
+		if (!transport->ops->open(transport, address))
+		{
+			transport->ops->close(transport);
+			ret = ERROR_COLIBRI_NOT_FOUND;
+		}
 	}
-	else
+	return ret == ERROR_COLIBRI_OK ? ERROR_COLIBRI_OK : ERROR_COLIBRI_NOT_FOUND;
+}
+
+Error_t colibriOpen(Colibri_t *self)
+{
+	if (self->isOpen)
+	{
+		return ERROR_COLIBRI_OK;
+	}
+	self->isOpen = colibriTransportOpen(self, &self->transport) == ERROR_COLIBRI_OK;
+	return self->isOpen ? ERROR_COLIBRI_OK : ERROR_COLIBRI_NOT_FOUND;
+}
+
+void colibriClose(Colibri_t *self)
+{
+	if (self->isOpen)
+	{
+		self->transport.ops->close(&self->transport);
+		self->isOpen = false;
+	}
+}
+
+Error_t colibriCommand(Colibri_t *self, const char * command, ColibriResponse_t *response)
+{
+	ColibriTransport_t transport;
+	Error_t ret;
+
+	if (self->isOpen)
+	{
+		return colibriCommandComm(self, &self->transport, command, response);
+	}
+
+	ret = colibriTransportOpen(self, &transport);
+	if (ret == ERROR_COLIBRI_OK)
+	{
+		ret = colibriCommandComm(self, &transport, command, response);
+		transport.ops->close(&transport);
+	}
+	return ret;
+}
+
+Error_t colibriCommands(Colibri_t *self, const char ** commands, size_t count, ColibriResponse_t *responses)
+{
+	Error_t ret;
+	bool isOpen = self->isOpen;
+
+	ret = colibriOpen(self);
+	if (ret == ERROR_COLIBRI_OK)
 	{
-		ret = ERROR_COLIBRI_NOT_FOUND;
+		ret = colibriCommandsComm(self, &self->transport, commands, count, responses);
+		if (!isOpen)
+		{
+			colibriClose(self);
+		}
 	}
 	return ret;
 }
 
+// The error of a response which does not belong to cmd
+static Error_t colibriResponseError(const char * cmd, ColibriResponse_t *response)
+{
+	if (response->argc > 0 && strncmp(response->argv[0], cmd, 1) == 0)
+	{
+		return ERROR_COLIBRI_OK;
+	}
+	else if(response->argc == 2 && strncmp(response->argv[0], "E", 1) == 0)
+	{
+		return atoi(response->argv[1]);
+	}
+	else
+	{
+		return ERROR_COLIBRI_RESPONSE_ERROR;
+	}
+}
+
 Error_t colibriExecute(Colibri_t * self, char * cmd, Error_t(execute)(ColibriResponse_t *response, void *user), void *user)
 {
 	ColibriResponse_t *response = colibriCreateResponse();
 	Error_t ret = colibriCommand(self, cmd, response);
 	if (ret == ERROR_COLIBRI_OK)
 	{
-		if (strncmp(response->argv[0], cmd, 1) == 0)
+		ret = colibriResponseError(cmd, response);
+		if (ret == ERROR_COLIBRI_OK)
 		{
 			ret = execute(response, user);
 		}
-		else
-		{
-			if(response->argc == 2 && strncmp(response->argv[0], "E", 1) == 0)
-			{
-			  ret = atoi(response->argv[1]);			  
-			}
-			else
-			{
-			  ret = ERROR_COLIBRI_RESPONSE_ERROR;
-			}
-		}
 	}
 	colibriFreeResponse(response);
 	return ret;
@@ -261,6 +413,99 @@ Error_t colibriSet(Colibri_t * self, uint32_t index, const char * value)
 	return colibriExecute(self, cmd, colibriNoReturn_, 0);
 }
 
+// Runs the commands of the indices pipelined, errors holds the error of
+// every index.
+static Error_t colibriValues(Colibri_t * self, char (*commands)[COLIBRI_MAX_LINE_LENGTH], size_t count, ColibriResponse_t ** responses, Error_t * errors)
+{
+	const char ** pointers = (const char **)malloc((count ? count : 1) * sizeof(char *));
+	Error_t ret;
+
+	*responses = (ColibriResponse_t *)calloc(count ? count : 1, sizeof(ColibriResponse_t));
+	if (pointers == NULL || *responses == NULL)
+	{
+		free(pointers);
+		free(*responses);
+		*responses = NULL;
+		return ERROR_COLIBRI_OUT_OF_MEMORY;
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		pointers[i] = commands[i];
+	}
+
+	ret = colibriCommands(self, pointers, count, *responses);
+	for (size_t i = 0; i < count; i++)
+	{
+		errors[i] = ret != ERROR_COLIBRI_OK ? ret : colibriResponseError("V", &(*responses)[i]);
+	}
+	free(pointers);
+	return ret;
+}
+
+Error_t colibriGetValues(Colibri_t * self, const uint32_t * indices, size_t count, char * values, size_t valueSize, Error_t * errors)
+{
+	char (*commands)[COLIBRI_MAX_LINE_LENGTH] = malloc((count ? count : 1) * COLIBRI_MAX_LINE_LENGTH);
+	ColibriResponse_t * responses;
+	Error_t ret;
+
+	if (commands == NULL)
+	{
+		return ERROR_COLIBRI_OUT_OF_MEMORY;
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		snprintf(commands[i], COLIBRI_MAX_LINE_LENGTH, "V %u", indices[i]);
+	}
+
+	ret = colibriValues(self, commands, count, &responses, errors);
+	if (responses)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			values[i * valueSize] = 0;
+			if (errors[i] == ERROR_COLIBRI_OK)
+			{
+				UserGet user = {values + i * valueSize, valueSize};
+				errors[i] = colibriGet_(&responses[i], &user);
+			}
+		}
+	}
+	free(responses);
+	free(commands);
+	return ret;
+}
+
+Error_t colibriSetValues(Colibri_t * self, const uint32_t * indices, const char ** values, size_t count, Error_t * errors)
+{
+	char (*commands)[COLIBRI_MAX_LINE_LENGTH] = malloc((count ? count : 1) * COLIBRI_MAX_LINE_LENGTH);
+	ColibriResponse_t * responses;
+	Error_t ret;
+
+	if (commands == NULL)
+	{
+		return ERROR_COLIBRI_OUT_OF_MEMORY;
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		snprintf(commands[i], COLIBRI_MAX_LINE_LENGTH, "V %u %s", indices[i], values[i]);
+	}
+
+	ret = colibriValues(self, commands, count, &responses, errors);
+	if (responses)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			if (errors[i] == ERROR_COLIBRI_OK)
+			{
+				errors[i] = colibriNoReturn_(&responses[i], NULL);
+			}
+		}
+	}
+	free(responses);
+	free(commands);
+	return ret;
+}
+
 Error_t colibriMeasure_(ColibriResponse_t *response, void *user)
 {
 	UserMeasurement *u = (UserMeasurement *)user;
@@ -282,10 +527,24 @@ Error_t colibriMeasure_(ColibriResponse_t *response, void *user)
 	}
 }
 
+static void colibriPublish(Colibri_t * self, ColibriFeedType_t type, const UserMeasurement * u)
+{
+	if (self->feed)
+	{
+		uint32_t values[8] = {*(u->sample230), *(u->reference230), *(u->sample260), *(u->reference260), *(u->sample280), *(u->reference280), *(u->sample340), *(u->reference340)};
+		colibriFeedPublish(self->feed, type, values);
+	}
+}
+
 Error_t colibriMeasure(Colibri_t * self, uint32_t * sample230, uint32_t * reference230, uint32_t * sample260, uint32_t * reference260, uint32_t * sample280, uint32_t * reference280, uint32_t * sample340, uint32_t * reference340)
 {
 	UserMeasurement user = {sample230 = sample230, reference230 = reference230, sample260 = sample260, reference260 = reference260, sample280 = sample280, reference280 = reference280, sample340 = sample340, reference340 = reference340};
-	return colibriExecute(self, "M", colibriMeasure_, &user);
+	Error_t ret = colibriExecute(self, "M", colibriMeasure_, &user);
+	if (ret == ERROR_COLIBRI_OK)
+	{
+		colibriPublish(self, COLIBRI_FEED_MEASUREMENT, &user);
+	}
+	return ret;
 }
 
 Error_t colibriLastMeasurements(Colibri_t * self, uint32_t last, uint32_t * sample230, uint32_t * reference230, uint32_t * sample260, uint32_t * reference260, uint32_t * sample280, uint32_t * reference280, uint32_t * sample340, uint32_t * reference340)
@@ -365,7 +624,12 @@ Error_t colibriBaseline_(ColibriResponse_t *response, void *user)
 Error_t colibriBaseline(Colibri_t * self, uint32_t * sample230, uint32_t * reference230, uint32_t * sample260, uint32_t * reference260, uint32_t * sample280, uint32_t * reference280, uint32_t * sample340, uint32_t * reference340)
 {
 	UserMeasurement user = {sample230 = sample230, reference230 = reference230, sample260 = sample260, reference260 = reference260, sample280 = sample280, reference280 = reference280, sample340 = sample340, reference340 = reference340};
-	return colibriExecute(self, "G", colibriBaseline_, &user);
+	Error_t ret = colibriExecute(self, "G", colibriBaseline_, &user);
+	if (ret == ERROR_COLIBRI_OK)
+	{
+		colibriPublish(self, COLIBRI_FEED_BASELINE, &user);
+	}
+	return ret;
 }
 
 Error_t colibriSelftest_(ColibriResponse_t *response, void *user)
@@ -449,43 +713,46 @@ Error_t colibriFwUpdate(Colibri_t * self, const char * file)
 		size_t n;
 		char * line = NULL;
 		int length = 0;
-		Error_t ret;
 		char cmd[255];
-	    char portNameBuffer[1024];
-	    size_t portNameBufferSize = sizeof(portNameBuffer);
-        
-		if(self->portName == 0)
+		Error_t reset;
+		ColibriTransport_t local;
+		// An open port, e.g. of a fleet device, is exclusive and must be reused
+		ColibriTransport_t *transport = self->isOpen ? &self->transport : &local;
+
+		if(!self->isOpen)
 		{
-          ret = colibriFindDevice(portNameBuffer, &portNameBufferSize, self->verbose);
-		  self->portName = portNameBuffer;
-		  if(ret != ERROR_COLIBRI_OK)
-		  {
-			return ret;
-		  }
+			ret = colibriTransportOpen(self, &local);
+			if(ret != ERROR_COLIBRI_OK)
+			{
+				fclose(f);
+				return ret;
+			}
 		}
 
 		ColibriResponse_t *response = colibriCreateResponse();
-		HANDLE hComm = colibriPortOpen(self->portName);
-        ret = colibriCommandComm(self, hComm, "F", response);
-		do
+		ret = colibriCommandComm(self, transport, "F", response);
+		while(ret == ERROR_COLIBRI_OK && (length = getlineInternal(&line, &n, f)) != -1)
 		{
-		   length = getlineInternal(&line, &n, f);
-		   if(length != -1)
-		   {
-		     snprintf(cmd, sizeof(cmd), "S %s", line);
-			 ret = colibriCommandComm(self, hComm, cmd, response);
-		   }
+			snprintf(cmd, sizeof(cmd), "S %s", line);
+			ret = colibriCommandComm(self, transport, cmd, response);
 		}
-		while(length != -1 && ret == ERROR_COLIBRI_OK);
 
-		ret = colibriCommandComm(self, hComm, "R", response);
+		// The device is restarted even after an error, the first error is kept
+		reset = colibriCommandComm(self, transport, "R", response);
+		if(ret == ERROR_COLIBRI_OK)
+		{
+			ret = reset;
+		}
 
 		Sleep(5000);
 
 		free(line);
 		fclose(f);
 		colibriFreeResponse(response);
-		colibriPortClose(hComm);
+		if(transport == &local)
+		{
+			local.ops->close(&local);
+		}
 	}
 	else
 	{
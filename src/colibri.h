@@ -32,6 +32,18 @@ extern void Sleep(uint32_t dwMilliseconds);
 #define COLIBRI_CHECKSUM_SEPARATOR '@'
 #define COLIBRI_STOP1 '\n'
 #define COLIBRI_STOP2 '\r'
+// Commands sent at once by colibriCommands() and the time for their
+// responses in [ms]
+#define COLIBRI_PIPELINE_DEPTH 16
+#define COLIBRI_PIPELINE_TIMEOUT 5000
+// Time for the response of a single command in [ms], e.g. a levelling
+#define COLIBRI_COMMAND_TIMEOUT 60000
+
+// Port names with these prefixes use the TCP transport, e.g.
+// tcp:192.168.1.10:4001 for a ser2net bridge, or the loopback transport.
+// All others are serial ports.
+#define COLIBRI_TCP_PREFIX "tcp:"
+#define COLIBRI_LOOPBACK_PREFIX "loopback"
 
 typedef struct
 {
@@ -40,11 +52,46 @@ typedef struct
     char response[COLIBRI_MAX_LINE_LENGTH];
 } ColibriResponse_t;
 
+struct ColibriTransport;
+
+// Moves the bytes of the protocol. write sends a whole string. read returns
+// the number of bytes received, 0 if none arrived before deadline, a time
+// of colibriMilliseconds(), and -1 on errors.
+typedef struct
+{
+    bool (*open)(struct ColibriTransport *self, const char *address);
+    bool (*write)(struct ColibriTransport *self, const char *data);
+    int32_t (*read)(struct ColibriTransport *self, char *buffer, size_t size, uint64_t deadline);
+    void (*close)(struct ColibriTransport *self);
+} ColibriTransportOps_t;
+
+// Answers a command of the loopback transport, both without the framing.
+typedef void (*ColibriLoopbackDevice_t)(void *user, const char *command, char *response, size_t responseSize);
+
+typedef struct ColibriTransport
+{
+    const ColibriTransportOps_t *ops;
+    HANDLE handle;
+    ColibriLoopbackDevice_t device;
+    void *user;
+    struct ColibriLoopback *loopback;
+} ColibriTransport_t;
+
+// With isOpen set by colibriOpen() all commands use transport instead of
+// opening the port for every command. With feed set the results of
+// colibriMeasure() and colibriBaseline() are published to it, see
+// colibriFeed.h. The loopback transport answers with loopbackDevice, without
+// it every command is answered with itself.
 typedef struct
 {
     bool verbose;
     char *portName;
     bool useChecksum;
+    bool isOpen;
+    ColibriTransport_t transport;
+    struct ColibriFeed *feed;
+    ColibriLoopbackDevice_t loopbackDevice;
+    void *loopbackUser;
 } Colibri_t;
 
 typedef struct
@@ -74,6 +121,11 @@ typedef enum
     ERROR_COLIBRI_INVALID_NUMBER = 203,
     ERROR_COLIBRI_FILE_NOT_FOUND = 204,    
     ERROR_COLIBRI_NUMBER_OF_MEASUREMENTS = 207,
+    ERROR_COLIBRI_OUT_OF_MEMORY = 208,
+    ERROR_COLIBRI_FILE_WRITE_ERROR = 209,
+    ERROR_COLIBRI_INVALID_FILE_FORMAT = 210,
+    ERROR_COLIBRI_VERIFY_FAILED = 211,
+    ERROR_COLIBRI_ALL_REJECTED = 212,
 } Error_t;
 
 typedef enum
@@ -127,11 +179,24 @@ typedef enum
 
     DLLEXPORT Error_t
     colibriFindDevice(char *portName, size_t *portNameSize, bool verbose);
+// portNames holds *count names of portNameSize bytes each, *count is set to
+// the number of devices found.
+DLLEXPORT Error_t colibriFindDevices(char *portNames, size_t portNameSize, size_t *count, bool verbose);
+DLLEXPORT Error_t colibriOpen(Colibri_t *self);
+DLLEXPORT void colibriClose(Colibri_t *self);
 DLLEXPORT ColibriResponse_t *colibriCreateResponse();
 DLLEXPORT void colibriFreeResponse(ColibriResponse_t *response);
 DLLEXPORT Error_t colibriCommand(Colibri_t *self, const char *command, ColibriResponse_t *response);
 
+// Sends up to COLIBRI_PIPELINE_DEPTH commands at once before reading their
+// responses, so a batch costs one round trip.
+DLLEXPORT Error_t colibriCommands(Colibri_t *self, const char **commands, size_t count, ColibriResponse_t *responses);
 DLLEXPORT Error_t colibriGet(Colibri_t *self, uint32_t index, char *value, size_t valueSize);
+// Pipelined get and set of count indices. values holds count strings of
+// valueSize bytes for get. errors holds the error of every index, the
+// return value is the error of the transfer.
+DLLEXPORT Error_t colibriGetValues(Colibri_t *self, const uint32_t *indices, size_t count, char *values, size_t valueSize, Error_t *errors);
+DLLEXPORT Error_t colibriSetValues(Colibri_t *self, const uint32_t *indices, const char **values, size_t count, Error_t *errors);
 DLLEXPORT Error_t colibriSet(Colibri_t *self, uint32_t index, const char *value);
 DLLEXPORT Error_t colibriMeasure(Colibri_t *self, uint32_t *sample230, uint32_t *reference230, uint32_t *sample260, uint32_t *reference260, uint32_t *sample280, uint32_t *reference280, uint32_t *sample340, uint32_t *reference340);
 DLLEXPORT Error_t colibriBaseline(Colibri_t *self, uint32_t *sample230, uint32_t *reference230, uint32_t *sample260, uint32_t *reference260, uint32_t *sample280, uint32_t *reference280, uint32_t *sample340, uint32_t *reference340);
@@ -143,7 +208,35 @@ DLLEXPORT Error_t colibriLastLevelling(Colibri_t *self, Levelling_t *levelling23
 DLLEXPORT const char *colibriError2String(Error_t e);
 DLLEXPORT const char *colibriVersion();
 
+// The transports of port names, see COLIBRI_TCP_PREFIX. address is set to
+// the part of portName the transport opens.
+DLLEXPORT const ColibriTransportOps_t *colibriTransportFind(const char *portName, const char **address);
+DLLEXPORT extern const ColibriTransportOps_t colibriSerialTransport;
+DLLEXPORT extern const ColibriTransportOps_t colibriTcpTransport;
+DLLEXPORT extern const ColibriTransportOps_t colibriLoopbackTransport;
+
+// Appends command framed with start character, checksum if useChecksum and
+// stop character to tx.
+void colibriFrame(const char *command, bool useChecksum, char *tx, size_t txSize);
+// Removes the framing of a received line, which starts with the start
+// character and has no stop character. Returns the payload, NULL if the
+// checksum is wrong.
+char *colibriUnframe(char *line);
+
+// Monotonic time in [ms]
+uint64_t colibriMilliseconds(void);
 HANDLE colibriPortOpen(char *portName);
 void colibriPortClose(HANDLE hComm);
 bool colibriPortWrite(HANDLE hComm, char *buffer, bool verbose);
-uint32_t colibriPortRead(HANDLE hComm, char *buffer, size_t size, bool verbose);
+// Returns the bytes received within the read timeout of the port, -1 on errors.
+int32_t colibriPortReceive(HANDLE hComm, char *buffer, size_t size, bool verbose);
+// address is HOST:PORT. Receive waits up to timeout [ms] and returns the
+// bytes received, -1 on errors or when the connection was closed.
+HANDLE colibriTcpOpen(const char *address);
+void colibriTcpClose(HANDLE socket);
+bool colibriTcpWrite(HANDLE socket, const char *data);
+int32_t colibriTcpReceive(HANDLE socket, char *buffer, size_t size, uint32_t timeout);
+// Maps the named shared memory of size bytes, created by the writer.
+// Returns NULL on errors.
+void *colibriSharedMemoryMap(const char *name, size_t size, bool isWriter, HANDLE *handle);
+void colibriSharedMemoryUnmap(void *memory, size_t size, HANDLE handle);
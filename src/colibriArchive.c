@@ -0,0 +1,412 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "colibriArchive.h"
+#include "system.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARCHIVE_ALIGN(x) (((x) + COLIBRI_ARCHIVE_ALIGNMENT - 1) & ~((uint64_t)COLIBRI_ARCHIVE_ALIGNMENT - 1))
+#define ARCHIVE_RAW_COLUMNS (ROLE_COUNT * WAVELENGTH_COUNT * 2)
+
+static void sectionSizes(uint64_t count, uint64_t stringsSize, uint64_t sizes[ARCHIVE_SECTION_COUNT])
+{
+    sizes[ARCHIVE_SECTION_RECORDS] = count * sizeof(ArchiveRecord_t);
+    sizes[ARCHIVE_SECTION_RAW] = count * ARCHIVE_RAW_COLUMNS * sizeof(uint32_t);
+    sizes[ARCHIVE_SECTION_LEVELLING] = count * WAVELENGTH_COUNT * sizeof(ArchiveLevelling_t);
+    sizes[ARCHIVE_SECTION_CALCULATED] = count * (WAVELENGTH_COUNT + 1) * sizeof(double);
+    sizes[ARCHIVE_SECTION_STRINGS] = stringsSize;
+}
+
+static const uint32_t *rawColumn(const char *base, const ArchiveHeader_t *header, int role, int w, int reference)
+{
+    size_t column = (role * WAVELENGTH_COUNT + w) * 2 + reference;
+
+    return (const uint32_t *)(base + header->offsets[ARCHIVE_SECTION_RAW]) + column * header->count;
+}
+
+static bool validString(uint32_t offset, uint64_t stringsSize)
+{
+    return offset == DATA_NO_STRING || offset < stringsSize;
+}
+
+static uint32_t archiveString(const char *strings, uint32_t offset, DataFile_t *data, bool copy)
+{
+    return (copy && offset != DATA_NO_STRING) ? dataFileAddString(data, strings + offset) : offset;
+}
+
+bool colibriArchiveProbe(const char *file)
+{
+    char magic[8];
+    FILE *fin = fopen(file, "rb");
+    bool ret = false;
+
+    if (fin)
+    {
+        ret = fread(magic, 1, sizeof(magic), fin) == sizeof(magic) && memcmp(magic, COLIBRI_ARCHIVE_MAGIC, sizeof(magic)) == 0;
+        fclose(fin);
+    }
+    return ret;
+}
+
+static bool validHeader(const ArchiveHeader_t *header, size_t size)
+{
+    uint64_t sizes[ARCHIVE_SECTION_COUNT];
+
+    if (size < sizeof(ArchiveHeader_t) ||
+        memcmp(header->magic, COLIBRI_ARCHIVE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != COLIBRI_ARCHIVE_VERSION ||
+        header->byteOrder != COLIBRI_ARCHIVE_BYTE_ORDER ||
+        header->count > size / sizeof(ArchiveRecord_t) ||
+        header->stringsSize > size)
+    {
+        return false;
+    }
+
+    sectionSizes(header->count, header->stringsSize, sizes);
+    for (int section = 0; section < ARCHIVE_SECTION_COUNT; section++)
+    {
+        uint64_t offset = header->offsets[section];
+
+        if (offset % COLIBRI_ARCHIVE_ALIGNMENT != 0 || offset > size || sizes[section] > size - offset)
+        {
+            return false;
+        }
+    }
+
+    if (!validString(header->serialNumber, header->stringsSize) || !validString(header->firmwareVersion, header->stringsSize))
+    {
+        return false;
+    }
+
+    // Every string offset below stringsSize must end at a terminator.
+    return header->stringsSize == 0 || ((const char *)header)[header->offsets[ARCHIVE_SECTION_STRINGS] + header->stringsSize - 1] == '\0';
+}
+
+// Decodes the records first .. first + count - 1 into the records
+// 0 .. count - 1 of data. With copyStrings the strings are added to data,
+// otherwise data holds the whole strings section and the offsets are kept.
+static Error_t decodeRange(const char *base, const ArchiveHeader_t *header, size_t first, size_t count, DataFile_t *data, bool copyStrings)
+{
+    const char *strings = base + header->offsets[ARCHIVE_SECTION_STRINGS];
+    const ArchiveRecord_t *records = (const ArchiveRecord_t *)(base + header->offsets[ARCHIVE_SECTION_RECORDS]) + first;
+    const ArchiveLevelling_t *levelling = (const ArchiveLevelling_t *)(base + header->offsets[ARCHIVE_SECTION_LEVELLING]) + first * WAVELENGTH_COUNT;
+    const double *calculated = (const double *)(base + header->offsets[ARCHIVE_SECTION_CALCULATED]) + first;
+    size_t total = (size_t)header->count;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        Record_t *record = &data->records[i];
+        uint32_t flags = records[i].flags;
+
+        if (!validString(records[i].comment, header->stringsSize) || !validString(records[i].timestamp, header->stringsSize))
+        {
+            return ERROR_COLIBRI_INVALID_FILE_FORMAT;
+        }
+
+        data->measurements.hasAir[i] = (flags & ARCHIVE_RECORD_AIR) != 0;
+        record->node = NULL;
+        record->hasLevelling = (flags & ARCHIVE_RECORD_LEVELLING) != 0;
+        record->hasCalculated = (flags & ARCHIVE_RECORD_CALCULATED) != 0;
+        record->hasOD = (flags & ARCHIVE_RECORD_OD) != 0;
+        record->hasConcentration = (flags & ARCHIVE_RECORD_CONCENTRATION) != 0;
+        record->comment = archiveString(strings, records[i].comment, data, copyStrings);
+        record->timestamp = archiveString(strings, records[i].timestamp, data, copyStrings);
+
+        for (int w = 0; w < WAVELENGTH_COUNT; w++)
+        {
+            const ArchiveLevelling_t *channel = &levelling[i * WAVELENGTH_COUNT + w];
+
+            if (!validString(channel->resultText, header->stringsSize))
+            {
+                return ERROR_COLIBRI_INVALID_FILE_FORMAT;
+            }
+            record->levelling[w].amplificationSample = channel->amplificationSample;
+            record->levelling[w].amplificationReference = channel->amplificationReference;
+            record->levelling[w].current = channel->current;
+            record->levelling[w].result = channel->result;
+            record->levelling[w].resultText = archiveString(strings, channel->resultText, data, copyStrings);
+        }
+    }
+
+    for (int role = 0; role < ROLE_COUNT; role++)
+    {
+        for (int w = 0; w < WAVELENGTH_COUNT; w++)
+        {
+            const uint32_t *sample = rawColumn(base, header, role, w, 0) + first;
+            const uint32_t *reference = rawColumn(base, header, role, w, 1) + first;
+            double *sampleOut = data->measurements.sample[role][w];
+            double *referenceOut = data->measurements.reference[role][w];
+
+            for (size_t i = 0; i < count; i++)
+            {
+                sampleOut[i] = sample[i];
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                referenceOut[i] = reference[i];
+            }
+        }
+    }
+
+    for (int w = 0; w < WAVELENGTH_COUNT; w++)
+    {
+        memcpy(data->calculated.od[w], calculated + w * total, count * sizeof(double));
+    }
+    memcpy(data->calculated.concentration, calculated + WAVELENGTH_COUNT * total, count * sizeof(double));
+
+    return ERROR_COLIBRI_OK;
+}
+
+static Error_t archiveDecode(const char *base, size_t size, DataFile_t *data)
+{
+    const ArchiveHeader_t *header = (const ArchiveHeader_t *)base;
+    size_t count;
+    Error_t ret;
+
+    if (!validHeader(header, size))
+    {
+        return ERROR_COLIBRI_INVALID_FILE_FORMAT;
+    }
+
+    count = (size_t)header->count;
+    if (!dataFileCreate(data, count))
+    {
+        return ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+
+    if (header->stringsSize)
+    {
+        data->strings = malloc(header->stringsSize);
+        if (data->strings == NULL)
+        {
+            dataFileFree(data);
+            return ERROR_COLIBRI_OUT_OF_MEMORY;
+        }
+        memcpy(data->strings, base + header->offsets[ARCHIVE_SECTION_STRINGS], header->stringsSize);
+        data->stringsSize = header->stringsSize;
+        data->stringsCapacity = header->stringsSize;
+    }
+    data->serialNumber = header->serialNumber;
+    data->firmwareVersion = header->firmwareVersion;
+
+    ret = decodeRange(base, header, 0, count, data, false);
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        dataFileFree(data);
+    }
+    return ret;
+}
+
+Error_t colibriArchiveLoad(const char *file, DataFile_t *data)
+{
+    MappedFile_t map;
+    Error_t ret;
+
+    if (!systemMapFile(&map, file))
+    {
+        return ERROR_COLIBRI_FILE_NOT_FOUND;
+    }
+
+    ret = archiveDecode(map.data, map.size, data);
+
+    systemUnmapFile(&map);
+    return ret;
+}
+
+Error_t colibriArchiveOpen(ColibriArchive_t *self, const char *file)
+{
+    if (!systemMapFile(&self->map, file))
+    {
+        return ERROR_COLIBRI_FILE_NOT_FOUND;
+    }
+
+    self->header = self->map.data;
+    if (!validHeader(self->header, self->map.size))
+    {
+        systemUnmapFile(&self->map);
+        return ERROR_COLIBRI_INVALID_FILE_FORMAT;
+    }
+    self->count = (size_t)self->header->count;
+    return ERROR_COLIBRI_OK;
+}
+
+const char *colibriArchiveString(const ColibriArchive_t *self, uint32_t offset)
+{
+    return offset == DATA_NO_STRING ? NULL : (const char *)self->map.data + self->header->offsets[ARCHIVE_SECTION_STRINGS] + offset;
+}
+
+Error_t colibriArchiveRead(const ColibriArchive_t *self, size_t first, size_t count, DataFile_t *data)
+{
+    if (first > self->count || count > self->count - first || count > data->count)
+    {
+        return ERROR_COLIBRI_INVALID_PARAMETER;
+    }
+    return decodeRange(self->map.data, self->header, first, count, data, true);
+}
+
+void colibriArchiveClose(ColibriArchive_t *self)
+{
+    systemUnmapFile(&self->map);
+}
+
+static bool writeSection(FILE *fout, uint64_t *position, uint64_t offset, const void *data, size_t size)
+{
+    static const char zeros[COLIBRI_ARCHIVE_ALIGNMENT] = {0};
+    size_t padding = (size_t)(offset - *position);
+
+    *position = offset + size;
+    return fwrite(zeros, 1, padding, fout) == padding && fwrite(data, 1, size, fout) == size;
+}
+
+static bool rawToUint32(const double *values, size_t count, uint32_t *out)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        // Also false for NAN
+        if (!(values[i] >= 0.0 && values[i] <= (double)UINT32_MAX) || (double)(uint32_t)values[i] != values[i])
+        {
+            return false;
+        }
+        out[i] = (uint32_t)values[i];
+    }
+    return true;
+}
+
+static void layout(ArchiveHeader_t *header, const DataFile_t *data)
+{
+    uint64_t sizes[ARCHIVE_SECTION_COUNT];
+    uint64_t offset = ARCHIVE_ALIGN(sizeof(ArchiveHeader_t));
+
+    memset(header, 0, sizeof(ArchiveHeader_t));
+    memcpy(header->magic, COLIBRI_ARCHIVE_MAGIC, sizeof(header->magic));
+    header->version = COLIBRI_ARCHIVE_VERSION;
+    header->byteOrder = COLIBRI_ARCHIVE_BYTE_ORDER;
+    header->count = data->count;
+    header->serialNumber = data->serialNumber;
+    header->firmwareVersion = data->firmwareVersion;
+    header->stringsSize = data->stringsSize;
+
+    sectionSizes(header->count, header->stringsSize, sizes);
+    for (int section = 0; section < ARCHIVE_SECTION_COUNT; section++)
+    {
+        header->offsets[section] = offset;
+        offset = ARCHIVE_ALIGN(offset + sizes[section]);
+    }
+}
+
+static Error_t archiveWrite(FILE *fout, const DataFile_t *data, void *scratch)
+{
+    ArchiveHeader_t header;
+    ArchiveRecord_t *records = scratch;
+    ArchiveLevelling_t *levelling = scratch;
+    uint32_t *column = scratch;
+    uint64_t position = 0;
+    size_t count = data->count;
+    bool ok;
+
+    layout(&header, data);
+    ok = writeSection(fout, &position, 0, &header, sizeof(header));
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const Record_t *record = &data->records[i];
+
+        records[i].flags = (data->measurements.hasAir[i] ? ARCHIVE_RECORD_AIR : 0) |
+                           (record->hasLevelling ? ARCHIVE_RECORD_LEVELLING : 0) |
+                           (record->hasCalculated ? ARCHIVE_RECORD_CALCULATED : 0) |
+                           (record->hasOD ? ARCHIVE_RECORD_OD : 0) |
+                           (record->hasConcentration ? ARCHIVE_RECORD_CONCENTRATION : 0);
+        records[i].comment = record->comment;
+        records[i].timestamp = record->timestamp;
+        records[i].reserved = 0;
+    }
+    ok = ok && writeSection(fout, &position, header.offsets[ARCHIVE_SECTION_RECORDS], records, count * sizeof(ArchiveRecord_t));
+
+    for (int role = 0; role < ROLE_COUNT && ok; role++)
+    {
+        for (int w = 0; w < WAVELENGTH_COUNT && ok; w++)
+        {
+            if (!rawToUint32(data->measurements.sample[role][w], count, column) ||
+                !rawToUint32(data->measurements.reference[role][w], count, column + count))
+            {
+                return ERROR_COLIBRI_INVALID_NUMBER;
+            }
+            ok = writeSection(fout, &position, role == 0 && w == 0 ? header.offsets[ARCHIVE_SECTION_RAW] : position, column, 2 * count * sizeof(uint32_t));
+        }
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        for (int w = 0; w < WAVELENGTH_COUNT; w++)
+        {
+            const LevellingChannel_t *channel = &data->records[i].levelling[w];
+            ArchiveLevelling_t *out = &levelling[i * WAVELENGTH_COUNT + w];
+
+            out->amplificationSample = channel->amplificationSample;
+            out->amplificationReference = channel->amplificationReference;
+            out->current = channel->current;
+            out->result = channel->result;
+            out->resultText = channel->resultText;
+            out->reserved = 0;
+        }
+    }
+    ok = ok && writeSection(fout, &position, header.offsets[ARCHIVE_SECTION_LEVELLING], levelling, count * WAVELENGTH_COUNT * sizeof(ArchiveLevelling_t));
+
+    for (int w = 0; w < WAVELENGTH_COUNT; w++)
+    {
+        ok = ok && writeSection(fout, &position, w == 0 ? header.offsets[ARCHIVE_SECTION_CALCULATED] : position, data->calculated.od[w], count * sizeof(double));
+    }
+    ok = ok && writeSection(fout, &position, position, data->calculated.concentration, count * sizeof(double));
+
+    ok = ok && writeSection(fout, &position, header.offsets[ARCHIVE_SECTION_STRINGS], data->strings, data->stringsSize);
+
+    return ok ? ERROR_COLIBRI_OK : ERROR_COLIBRI_FILE_WRITE_ERROR;
+}
+
+// Like colibriJsonSave() the archive is written to FILE.tmp which then
+// replaces FILE.
+Error_t colibriArchiveSave(const char *file, const DataFile_t *data)
+{
+    Error_t ret;
+    FILE *fout;
+    size_t size = strlen(file) + sizeof(".tmp");
+    char *tempFile = malloc(size);
+    // The levelling section is the largest one built in memory.
+    void *scratch = malloc((data->count ? data->count : 1) * WAVELENGTH_COUNT * sizeof(ArchiveLevelling_t));
+
+    if (scratch == NULL || tempFile == NULL)
+    {
+        free(scratch);
+        free(tempFile);
+        return ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+    snprintf(tempFile, size, "%s.tmp", file);
+
+    fout = fopen(tempFile, "wb");
+    if (fout == NULL)
+    {
+        free(scratch);
+        free(tempFile);
+        return ERROR_COLIBRI_FILE_WRITE_ERROR;
+    }
+
+    ret = archiveWrite(fout, data, scratch);
+    if (fclose(fout) != 0 && ret == ERROR_COLIBRI_OK)
+    {
+        ret = ERROR_COLIBRI_FILE_WRITE_ERROR;
+    }
+    if (ret == ERROR_COLIBRI_OK && !systemReplaceFile(tempFile, file))
+    {
+        ret = ERROR_COLIBRI_FILE_WRITE_ERROR;
+    }
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        remove(tempFile);
+    }
+
+    free(scratch);
+    free(tempFile);
+    return ret;
+}
@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#pragma once
+
+#include "colibri.h"
+#include "colibriData.h"
+#include "system.h"
+
+// Binary archive of a data file. All values are little endian, every section
+// starts at a multiple of COLIBRI_ARCHIVE_ALIGNMENT.
+//
+//   ArchiveHeader_t
+//   records     ArchiveRecord_t[count]                  record index
+//   raw         uint32_t[ROLE][WAVELENGTH][2][count]    sample and reference columns
+//   levelling   ArchiveLevelling_t[count][WAVELENGTH]
+//   calculated  double[WAVELENGTH + 1][count]           od columns and concentration
+//   strings     zero terminated strings, referenced by offset
+//
+// The air columns of records without an air measurement are 1.
+
+#define COLIBRI_ARCHIVE_MAGIC "COLIBRI\x1a"
+#define COLIBRI_ARCHIVE_VERSION 2
+#define COLIBRI_ARCHIVE_BYTE_ORDER 0x01020304u
+#define COLIBRI_ARCHIVE_ALIGNMENT 64
+
+typedef enum
+{
+    ARCHIVE_SECTION_RECORDS = 0,
+    ARCHIVE_SECTION_RAW = 1,
+    ARCHIVE_SECTION_LEVELLING = 2,
+    ARCHIVE_SECTION_CALCULATED = 3,
+    ARCHIVE_SECTION_STRINGS = 4,
+    ARCHIVE_SECTION_COUNT = 5,
+} ArchiveSection_t;
+
+typedef enum
+{
+    ARCHIVE_RECORD_AIR = 0x01,
+    ARCHIVE_RECORD_LEVELLING = 0x02,
+    ARCHIVE_RECORD_CALCULATED = 0x04,
+    ARCHIVE_RECORD_OD = 0x08,
+    ARCHIVE_RECORD_CONCENTRATION = 0x10,
+} ArchiveRecordFlags_t;
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t count;
+    uint32_t serialNumber;
+    uint32_t firmwareVersion;
+    uint64_t stringsSize;
+    uint64_t offsets[ARCHIVE_SECTION_COUNT];
+} ArchiveHeader_t;
+
+typedef struct
+{
+    uint32_t flags;
+    uint32_t comment;
+    uint32_t timestamp;
+    uint32_t reserved;
+} ArchiveRecord_t;
+
+typedef struct
+{
+    double amplificationSample;
+    double amplificationReference;
+    double current;
+    double result;
+    uint32_t resultText;
+    uint32_t reserved;
+} ArchiveLevelling_t;
+
+bool colibriArchiveProbe(const char *file);
+Error_t colibriArchiveLoad(const char *file, DataFile_t *data);
+Error_t colibriArchiveSave(const char *file, const DataFile_t *data);
+
+// Archive mapped into memory for reading ranges of records without loading
+// the whole file.
+typedef struct
+{
+    MappedFile_t map;
+    const ArchiveHeader_t *header;
+    size_t count;
+} ColibriArchive_t;
+
+Error_t colibriArchiveOpen(ColibriArchive_t *self, const char *file);
+const char *colibriArchiveString(const ColibriArchive_t *self, uint32_t offset);
+// Decodes count records starting at first into the first count records of
+// data, which must have room for them. The strings are added to data.
+Error_t colibriArchiveRead(const ColibriArchive_t *self, size_t first, size_t count, DataFile_t *data);
+void colibriArchiveClose(ColibriArchive_t *self);
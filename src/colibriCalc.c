@@ -0,0 +1,293 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "colibriCalc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(_MSC_VER)
+#define restrict __restrict
+#endif
+
+// The kernels in this file are plain loops over restrict qualified columns so
+// that the compiler can vectorize them. The CMake option COLIBRI_VECTOR_MATH
+// only compiles this file with -O3 and AVX2; log10 stays the scalar libm call
+// and the results are bit identical to the per measurement calculation.
+
+bool measurementsCreate(Measurements_t *self, size_t count)
+{
+    size_t columns = 2 * ROLE_COUNT * WAVELENGTH_COUNT;
+    double *block;
+
+    memset(self, 0, sizeof(Measurements_t));
+
+    block = malloc((count ? count : 1) * (columns * sizeof(double) + sizeof(bool)));
+    if (block == NULL)
+    {
+        return false;
+    }
+
+    for (int role = 0; role < ROLE_COUNT; role++)
+    {
+        for (int w = 0; w < WAVELENGTH_COUNT; w++)
+        {
+            self->sample[role][w] = block;
+            block += count;
+            self->reference[role][w] = block;
+            block += count;
+        }
+    }
+    self->hasAir = (bool *)block;
+    self->count = count;
+
+    return true;
+}
+
+void measurementsFree(Measurements_t *self)
+{
+    free(self->sample[0][0]);
+    memset(self, 0, sizeof(Measurements_t));
+}
+
+bool resultsCreate(Results_t *self, size_t count)
+{
+    double *block;
+
+    memset(self, 0, sizeof(Results_t));
+
+    block = malloc((count ? count : 1) * (WAVELENGTH_COUNT + 1) * sizeof(double));
+    if (block == NULL)
+    {
+        return false;
+    }
+
+    for (int w = 0; w < WAVELENGTH_COUNT; w++)
+    {
+        self->od[w] = block + w * count;
+    }
+    self->concentration = block + WAVELENGTH_COUNT * count;
+    self->count = count;
+
+    return true;
+}
+
+void resultsFree(Results_t *self)
+{
+    free(self->od[0]);
+    memset(self, 0, sizeof(Results_t));
+}
+
+void calcOD(const double *restrict baselineSample, const double *restrict baselineReference, const double *restrict sample, const double *restrict reference, double *restrict od, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        od[i] = log10(baselineSample[i] / baselineReference[i] * reference[i] / sample[i]);
+    }
+}
+
+static void calcAirCorrection(const double *restrict odSample, const double *restrict odAir, const bool *restrict hasAir, double factor, double *restrict od, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        od[i] = hasAir[i] ? odSample[i] - odAir[i] * factor : odSample[i];
+    }
+}
+
+static void calcConcentration(const double *restrict od260, const bool *restrict hasAir, double pathLength, double a260Unit, double *restrict concentration, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        concentration[i] = hasAir[i] ? od260[i] * 10.0 / pathLength * a260Unit : NAN;
+    }
+}
+
+static void calcODs(const Measurements_t *m, Role_t role, Wavelength_t w, size_t count, double *od)
+{
+    calcOD(m->sample[ROLE_BASELINE][w], m->reference[ROLE_BASELINE][w], m->sample[role][w], m->reference[role][w], od, count);
+}
+
+// Optical density of a single measurement, the same expression as calcOD
+static double calcODAt(const Measurements_t *m, Role_t role, Wavelength_t w, size_t i)
+{
+    return log10(m->sample[ROLE_BASELINE][w][i] / m->reference[ROLE_BASELINE][w][i] * m->reference[role][w][i] / m->sample[role][w][i]);
+}
+
+void calcFactors(const Measurements_t *measurements, uint32_t blanks, double factors[WAVELENGTH_COUNT])
+{
+    size_t count = blanks < measurements->count ? blanks : measurements->count;
+
+    for (int w = 0; w < WAVELENGTH_COUNT; w++)
+    {
+        size_t nrOfAir = 0;
+        double sum = 0.0;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if (measurements->hasAir[i])
+            {
+                sum = sum + calcODAt(measurements, ROLE_SAMPLE, w, i) / calcODAt(measurements, ROLE_AIR, w, i);
+                nrOfAir++;
+            }
+        }
+        factors[w] = nrOfAir ? sum / (double)nrOfAir : 1.0;
+    }
+}
+
+bool calcResults(const Measurements_t *measurements, const double factors[WAVELENGTH_COUNT], double pathLength, double a260Unit, Results_t *results)
+{
+    size_t count = measurements->count;
+    double *odSample = malloc((count ? count : 1) * 2 * sizeof(double));
+    double *odAir;
+
+    if (odSample == NULL)
+    {
+        return false;
+    }
+    odAir = odSample + count;
+
+    for (int w = 0; w < WAVELENGTH_COUNT; w++)
+    {
+        calcODs(measurements, ROLE_SAMPLE, w, count, odSample);
+        calcODs(measurements, ROLE_AIR, w, count, odAir);
+        calcAirCorrection(odSample, odAir, measurements->hasAir, factors[w], results->od[w], count);
+    }
+    calcConcentration(results->od[WAVELENGTH_260], measurements->hasAir, pathLength, a260Unit, results->concentration, count);
+
+    free(odSample);
+    return true;
+}
+
+bool calcSweepCreate(CalcSweep_t *self, const Measurements_t *measurements)
+{
+    size_t count = measurements->count;
+    double *block;
+
+    memset(self, 0, sizeof(CalcSweep_t));
+
+    block = malloc((3 * count + 1) * WAVELENGTH_COUNT * sizeof(double));
+    self->airCounts = malloc((count + 1) * sizeof(size_t));
+    if (block == NULL || self->airCounts == NULL)
+    {
+        free(block);
+        free(self->airCounts);
+        return false;
+    }
+
+    self->airCounts[0] = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        self->airCounts[i + 1] = self->airCounts[i] + (measurements->hasAir[i] ? 1 : 0);
+    }
+
+    for (int w = 0; w < WAVELENGTH_COUNT; w++)
+    {
+        double *odSample = block;
+        double *odAir = block + count;
+        double *ratioSums = block + 2 * count;
+
+        calcODs(measurements, ROLE_SAMPLE, w, count, odSample);
+        calcODs(measurements, ROLE_AIR, w, count, odAir);
+
+        ratioSums[0] = 0.0;
+        for (size_t i = 0; i < count; i++)
+        {
+            ratioSums[i + 1] = measurements->hasAir[i] ? ratioSums[i] + odSample[i] / odAir[i] : ratioSums[i];
+        }
+
+        self->odSample[w] = odSample;
+        self->odAir[w] = odAir;
+        self->ratioSums[w] = ratioSums;
+        block += 3 * count + 1;
+    }
+
+    self->hasAir = measurements->hasAir;
+    self->count = count;
+    return true;
+}
+
+void calcSweepFree(CalcSweep_t *self)
+{
+    free(self->odSample[0]);
+    free(self->airCounts);
+    memset(self, 0, sizeof(CalcSweep_t));
+}
+
+void calcSweepFactors(const CalcSweep_t *self, uint32_t blanks, double factors[WAVELENGTH_COUNT])
+{
+    size_t count = blanks < self->count ? blanks : self->count;
+    size_t nrOfAir = self->airCounts[count];
+
+    for (int w = 0; w < WAVELENGTH_COUNT; w++)
+    {
+        factors[w] = nrOfAir ? self->ratioSums[w][count] / (double)nrOfAir : 1.0;
+    }
+}
+
+void calcSweepODs(const CalcSweep_t *self, const double factors[WAVELENGTH_COUNT], Results_t *results)
+{
+    for (int w = 0; w < WAVELENGTH_COUNT; w++)
+    {
+        calcAirCorrection(self->odSample[w], self->odAir[w], self->hasAir, factors[w], results->od[w], self->count);
+    }
+}
+
+void calcSweepConcentration(const CalcSweep_t *self, double pathLength, double a260Unit, Results_t *results)
+{
+    calcConcentration(results->od[WAVELENGTH_260], self->hasAir, pathLength, a260Unit, results->concentration, self->count);
+}
+
+void calcBlanksInit(CalcBlanks_t *self)
+{
+    memset(self, 0, sizeof(CalcBlanks_t));
+}
+
+void calcBlanksAdd(CalcBlanks_t *self, const Measurements_t *measurements, size_t count, size_t first, size_t blanks)
+{
+    for (size_t i = 0; i < count && first + i < blanks; i++)
+    {
+        if (measurements->hasAir[i])
+        {
+            for (int w = 0; w < WAVELENGTH_COUNT; w++)
+            {
+                double odSample;
+                double odAir;
+
+                calcOD(measurements->sample[ROLE_BASELINE][w] + i, measurements->reference[ROLE_BASELINE][w] + i, measurements->sample[ROLE_SAMPLE][w] + i, measurements->reference[ROLE_SAMPLE][w] + i, &odSample, 1);
+                calcOD(measurements->sample[ROLE_BASELINE][w] + i, measurements->reference[ROLE_BASELINE][w] + i, measurements->sample[ROLE_AIR][w] + i, measurements->reference[ROLE_AIR][w] + i, &odAir, 1);
+                self->ratioSums[w] = self->ratioSums[w] + odSample / odAir;
+            }
+            self->nrOfAir++;
+        }
+    }
+}
+
+void calcBlanksFactors(const CalcBlanks_t *self, double factors[WAVELENGTH_COUNT])
+{
+    for (int w = 0; w < WAVELENGTH_COUNT; w++)
+    {
+        factors[w] = self->nrOfAir ? self->ratioSums[w] / (double)self->nrOfAir : 1.0;
+    }
+}
+
+void statisticsInit(Statistics_t *self)
+{
+    self->count = 0;
+    self->mean = 0.0;
+    self->m2 = 0.0;
+}
+
+void statisticsAdd(Statistics_t *self, double value)
+{
+    double delta = value - self->mean;
+
+    self->count++;
+    self->mean += delta / (double)self->count;
+    self->m2 += delta * (value - self->mean);
+}
+
+// Sample standard deviation, NAN for less than two values.
+double statisticsStdDev(const Statistics_t *self)
+{
+    return self->count > 1 ? sqrt(self->m2 / (double)(self->count - 1)) : NAN;
+}
@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum
+{
+    WAVELENGTH_230 = 0,
+    WAVELENGTH_260 = 1,
+    WAVELENGTH_280 = 2,
+    WAVELENGTH_340 = 3,
+    WAVELENGTH_COUNT = 4,
+} Wavelength_t;
+
+typedef enum
+{
+    ROLE_BASELINE = 0,
+    ROLE_AIR = 1,
+    ROLE_SAMPLE = 2,
+    ROLE_COUNT = 3,
+} Role_t;
+
+// Raw values of all measurements in a data file, stored as one contiguous
+// column per role and wavelength. Measurements without an air measurement
+// have their air columns set to 1.0.
+typedef struct
+{
+    size_t count;
+    bool *hasAir;
+    double *sample[ROLE_COUNT][WAVELENGTH_COUNT];
+    double *reference[ROLE_COUNT][WAVELENGTH_COUNT];
+} Measurements_t;
+
+// Calculated values, one column per wavelength. The concentration is NAN
+// for measurements without an air measurement.
+typedef struct
+{
+    size_t count;
+    double *od[WAVELENGTH_COUNT];
+    double *concentration;
+} Results_t;
+
+// Running mean and variance (Welford). Adding a value is numerically stable
+// and needs no memory besides the accumulator.
+typedef struct
+{
+    uint64_t count;
+    double mean;
+    double m2;
+} Statistics_t;
+
+// Shared work of a parameter sweep: the optical densities of the sample
+// and air measurements against the baseline, and running sums of their
+// ratios from which the factors for any number of blanks follow directly.
+typedef struct
+{
+    size_t count;
+    double *odSample[WAVELENGTH_COUNT];
+    double *odAir[WAVELENGTH_COUNT];
+    double *ratioSums[WAVELENGTH_COUNT];
+    size_t *airCounts;
+    const bool *hasAir;
+} CalcSweep_t;
+
+// Blank factors summed up measurement by measurement, for measurements which
+// are not all in memory at once.
+typedef struct
+{
+    double ratioSums[WAVELENGTH_COUNT];
+    size_t nrOfAir;
+} CalcBlanks_t;
+
+bool measurementsCreate(Measurements_t *self, size_t count);
+void measurementsFree(Measurements_t *self);
+
+bool resultsCreate(Results_t *self, size_t count);
+void resultsFree(Results_t *self);
+
+void calcOD(const double *baselineSample, const double *baselineReference, const double *sample, const double *reference, double *od, size_t count);
+// The factor of a wavelength is the mean of OD sample / OD air over the
+// measurements with air among the first blanks, summed in the order of the
+// measurements. The sweep and CalcBlanks_t sum in this order too, so their
+// factors are the same to the bit.
+void calcFactors(const Measurements_t *measurements, uint32_t blanks, double factors[WAVELENGTH_COUNT]);
+bool calcResults(const Measurements_t *measurements, const double factors[WAVELENGTH_COUNT], double pathLength, double a260Unit, Results_t *results);
+
+// The results equal calcFactors() and calcResults() with the same parameters.
+bool calcSweepCreate(CalcSweep_t *self, const Measurements_t *measurements);
+void calcSweepFree(CalcSweep_t *self);
+void calcSweepFactors(const CalcSweep_t *self, uint32_t blanks, double factors[WAVELENGTH_COUNT]);
+void calcSweepODs(const CalcSweep_t *self, const double factors[WAVELENGTH_COUNT], Results_t *results);
+void calcSweepConcentration(const CalcSweep_t *self, double pathLength, double a260Unit, Results_t *results);
+
+void calcBlanksInit(CalcBlanks_t *self);
+// Adds the count measurements which are among the first blanks of all
+// measurements, first is the index of measurements[0] among all.
+void calcBlanksAdd(CalcBlanks_t *self, const Measurements_t *measurements, size_t count, size_t first, size_t blanks);
+void calcBlanksFactors(const CalcBlanks_t *self, double factors[WAVELENGTH_COUNT]);
+
+void statisticsInit(Statistics_t *self);
+void statisticsAdd(Statistics_t *self, double value);
+double statisticsStdDev(const Statistics_t *self);
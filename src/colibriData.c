@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "colibriData.h"
+#include <stdlib.h>
+#include <string.h>
+
+bool dataFileCreate(DataFile_t *self, size_t count)
+{
+    memset(self, 0, sizeof(DataFile_t));
+
+    self->serialNumber = DATA_NO_STRING;
+    self->firmwareVersion = DATA_NO_STRING;
+    self->records = calloc(count ? count : 1, sizeof(Record_t));
+    if (self->records == NULL)
+    {
+        return false;
+    }
+
+    if (!measurementsCreate(&self->measurements, count))
+    {
+        dataFileFree(self);
+        return false;
+    }
+
+    if (!resultsCreate(&self->calculated, count))
+    {
+        dataFileFree(self);
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        self->records[i].comment = DATA_NO_STRING;
+        self->records[i].timestamp = DATA_NO_STRING;
+        for (int w = 0; w < WAVELENGTH_COUNT; w++)
+        {
+            self->records[i].levelling[w].resultText = DATA_NO_STRING;
+        }
+    }
+    self->count = count;
+
+    return true;
+}
+
+void dataFileFree(DataFile_t *self)
+{
+    free(self->records);
+    free(self->strings);
+    measurementsFree(&self->measurements);
+    resultsFree(&self->calculated);
+    memset(self, 0, sizeof(DataFile_t));
+}
+
+uint32_t dataFileAddString(DataFile_t *self, const char *s)
+{
+    size_t length = strlen(s) + 1;
+    uint32_t offset = (uint32_t)self->stringsSize;
+
+    if (self->stringsSize + length > self->stringsCapacity)
+    {
+        size_t capacity = self->stringsCapacity ? self->stringsCapacity : 256;
+        char *strings;
+
+        while (self->stringsSize + length > capacity)
+        {
+            capacity *= 2;
+        }
+
+        strings = realloc(self->strings, capacity);
+        if (strings == NULL)
+        {
+            return DATA_NO_STRING;
+        }
+        self->strings = strings;
+        self->stringsCapacity = capacity;
+    }
+
+    memcpy(self->strings + self->stringsSize, s, length);
+    self->stringsSize += length;
+
+    return offset;
+}
+
+const char *dataFileString(const DataFile_t *self, uint32_t offset)
+{
+    return offset == DATA_NO_STRING ? NULL : self->strings + offset;
+}
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#pragma once
+
+#include "colibriCalc.h"
+#include "cJSON.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DATA_NO_STRING UINT32_MAX
+
+typedef struct
+{
+    double amplificationSample;
+    double amplificationReference;
+    double current;
+    double result;
+    uint32_t resultText;
+} LevellingChannel_t;
+
+// One measurement of a data file. The raw values are stored in the columns
+// of DataFile_t.measurements and the calculated values stored in the file
+// in the columns of DataFile_t.calculated, both at the index of the record.
+// node is the JSON object the record was decoded from, if any. timestamp is
+// the UTC time of the save in ISO 8601 format, e.g. 2024-05-01T12:00:00Z.
+typedef struct
+{
+    cJSON *node;
+    uint32_t comment;
+    uint32_t timestamp;
+    bool hasLevelling;
+    bool hasCalculated;
+    bool hasOD;
+    bool hasConcentration;
+    LevellingChannel_t levelling[WAVELENGTH_COUNT];
+} Record_t;
+
+typedef struct
+{
+    uint32_t serialNumber;
+    uint32_t firmwareVersion;
+    size_t count;
+    Record_t *records;
+    Measurements_t measurements;
+    Results_t calculated;
+    char *strings;
+    size_t stringsSize;
+    size_t stringsCapacity;
+} DataFile_t;
+
+bool dataFileCreate(DataFile_t *self, size_t count);
+void dataFileFree(DataFile_t *self);
+uint32_t dataFileAddString(DataFile_t *self, const char *s);
+const char *dataFileString(const DataFile_t *self, uint32_t offset);
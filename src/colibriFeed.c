@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "colibriFeed.h"
+#include <string.h>
+#include <time.h>
+
+// Release stores and acquire loads. With MSVC volatile accesses have these
+// semantics already.
+#if defined(_MSC_VER)
+#define FEED_LOAD(p) (*(p))
+#define FEED_STORE(p, v) (*(p) = (v))
+#define FEED_FENCE() MemoryBarrier()
+#else
+#define FEED_LOAD(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define FEED_STORE(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define FEED_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+static bool isInitialized(const ColibriFeedRing_t *ring)
+{
+    return FEED_LOAD(&ring->magic) == COLIBRI_FEED_MAGIC && ring->version == COLIBRI_FEED_VERSION &&
+           ring->slotCount == COLIBRI_FEED_SLOTS && ring->recordSize == sizeof(ColibriFeedRecord_t);
+}
+
+Error_t colibriFeedCreate(ColibriFeed_t *self, const char *name)
+{
+    memset(self, 0, sizeof(ColibriFeed_t));
+    self->ring = colibriSharedMemoryMap(name, sizeof(ColibriFeedRing_t), true, &self->handle);
+    if (self->ring == NULL)
+    {
+        return ERROR_COLIBRI_FILE_WRITE_ERROR;
+    }
+
+    if (!isInitialized(self->ring))
+    {
+        memset(self->ring, 0, sizeof(ColibriFeedRing_t));
+        self->ring->version = COLIBRI_FEED_VERSION;
+        self->ring->slotCount = COLIBRI_FEED_SLOTS;
+        self->ring->recordSize = sizeof(ColibriFeedRecord_t);
+        FEED_STORE(&self->ring->magic, COLIBRI_FEED_MAGIC);
+    }
+    return ERROR_COLIBRI_OK;
+}
+
+Error_t colibriFeedOpen(ColibriFeed_t *self, const char *name)
+{
+    memset(self, 0, sizeof(ColibriFeed_t));
+    self->ring = colibriSharedMemoryMap(name, sizeof(ColibriFeedRing_t), false, &self->handle);
+    if (self->ring == NULL)
+    {
+        return ERROR_COLIBRI_FILE_NOT_FOUND;
+    }
+    if (!isInitialized(self->ring))
+    {
+        colibriFeedClose(self);
+        return ERROR_COLIBRI_INVALID_FILE_FORMAT;
+    }
+
+    self->next = FEED_LOAD(&self->ring->head) + 1;
+    return ERROR_COLIBRI_OK;
+}
+
+void colibriFeedClose(ColibriFeed_t *self)
+{
+    if (self->ring)
+    {
+        colibriSharedMemoryUnmap(self->ring, sizeof(ColibriFeedRing_t), self->handle);
+        self->ring = NULL;
+    }
+}
+
+void colibriFeedPublish(ColibriFeed_t *self, ColibriFeedType_t type, const uint32_t *values)
+{
+    ColibriFeedRing_t *ring = self->ring;
+    uint64_t sequence = ring->head + 1;
+    ColibriFeedRecord_t *record = &ring->records[sequence % COLIBRI_FEED_SLOTS];
+    struct timespec now;
+
+    timespec_get(&now, TIME_UTC);
+
+    // Readers which see the old sequence before the fence see the old values
+    FEED_STORE(&record->sequence, 0);
+    FEED_FENCE();
+    record->timestamp = (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+    record->type = type;
+    memcpy(record->values, values, sizeof(record->values));
+    FEED_STORE(&record->sequence, sequence);
+    FEED_STORE(&ring->head, sequence);
+}
+
+const ColibriFeedRecord_t *colibriFeedNext(ColibriFeed_t *self, uint64_t *lost)
+{
+    uint64_t head = FEED_LOAD(&self->ring->head);
+
+    while (self->next <= head)
+    {
+        const ColibriFeedRecord_t *record;
+
+        if (head - self->next >= COLIBRI_FEED_SLOTS)
+        {
+            *lost += head - COLIBRI_FEED_SLOTS + 1 - self->next;
+            self->next = head - COLIBRI_FEED_SLOTS + 1;
+        }
+
+        // A record with another sequence is overwritten or being written
+        record = &self->ring->records[self->next % COLIBRI_FEED_SLOTS];
+        if (FEED_LOAD(&record->sequence) == self->next)
+        {
+            self->current = self->next++;
+            return record;
+        }
+        self->next++;
+        (*lost)++;
+    }
+    return NULL;
+}
+
+bool colibriFeedIsValid(const ColibriFeed_t *self, const ColibriFeedRecord_t *record)
+{
+    FEED_FENCE();
+    return FEED_LOAD(&record->sequence) == self->current;
+}
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#pragma once
+
+#include "colibri.h"
+
+// Live feed of the results of colibriMeasure() and colibriBaseline() in a
+// named shared memory ring. One process publishes, any number of processes
+// read the records in place without locks or copies.
+//
+// Every record gets the next sequence number, starting at 1. The record with
+// sequence s is in slot s % COLIBRI_FEED_SLOTS, its field sequence is s once
+// it is complete and 0 while it is written. A reader which falls more than
+// COLIBRI_FEED_SLOTS records behind loses the oldest ones.
+//
+// On Unix the ring is a POSIX shared memory object and stays until it is
+// removed, e.g. with rm /dev/shm/NAME on Linux, so the sequence continues
+// over several runs of the publisher. On Windows it exists while a publisher
+// or a reader has it open.
+
+#define COLIBRI_FEED_MAGIC 0x44454643
+#define COLIBRI_FEED_VERSION 1
+#define COLIBRI_FEED_SLOTS 1024
+
+typedef enum
+{
+    COLIBRI_FEED_MEASUREMENT = 1,
+    COLIBRI_FEED_BASELINE = 2,
+} ColibriFeedType_t;
+
+// 64 bytes, one cache line
+typedef struct
+{
+    volatile uint64_t sequence;
+    // Microseconds since 1970-01-01 UTC
+    int64_t timestamp;
+    uint32_t type;
+    // sample230 reference230 ... sample340 reference340
+    uint32_t values[8];
+    uint32_t reserved[3];
+} ColibriFeedRecord_t;
+
+typedef struct
+{
+    volatile uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t recordSize;
+    // Sequence of the last complete record, 0 if there is none
+    volatile uint64_t head;
+    uint64_t reserved[5];
+    ColibriFeedRecord_t records[COLIBRI_FEED_SLOTS];
+} ColibriFeedRing_t;
+
+typedef struct ColibriFeed
+{
+    ColibriFeedRing_t *ring;
+    HANDLE handle;
+    // Reader only: the sequence to read next and the one read last
+    uint64_t next;
+    uint64_t current;
+} ColibriFeed_t;
+
+// Creates the ring or continues an existing one. Only one publisher may use
+// a ring at a time.
+DLLEXPORT Error_t colibriFeedCreate(ColibriFeed_t *self, const char *name);
+// Opens a ring for reading, the first record read is the next one published.
+DLLEXPORT Error_t colibriFeedOpen(ColibriFeed_t *self, const char *name);
+DLLEXPORT void colibriFeedClose(ColibriFeed_t *self);
+DLLEXPORT void colibriFeedPublish(ColibriFeed_t *self, ColibriFeedType_t type, const uint32_t *values);
+// Returns the next record in the ring or NULL if there is no new one. lost
+// is increased by the number of records overwritten before they were read.
+// The record may be overwritten while it is used, colibriFeedIsValid() tells
+// afterwards whether what was read is intact.
+DLLEXPORT const ColibriFeedRecord_t *colibriFeedNext(ColibriFeed_t *self, uint64_t *lost);
+DLLEXPORT bool colibriFeedIsValid(const ColibriFeed_t *self, const ColibriFeedRecord_t *record);
@@ -1,11 +1,15 @@
 
 #include "colibriJson.h"
+#include "system.h"
 #include <sys/stat.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
 
-cJSON* colibriJsonLoad(char * file)
+cJSON* colibriJsonLoad(char * file, ColibriJsonFormat_t * format)
 {
     FILE*  fin    = 0;
     char*  buffer = NULL;
@@ -16,15 +20,22 @@ cJSON* colibriJsonLoad(char * file)
     if (fin)
     {
         struct stat st;
-        stat(file, &st);
 
-        buffer = malloc(st.st_size);
+        if (stat(file, &st) == 0 && (buffer = malloc(st.st_size + 1)) != NULL)
+        {
+            size_t ret = fread(buffer, 1, st.st_size, fin);
 
-        size_t ret = fread(buffer, 1, st.st_size, fin);
+            if (ret == st.st_size)
+            {
+                buffer[ret] = '\0';
+                json = cJSON_ParseWithLength(buffer, ret);
 
-        if (ret == st.st_size)
-        {
-            json = cJSON_Parse(buffer);
+                // Pretty printed files start with "{\n", compact files with "{\""
+                if (format)
+                {
+                    *format = (ret > 1 && buffer[1] == '"') ? COLIBRI_JSON_COMPACT : COLIBRI_JSON_PRETTY;
+                }
+            }
         }
 
         fclose(fin);
@@ -33,18 +44,925 @@ cJSON* colibriJsonLoad(char * file)
     return json;
 }
 
-void colibriJsonSave(char* file, cJSON* json)
+static bool useArena = true;
+static SYSTEM_THREAD_LOCAL ColibriJsonScope_t *currentScope = NULL;
+
+bool colibriJsonAppendString(Buffer_t *buffer, const char *s)
+{
+    const char *start = s;
+    bool ok = bufferAppendChar(buffer, '"');
+
+    for (; *s != '\0' && ok; s++)
+    {
+        unsigned char c = (unsigned char)*s;
+        char escape[7];
+
+        if (c >= 32 && c != '"' && c != '\\')
+        {
+            continue;
+        }
+
+        ok = bufferAppend(buffer, start, s - start);
+        start = s + 1;
+
+        switch (c)
+        {
+            case '"':
+                ok = ok && bufferAppend(buffer, "\\\"", 2);
+                break;
+            case '\\':
+                ok = ok && bufferAppend(buffer, "\\\\", 2);
+                break;
+            case '\b':
+                ok = ok && bufferAppend(buffer, "\\b", 2);
+                break;
+            case '\f':
+                ok = ok && bufferAppend(buffer, "\\f", 2);
+                break;
+            case '\n':
+                ok = ok && bufferAppend(buffer, "\\n", 2);
+                break;
+            case '\r':
+                ok = ok && bufferAppend(buffer, "\\r", 2);
+                break;
+            case '\t':
+                ok = ok && bufferAppend(buffer, "\\t", 2);
+                break;
+            default:
+                snprintf(escape, sizeof(escape), "\\u%04x", c);
+                ok = ok && bufferAppend(buffer, escape, 6);
+                break;
+        }
+    }
+
+    return ok && bufferAppend(buffer, start, s - start) && bufferAppendChar(buffer, '"');
+}
+
+static bool printIndent(Buffer_t *buffer, int depth)
+{
+    if (!bufferReserve(buffer, depth))
+    {
+        return false;
+    }
+    memset(buffer->data + buffer->size, '\t', depth);
+    buffer->size += depth;
+    buffer->data[buffer->size] = '\0';
+    return true;
+}
+
+static bool printValue(Buffer_t *buffer, const cJSON *item, int depth, bool format)
+{
+    const cJSON *child;
+    bool ok = true;
+
+    switch (item->type & 0xFF)
+    {
+        case cJSON_NULL:
+            return bufferAppendString(buffer, "null");
+        case cJSON_False:
+            return bufferAppendString(buffer, "false");
+        case cJSON_True:
+            return bufferAppendString(buffer, "true");
+        case cJSON_Number:
+            return bufferAppendDouble(buffer, item->valuedouble);
+        case cJSON_String:
+            return colibriJsonAppendString(buffer, item->valuestring ? item->valuestring : "");
+        case cJSON_Raw:
+            return item->valuestring ? bufferAppendString(buffer, item->valuestring) : false;
+        case cJSON_Array:
+            ok = bufferAppendChar(buffer, '[');
+            for (child = item->child; child != NULL && ok; child = child->next)
+            {
+                ok = printValue(buffer, child, depth, format);
+                if (ok && child->next)
+                {
+                    ok = format ? bufferAppend(buffer, ", ", 2) : bufferAppendChar(buffer, ',');
+                }
+            }
+            return ok && bufferAppendChar(buffer, ']');
+        case cJSON_Object:
+            ok = format ? bufferAppend(buffer, "{\n", 2) : bufferAppendChar(buffer, '{');
+            for (child = item->child; child != NULL && ok; child = child->next)
+            {
+                ok = (!format || printIndent(buffer, depth + 1)) &&
+                     colibriJsonAppendString(buffer, child->string ? child->string : "") &&
+                     (format ? bufferAppend(buffer, ":\t", 2) : bufferAppendChar(buffer, ':')) &&
+                     printValue(buffer, child, depth + 1, format) &&
+                     (!child->next || bufferAppendChar(buffer, ',')) &&
+                     (!format || bufferAppendChar(buffer, '\n'));
+            }
+            return ok && (!format || printIndent(buffer, depth)) && bufferAppendChar(buffer, '}');
+        default:
+            return false;
+    }
+}
+
+bool colibriJsonPrint(const cJSON *json, bool format, Buffer_t *buffer)
+{
+    bufferClear(buffer);
+    return printValue(buffer, json, 0, format);
+}
+
+bool colibriJsonAppend(const cJSON *json, int depth, bool format, Buffer_t *buffer)
+{
+    return printValue(buffer, json, depth, format);
+}
+
+static double elapsedMs(const struct timespec *start)
+{
+    struct timespec end;
+
+    timespec_get(&end, TIME_UTC);
+    return (end.tv_sec - start->tv_sec) * 1000.0 + (end.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+// The file is written to FILE.tmp which then replaces FILE, so a failed or
+// concurrent save never leaves a partially written data file.
+bool colibriJsonSave(char* file, cJSON* json, ColibriJsonFormat_t format)
+{
+    FILE*           fout       = 0;
+    bool            ok         = false;
+    size_t          size       = strlen(file) + sizeof(".tmp");
+    char*           tempFile   = malloc(size);
+    Buffer_t        local      = {0};
+    Buffer_t*       buffer     = currentScope ? &currentScope->writeBuffer : &local;
+    struct timespec start;
+
+    timespec_get(&start, TIME_UTC);
+
+    if (tempFile == NULL)
+    {
+        return false;
+    }
+    snprintf(tempFile, size, "%s.tmp", file);
+
+    fout = fopen(tempFile, "w+");
+
+    if (fout)
+    {
+        if (buffer->capacity == 0)
+        {
+            bufferReserve(buffer, COLIBRI_JSON_WRITE_BUFFER_SIZE);
+        }
+        bufferClear(buffer);
+        bufferAttach(buffer, fout);
+
+        ok = printValue(buffer, json, 0, format == COLIBRI_JSON_PRETTY) && bufferFlush(buffer);
+
+        bufferAttach(buffer, NULL);
+        if (currentScope && currentScope->verbose)
+        {
+            fprintf(stderr, "JSON save: %s, %ld bytes, ", format == COLIBRI_JSON_PRETTY ? "pretty" : "compact", ftell(fout));
+        }
+        ok = (fclose(fout) == 0) && ok;
+        ok = ok && systemReplaceFile(tempFile, file);
+        if (!ok)
+        {
+            remove(tempFile);
+        }
+        if (currentScope && currentScope->verbose)
+        {
+            fprintf(stderr, "%.3f ms\n", elapsedMs(&start));
+        }
+    }
+
+    bufferFree(&local);
+    free(tempFile);
+    return ok;
+}
+
+// The hooks stay installed once the first scope was opened. They use the
+// scope of the calling thread, or malloc for threads without a scope.
+static bool hooksInstalled = false;
+
+static void *scopeMalloc(size_t size)
+{
+    ColibriJsonScope_t *scope = currentScope;
+
+    if (scope == NULL)
+    {
+        return malloc(size);
+    }
+    if (scope->useArena)
+    {
+        return arenaAlloc(&scope->arena, size);
+    }
+
+    scope->arena.allocations++;
+    scope->arena.bytes += size;
+    return malloc(size);
+}
+
+// Memory of an arena is only given back with the whole arena
+static void scopeFree(void *ptr)
+{
+    ColibriJsonScope_t *scope = currentScope;
+
+    if (scope == NULL)
+    {
+        free(ptr);
+        return;
+    }
+    scope->arena.releases++;
+    if (!scope->useArena)
+    {
+        free(ptr);
+    }
+}
+
+void colibriJsonRelease(cJSON *json)
+{
+    if (currentScope == NULL || !currentScope->useArena)
+    {
+        cJSON_Delete(json);
+    }
+}
+
+void colibriJsonUseArena(bool enable)
+{
+    useArena = enable;
+}
+
+void colibriJsonScopeBegin(ColibriJsonScope_t *scope, bool verbose)
+{
+    arenaInit(&scope->arena, COLIBRI_JSON_ARENA_BLOCK_SIZE);
+    bufferInit(&scope->writeBuffer);
+    scope->useArena = useArena;
+    scope->verbose = verbose;
+    timespec_get(&scope->start, TIME_UTC);
+    scope->previous = currentScope;
+    currentScope = scope;
+
+    if (!hooksInstalled)
+    {
+        cJSON_Hooks hooks = {0};
+
+        hooks.malloc_fn = scopeMalloc;
+        hooks.free_fn = scopeFree;
+        cJSON_InitHooks(&hooks);
+        hooksInstalled = true;
+    }
+}
+
+void colibriJsonScopeReset(ColibriJsonScope_t *scope)
+{
+    arenaReset(&scope->arena);
+}
+
+void colibriJsonScopeEnd(ColibriJsonScope_t *scope)
+{
+    arenaFree(&scope->arena);
+    bufferFree(&scope->writeBuffer);
+    currentScope = scope->previous;
+
+    if (scope->verbose)
+    {
+        fprintf(stderr, "JSON allocator: %s, %llu allocations, %llu frees, %llu bytes, %llu blocks, %.3f ms\n",
+                scope->useArena ? "arena" : "malloc",
+                (unsigned long long)scope->arena.allocations,
+                (unsigned long long)scope->arena.releases,
+                (unsigned long long)scope->arena.bytes,
+                (unsigned long long)scope->arena.blocksAllocated,
+                elapsedMs(&scope->start));
+    }
+}
+
+static bool keyEquals(const char *key, const char *name)
+{
+    if (key == NULL)
+    {
+        return false;
+    }
+
+    while (tolower((unsigned char)*key) == tolower((unsigned char)*name))
+    {
+        if (*key == '\0')
+        {
+            return true;
+        }
+        key++;
+        name++;
+    }
+    return false;
+}
+
+static int wavelengthIndex(const char *key)
+{
+    if (keyEquals(key, DICT_230))
+        return WAVELENGTH_230;
+    if (keyEquals(key, DICT_260))
+        return WAVELENGTH_260;
+    if (keyEquals(key, DICT_280))
+        return WAVELENGTH_280;
+    if (keyEquals(key, DICT_340))
+        return WAVELENGTH_340;
+    return -1;
+}
+
+static void decodeChannels(cJSON *obj, Measurements_t *measurements, Role_t role, size_t index)
+{
+    cJSON *oChannel = NULL;
+
+    for (int w = 0; w < WAVELENGTH_COUNT; w++)
+    {
+        measurements->sample[role][w][index] = NAN;
+        measurements->reference[role][w][index] = NAN;
+    }
+
+    cJSON_ArrayForEach(oChannel, obj)
+    {
+        int w = wavelengthIndex(oChannel->string);
+        cJSON *iterator = NULL;
+
+        if (w < 0)
+            continue;
+
+        cJSON_ArrayForEach(iterator, oChannel)
+        {
+            if (keyEquals(iterator->string, DICT_SAMPLE))
+                measurements->sample[role][w][index] = cJSON_GetNumberValue(iterator);
+            else if (keyEquals(iterator->string, DICT_REFERENCE))
+                measurements->reference[role][w][index] = cJSON_GetNumberValue(iterator);
+        }
+    }
+}
+
+static void decodeLevelling(cJSON *obj, DataFile_t *data, Record_t *record)
+{
+    cJSON *oChannel = NULL;
+
+    record->hasLevelling = true;
+
+    cJSON_ArrayForEach(oChannel, obj)
+    {
+        int w = wavelengthIndex(oChannel->string);
+        cJSON *iterator = NULL;
+
+        if (w < 0)
+            continue;
+
+        cJSON_ArrayForEach(iterator, oChannel)
+        {
+            if (keyEquals(iterator->string, DICT_AMPLIFICATION_SAMPLE))
+                record->levelling[w].amplificationSample = cJSON_GetNumberValue(iterator);
+            else if (keyEquals(iterator->string, DICT_AMPLIFICATION_REFERENCE))
+                record->levelling[w].amplificationReference = cJSON_GetNumberValue(iterator);
+            else if (keyEquals(iterator->string, DICT_CURRENT))
+                record->levelling[w].current = cJSON_GetNumberValue(iterator);
+            else if (keyEquals(iterator->string, DICT_RESULT))
+                record->levelling[w].result = cJSON_GetNumberValue(iterator);
+            else if (keyEquals(iterator->string, DICT_RESULT_TEXT) && cJSON_IsString(iterator))
+                record->levelling[w].resultText = dataFileAddString(data, cJSON_GetStringValue(iterator));
+        }
+    }
+}
+
+static void decodeCalculated(cJSON *obj, DataFile_t *data, size_t index)
+{
+    Record_t *record = &data->records[index];
+    cJSON *iterator = NULL;
+
+    record->hasCalculated = true;
+
+    cJSON_ArrayForEach(iterator, obj)
+    {
+        if (keyEquals(iterator->string, DICT_CONCENTRATION))
+        {
+            record->hasConcentration = true;
+            data->calculated.concentration[index] = cJSON_GetNumberValue(iterator);
+        }
+        else if (keyEquals(iterator->string, DICT_OD))
+        {
+            cJSON *oOD = NULL;
+
+            record->hasOD = true;
+            cJSON_ArrayForEach(oOD, iterator)
+            {
+                int w = wavelengthIndex(oOD->string);
+                if (w >= 0)
+                {
+                    data->calculated.od[w][index] = cJSON_GetNumberValue(oOD);
+                }
+            }
+        }
+    }
+}
+
+static void decodeRecord(cJSON *obj, DataFile_t *data, size_t index)
+{
+    Measurements_t *measurements = &data->measurements;
+    Record_t *record = &data->records[index];
+    cJSON *iterator = NULL;
+
+    // The record may be reused, e.g. by a streaming reader
+    memset(record, 0, sizeof(Record_t));
+    record->node = obj;
+    record->comment = DATA_NO_STRING;
+    record->timestamp = DATA_NO_STRING;
+    for (int w = 0; w < WAVELENGTH_COUNT; w++)
+    {
+        record->levelling[w].resultText = DATA_NO_STRING;
+    }
+    measurements->hasAir[index] = false;
+    decodeChannels(NULL, measurements, ROLE_BASELINE, index);
+    decodeChannels(NULL, measurements, ROLE_SAMPLE, index);
+    data->calculated.concentration[index] = NAN;
+    for (int w = 0; w < WAVELENGTH_COUNT; w++)
+    {
+        data->calculated.od[w][index] = 0.0;
+    }
+
+    cJSON_ArrayForEach(iterator, obj)
+    {
+        const char *key = iterator->string;
+
+        if (keyEquals(key, DICT_BASELINE))
+        {
+            decodeChannels(iterator, measurements, ROLE_BASELINE, index);
+        }
+        else if (keyEquals(key, DICT_SAMPLE))
+        {
+            decodeChannels(iterator, measurements, ROLE_SAMPLE, index);
+        }
+        else if (keyEquals(key, DICT_AIR))
+        {
+            measurements->hasAir[index] = true;
+            decodeChannels(iterator, measurements, ROLE_AIR, index);
+        }
+        else if (keyEquals(key, DICT_LEVELLING))
+        {
+            decodeLevelling(iterator, data, record);
+        }
+        else if (keyEquals(key, DICT_COMMENT) && cJSON_IsString(iterator))
+        {
+            record->comment = dataFileAddString(data, cJSON_GetStringValue(iterator));
+        }
+        else if (keyEquals(key, DICT_TIMESTAMP) && cJSON_IsString(iterator))
+        {
+            record->timestamp = dataFileAddString(data, cJSON_GetStringValue(iterator));
+        }
+        else if (keyEquals(key, DICT_CALCULATED))
+        {
+            decodeCalculated(iterator, data, index);
+        }
+    }
+
+    if (!measurements->hasAir[index])
+    {
+        for (int w = 0; w < WAVELENGTH_COUNT; w++)
+        {
+            measurements->sample[ROLE_AIR][w][index] = 1.0;
+            measurements->reference[ROLE_AIR][w][index] = 1.0;
+        }
+    }
+}
+
+void colibriJsonDecodeRecord(cJSON *obj, DataFile_t *data, size_t index)
+{
+    decodeRecord(obj, data, index);
+}
+
+bool colibriJsonDecode(cJSON *json, DataFile_t *data)
+{
+    cJSON *oMeasurements = NULL;
+    cJSON *iterator = NULL;
+    size_t index = 0;
+
+    cJSON_ArrayForEach(iterator, json)
+    {
+        if (keyEquals(iterator->string, DICT_MEASUREMENTS) && oMeasurements == NULL)
+        {
+            oMeasurements = iterator;
+        }
+    }
+
+    if (!dataFileCreate(data, cJSON_GetArraySize(oMeasurements)))
+    {
+        return false;
+    }
+
+    cJSON_ArrayForEach(iterator, json)
+    {
+        if (keyEquals(iterator->string, DICT_SERIALNUMBER) && cJSON_IsString(iterator))
+        {
+            data->serialNumber = dataFileAddString(data, cJSON_GetStringValue(iterator));
+        }
+        else if (keyEquals(iterator->string, DICT_FIRMWAREVERSION) && cJSON_IsString(iterator))
+        {
+            data->firmwareVersion = dataFileAddString(data, cJSON_GetStringValue(iterator));
+        }
+    }
+
+    cJSON_ArrayForEach(iterator, oMeasurements)
+    {
+        decodeRecord(iterator, data, index);
+        index++;
+    }
+
+    return true;
+}
+
+static const char *wavelengthKeys[WAVELENGTH_COUNT] = {DICT_230, DICT_260, DICT_280, DICT_340};
+
+static cJSON *encodeChannels(const Measurements_t *measurements, Role_t role, size_t index)
+{
+    cJSON *obj = cJSON_CreateObject();
+
+    for (int w = 0; w < WAVELENGTH_COUNT; w++)
+    {
+        cJSON *oChannel = cJSON_CreateObject();
+
+        cJSON_AddItemToObject(oChannel, DICT_SAMPLE, cJSON_CreateNumber(measurements->sample[role][w][index]));
+        cJSON_AddItemToObject(oChannel, DICT_REFERENCE, cJSON_CreateNumber(measurements->reference[role][w][index]));
+        cJSON_AddItemToObject(obj, wavelengthKeys[w], oChannel);
+    }
+
+    return obj;
+}
+
+static cJSON *encodeLevelling(const DataFile_t *data, const Record_t *record)
+{
+    cJSON *obj = cJSON_CreateObject();
+
+    for (int w = 0; w < WAVELENGTH_COUNT; w++)
+    {
+        const LevellingChannel_t *levelling = &record->levelling[w];
+        const char *resultText = dataFileString(data, levelling->resultText);
+        cJSON *oChannel = cJSON_CreateObject();
+
+        cJSON_AddItemToObject(oChannel, DICT_AMPLIFICATION_SAMPLE, cJSON_CreateNumber(levelling->amplificationSample));
+        cJSON_AddItemToObject(oChannel, DICT_AMPLIFICATION_REFERENCE, cJSON_CreateNumber(levelling->amplificationReference));
+        cJSON_AddItemToObject(oChannel, DICT_CURRENT, cJSON_CreateNumber(levelling->current));
+        cJSON_AddItemToObject(oChannel, DICT_RESULT, cJSON_CreateNumber(levelling->result));
+        if (resultText)
+        {
+            cJSON_AddItemToObject(oChannel, DICT_RESULT_TEXT, cJSON_CreateString(resultText));
+        }
+        cJSON_AddItemToObject(obj, wavelengthKeys[w], oChannel);
+    }
+
+    return obj;
+}
+
+cJSON *colibriJsonCalculated(const DataFile_t *data, size_t index)
+{
+    cJSON *obj = cJSON_CreateObject();
+
+    if (data->records[index].hasConcentration)
+    {
+        cJSON_AddItemToObject(obj, DICT_CONCENTRATION, cJSON_CreateNumber(data->calculated.concentration[index]));
+    }
+
+    if (data->records[index].hasOD)
+    {
+        cJSON *oOD = cJSON_CreateObject();
+        cJSON_AddItemToObject(oOD, DICT_230, cJSON_CreateNumber(data->calculated.od[WAVELENGTH_230][index]));
+        cJSON_AddItemToObject(oOD, DICT_260, cJSON_CreateNumber(data->calculated.od[WAVELENGTH_260][index]));
+        cJSON_AddItemToObject(oOD, DICT_280, cJSON_CreateNumber(data->calculated.od[WAVELENGTH_280][index]));
+        cJSON_AddItemToObject(oOD, DICT_340, cJSON_CreateNumber(data->calculated.od[WAVELENGTH_340][index]));
+        cJSON_AddItemToObject(obj, DICT_OD, oOD);
+    }
+
+    return obj;
+}
+
+// Builds a data file in the layout written by the command save.
+cJSON *colibriJsonEncode(const DataFile_t *data)
+{
+    cJSON *json = cJSON_CreateObject();
+    cJSON *oMeasurements = cJSON_CreateArray();
+    const char *serialNumber = dataFileString(data, data->serialNumber);
+    const char *firmwareVersion = dataFileString(data, data->firmwareVersion);
+
+    if (serialNumber)
+    {
+        cJSON_AddItemToObject(json, DICT_SERIALNUMBER, cJSON_CreateString(serialNumber));
+    }
+    if (firmwareVersion)
+    {
+        cJSON_AddItemToObject(json, DICT_FIRMWAREVERSION, cJSON_CreateString(firmwareVersion));
+    }
+
+    for (size_t i = 0; i < data->count; i++)
+    {
+        const Record_t *record = &data->records[i];
+        const char *comment = dataFileString(data, record->comment);
+        const char *timestamp = dataFileString(data, record->timestamp);
+        cJSON *obj = cJSON_CreateObject();
+
+        if (comment)
+        {
+            cJSON_AddItemToObject(obj, DICT_COMMENT, cJSON_CreateString(comment));
+        }
+        if (timestamp)
+        {
+            cJSON_AddItemToObject(obj, DICT_TIMESTAMP, cJSON_CreateString(timestamp));
+        }
+        if (record->hasLevelling)
+        {
+            cJSON_AddItemToObject(obj, DICT_LEVELLING, encodeLevelling(data, record));
+        }
+        cJSON_AddItemToObject(obj, DICT_BASELINE, encodeChannels(&data->measurements, ROLE_BASELINE, i));
+        if (data->measurements.hasAir[i])
+        {
+            cJSON_AddItemToObject(obj, DICT_AIR, encodeChannels(&data->measurements, ROLE_AIR, i));
+        }
+        cJSON_AddItemToObject(obj, DICT_SAMPLE, encodeChannels(&data->measurements, ROLE_SAMPLE, i));
+        if (record->hasCalculated)
+        {
+            cJSON_AddItemToObject(obj, DICT_CALCULATED, colibriJsonCalculated(data, i));
+        }
+        cJSON_AddItemToArray(oMeasurements, obj);
+    }
+
+    cJSON_AddItemToObject(json, DICT_MEASUREMENTS, oMeasurements);
+
+    return json;
+}
+
+static bool keyEqualsN(const char *key, size_t length, const char *name)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        if (tolower((unsigned char)key[i]) != tolower((unsigned char)name[i]) || name[i] == '\0')
+        {
+            return false;
+        }
+    }
+    return name[length] == '\0';
+}
+
+// Finds the records without parsing the numbers: only strings and brackets
+// are followed. offsets[i] is the position of the '{' of record i.
+size_t colibriJsonRecordOffsets(const char *text, size_t size, uint64_t *offsets, size_t count)
+{
+    size_t found = 0;
+    size_t stringStart = 0;
+    size_t stringLength = 0;
+    int depth = 0;
+    bool isMeasurements = false;
+    bool inMeasurements = false;
+    bool seenMeasurements = false;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        switch (text[i])
+        {
+            case '"':
+                stringStart = ++i;
+                while (i < size && text[i] != '"')
+                {
+                    i += text[i] == '\\' ? 2 : 1;
+                }
+                stringLength = i - stringStart;
+                break;
+            case ':':
+                if (depth == 1)
+                {
+                    isMeasurements = !seenMeasurements && keyEqualsN(text + stringStart, stringLength, DICT_MEASUREMENTS);
+                }
+                break;
+            case '{':
+            case '[':
+                if (depth == 1 && isMeasurements && text[i] == '[')
+                {
+                    inMeasurements = true;
+                    seenMeasurements = true;
+                }
+                else if (depth == 2 && inMeasurements && text[i] == '{')
+                {
+                    if (found < count)
+                    {
+                        offsets[found] = i;
+                    }
+                    found++;
+                }
+                depth++;
+                break;
+            case '}':
+            case ']':
+                depth--;
+                if (depth == 1)
+                {
+                    inMeasurements = false;
+                    isMeasurements = false;
+                }
+                break;
+        }
+    }
+
+    return found;
+}
+
+static size_t skipWhitespace(const char *text, size_t size, size_t i)
+{
+    while (i < size && (text[i] == ' ' || text[i] == '\t' || text[i] == '\n' || text[i] == '\r'))
+    {
+        i++;
+    }
+    return i;
+}
+
+bool colibriJsonReadHeader(const char *text, size_t size, DataFile_t *data, size_t *offset)
 {
-    FILE* fout   = 0;
-    char* buffer = NULL;
+    size_t i = skipWhitespace(text, size, 0);
+
+    *offset = 0;
+    if (i >= size || text[i] != '{')
+    {
+        return false;
+    }
+    i = skipWhitespace(text, size, i + 1);
+    if (i < size && text[i] == '}')
+    {
+        return true;
+    }
+
+    while (i < size)
+    {
+        const char *end;
+        cJSON *key = cJSON_ParseWithLengthOpts(text + i, size - i, &end, false);
+        cJSON *value;
+        bool ok;
+
+        if (!cJSON_IsString(key))
+        {
+            colibriJsonRelease(key);
+            return false;
+        }
+        i = skipWhitespace(text, size, end - text);
+        if (i >= size || text[i] != ':')
+        {
+            colibriJsonRelease(key);
+            return false;
+        }
+        i = skipWhitespace(text, size, i + 1);
+
+        if (keyEquals(key->valuestring, DICT_MEASUREMENTS) && i < size && text[i] == '[')
+        {
+            colibriJsonRelease(key);
+            *offset = i + 1;
+            return true;
+        }
 
-    fout = fopen(file, "w+");
+        value = cJSON_ParseWithLengthOpts(text + i, size - i, &end, false);
+        ok = value != NULL;
+        if (ok && cJSON_IsString(value) && keyEquals(key->valuestring, DICT_SERIALNUMBER))
+        {
+            data->serialNumber = dataFileAddString(data, cJSON_GetStringValue(value));
+        }
+        else if (ok && cJSON_IsString(value) && keyEquals(key->valuestring, DICT_FIRMWAREVERSION))
+        {
+            data->firmwareVersion = dataFileAddString(data, cJSON_GetStringValue(value));
+        }
+        colibriJsonRelease(value);
+        colibriJsonRelease(key);
+        if (!ok)
+        {
+            return false;
+        }
 
-    buffer = cJSON_Print(json);
+        i = skipWhitespace(text, size, end - text);
+        if (i < size && text[i] == '}')
+        {
+            return true;
+        }
+        if (i >= size || text[i] != ',')
+        {
+            return false;
+        }
+        i = skipWhitespace(text, size, i + 1);
+    }
 
-    fwrite(buffer, strlen(buffer), 1, fout);
+    return false;
+}
 
-    free(buffer);
+bool colibriJsonReadRecord(const char *text, size_t size, size_t *offset, cJSON **record)
+{
+    size_t i = skipWhitespace(text, size, *offset);
+    const char *end;
 
-    fclose(fout);
+    *record = NULL;
+    if (i < size && text[i] == ',')
+    {
+        i = skipWhitespace(text, size, i + 1);
+    }
+    if (i < size && text[i] == ']')
+    {
+        *offset = i;
+        return true;
+    }
+    if (i >= size || text[i] != '{')
+    {
+        return false;
+    }
+
+    *record = cJSON_ParseWithLengthOpts(text + i, size - i, &end, false);
+    if (*record == NULL)
+    {
+        return false;
+    }
+    *offset = end - text;
+    return true;
+}
+
+// Moves the unread text to the front of the window and reads more of the
+// file behind it. The window grows if it is full.
+static bool streamFill(ColibriJsonStream_t *self)
+{
+    Buffer_t *text = &self->text;
+    size_t read;
+
+    if (self->eof)
+    {
+        return false;
+    }
+
+    memmove(text->data, text->data + self->offset, text->size - self->offset);
+    text->size -= self->offset;
+    self->offset = 0;
+
+    if (text->size + 1 >= text->capacity && !bufferReserve(text, text->capacity))
+    {
+        return false;
+    }
+
+    read = fread(text->data + text->size, 1, text->capacity - text->size - 1, self->file);
+    text->size += read;
+    text->data[text->size] = '\0';
+    self->eof = read == 0;
+    return read > 0;
+}
+
+bool colibriJsonStreamOpen(ColibriJsonStream_t *self, const char *file, DataFile_t *data, Buffer_t *header)
+{
+    size_t strings = data->stringsSize;
+
+    memset(self, 0, sizeof(ColibriJsonStream_t));
+    bufferInit(&self->text);
+    self->file = fopen(file, "rb");
+    if (self->file == NULL || !bufferReserve(&self->text, COLIBRI_JSON_STREAM_SIZE))
+    {
+        colibriJsonStreamClose(self);
+        return false;
+    }
+
+    // The header is decoded again whenever more of it had to be read
+    while (!colibriJsonReadHeader(self->text.data, self->text.size, data, &self->offset))
+    {
+        data->stringsSize = strings;
+        if (!streamFill(self))
+        {
+            colibriJsonStreamClose(self);
+            return false;
+        }
+    }
+
+    if (self->offset == 0 || (header && !bufferAppend(header, self->text.data, self->offset)))
+    {
+        colibriJsonStreamClose(self);
+        return false;
+    }
+    return true;
+}
+
+bool colibriJsonStreamRecord(ColibriJsonStream_t *self, cJSON **record)
+{
+    size_t offset = self->offset;
+
+    // A record which does not parse may only be cut off by the window
+    while (!colibriJsonReadRecord(self->text.data, self->text.size, &offset, record))
+    {
+        if (!streamFill(self))
+        {
+            return false;
+        }
+        offset = self->offset;
+    }
+
+    self->offset = offset;
+    return true;
+}
+
+bool colibriJsonStreamTail(ColibriJsonStream_t *self, Buffer_t *out)
+{
+    bool ok = bufferAppend(out, self->text.data + self->offset, self->text.size - self->offset);
+
+    self->offset = self->text.size;
+    while (ok && streamFill(self))
+    {
+        ok = bufferAppend(out, self->text.data, self->text.size);
+        self->offset = self->text.size;
+    }
+    return ok && !ferror(self->file);
+}
+
+void colibriJsonStreamClose(ColibriJsonStream_t *self)
+{
+    if (self->file)
+    {
+        fclose(self->file);
+    }
+    bufferFree(&self->text);
+    memset(self, 0, sizeof(ColibriJsonStream_t));
 }
@@ -1,4 +1,10 @@
+#pragma once
+
 #include "cJSON.h"
+#include "colibriData.h"
+#include "arena.h"
+#include "buffer.h"
+#include <time.h>
 
 #define DICT_MEASUREMENTS "measurements"
 #define DICT_SERIALNUMBER "serialnumber"
@@ -17,6 +23,7 @@
 #define DICT_BASELINE "baseline"
 #define DICT_AIR "air"
 #define DICT_COMMENT "comment"
+#define DICT_TIMESTAMP "timestamp"
 
 #define DICT_230 "230"
 #define DICT_260 "260"
@@ -27,5 +34,82 @@
 #define DICT_OD "od"
 #define DICT_CONCENTRATION "concentration"
 
-cJSON *colibriJsonLoad(char *file);
-void colibriJsonSave(char* file, cJSON* json);
\ No newline at end of file
+#define COLIBRI_JSON_ARENA_BLOCK_SIZE (1024 * 1024)
+
+// All cJSON memory allocated between colibriJsonScopeBegin() and
+// colibriJsonScopeEnd() comes from one arena and is freed at once by
+// colibriJsonScopeEnd(). No cJSON item may outlive the scope. Every thread
+// has its own current scope, the first scope must be opened before other
+// threads use cJSON. The saves of a scope share its write buffer.
+typedef struct ColibriJsonScope
+{
+    Arena_t arena;
+    Buffer_t writeBuffer;
+    bool useArena;
+    bool verbose;
+    struct timespec start;
+    struct ColibriJsonScope *previous;
+} ColibriJsonScope_t;
+
+void colibriJsonUseArena(bool enable);
+void colibriJsonScopeBegin(ColibriJsonScope_t *scope, bool verbose);
+// Frees all cJSON memory of the scope but keeps the scope open.
+void colibriJsonScopeReset(ColibriJsonScope_t *scope);
+void colibriJsonScopeEnd(ColibriJsonScope_t *scope);
+// Use instead of cJSON_Delete(). In an arena scope it does nothing, the
+// tree is freed with the arena instead of node by node.
+void colibriJsonRelease(cJSON *json);
+
+#define COLIBRI_JSON_WRITE_BUFFER_SIZE (256 * 1024)
+
+typedef enum
+{
+    COLIBRI_JSON_PRETTY = 0,
+    COLIBRI_JSON_COMPACT = 1,
+} ColibriJsonFormat_t;
+
+cJSON *colibriJsonLoad(char *file, ColibriJsonFormat_t *format);
+bool colibriJsonSave(char* file, cJSON* json, ColibriJsonFormat_t format);
+bool colibriJsonPrint(const cJSON *json, bool format, Buffer_t *buffer);
+// Appends json printed as a value at depth of an enclosing document, e.g.
+// depth 1 for a record in the measurements.
+bool colibriJsonAppend(const cJSON *json, int depth, bool format, Buffer_t *buffer);
+// Appends s as a quoted JSON string.
+bool colibriJsonAppendString(Buffer_t *buffer, const char *s);
+bool colibriJsonDecode(cJSON *json, DataFile_t *data);
+// Decodes one record object into the record index of data.
+void colibriJsonDecodeRecord(cJSON *obj, DataFile_t *data, size_t index);
+// Byte offsets of the records in the text of a data file. Returns the number
+// of records, only the first count offsets are stored.
+size_t colibriJsonRecordOffsets(const char *text, size_t size, uint64_t *offsets, size_t count);
+// Reading the text of a data file record by record without the tree of the
+// whole file. colibriJsonReadHeader decodes the fields in front of the
+// measurements into data and sets offset to the first record, or to 0 if
+// there are no measurements. colibriJsonReadRecord parses the record at
+// offset and moves offset behind it, record is NULL after the last record.
+bool colibriJsonReadHeader(const char *text, size_t size, DataFile_t *data, size_t *offset);
+bool colibriJsonReadRecord(const char *text, size_t size, size_t *offset, cJSON **record);
+
+#define COLIBRI_JSON_STREAM_SIZE (64 * 1024)
+
+// Reads the text of a data file through a window which only grows for
+// records larger than it, for files too large to be held in memory.
+typedef struct
+{
+    FILE *file;
+    Buffer_t text;
+    size_t offset;
+    bool eof;
+} ColibriJsonStream_t;
+
+// Decodes the fields in front of the measurements into data and appends
+// their text up to the [ of the measurements to header if it is not NULL.
+// Fails for files without measurements.
+bool colibriJsonStreamOpen(ColibriJsonStream_t *self, const char *file, DataFile_t *data, Buffer_t *header);
+// record is NULL after the last record.
+bool colibriJsonStreamRecord(ColibriJsonStream_t *self, cJSON **record);
+// Appends the rest of the file, starting with the ] of the measurements.
+bool colibriJsonStreamTail(ColibriJsonStream_t *self, Buffer_t *out);
+void colibriJsonStreamClose(ColibriJsonStream_t *self);
+cJSON *colibriJsonEncode(const DataFile_t *data);
+cJSON *colibriJsonCalculated(const DataFile_t *data, size_t index);
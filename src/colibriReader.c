@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "colibriReader.h"
+#include <string.h>
+
+Error_t colibriReaderOpen(ColibriReader_t *self, const char *file, size_t chunkSize)
+{
+    Error_t ret = ERROR_COLIBRI_OK;
+
+    memset(self, 0, sizeof(ColibriReader_t));
+    self->capacity = chunkSize ? chunkSize : COLIBRI_READER_CHUNK_SIZE;
+    if (!dataFileCreate(&self->chunk, self->capacity))
+    {
+        return ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+
+    self->isArchive = colibriArchiveProbe(file);
+    if (self->isArchive)
+    {
+        ret = colibriArchiveOpen(&self->archive, file);
+        if (ret == ERROR_COLIBRI_OK)
+        {
+            const char *serialNumber = colibriArchiveString(&self->archive, self->archive.header->serialNumber);
+            const char *firmwareVersion = colibriArchiveString(&self->archive, self->archive.header->firmwareVersion);
+
+            self->chunk.serialNumber = serialNumber ? dataFileAddString(&self->chunk, serialNumber) : DATA_NO_STRING;
+            self->chunk.firmwareVersion = firmwareVersion ? dataFileAddString(&self->chunk, firmwareVersion) : DATA_NO_STRING;
+        }
+    }
+    else if (!systemMapFile(&self->map, file))
+    {
+        ret = ERROR_COLIBRI_FILE_NOT_FOUND;
+    }
+    else
+    {
+        colibriJsonScopeBegin(&self->scope, false);
+        if (!colibriJsonReadHeader(self->map.data, self->map.size, &self->chunk, &self->offset))
+        {
+            colibriJsonScopeEnd(&self->scope);
+            systemUnmapFile(&self->map);
+            ret = ERROR_COLIBRI_INVALID_FILE_FORMAT;
+        }
+        self->done = self->offset == 0;
+    }
+
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        dataFileFree(&self->chunk);
+        return ret;
+    }
+
+    self->headerStrings = self->chunk.stringsSize;
+    self->chunk.count = 0;
+    return ERROR_COLIBRI_OK;
+}
+
+static Error_t readJson(ColibriReader_t *self)
+{
+    size_t count = 0;
+
+    // Everything cJSON allocated for the previous chunk is freed at once
+    colibriJsonScopeReset(&self->scope);
+
+    while (count < self->capacity && !self->done)
+    {
+        cJSON *record;
+
+        if (!colibriJsonReadRecord(self->map.data, self->map.size, &self->offset, &record))
+        {
+            return ERROR_COLIBRI_INVALID_FILE_FORMAT;
+        }
+        if (record == NULL)
+        {
+            self->done = true;
+            break;
+        }
+        colibriJsonDecodeRecord(record, &self->chunk, count);
+        self->chunk.records[count].node = NULL;
+        colibriJsonRelease(record);
+        count++;
+    }
+
+    self->chunk.count = count;
+    return ERROR_COLIBRI_OK;
+}
+
+Error_t colibriReaderNext(ColibriReader_t *self)
+{
+    Error_t ret = ERROR_COLIBRI_OK;
+
+    self->first = self->next;
+    self->chunk.stringsSize = self->headerStrings;
+
+    if (self->isArchive)
+    {
+        size_t count = self->archive.count - self->next;
+
+        count = count < self->capacity ? count : self->capacity;
+        self->chunk.count = self->capacity;
+        ret = colibriArchiveRead(&self->archive, self->next, count, &self->chunk);
+        self->chunk.count = count;
+    }
+    else
+    {
+        ret = readJson(self);
+    }
+
+    if (ret != ERROR_COLIBRI_OK)
+    {
+        self->chunk.count = 0;
+    }
+    self->next += self->chunk.count;
+    return ret;
+}
+
+void colibriReaderClose(ColibriReader_t *self)
+{
+    if (self->isArchive)
+    {
+        colibriArchiveClose(&self->archive);
+    }
+    else
+    {
+        colibriJsonScopeEnd(&self->scope);
+        systemUnmapFile(&self->map);
+    }
+    dataFileFree(&self->chunk);
+}
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#pragma once
+
+#include "colibri.h"
+#include "colibriData.h"
+#include "colibriArchive.h"
+#include "colibriJson.h"
+#include "system.h"
+
+#define COLIBRI_READER_CHUNK_SIZE 4096
+
+// Reads a data file, JSON or archive, a chunk of records at a time, so the
+// memory does not depend on the size of the file. The reader has its own
+// JSON scope, scopes opened while the reader is open must be closed before
+// it.
+typedef struct
+{
+    bool isArchive;
+    bool done;
+    ColibriArchive_t archive;
+    MappedFile_t map;
+    size_t offset;
+    size_t first;
+    size_t next;
+    size_t capacity;
+    size_t headerStrings;
+    ColibriJsonScope_t scope;
+    DataFile_t chunk;
+} ColibriReader_t;
+
+Error_t colibriReaderOpen(ColibriReader_t *self, const char *file, size_t chunkSize);
+// Reads the next records into chunk, chunk.count is 0 after the last record.
+// The first record of the chunk is the record first of the file. The serial
+// number and firmware version of the file are in every chunk.
+Error_t colibriReaderNext(ColibriReader_t *self);
+void colibriReaderClose(ColibriReader_t *self);
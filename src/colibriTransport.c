@@ -0,0 +1,258 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "colibri.h"
+#include "crc-16-ccitt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void colibriFrame(const char *command, bool useChecksum, char *tx, size_t txSize)
+{
+    char s[20] = {0};
+
+    if (useChecksum)
+    {
+        crc_t crc = crc_init();
+        crc = crc_update(crc, command, strlen(command));
+        crc = crc_finalize(crc);
+
+        s[0] = COLIBRI_START_WITH_CHK;
+        strncat_s(tx, txSize, s, 1);
+        strncat_s(tx, txSize, command, strlen(command));
+        s[0] = COLIBRI_CHECKSUM_SEPARATOR;
+        strncat_s(tx, txSize, s, 1);
+        snprintf(s, sizeof(s), "%d", (uint32_t)crc);
+        strncat_s(tx, txSize, s, strlen(s));
+    }
+    else
+    {
+        s[0] = COLIBRI_START_NO_CHK;
+        strncat_s(tx, txSize, s, 1);
+        strncat_s(tx, txSize, command, strlen(command));
+    }
+    strncat_s(tx, txSize, "\n", 1);
+}
+
+char *colibriUnframe(char *line)
+{
+    char *payload = line + 1;
+
+    if (line[0] == COLIBRI_START_WITH_CHK)
+    {
+        char *separator = strchr(payload, COLIBRI_CHECKSUM_SEPARATOR);
+        crc_t crc = crc_init();
+
+        if (separator == NULL)
+        {
+            return NULL;
+        }
+        crc = crc_update(crc, payload, separator - payload);
+        crc = crc_finalize(crc);
+        if (crc != (crc_t)atoi(separator + 1))
+        {
+            fprintf(stderr, "CRC differ: received message %s\n", line);
+            return NULL;
+        }
+        *separator = 0;
+    }
+    return payload;
+}
+
+static bool serialOpen(ColibriTransport_t *self, const char *address)
+{
+    self->handle = colibriPortOpen((char *)address);
+    return self->handle != INVALID_HANDLE_VALUE;
+}
+
+static bool serialWrite(ColibriTransport_t *self, const char *data)
+{
+    return colibriPortWrite(self->handle, (char *)data, false);
+}
+
+// The port returns after its read timeout of 100 ms without data
+static int32_t serialRead(ColibriTransport_t *self, char *buffer, size_t size, uint64_t deadline)
+{
+    int32_t received = 0;
+
+    while (received == 0 && colibriMilliseconds() < deadline)
+    {
+        received = colibriPortReceive(self->handle, buffer, size, false);
+    }
+    return received;
+}
+
+static void serialClose(ColibriTransport_t *self)
+{
+    colibriPortClose(self->handle);
+    self->handle = INVALID_HANDLE_VALUE;
+}
+
+const ColibriTransportOps_t colibriSerialTransport = {serialOpen, serialWrite, serialRead, serialClose};
+
+static bool tcpOpen(ColibriTransport_t *self, const char *address)
+{
+    self->handle = colibriTcpOpen(address);
+    return self->handle != INVALID_HANDLE_VALUE;
+}
+
+static bool tcpWrite(ColibriTransport_t *self, const char *data)
+{
+    return colibriTcpWrite(self->handle, data);
+}
+
+static int32_t tcpRead(ColibriTransport_t *self, char *buffer, size_t size, uint64_t deadline)
+{
+    uint64_t now = colibriMilliseconds();
+
+    return now < deadline ? colibriTcpReceive(self->handle, buffer, size, (uint32_t)(deadline - now)) : 0;
+}
+
+static void tcpClose(ColibriTransport_t *self)
+{
+    colibriTcpClose(self->handle);
+    self->handle = INVALID_HANDLE_VALUE;
+}
+
+const ColibriTransportOps_t colibriTcpTransport = {tcpOpen, tcpWrite, tcpRead, tcpClose};
+
+// The line being written and the framed responses not read yet
+typedef struct ColibriLoopback
+{
+    char line[COLIBRI_MAX_LINE_LENGTH];
+    size_t lineLength;
+    bool inFrame;
+    char *output;
+    size_t outputSize;
+    size_t outputLength;
+    size_t outputRead;
+} ColibriLoopback_t;
+
+static void loopbackEcho(void *user, const char *command, char *response, size_t responseSize)
+{
+    strncpy_s(response, responseSize, command, responseSize);
+}
+
+static bool loopbackOpen(ColibriTransport_t *self, const char *address)
+{
+    self->loopback = (ColibriLoopback_t *)calloc(1, sizeof(ColibriLoopback_t));
+    self->handle = INVALID_HANDLE_VALUE;
+    if (self->device == NULL)
+    {
+        self->device = loopbackEcho;
+    }
+    return self->loopback != NULL;
+}
+
+// Answers the line, the response is framed like the command.
+static bool loopbackAnswer(ColibriTransport_t *self, ColibriLoopback_t *loopback)
+{
+    char response[COLIBRI_MAX_LINE_LENGTH] = "";
+    bool useChecksum = loopback->line[0] == COLIBRI_START_WITH_CHK;
+    char *command = colibriUnframe(loopback->line);
+
+    if (command == NULL)
+    {
+        snprintf(response, sizeof(response), "E %d", ERROR_COLIBRI_PROTOCOL_ERROR);
+    }
+    else
+    {
+        self->device(self->user, command, response, sizeof(response));
+    }
+
+    // Room for the response with its framing
+    if (loopback->outputSize - loopback->outputLength < 2 * COLIBRI_MAX_LINE_LENGTH)
+    {
+        size_t size = loopback->outputSize * 2 + 2 * COLIBRI_MAX_LINE_LENGTH;
+        char *output = (char *)realloc(loopback->output, size);
+
+        if (output == NULL)
+        {
+            return false;
+        }
+        loopback->output = output;
+        loopback->outputSize = size;
+    }
+    loopback->output[loopback->outputLength] = 0;
+    colibriFrame(response, useChecksum, loopback->output + loopback->outputLength, loopback->outputSize - loopback->outputLength);
+    loopback->outputLength += strlen(loopback->output + loopback->outputLength);
+    return true;
+}
+
+static bool loopbackWrite(ColibriTransport_t *self, const char *data)
+{
+    ColibriLoopback_t *loopback = self->loopback;
+
+    for (; *data; data++)
+    {
+        if (*data == COLIBRI_START_NO_CHK || *data == COLIBRI_START_WITH_CHK)
+        {
+            loopback->inFrame = true;
+            loopback->line[0] = *data;
+            loopback->lineLength = 1;
+        }
+        else if (loopback->inFrame && (*data == COLIBRI_STOP1 || *data == COLIBRI_STOP2))
+        {
+            loopback->inFrame = false;
+            loopback->line[loopback->lineLength] = 0;
+            if (!loopbackAnswer(self, loopback))
+            {
+                return false;
+            }
+        }
+        else if (loopback->inFrame && loopback->lineLength < sizeof(loopback->line) - 1)
+        {
+            loopback->line[loopback->lineLength++] = *data;
+        }
+    }
+    return true;
+}
+
+// Everything written is answered at once, so there is nothing to wait for.
+static int32_t loopbackRead(ColibriTransport_t *self, char *buffer, size_t size, uint64_t deadline)
+{
+    ColibriLoopback_t *loopback = self->loopback;
+    size_t available = loopback->outputLength - loopback->outputRead;
+    size_t count = available < size ? available : size;
+
+    if (count == 0)
+    {
+        return 0;
+    }
+    memcpy(buffer, loopback->output + loopback->outputRead, count);
+    loopback->outputRead += count;
+    if (loopback->outputRead == loopback->outputLength)
+    {
+        loopback->outputRead = 0;
+        loopback->outputLength = 0;
+    }
+    return (int32_t)count;
+}
+
+static void loopbackClose(ColibriTransport_t *self)
+{
+    if (self->loopback)
+    {
+        free(self->loopback->output);
+        free(self->loopback);
+        self->loopback = NULL;
+    }
+}
+
+const ColibriTransportOps_t colibriLoopbackTransport = {loopbackOpen, loopbackWrite, loopbackRead, loopbackClose};
+
+const ColibriTransportOps_t *colibriTransportFind(const char *portName, const char **address)
+{
+    if (strncmp(portName, COLIBRI_TCP_PREFIX, strlen(COLIBRI_TCP_PREFIX)) == 0)
+    {
+        *address = portName + strlen(COLIBRI_TCP_PREFIX);
+        return &colibriTcpTransport;
+    }
+    if (strncmp(portName, COLIBRI_LOOPBACK_PREFIX, strlen(COLIBRI_LOOPBACK_PREFIX)) == 0)
+    {
+        *address = portName + strlen(COLIBRI_LOOPBACK_PREFIX);
+        return &colibriLoopbackTransport;
+    }
+    *address = portName;
+    return &colibriSerialTransport;
+}
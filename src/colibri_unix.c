@@ -2,29 +2,50 @@
 // SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
 
 #include "colibri.h"
-#include "crc-16-ccitt.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <termios.h>
 #include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <netdb.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
 
 #define MIN(x, y) (((x) < (y)) ? (x) : (y))
 
 Error_t colibriFindDevice(char *portName, size_t *portNameSize, bool verbose)
+{
+    size_t count = 1;
+    Error_t ret = colibriFindDevices(portName, *portNameSize, &count, verbose);
+
+    if (ret == ERROR_COLIBRI_OK)
+    {
+        *portNameSize = strlen(portName);
+    }
+    return ret;
+}
+
+Error_t colibriFindDevices(char *portNames, size_t portNameSize, size_t *count, bool verbose)
 {
     struct dirent **namelist;
     int n;
     char *id = "usb-HSE_Colibri_";
     char * path = "/dev/serial/by-id/";
-    bool found = false;
+    size_t found = 0;
 
-    memset(portName, 0, *portNameSize);
+    memset(portNames, 0, portNameSize * *count);
 
     n = scandir(path, &namelist, NULL, NULL);
     if (n < 0)
     {
+        *count = 0;
         return ERROR_COLIBRI_NOT_FOUND;
     }
     else
@@ -35,14 +56,12 @@ Error_t colibriFindDevice(char *portName, size_t *portNameSize, bool verbose)
             {
                 printf("%s\n", namelist[n]->d_name);
             }
-            if (!found)
+            if (found < *count)
             {
                 if (strncmp(namelist[n]->d_name, id, strlen(id)) == 0)
                 {
-                    found = true;
-                    strncat(portName, path, *portNameSize);
-                    strncat(portName, namelist[n]->d_name, *portNameSize);
-                    *portNameSize = strlen(portName);
+                    snprintf(portNames + found * portNameSize, portNameSize, "%s%s", path, namelist[n]->d_name);
+                    found++;
                 }
             }
             free(namelist[n]);
@@ -50,7 +69,8 @@ Error_t colibriFindDevice(char *portName, size_t *portNameSize, bool verbose)
         free(namelist);
     }
 
-    return found ? ERROR_COLIBRI_OK : ERROR_COLIBRI_NOT_FOUND;
+    *count = found;
+    return found > 0 ? ERROR_COLIBRI_OK : ERROR_COLIBRI_NOT_FOUND;
 }
 
 int colibriPortOpen(char *portName)
@@ -140,83 +160,155 @@ bool colibriPortWrite(int hComm, char *buffer, bool verbose)
     return true;
 }
 
-uint32_t colibriPortRead(int hComm, char *buffer, size_t size, bool verbose)
+int32_t colibriPortReceive(int hComm, char *buffer, size_t size, bool verbose)
 {
-    ssize_t received;
-    size_t count = 0;
-    char rx[COLIBRI_MAX_LINE_LENGTH];
-    bool waitForStart = true;
-    bool done = false;
-    bool useChecksum = false;
-    int checkSumSeparator = -1;
-
-    do
+    ssize_t received = read(hComm, buffer, size);
+
+    if (received == -1)
     {
-        memset(rx, 0, COLIBRI_MAX_LINE_LENGTH);
-        received = read(hComm, rx, COLIBRI_MAX_LINE_LENGTH);
-        if (received == -1)
-        {
-            fprintf(stderr, "Could not read from port\n");
-            return 0;
-        }
+        fprintf(stderr, "Could not read from port\n");
+        return -1;
+    }
 
-        if (verbose && received > 0)
-        {
-            fprintf(stderr, "RX: %s\n", rx);
-        }
+    if (verbose && received > 0)
+    {
+        fprintf(stderr, "RX: %.*s\n", (int)received, buffer);
+    }
 
-        for (size_t i = 0; i < (size_t)received && !done; i++)
-        {
-            if (waitForStart)
-            {
-                if (rx[i] == COLIBRI_START_NO_CHK || rx[i] == COLIBRI_START_WITH_CHK)
-                {
-                    waitForStart = false;
-                    if (rx[i] == COLIBRI_START_WITH_CHK)
-                    {
-                        useChecksum = true;
-                    }
-                }
-            }
-            else
-            {
-                if (rx[i] == COLIBRI_STOP1 || rx[i] == COLIBRI_STOP2)
-                {
-                    done = true;
-                    buffer[count] = 0;
-                }
-                else
-                {
-                    buffer[count] = rx[i];
-                    if (buffer[count] == COLIBRI_CHECKSUM_SEPARATOR)
-                    {
-                        checkSumSeparator = count;
-                    }
-                    count++;
-                }
-            }
-        }
-    } while (!done);
+    return (int32_t)received;
+}
 
-    if (useChecksum)
+uint64_t colibriMilliseconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+int colibriTcpOpen(const char *address)
+{
+    char host[COLIBRI_MAX_LINE_LENGTH];
+    const char *port = strrchr(address, ':');
+    struct addrinfo hints = {0};
+    struct addrinfo *result;
+    int flag = 1;
+    int hSocket = -1;
+
+    if (port == NULL || (size_t)(port - address) >= sizeof(host))
+    {
+        fprintf(stderr, "Expected HOST:PORT instead of %s\n", address);
+        return -1;
+    }
+    memcpy(host, address, port - address);
+    host[port - address] = 0;
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port + 1, &hints, &result) != 0)
     {
-        crc_t crcReceived;
-        crc_t crc = crc_init();
-        crc = crc_update(crc, buffer, checkSumSeparator);
-        crc = crc_finalize(crc);
-        crcReceived = atoi(buffer + checkSumSeparator + 1);
-        if (crc == crcReceived)
+        fprintf(stderr, "Could not resolve %s\n", address);
+        return -1;
+    }
+    for (struct addrinfo *a = result; a != NULL && hSocket == -1; a = a->ai_next)
+    {
+        hSocket = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (hSocket != -1 && connect(hSocket, a->ai_addr, a->ai_addrlen) == -1)
         {
-            buffer[checkSumSeparator] = 0;
+            close(hSocket);
+            hSocket = -1;
         }
-        else
+    }
+    freeaddrinfo(result);
+
+    if (hSocket == -1)
+    {
+        fprintf(stderr, "Could not connect to %s\n", address);
+        return -1;
+    }
+
+    // Commands are short, they must not wait for more data
+    setsockopt(hSocket, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    return hSocket;
+}
+
+void colibriTcpClose(int hSocket)
+{
+    if (hSocket != -1)
+    {
+        close(hSocket);
+    }
+}
+
+bool colibriTcpWrite(int hSocket, const char *data)
+{
+    size_t size = strlen(data);
+
+    while (size > 0)
+    {
+        ssize_t written = send(hSocket, data, size, MSG_NOSIGNAL);
+
+        if (written == -1)
         {
-            fprintf(stderr, "CRC differ: received message %s, calculated crc=%i", buffer, (uint32_t)crcReceived);
-            return 0;
+            fprintf(stderr, "Could not write to socket\n");
+            return false;
         }
+        data += written;
+        size -= written;
     }
+    return true;
+}
+
+int32_t colibriTcpReceive(int hSocket, char *buffer, size_t size, uint32_t timeout)
+{
+    struct pollfd fd = {hSocket, POLLIN, 0};
+    ssize_t received;
+    int ready = poll(&fd, 1, (int)timeout);
 
-    return count;
+    if (ready == 0)
+    {
+        return 0;
+    }
+
+    received = ready == -1 ? -1 : recv(hSocket, buffer, size, 0);
+    if (received <= 0)
+    {
+        fprintf(stderr, received == 0 ? "Connection closed\n" : "Could not read from socket\n");
+        return -1;
+    }
+    return (int32_t)received;
+}
+
+void *colibriSharedMemoryMap(const char *name, size_t size, bool isWriter, HANDLE *handle)
+{
+    char path[COLIBRI_MAX_LINE_LENGTH];
+    struct stat status;
+    void *memory;
+    int fd;
+
+    // POSIX names start with a slash
+    snprintf(path, sizeof(path), "%s%s", name[0] == '/' ? "" : "/", name);
+    *handle = INVALID_HANDLE_VALUE;
+
+    fd = shm_open(path, isWriter ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (fd == -1)
+    {
+        return NULL;
+    }
+    if (fstat(fd, &status) != 0 || ((size_t)status.st_size < size && (!isWriter || ftruncate(fd, size) != 0)))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    memory = mmap(NULL, size, isWriter ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return memory == MAP_FAILED ? NULL : memory;
+}
+
+void colibriSharedMemoryUnmap(void *memory, size_t size, HANDLE handle)
+{
+    munmap(memory, size);
 }
 
 errno_t strncat_s(char *restrict dest, rsize_t destsz, const char *restrict src, rsize_t count)
@@ -254,5 +346,7 @@ errno_t strcpy_s(char *restrict dest, rsize_t destsz, const char *restrict src)
 
 void Sleep(uint32_t dwMilliseconds)
 {
-    sleep(dwMilliseconds);
+    struct timespec duration = {dwMilliseconds / 1000, (long)(dwMilliseconds % 1000) * 1000000};
+
+    nanosleep(&duration, NULL);
 }
@@ -1,9 +1,12 @@
 // SPDX-License-Identifier: MIT
 // SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
 
+// Winsock 2 must come before windows.h
+#include <winsock2.h>
+#include <ws2tcpip.h>
 #include "colibri.h"
-#include "crc-16-ccitt.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <windows.h>
 #include <tchar.h>
@@ -13,11 +16,24 @@
 #include <stdarg.h>
 
 #pragma comment(lib, "Setupapi.lib")
+#pragma comment(lib, "Ws2_32.lib")
 // This is the GUID for the USB device class
 DEFINE_GUID(GUID_DEVINTERFACE_USB_DEVICE, 0xA5DCBF10L, 0x6530, 0x11D2, 0x90, 0x1F, 0x00, 0xC0, 0x4F, 0xB9, 0x51, 0xED);
 
 
 Error_t colibriFindDevice(char * portName, size_t * portNameSize, bool verbose)
+{
+	size_t count = 1;
+	Error_t ret = colibriFindDevices(portName, *portNameSize, &count, verbose);
+
+	if (ret == ERROR_COLIBRI_OK)
+	{
+		*portNameSize = strlen(portName);
+	}
+	return ret;
+}
+
+Error_t colibriFindDevices(char * portNames, size_t portNameSize, size_t * count, bool verbose)
 {
 	HDEVINFO hDevInfo;
 	SP_DEVICE_INTERFACE_DATA devIntfData;
@@ -28,9 +44,9 @@ Error_t colibriFindDevice(char * portName, size_t * portNameSize, bool verbose)
 	DWORD dwType;
 	uint32_t dwMemberIdx;
 	HKEY hKey;
-	bool found = false;
+	size_t found = 0;
 
-	memset(portName, 0, *portNameSize);
+	memset(portNames, 0, portNameSize * *count);
 
 	// We will try to get device information set for all USB devices that have a
 	// device interface and are currently present on the system (plugged in).
@@ -54,7 +70,7 @@ Error_t colibriFindDevice(char * portName, size_t * portNameSize, bool verbose)
 		{
 			fprintf(stderr, "USB Devices:\n");
 		}
-		while (GetLastError() != ERROR_NO_MORE_ITEMS && !found)
+		while (GetLastError() != ERROR_NO_MORE_ITEMS && found < *count)
 		{
 			// As a last step we will need to get some more details for each
 			// of device interface information we are able to retrieve. This
@@ -87,11 +103,10 @@ Error_t colibriFindDevice(char * portName, size_t * portNameSize, bool verbose)
 				{
 					hKey = SetupDiOpenDevRegKey(hDevInfo, &devData, DICS_FLAG_GLOBAL, 0, DIREG_DEV, KEY_READ);
 					dwType = REG_SZ;
-					DWORD d = *portNameSize;
-					RegQueryValueEx(hKey, _T("PortName"), NULL, &dwType, (LPBYTE)portName, &d);
-					*portNameSize = d;
+					DWORD d = (DWORD)portNameSize;
+					RegQueryValueEx(hKey, _T("PortName"), NULL, &dwType, (LPBYTE)(portNames + found * portNameSize), &d);
 					RegCloseKey(hKey);
-					found = true;
+					found++;
 				}
 			}
 
@@ -104,7 +119,8 @@ Error_t colibriFindDevice(char * portName, size_t * portNameSize, bool verbose)
 		SetupDiDestroyDeviceInfoList(hDevInfo);
 	}
 
-	return found ? ERROR_COLIBRI_OK : ERROR_COLIBRI_NOT_FOUND;
+	*count = found;
+	return found > 0 ? ERROR_COLIBRI_OK : ERROR_COLIBRI_NOT_FOUND;
 }
 
 HANDLE colibriPortOpen(char * portName)
@@ -208,81 +224,162 @@ bool colibriPortWrite(HANDLE hComm, LPTSTR buffer, bool verbose)
 	return true;
 }
 
-uint32_t colibriPortRead(HANDLE hComm, LPTSTR buffer, size_t size, bool verbose)
+int32_t colibriPortReceive(HANDLE hComm, char *buffer, size_t size, bool verbose)
 {
 	DWORD received;
-	DWORD count = 0;
-	char rx[COLIBRI_MAX_LINE_LENGTH];
-	bool waitForStart = true;
-	bool done = false;
-	bool useChecksum = false;
-	int checkSumSeparator = -1;
-
-	do
+
+	if (!ReadFile(hComm, buffer, (DWORD)size, &received, NULL))
 	{
-		memset(rx, 0, COLIBRI_MAX_LINE_LENGTH);
-		BOOL success = ReadFile(hComm, rx, COLIBRI_MAX_LINE_LENGTH, &received, NULL);
-		if (!success)
-		{
-			fprintf(stderr, "could not read from port\n");
-			return -1;
-		}
+		fprintf(stderr, "could not read from port\n");
+		return -1;
+	}
 
-        if(verbose && received > 0)
-        {
-	      fprintf(stderr, "RX: %s\n", rx);
-        }		
+	if (verbose && received > 0)
+	{
+		fprintf(stderr, "RX: %.*s\n", (int)received, buffer);
+	}
 
-		for (DWORD i = 0; i < received && !done; i++)
-		{
-			if (waitForStart)
-			{
-				if (rx[i] == COLIBRI_START_NO_CHK || rx[i] == COLIBRI_START_WITH_CHK)
-				{
-					waitForStart = false;
-					if(rx[i] == COLIBRI_START_WITH_CHK)
-					{
-						useChecksum = true;
-					}
-				}
-			}
-			else
-			{
-				if (rx[i] == COLIBRI_STOP1 || rx[i] == COLIBRI_STOP2)
-				{
-					done = true;
-					buffer[count] = 0;
-				}
-				else
-				{
-     			    buffer[count] = rx[i];
-					if(buffer[count] == COLIBRI_CHECKSUM_SEPARATOR)
-					{
-						checkSumSeparator = count;
-					}
-					count++;
-				}
-			}
-		}
-	} while (!done);
+	return (int32_t)received;
+}
+
+uint64_t colibriMilliseconds(void)
+{
+	return GetTickCount64();
+}
+
+HANDLE colibriTcpOpen(const char *address)
+{
+	static bool isStarted = false;
+	char host[COLIBRI_MAX_LINE_LENGTH];
+	const char *port = strrchr(address, ':');
+	struct addrinfo hints = {0};
+	struct addrinfo *result;
+	SOCKET hSocket = INVALID_SOCKET;
+	BOOL flag = TRUE;
+
+	if (!isStarted)
+	{
+		WSADATA data;
+		isStarted = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+	}
+
+	if (port == NULL || (size_t)(port - address) >= sizeof(host))
+	{
+		fprintf(stderr, "Expected HOST:PORT instead of %s\n", address);
+		return INVALID_HANDLE_VALUE;
+	}
+	memcpy(host, address, port - address);
+	host[port - address] = 0;
 
-    if(useChecksum)
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	if (getaddrinfo(host, port + 1, &hints, &result) != 0)
 	{
-		crc_t crcReceived;
-		crc_t crc = crc_init();
-		crc = crc_update(crc, buffer, checkSumSeparator);
-		crc = crc_finalize(crc);
-		crcReceived = atoi(buffer+checkSumSeparator+1);
-		if(crc == crcReceived)
+		fprintf(stderr, "could not resolve %s\n", address);
+		return INVALID_HANDLE_VALUE;
+	}
+	for (struct addrinfo *a = result; a != NULL && hSocket == INVALID_SOCKET; a = a->ai_next)
+	{
+		hSocket = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+		if (hSocket != INVALID_SOCKET && connect(hSocket, a->ai_addr, (int)a->ai_addrlen) == SOCKET_ERROR)
 		{
-          buffer[checkSumSeparator] = 0;
+			closesocket(hSocket);
+			hSocket = INVALID_SOCKET;
 		}
-		else
+	}
+	freeaddrinfo(result);
+
+	if (hSocket == INVALID_SOCKET)
+	{
+		fprintf(stderr, "could not connect to %s\n", address);
+		return INVALID_HANDLE_VALUE;
+	}
+
+	// Commands are short, they must not wait for more data
+	setsockopt(hSocket, IPPROTO_TCP, TCP_NODELAY, (const char *)&flag, sizeof(flag));
+	return (HANDLE)hSocket;
+}
+
+void colibriTcpClose(HANDLE hSocket)
+{
+	if (hSocket != INVALID_HANDLE_VALUE)
+	{
+		closesocket((SOCKET)hSocket);
+	}
+}
+
+bool colibriTcpWrite(HANDLE hSocket, const char *data)
+{
+	size_t size = strlen(data);
+
+	while (size > 0)
+	{
+		int written = send((SOCKET)hSocket, data, (int)size, 0);
+		if (written == SOCKET_ERROR)
 		{
-			fprintf(stderr, "CRC differ: received message %s, calculated crc=%i", buffer, crcReceived);
-			return 0;
+			fprintf(stderr, "could not write to socket\n");
+			return false;
 		}
+		data += written;
+		size -= written;
+	}
+	return true;
+}
+
+int32_t colibriTcpReceive(HANDLE hSocket, char *buffer, size_t size, uint32_t timeout)
+{
+	fd_set set;
+	struct timeval wait = {timeout / 1000, (timeout % 1000) * 1000};
+	int ready;
+	int received;
+
+	FD_ZERO(&set);
+	FD_SET((SOCKET)hSocket, &set);
+	ready = select(0, &set, NULL, NULL, &wait);
+	if (ready == 0)
+	{
+		return 0;
+	}
+
+	received = ready == SOCKET_ERROR ? SOCKET_ERROR : recv((SOCKET)hSocket, buffer, (int)size, 0);
+	if (received <= 0)
+	{
+		fprintf(stderr, received == 0 ? "connection closed\n" : "could not read from socket\n");
+		return -1;
+	}
+	return received;
+}
+
+void *colibriSharedMemoryMap(const char *name, size_t size, bool isWriter, HANDLE *handle)
+{
+	void *memory;
+
+	if (isWriter)
+	{
+		*handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)size, name);
 	}
+	else
+	{
+		*handle = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+	}
+	if (*handle == NULL)
+	{
+		*handle = INVALID_HANDLE_VALUE;
+		return NULL;
+	}
+
+	memory = MapViewOfFile(*handle, isWriter ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, size);
+	if (memory == NULL)
+	{
+		CloseHandle(*handle);
+		*handle = INVALID_HANDLE_VALUE;
+	}
+	return memory;
+}
 
-	return count;
-}
\ No newline at end of file
+void colibriSharedMemoryUnmap(void *memory, size_t size, HANDLE handle)
+{
+	UnmapViewOfFile(memory);
+	CloseHandle(handle);
+}
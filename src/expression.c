@@ -0,0 +1,425 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "expression.h"
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    Expression_t *expression;
+    const char *text;
+    const char *position;
+    const char *const *names;
+    size_t nameCount;
+    size_t depth;
+    bool ok;
+} Parser_t;
+
+static const struct
+{
+    const char *name;
+    ExpressionOp_t op;
+} functions[] = {
+    {"log10", EXPRESSION_LOG10},
+    {"ln", EXPRESSION_LN},
+    {"exp", EXPRESSION_EXP},
+    {"sqrt", EXPRESSION_SQRT},
+    {"abs", EXPRESSION_ABS},
+};
+
+static bool parseSum(Parser_t *parser);
+
+static bool fail(Parser_t *parser, const char *message)
+{
+    if (parser->ok)
+    {
+        snprintf(parser->expression->error, EXPRESSION_ERROR_SIZE, "%s at position %d", message, (int)(parser->position - parser->text) + 1);
+        parser->ok = false;
+    }
+    return false;
+}
+
+static void skipSpaces(Parser_t *parser)
+{
+    while (isspace((unsigned char)*parser->position))
+    {
+        parser->position++;
+    }
+}
+
+static bool accept(Parser_t *parser, char c)
+{
+    skipSpaces(parser);
+    if (*parser->position == c)
+    {
+        parser->position++;
+        return true;
+    }
+    return false;
+}
+
+static double apply(ExpressionOp_t op, double a, double b)
+{
+    switch (op)
+    {
+        case EXPRESSION_ADD:
+            return a + b;
+        case EXPRESSION_SUBTRACT:
+            return a - b;
+        case EXPRESSION_MULTIPLY:
+            return a * b;
+        case EXPRESSION_DIVIDE:
+            return a / b;
+        case EXPRESSION_POWER:
+            return pow(a, b);
+        case EXPRESSION_NEGATE:
+            return -a;
+        case EXPRESSION_LOG10:
+            return log10(a);
+        case EXPRESSION_LN:
+            return log(a);
+        case EXPRESSION_EXP:
+            return exp(a);
+        case EXPRESSION_SQRT:
+            return sqrt(a);
+        case EXPRESSION_ABS:
+            return fabs(a);
+        default:
+            return NAN;
+    }
+}
+
+static bool emit(Parser_t *parser, ExpressionOp_t op, size_t variable, double constant)
+{
+    Expression_t *expression = parser->expression;
+    ExpressionInstruction_t *code = expression->code;
+    size_t length = expression->length;
+    bool binary = op >= EXPRESSION_ADD && op <= EXPRESSION_POWER;
+    bool unary = op >= EXPRESSION_NEGATE;
+
+    // Operations on constants are folded
+    if (binary && length >= 2 && code[length - 2].op == EXPRESSION_CONSTANT && code[length - 1].op == EXPRESSION_CONSTANT)
+    {
+        code[length - 2].constant = apply(op, code[length - 2].constant, code[length - 1].constant);
+        expression->length--;
+        parser->depth--;
+        return true;
+    }
+    if (unary && length >= 1 && code[length - 1].op == EXPRESSION_CONSTANT)
+    {
+        code[length - 1].constant = apply(op, code[length - 1].constant, 0.0);
+        return true;
+    }
+
+    if (length == EXPRESSION_MAX_CODE)
+    {
+        return fail(parser, "Expression too long");
+    }
+
+    if (op == EXPRESSION_VARIABLE || op == EXPRESSION_CONSTANT)
+    {
+        if (++parser->depth > EXPRESSION_MAX_DEPTH)
+        {
+            return fail(parser, "Expression nested too deeply");
+        }
+        expression->depth = parser->depth > expression->depth ? parser->depth : expression->depth;
+    }
+    else if (binary)
+    {
+        parser->depth--;
+    }
+
+    code[length].op = op;
+    code[length].variable = variable;
+    code[length].constant = constant;
+    expression->length++;
+    return true;
+}
+
+static bool parseIdentifier(Parser_t *parser)
+{
+    const char *start = parser->position;
+    size_t length;
+
+    while (isalnum((unsigned char)*parser->position) || *parser->position == '_')
+    {
+        parser->position++;
+    }
+    length = parser->position - start;
+
+    for (size_t f = 0; f < sizeof(functions) / sizeof(functions[0]); f++)
+    {
+        if (strlen(functions[f].name) == length && strncmp(functions[f].name, start, length) == 0)
+        {
+            if (!accept(parser, '('))
+            {
+                return fail(parser, "Expected (");
+            }
+            if (!parseSum(parser))
+            {
+                return false;
+            }
+            if (!accept(parser, ')'))
+            {
+                return fail(parser, "Expected )");
+            }
+            return emit(parser, functions[f].op, 0, 0.0);
+        }
+    }
+
+    for (size_t v = 0; v < parser->nameCount; v++)
+    {
+        if (strlen(parser->names[v]) == length && strncmp(parser->names[v], start, length) == 0)
+        {
+            return emit(parser, EXPRESSION_VARIABLE, v, 0.0);
+        }
+    }
+
+    parser->position = start;
+    return fail(parser, "Unknown name");
+}
+
+static bool parsePrimary(Parser_t *parser)
+{
+    skipSpaces(parser);
+
+    if (accept(parser, '('))
+    {
+        if (!parseSum(parser))
+        {
+            return false;
+        }
+        return accept(parser, ')') || fail(parser, "Expected )");
+    }
+
+    if (isdigit((unsigned char)*parser->position) || *parser->position == '.')
+    {
+        char *end;
+        double value = strtod(parser->position, &end);
+
+        if (end == parser->position)
+        {
+            return fail(parser, "Invalid number");
+        }
+        parser->position = end;
+        return emit(parser, EXPRESSION_CONSTANT, 0, value);
+    }
+
+    if (isalpha((unsigned char)*parser->position) || *parser->position == '_')
+    {
+        return parseIdentifier(parser);
+    }
+
+    return fail(parser, "Expected a number, a name or (");
+}
+
+static bool parseUnary(Parser_t *parser);
+
+// ^ binds stronger than unary minus and is right associative
+static bool parsePower(Parser_t *parser)
+{
+    if (!parsePrimary(parser))
+    {
+        return false;
+    }
+    if (accept(parser, '^'))
+    {
+        return parseUnary(parser) && emit(parser, EXPRESSION_POWER, 0, 0.0);
+    }
+    return true;
+}
+
+static bool parseUnary(Parser_t *parser)
+{
+    if (accept(parser, '-'))
+    {
+        return parseUnary(parser) && emit(parser, EXPRESSION_NEGATE, 0, 0.0);
+    }
+    if (accept(parser, '+'))
+    {
+        return parseUnary(parser);
+    }
+    return parsePower(parser);
+}
+
+static bool parseProduct(Parser_t *parser)
+{
+    if (!parseUnary(parser))
+    {
+        return false;
+    }
+
+    while (true)
+    {
+        if (accept(parser, '*'))
+        {
+            if (!parseUnary(parser) || !emit(parser, EXPRESSION_MULTIPLY, 0, 0.0))
+            {
+                return false;
+            }
+        }
+        else if (accept(parser, '/'))
+        {
+            if (!parseUnary(parser) || !emit(parser, EXPRESSION_DIVIDE, 0, 0.0))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            return true;
+        }
+    }
+}
+
+static bool parseSum(Parser_t *parser)
+{
+    if (!parseProduct(parser))
+    {
+        return false;
+    }
+
+    while (true)
+    {
+        if (accept(parser, '+'))
+        {
+            if (!parseProduct(parser) || !emit(parser, EXPRESSION_ADD, 0, 0.0))
+            {
+                return false;
+            }
+        }
+        else if (accept(parser, '-'))
+        {
+            if (!parseProduct(parser) || !emit(parser, EXPRESSION_SUBTRACT, 0, 0.0))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            return true;
+        }
+    }
+}
+
+bool expressionCompile(Expression_t *self, const char *text, const char *const *names, size_t nameCount)
+{
+    Parser_t parser;
+
+    memset(self, 0, sizeof(Expression_t));
+    parser.expression = self;
+    parser.text = text;
+    parser.position = text;
+    parser.names = names;
+    parser.nameCount = nameCount;
+    parser.depth = 0;
+    parser.ok = true;
+
+    if (parseSum(&parser))
+    {
+        skipSpaces(&parser);
+        if (*parser.position != '\0')
+        {
+            fail(&parser, "Unexpected character");
+        }
+    }
+
+    return parser.ok;
+}
+
+// Every instruction works on a whole block, so the dispatch is paid once
+// per block and the inner loops can be vectorized.
+static void evaluateBlock(const Expression_t *self, const double *const *variables, size_t first, size_t count, double *stack, double *result)
+{
+    size_t depth = 0;
+
+    for (size_t pc = 0; pc < self->length; pc++)
+    {
+        const ExpressionInstruction_t *instruction = &self->code[pc];
+        double *top = stack + depth * EXPRESSION_BLOCK_SIZE;
+        double *b = depth >= 1 ? top - EXPRESSION_BLOCK_SIZE : stack;
+        double *a = depth >= 2 ? b - EXPRESSION_BLOCK_SIZE : stack;
+
+        switch (instruction->op)
+        {
+            case EXPRESSION_VARIABLE:
+                memcpy(top, variables[instruction->variable] + first, count * sizeof(double));
+                depth++;
+                break;
+            case EXPRESSION_CONSTANT:
+                for (size_t i = 0; i < count; i++)
+                {
+                    top[i] = instruction->constant;
+                }
+                depth++;
+                break;
+            case EXPRESSION_ADD:
+                for (size_t i = 0; i < count; i++)
+                {
+                    a[i] += b[i];
+                }
+                depth--;
+                break;
+            case EXPRESSION_SUBTRACT:
+                for (size_t i = 0; i < count; i++)
+                {
+                    a[i] -= b[i];
+                }
+                depth--;
+                break;
+            case EXPRESSION_MULTIPLY:
+                for (size_t i = 0; i < count; i++)
+                {
+                    a[i] *= b[i];
+                }
+                depth--;
+                break;
+            case EXPRESSION_DIVIDE:
+                for (size_t i = 0; i < count; i++)
+                {
+                    a[i] /= b[i];
+                }
+                depth--;
+                break;
+            case EXPRESSION_POWER:
+                for (size_t i = 0; i < count; i++)
+                {
+                    a[i] = pow(a[i], b[i]);
+                }
+                depth--;
+                break;
+            default:
+                for (size_t i = 0; i < count; i++)
+                {
+                    b[i] = apply(instruction->op, b[i], 0.0);
+                }
+                break;
+        }
+    }
+
+    memcpy(result + first, stack, count * sizeof(double));
+}
+
+bool expressionEvaluate(const Expression_t *self, const double *const *variables, size_t count, double *result)
+{
+    double *stack = malloc(self->depth * EXPRESSION_BLOCK_SIZE * sizeof(double));
+
+    if (stack == NULL)
+    {
+        return false;
+    }
+
+    for (size_t first = 0; first < count; first += EXPRESSION_BLOCK_SIZE)
+    {
+        size_t block = count - first < EXPRESSION_BLOCK_SIZE ? count - first : EXPRESSION_BLOCK_SIZE;
+
+        evaluateBlock(self, variables, first, block, stack, result);
+    }
+
+    free(stack);
+    return true;
+}
@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Arithmetic expression over named columns, e.g. "od260 / od280". The text
+// is compiled once into code for a stack machine which is then evaluated
+// for a block of values per instruction.
+//
+// Supported are numbers, variables, + - * / ^, unary minus, parentheses and
+// the functions log10, ln, exp, sqrt and abs.
+
+#define EXPRESSION_MAX_CODE 128
+#define EXPRESSION_MAX_DEPTH 32
+#define EXPRESSION_BLOCK_SIZE 256
+#define EXPRESSION_ERROR_SIZE 128
+
+typedef enum
+{
+    EXPRESSION_VARIABLE,
+    EXPRESSION_CONSTANT,
+    EXPRESSION_ADD,
+    EXPRESSION_SUBTRACT,
+    EXPRESSION_MULTIPLY,
+    EXPRESSION_DIVIDE,
+    EXPRESSION_POWER,
+    EXPRESSION_NEGATE,
+    EXPRESSION_LOG10,
+    EXPRESSION_LN,
+    EXPRESSION_EXP,
+    EXPRESSION_SQRT,
+    EXPRESSION_ABS,
+} ExpressionOp_t;
+
+typedef struct
+{
+    ExpressionOp_t op;
+    size_t variable;
+    double constant;
+} ExpressionInstruction_t;
+
+typedef struct
+{
+    ExpressionInstruction_t code[EXPRESSION_MAX_CODE];
+    size_t length;
+    size_t depth;
+    char error[EXPRESSION_ERROR_SIZE];
+} Expression_t;
+
+// The variables are referenced by their index in names. On failure error
+// describes the problem.
+bool expressionCompile(Expression_t *self, const char *text, const char *const *names, size_t nameCount);
+// variables holds one column per name given to expressionCompile.
+bool expressionEvaluate(const Expression_t *self, const double *const *variables, size_t count, double *result);
@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "fleet.h"
+#include "output.h"
+#include "printerror.h"
+#include "system.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct
+{
+    Colibri_t colibri;
+    char name[COLIBRI_MAX_LINE_LENGTH];
+    Buffer_t output;
+    Error_t ret;
+    bool isStarted;
+    SystemThread_t thread;
+    FleetCommand_t command;
+    int argcCmd;
+    char **argvCmd;
+} FleetDevice_t;
+
+void fleetInit(Fleet_t *self)
+{
+    memset(self, 0, sizeof(Fleet_t));
+}
+
+bool fleetAdd(Fleet_t *self, char *portName)
+{
+    // Two threads must not drive one port
+    for (size_t i = 0; i < self->count; i++)
+    {
+        if (strcmp(self->portNames[i], portName) == 0)
+        {
+            return true;
+        }
+    }
+    if (self->count == FLEET_MAX_DEVICES)
+    {
+        return false;
+    }
+    self->portNames[self->count++] = portName;
+    return true;
+}
+
+bool fleetIsFleet(const Fleet_t *self)
+{
+    return self->isAllDevices || self->count > 1;
+}
+
+// The device is named by its serial number, by the port if it can not be read
+static void fleetDevice(void *argument)
+{
+    FleetDevice_t *device = argument;
+    char serialNumber[COLIBRI_MAX_LINE_LENGTH];
+
+    bufferInit(&device->output);
+    outputCapture(&device->output, device->name);
+    printErrorDevice(device->name);
+
+    if (colibriOpen(&device->colibri) == ERROR_COLIBRI_OK &&
+        colibriGet(&device->colibri, INDEX_SERIALNUMBER, serialNumber, sizeof(serialNumber)) == ERROR_COLIBRI_OK)
+    {
+        snprintf(device->name, sizeof(device->name), "%s", serialNumber);
+    }
+
+    device->ret = device->command(&device->colibri, device->argcCmd, device->argvCmd);
+    colibriClose(&device->colibri);
+}
+
+static Error_t fleetFind(Fleet_t *self, char **found)
+{
+    size_t count = FLEET_MAX_DEVICES - self->count;
+    Error_t ret;
+
+    *found = calloc(FLEET_MAX_DEVICES, FLEET_PORT_NAME_SIZE);
+    if (*found == NULL)
+    {
+        return ERROR_COLIBRI_OUT_OF_MEMORY;
+    }
+
+    ret = colibriFindDevices(*found, FLEET_PORT_NAME_SIZE, &count, false);
+    for (size_t i = 0; i < count; i++)
+    {
+        fleetAdd(self, *found + i * FLEET_PORT_NAME_SIZE);
+    }
+    return ret;
+}
+
+Error_t fleetRun(Fleet_t *self, const Colibri_t *colibri, FleetCommand_t command, int argcCmd, char **argvCmd)
+{
+    FleetDevice_t *devices;
+    char *found = NULL;
+    Error_t ret = ERROR_COLIBRI_OK;
+    size_t failed = 0;
+
+    if (self->isAllDevices && fleetFind(self, &found) != ERROR_COLIBRI_OK && self->count == 0)
+    {
+        free(found);
+        return printError(ERROR_COLIBRI_NOT_FOUND, "No Colibri Module found\n");
+    }
+
+    devices = calloc(self->count, sizeof(FleetDevice_t));
+    if (devices == NULL)
+    {
+        free(found);
+        return printError(ERROR_COLIBRI_OUT_OF_MEMORY, NULL);
+    }
+
+    for (size_t i = 0; i < self->count; i++)
+    {
+        FleetDevice_t *device = &devices[i];
+
+        device->colibri = *colibri;
+        device->colibri.portName = self->portNames[i];
+        device->colibri.isOpen = false;
+        device->colibri.feed = NULL;
+        snprintf(device->name, sizeof(device->name), "%s", self->portNames[i]);
+        device->command = command;
+        device->argcCmd = argcCmd;
+        device->argvCmd = argvCmd;
+        device->isStarted = systemThreadStart(&device->thread, fleetDevice, device);
+        if (!device->isStarted)
+        {
+            device->ret = printError(ERROR_COLIBRI_OUT_OF_MEMORY, "%s: could not start a thread\n", device->name);
+        }
+    }
+
+    // The output is written in the order of the devices
+    for (size_t i = 0; i < self->count; i++)
+    {
+        FleetDevice_t *device = &devices[i];
+
+        if (device->isStarted)
+        {
+            systemThreadJoin(&device->thread);
+            outputAppend(&device->output, device->name);
+            bufferFree(&device->output);
+        }
+        if (device->ret != ERROR_COLIBRI_OK)
+        {
+            failed++;
+            ret = ret == ERROR_COLIBRI_OK ? device->ret : ret;
+        }
+    }
+
+    if (failed > 0)
+    {
+        fprintf(stderr, "%zu of %zu devices failed\n", failed, self->count);
+    }
+
+    free(devices);
+    free(found);
+    return ret;
+}
@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#pragma once
+
+#include "colibri.h"
+
+#define FLEET_MAX_DEVICES 32
+#define FLEET_PORT_NAME_SIZE 1024
+
+// A command run on several devices at once, one thread and one open port per
+// device. The output of every device is tagged with its serial number.
+typedef Error_t (*FleetCommand_t)(Colibri_t *colibri, int argcCmd, char **argvCmd);
+
+typedef struct
+{
+    bool isAllDevices;
+    size_t count;
+    char *portNames[FLEET_MAX_DEVICES];
+} Fleet_t;
+
+void fleetInit(Fleet_t *self);
+// A port already in the fleet is skipped. False if the fleet is full.
+bool fleetAdd(Fleet_t *self, char *portName);
+// True if the command has to run on more than one device
+bool fleetIsFleet(const Fleet_t *self);
+// Runs command on all devices, colibri holds the options for every device.
+// Returns the error of the first device which failed.
+Error_t fleetRun(Fleet_t *self, const Colibri_t *colibri, FleetCommand_t command, int argcCmd, char **argvCmd);
@@ -0,0 +1,298 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "levellingpolicy.h"
+#include "printerror.h"
+#include "system.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// The state file holds the time of the last levelling followed by its
+// values, so a levelling run by someone else is not taken for it.
+#define LEVELLING_POLICY_HEADER "colibri-levelling 1"
+
+static const char *wavelengths[4] = {"230", "260", "280", "340"};
+
+void levellingPolicyInit(LevellingPolicy_t *self)
+{
+    memset(self, 0, sizeof(LevellingPolicy_t));
+    self->maxDrift = LEVELLING_POLICY_MAX_DRIFT;
+}
+
+bool levellingPolicyParse(LevellingPolicy_t *self, int argcCmd, char **argvCmd, int *i)
+{
+    if (strcmp(argvCmd[*i], "--auto-levelling") == 0)
+    {
+        self->isEnabled = true;
+        return true;
+    }
+
+    if (*i + 1 >= argcCmd)
+    {
+        return false;
+    }
+
+    if (strcmp(argvCmd[*i], "--max-age") == 0)
+    {
+        self->maxAge = atof(argvCmd[++(*i)]);
+    }
+    else if (strcmp(argvCmd[*i], "--max-drift") == 0)
+    {
+        self->maxDrift = atof(argvCmd[++(*i)]);
+    }
+    else if (strcmp(argvCmd[*i], "--levelling-state") == 0)
+    {
+        self->stateFile = argvCmd[++(*i)];
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+static void logDecision(const char *format, ...)
+{
+    va_list args;
+
+    fprintf(stderr, "Levelling: ");
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+}
+
+static bool levellingEquals(const Levelling_t *a, const Levelling_t *b)
+{
+    for (int w = 0; w < 4; w++)
+    {
+        if (a[w].result != b[w].result || a[w].current != b[w].current ||
+            a[w].amplificationSample != b[w].amplificationSample || a[w].amplificationReference != b[w].amplificationReference)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns the time of levelling if the state file records it, 0 otherwise.
+static time_t stateRead(const char *file, const Levelling_t *levelling)
+{
+    Levelling_t stored[4];
+    long long at = 0;
+    FILE *fin = file ? fopen(file, "r") : NULL;
+    bool ok;
+
+    if (fin == NULL)
+    {
+        return 0;
+    }
+
+    ok = fscanf(fin, LEVELLING_POLICY_HEADER " %lld", &at) == 1;
+    for (int w = 0; w < 4 && ok; w++)
+    {
+        ok = fscanf(fin, "%u %u %u %u", &stored[w].result, &stored[w].current, &stored[w].amplificationSample, &stored[w].amplificationReference) == 4;
+    }
+    fclose(fin);
+
+    return ok && levellingEquals(stored, levelling) ? (time_t)at : 0;
+}
+
+// Written to FILE.tmp which then replaces FILE.
+static void stateWrite(const char *file, time_t at, const Levelling_t *levelling)
+{
+    size_t size = strlen(file) + sizeof(".tmp");
+    char *tempFile = malloc(size);
+    FILE *fout;
+    bool ok;
+
+    if (tempFile == NULL)
+    {
+        return;
+    }
+    snprintf(tempFile, size, "%s.tmp", file);
+
+    fout = fopen(tempFile, "w");
+    ok = fout != NULL;
+    if (ok)
+    {
+        fprintf(fout, LEVELLING_POLICY_HEADER " %lld", (long long)at);
+        for (int w = 0; w < 4; w++)
+        {
+            fprintf(fout, " %u %u %u %u", levelling[w].result, levelling[w].current, levelling[w].amplificationSample, levelling[w].amplificationReference);
+        }
+        fprintf(fout, "\n");
+        ok = fclose(fout) == 0;
+    }
+    ok = ok && systemReplaceFile(tempFile, file);
+    if (!ok)
+    {
+        remove(tempFile);
+        fprintf(stderr, "Levelling: could not write %s\n", file);
+    }
+    free(tempFile);
+}
+
+static Error_t readTargets(Colibri_t *colibri, LevellingPolicy_t *self)
+{
+    static const int indices[4] = {INDEX_SETUP_TARGET230, INDEX_SETUP_TARGET260, INDEX_SETUP_TARGET280, INDEX_SETUP_TARGET340};
+    char value[20];
+
+    for (int w = 0; w < 4; w++)
+    {
+        Error_t ret = colibriGet(colibri, indices[w], value, sizeof(value));
+
+        if (ret != ERROR_COLIBRI_OK)
+        {
+            return ret;
+        }
+        self->targets[w] = atof(value);
+    }
+    self->hasTargets = true;
+    return ERROR_COLIBRI_OK;
+}
+
+// Largest deviation of a channel from the setup target of its wavelength in
+// percent. Wavelengths without a target are skipped.
+static double baselineDrift(const LevellingPolicy_t *self, const uint32_t *baseline, int *wavelength)
+{
+    double drift = 0.0;
+
+    *wavelength = 0;
+    for (int w = 0; w < 4; w++)
+    {
+        for (int channel = 0; channel < 2 && self->targets[w] > 0.0; channel++)
+        {
+            double d = fabs((double)baseline[2 * w + channel] - self->targets[w]) / self->targets[w] * 100.0;
+
+            if (d > drift)
+            {
+                drift = d;
+                *wavelength = w;
+            }
+        }
+    }
+    return drift;
+}
+
+static Error_t measureBaseline(Colibri_t *colibri, uint32_t *baseline)
+{
+    return colibriBaseline(colibri, &baseline[0], &baseline[1], &baseline[2], &baseline[3], &baseline[4], &baseline[5], &baseline[6], &baseline[7]);
+}
+
+Error_t levellingPolicyBaseline(Colibri_t *colibri, LevellingPolicy_t *self, Levelling_t *levelling, uint32_t *baseline, bool *isLevelled)
+{
+    char reason[100] = "";
+    time_t now = time(NULL);
+    Error_t ret = ERROR_COLIBRI_OK;
+
+    *isLevelled = false;
+
+    if (!self->hasTargets)
+    {
+        ret = readTargets(colibri, self);
+        if (ret != ERROR_COLIBRI_OK)
+        {
+            return ret;
+        }
+    }
+
+    // The last levelling is read once, later ones are known
+    if (!self->hasLevelling)
+    {
+        if (colibriLastLevelling(colibri, &self->levelling[0], &self->levelling[1], &self->levelling[2], &self->levelling[3]) == ERROR_COLIBRI_OK)
+        {
+            self->hasLevelling = true;
+            self->levelledAt = stateRead(self->stateFile, self->levelling);
+        }
+        else
+        {
+            snprintf(reason, sizeof(reason), "no last levelling");
+        }
+    }
+
+    for (int w = 0; w < 4 && reason[0] == '\0'; w++)
+    {
+        if (self->levelling[w].result != SETUPRESULT_OK)
+        {
+            snprintf(reason, sizeof(reason), "last levelling failed at %s nm with result %u", wavelengths[w], self->levelling[w].result);
+        }
+    }
+
+    if (reason[0] == '\0' && self->maxAge > 0.0)
+    {
+        if (self->levelledAt == 0)
+        {
+            snprintf(reason, sizeof(reason), "age of the last levelling unknown");
+        }
+        else if (difftime(now, self->levelledAt) > self->maxAge)
+        {
+            snprintf(reason, sizeof(reason), "age %.0f s over %.0f s", difftime(now, self->levelledAt), self->maxAge);
+        }
+    }
+
+    if (reason[0] == '\0')
+    {
+        int wavelength;
+        double drift;
+
+        ret = measureBaseline(colibri, baseline);
+        if (ret != ERROR_COLIBRI_OK)
+        {
+            return ret;
+        }
+
+        drift = baselineDrift(self, baseline, &wavelength);
+        if (drift > self->maxDrift)
+        {
+            snprintf(reason, sizeof(reason), "baseline drift %.1f %% at %s nm over %.1f %%", drift, wavelengths[wavelength], self->maxDrift);
+        }
+        else if (self->levelledAt != 0)
+        {
+            logDecision("reused, age %.0f s, baseline drift %.1f %%", difftime(now, self->levelledAt), drift);
+        }
+        else
+        {
+            logDecision("reused, baseline drift %.1f %%", drift);
+        }
+    }
+
+    if (reason[0] != '\0')
+    {
+        logDecision("needed, %s", reason);
+
+        ret = colibriLevelling(colibri, &self->levelling[0], &self->levelling[1], &self->levelling[2], &self->levelling[3]);
+        if (ret != ERROR_COLIBRI_OK)
+        {
+            self->hasLevelling = false;
+            return ret;
+        }
+        *isLevelled = true;
+        self->hasLevelling = true;
+        self->levelledAt = now;
+
+        for (int w = 0; w < 4; w++)
+        {
+            if (self->levelling[w].result != SETUPRESULT_OK)
+            {
+                ret = ERROR_COLIBRI_LEVELLING_FAILED;
+            }
+        }
+        if (ret != ERROR_COLIBRI_OK)
+        {
+            return ret;
+        }
+
+        if (self->stateFile)
+        {
+            stateWrite(self->stateFile, now, self->levelling);
+        }
+        ret = measureBaseline(colibri, baseline);
+    }
+
+    memcpy(levelling, self->levelling, sizeof(self->levelling));
+    return ret;
+}
@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#pragma once
+
+#include "colibri.h"
+#include <time.h>
+
+#define LEVELLING_POLICY_MAX_DRIFT 10.0
+
+// Decides before a baseline whether the last levelling of the device can be
+// reused. A new levelling is run if the last one failed, if it is older than
+// maxAge seconds or if the baseline is more than maxDrift percent off the
+// setup target of a wavelength. The age is only known for levellings which
+// were run with the policy and recorded in stateFile, maxAge 0 ignores it.
+typedef struct
+{
+    bool isEnabled;
+    double maxAge;
+    double maxDrift;
+    const char *stateFile;
+    bool hasLevelling;
+    Levelling_t levelling[4];
+    time_t levelledAt;
+    bool hasTargets;
+    double targets[4];
+} LevellingPolicy_t;
+
+void levellingPolicyInit(LevellingPolicy_t *self);
+// Parses the option at argvCmd[*i] if it is a policy option. *i is left at
+// the value of the option.
+bool levellingPolicyParse(LevellingPolicy_t *self, int argcCmd, char **argvCmd, int *i);
+// Measures a baseline and runs a levelling in front of it if needed. The
+// decision is printed to stderr. levelling is the levelling the baseline was
+// measured with, isLevelled is set if a new levelling was run.
+Error_t levellingPolicyBaseline(Colibri_t *colibri, LevellingPolicy_t *self, Levelling_t *levelling, uint32_t *baseline, bool *isLevelled);
@@ -11,8 +11,17 @@
 #include "cmdfwupdate.h"
 #include "cmdlevelling.h"
 #include "cmdsave.h"
+#include "cmdrun.h"
+#include "cmdbatch.h"
+#include "cmdfeed.h"
+#include "cmdconfig.h"
 #include "cmddata.h"
 #include "printerror.h"
+#include "colibriJson.h"
+#include "colibriFeed.h"
+#include "fleet.h"
+#include "output.h"
+#include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -24,23 +33,39 @@ void help(int argcCmd, char **argvCmd)
 	{
 			fprintf(stdout, "Usage: colibri [OPTIONS] COMMAND [ARGUMENTS]\n");
 			fprintf(stdout, "Commands:\n");
-			fprintf(stdout, "  baseline            : starts a baseline measurement and return the values\\n");
+			fprintf(stdout, "  baseline            : starts a baseline measurement and return the values\n");
+			fprintf(stdout, "  batch MANIFEST      : measures and saves the samples of a manifest in one session\n");
 			fprintf(stdout, "  command COMMAND     : executes a command e.g colibri.exe command \"V 0\" returns the value at index 0\n");
+			fprintf(stdout, "  config CMD FILE     : dump saves the configuration of the device to FILE, restore restores it from FILE\n");
 			fprintf(stdout, "  data                : handels data in a data file\n");
+			fprintf(stdout, "  feed NAME           : prints the measurements published to a feed\n");
 			fprintf(stdout, "  fwupdate FILE       : loads a new firmware\n");
-			fprintf(stdout, "  get INDEX           : get a value from the device\n");
+			fprintf(stdout, "  get INDEX ...       : get values from the device\n");
 			fprintf(stdout, "  help COMMAND        : Prints a detailed help\n");
 			fprintf(stdout, "  levelling           : prepares the module for a measurment\n");
 			fprintf(stdout, "  measure             : starts a measurement and return the values\n");
+			fprintf(stdout, "  run                 : runs levelling, baseline, measurements and save in one session\n");
 			fprintf(stdout, "  save                : save the last measurement(s)\n");
 			fprintf(stdout, "  selftest            : executes an internal selftest\n");
-			fprintf(stdout, "  set INDEX VALUE     : set a value in the device\n");
+			fprintf(stdout, "  set INDEX VALUE     : set a value in the device, set INDEX=VALUE ... sets several values\n");
 			fprintf(stdout, "  version             : return the CLI and DLL version\n");
 			fprintf(stdout, "Options:\n");
 			fprintf(stdout, "  --verbose           : prints debug info\n");
 			fprintf(stdout, "  --help -h           : show this help and exit\n");
-			fprintf(stdout, "  --device            : use the given device, if omitted the CLI searchs for a device\n");
+			fprintf(stdout, "  --device            : use the given device, if omitted the CLI searchs for a device.\n");
+			fprintf(stdout, "                        tcp:HOST:PORT connects to a serial to TCP bridge, loopback answers every command with itself\n");
+			fprintf(stdout, "                        Given more than once, the command runs on all the devices at once\n");
+			fprintf(stdout, "  --all-devices       : run the command on all attached devices at once\n");
 			fprintf(stdout, "  --use-checksum      : use the protocol with a checksum\n");
+			fprintf(stdout, "  --no-arena          : allocate JSON data with malloc instead of an arena\n");
+			fprintf(stdout, "  --publish NAME      : publish every measurement and baseline to the shared memory feed NAME\n");
+			fprintf(stdout, "  --format            : output of get, measure, baseline, levelling, selftest, run, batch, feed, data print and\n");
+			fprintf(stdout, "                        data watch as text (default), json, ndjson or binary, see README.md for the records.\n");
+			fprintf(stdout, "                        data stats, export, sweep, index and query only print text and fail with another format\n");
+			fprintf(stdout, "\n");
+			fprintf(stdout, "With several devices get, set, measure, baseline, levelling, selftest, fwupdate and command run in one thread\n");
+			fprintf(stdout, "per device. Every output line starts with the serial number of its device, with --format every record has\n");
+			fprintf(stdout, "the field device. The exit code is the one of the first device which failed.\n");
 			fprintf(stdout, "\n");
 			fprintf(stdout, "The commandline tool returns the following exit codes:\n");
 			fprintf(stdout, "    0: No error.\n");
@@ -59,6 +84,11 @@ void help(int argcCmd, char **argvCmd)
 			fprintf(stdout, "  203: Colibri Module not found\n");
 			fprintf(stdout, "  204: File not found\n");
 			fprintf(stdout, "  207: Unexpected number of measurements.\n");
+			fprintf(stdout, "  208: Out of memory.\n");
+			fprintf(stdout, "  209: File write error.\n");
+			fprintf(stdout, "  210: Invalid file format.\n");
+			fprintf(stdout, "  211: Verify failed.\n");
+			fprintf(stdout, "  212: All measurements rejected as outliers.\n");
 	}
 	else
 	{
@@ -67,7 +97,10 @@ void help(int argcCmd, char **argvCmd)
 			if(strcmp(argvCmd[1], "get") == 0)
 			{
 				fprintf(stdout, "Usage: colibri get INDEX\n");
+				fprintf(stdout, "       colibri get INDEX|FIRST-LAST ...\n");
 				fprintf(stdout, "  Get a value from the device\n");
+				fprintf(stdout, "  With several indices or a range, e.g. get 0 1 2 60-65 80-83, all values are read with up to %d commands at once\n", COLIBRI_PIPELINE_DEPTH);
+				fprintf(stdout, "  over one open port. Every value is printed as INDEX VALUE, with --format as an indexValue record.\n");
 				fprintf(stdout, "INDEX:\n");
 				fprintf(stdout, "   0: Firmware version\n");
 				fprintf(stdout, "   1: Serial number\n");
@@ -91,7 +124,10 @@ void help(int argcCmd, char **argvCmd)
 			else if(strcmp(argvCmd[1], "set") == 0)
 			{
 				fprintf(stdout, "Usage: colibri set INDEX VALUE\n");
+				fprintf(stdout, "       colibri set INDEX=VALUE ...\n");
 				fprintf(stdout, "  Set a value in the device\n");
+				fprintf(stdout, "  With INDEX=VALUE pairs, e.g. set 23=5000 33=5000, all values are written with up to %d commands at once\n", COLIBRI_PIPELINE_DEPTH);
+				fprintf(stdout, "  over one open port.\n");
 				fprintf(stdout, "WARNING:\n");
 				fprintf(stdout, "  Changing a value can damage the device or lead to incorrect results!\n");
 				fprintf(stdout, "INDEX:\n");
@@ -129,9 +165,60 @@ void help(int argcCmd, char **argvCmd)
 			}
 			else if(strcmp(argvCmd[1], "save") == 0)
 			{
-				fprintf(stdout, "Usage: colibri save [FILE] [COMMENT]\n");
+				fprintf(stdout, "Usage: colibri save [--average N] [--outlier-limit K] [FILE] [COMMENT]\n");
 				fprintf(stdout, "  Saves the levelling data and the last measurements in the given file FILE as a JSON file. If the file already exists, the data are appended.\n");
 				fprintf(stdout, "  The optional string COMMENT is added as a comment to the measurement in the JSON file.\n");
+				fprintf(stdout, "  Every measurement gets the UTC time of the save as timestamp.\n");
+				fprintf(stdout, "  With --average N the last N measurements are averaged into the measurement as with measure --average,\n");
+				fprintf(stdout, "  e.g. after measure was run N times. --outlier-limit is the same as for measure.\n");
+			}
+			else if(strcmp(argvCmd[1], "config") == 0)
+			{
+				fprintf(stdout, "Usage: colibri config dump FILE\n");
+				fprintf(stdout, "       colibri config restore FILE\n");
+				fprintf(stdout, "  dump saves the read-only firmware version, serial number and hardware type to device and the settings 23 to 83\n");
+				fprintf(stdout, "  (see 'colibri help get') to values of the JSON file FILE and checks the written file.\n");
+				fprintf(stdout, "  restore sets the values of FILE which differ from the device and reads them back to check them.\n");
+				fprintf(stdout, "  device is not restored, a read-only index in values is an error. The changed settings are printed to stderr.\n");
+				fprintf(stdout, "  The values are read and written with up to %d commands at once over one open port.\n", COLIBRI_PIPELINE_DEPTH);
+			}
+			else if(strcmp(argvCmd[1], "batch") == 0)
+			{
+				fprintf(stdout, "Usage: colibri batch [OPTIONS] MANIFEST\n");
+				fprintf(stdout, "  Measures the samples of the CSV file MANIFEST over one open port and saves every sample as soon as it is measured.\n");
+				fprintf(stdout, "  Every line of MANIFEST is SAMPLEID,COMMENT,AIR. COMMENT and AIR may be left out, AIR is yes or no, default is no.\n");
+				fprintf(stdout, "  Empty lines and lines starting with # are skipped. The first other line is a header if its first field is SAMPLEID, SAMPLE or ID.\n");
+				fprintf(stdout, "  The levelling runs once, then every sample gets a baseline, the air measurement if AIR is yes and the measurement.\n");
+				fprintf(stdout, "  A sample is saved and calculated in the background while the next sample is measured.\n");
+				fprintf(stdout, "  The comment of a saved sample is SAMPLEID: COMMENT. If the batch is interrupted, starting it again\n");
+				fprintf(stdout, "  continues behind the last saved sample.\n");
+				fprintf(stdout, "  The progress and the estimated remaining time are printed to stderr.\n");
+				fprintf(stdout, "Options:\n");
+				fprintf(stdout, "  --out         : JSON file for the measurements. Default is MANIFEST with the extension .json\n");
+				fprintf(stdout, "  --wait        : wait for enter before every step, e.g. to move the cuvette\n");
+				fprintf(stdout, "  --blanks      : number of blanks from the begining. Default is 1\n");
+				fprintf(stdout, "  --pathLength  : path length in [mm]. Default is 1.0\n");
+				fprintf(stdout, "  --a260unit    : for dsDNA use 50, for ssDNA use 33 and for ssRNA use 40. Default is 50.\n");
+				fprintf(stdout, "  --auto-levelling : check the levelling before every baseline instead of levelling once, with --max-age, --max-drift and --levelling-state as for baseline\n");
+				fprintf(stdout, "Output:\n");
+				fprintf(stdout, "  INDEX OD_230 OD_260 OD_280 OD_340 CONCENTRATION COMMENT\n");
+			}
+			else if(strcmp(argvCmd[1], "run") == 0)
+			{
+				fprintf(stdout, "Usage: colibri run [OPTIONS]\n");
+				fprintf(stdout, "  Runs levelling, baseline, the air measurement with --air and the measurement over one open port\n");
+				fprintf(stdout, "  and saves the measured values, without reading them back from the device.\n");
+				fprintf(stdout, "  The values of every step are printed to stdout like the single commands do, the duration of every step to stderr.\n");
+				fprintf(stdout, "Options:\n");
+				fprintf(stdout, "  --air         : measure the empty cuvette after the baseline\n");
+				fprintf(stdout, "  --comment     : comment of the saved measurement\n");
+				fprintf(stdout, "  --out         : save the measurement to the given JSON file, without --out nothing is saved\n");
+				fprintf(stdout, "  --wait        : wait for enter before the air measurement and the measurement, e.g. to move the cuvette\n");
+				fprintf(stdout, "  --auto-levelling : run the levelling only if needed, with --max-age, --max-drift and --levelling-state as for baseline\n");
+				fprintf(stdout, "  --average     : average the air measurement and the measurement over N measurements as with measure --average\n");
+				fprintf(stdout, "  --outlier-limit : outlier limit for --average, see measure\n");
+				fprintf(stdout, "Output:\n");
+				fprintf(stdout, "  the output of levelling, baseline, measure (air) and measure\n");
 			}
 			else if(strcmp(argvCmd[1], "data") == 0)
 			{
@@ -140,13 +227,112 @@ void help(int argcCmd, char **argvCmd)
 				fprintf(stdout, "Output:\n");
 				fprintf(stdout, "  OD_230 OD_260 OD_280 OD_340 CONCENTRATION in ng/ul\n");
 				fprintf(stdout, "\n");
-				fprintf(stdout, "Usage: data calculate [OPTIONS] FILE\n");
-				fprintf(stdout, "  Calculates the optical density and concentration in the given file and adds the values to the file.\n");
+				fprintf(stdout, "Usage: data calculate [OPTIONS] FILE|DIRECTORY...\n");
+				fprintf(stdout, "  Calculates the optical density and concentration in the given files and adds the values to the files.\n");
+				fprintf(stdout, "  For a directory all JSON files (*.json) and archives in it are calculated.\n");
+				fprintf(stdout, "  JSON files are read and written one measurement at a time, so files of any size can be calculated.\n");
 				fprintf(stdout, "  To calculate the values at least the first value must be a blank.\n");
 				fprintf(stdout, "Options:\n");
 				fprintf(stdout, "  --blanks      : number of blanks from the begining. Default is 1\n");
 				fprintf(stdout, "  --pathLength  : path length in [mm]. Default is 1.0\n");
 				fprintf(stdout, "  --a260unit    : for dsDNA use 50, for ssDNS use 33 and for ssRNA use 40. Default is 50.\n");
+				fprintf(stdout, "  --jobs        : number of files calculated in parallel, 0 for one per CPU. Default is 1.\n");
+				fprintf(stdout, "  --expr        : NAME=EXPRESSION, stores the value of EXPRESSION as NAME in the calculated values. Can be repeated.\n");
+				fprintf(stdout, "                  EXPRESSION uses numbers, + - * / ^, parentheses, log10 ln exp sqrt abs and the names\n");
+				fprintf(stdout, "                  od230..od340 concentration sample230.. reference230.. baselineSample230.. baselineReference230..\n");
+				fprintf(stdout, "                  airSample230.. airReference230.. and the names of the expressions before, e.g. ratio=od260/od280.\n");
+				fprintf(stdout, "                  Only JSON files can store expressions.\n");
+				fprintf(stdout, "\n");
+				fprintf(stdout, "Usage: data reformat --compact|--pretty FILE\n");
+				fprintf(stdout, "  Rewrites the file FILE without whitespace (--compact) or indented (--pretty).\n");
+				fprintf(stdout, "  Later commands keep the layout of the file.\n");
+				fprintf(stdout, "\n");
+				fprintf(stdout, "Usage: data convert [--compact] INPUT OUTPUT\n");
+				fprintf(stdout, "  Converts the JSON file INPUT into the binary archive OUTPUT or the archive INPUT into the JSON file OUTPUT.\n");
+				fprintf(stdout, "  All data commands read archives as well as JSON files.\n");
+				fprintf(stdout, "Options:\n");
+				fprintf(stdout, "  --compact     : write the JSON file without whitespace.\n");
+				fprintf(stdout, "\n");
+				fprintf(stdout, "Usage: data index DIRECTORY\n");
+				fprintf(stdout, "  Creates or updates the catalog of all data files in DIRECTORY. Only new and changed files are read.\n");
+				fprintf(stdout, "\n");
+				fprintf(stdout, "Usage: data query [OPTIONS] DIRECTORY\n");
+				fprintf(stdout, "  Lists the measurements matching all options from the catalog of DIRECTORY.\n");
+				fprintf(stdout, "Options:\n");
+				fprintf(stdout, "  --comment       : the comment contains the given text\n");
+				fprintf(stdout, "  --serialnumber  : serial number of the device\n");
+				fprintf(stdout, "  --firmware      : firmware version of the device\n");
+				fprintf(stdout, "  --after         : saved at or after the given UTC time, e.g. 2024-05-01 or 2024-05-01T12:00:00Z\n");
+				fprintf(stdout, "  --before        : saved before the given UTC time\n");
+				fprintf(stdout, "  --print         : print the calculated values, only the matching files are read\n");
+				fprintf(stdout, "Output:\n");
+				fprintf(stdout, "  FILE INDEX TIMESTAMP COMMENT\n");
+				fprintf(stdout, "  FILE INDEX OD_230 OD_260 OD_280 OD_340 CONCENTRATION COMMENT with --print\n");
+				fprintf(stdout, "\n");
+				fprintf(stdout, "Usage: data stats [OPTIONS] FILE|DIRECTORY...\n");
+				fprintf(stdout, "  Prints count, mean, standard deviation and coefficient of variation of the calculated values in the given files.\n");
+				fprintf(stdout, "  The files are read one after the other, only one accumulator per group and value is kept.\n");
+				fprintf(stdout, "Options:\n");
+				fprintf(stdout, "  --group       : none, comment, serialnumber or role. Default is none\n");
+				fprintf(stdout, "                  comment groups by the comment without a trailing number, role by blank and sample\n");
+				fprintf(stdout, "  --prefix      : group by the first N characters of the comment\n");
+				fprintf(stdout, "  --calculate   : calculate the values from the raw counts instead of using the stored values\n");
+				fprintf(stdout, "  --blanks      : number of blanks from the begining, used by --calculate and --group role. Default is 1\n");
+				fprintf(stdout, "  --pathLength  : path length in [mm], used by --calculate. Default is 1.0\n");
+				fprintf(stdout, "  --a260unit    : for dsDNA use 50, for ssDNA use 33 and for ssRNA use 40, used by --calculate. Default is 50.\n");
+				fprintf(stdout, "Output:\n");
+				fprintf(stdout, "  GROUP VALUE COUNT MEAN STDDEV CV in %%\n");
+				fprintf(stdout, "\n");
+				fprintf(stdout, "Usage: data export [OPTIONS] FILE\n");
+				fprintf(stdout, "  Writes the measurements of FILE as a table with one row per measurement and a header row.\n");
+				fprintf(stdout, "  The file is read in chunks, so any size of file can be exported.\n");
+				fprintf(stdout, "Options:\n");
+				fprintf(stdout, "  --format      : csv or tsv. Default is csv\n");
+				fprintf(stdout, "  --columns     : comma separated list of columns and groups. Default is index,comment,od,concentration\n");
+				fprintf(stdout, "                  columns: index comment timestamp serialnumber firmware od_230..od_340 concentration\n");
+				fprintf(stdout, "                           ROLE_sample_WL ROLE_reference_WL with ROLE baseline, air or sample\n");
+				fprintf(stdout, "                           amplificationSample_WL amplificationReference_WL current_WL result_WL resultText_WL\n");
+				fprintf(stdout, "                  groups:  od, raw, levelling and all\n");
+				fprintf(stdout, "  --output      : write to the given file instead of stdout\n");
+				fprintf(stdout, "  Missing values are empty.\n");
+				fprintf(stdout, "\n");
+				fprintf(stdout, "Usage: data sweep [OPTIONS] FILE\n");
+				fprintf(stdout, "  Calculates FILE for every combination of the given parameter values and writes one row per combination and measurement.\n");
+				fprintf(stdout, "  The file is read once and the optical densities against the baseline are calculated once for all combinations.\n");
+				fprintf(stdout, "  The file is not changed.\n");
+				fprintf(stdout, "Options:\n");
+				fprintf(stdout, "  --blanks      : numbers of blanks from the begining. Default is 1\n");
+				fprintf(stdout, "  --pathLength  : path lengths in [mm]. Default is 1.0\n");
+				fprintf(stdout, "  --a260unit    : a260 units. Default is 50\n");
+				fprintf(stdout, "                  The values are a comma separated list of values and ranges FROM:TO:STEP, e.g. 1,2,5 or 0.5:2:0.5\n");
+				fprintf(stdout, "  --format      : csv or tsv. Default is csv\n");
+				fprintf(stdout, "  --output      : write to the given file instead of stdout\n");
+				fprintf(stdout, "Output:\n");
+				fprintf(stdout, "  blanks pathLength a260unit index comment od_230 od_260 od_280 od_340 concentration\n");
+				fprintf(stdout, "\n");
+				fprintf(stdout, "Usage: data watch [OPTIONS] FILE\n");
+				fprintf(stdout, "  Prints the calculated values of the JSON file FILE and then the values of every measurement saved to it, until it is stopped.\n");
+				fprintf(stdout, "  Only the new measurements are read after a save. The file is not changed.\n");
+				fprintf(stdout, "  The measurements used as blanks are calculated with the blanks saved up to them.\n");
+				fprintf(stdout, "Options:\n");
+				fprintf(stdout, "  --blanks      : number of blanks from the begining. Default is 1\n");
+				fprintf(stdout, "  --pathLength  : path length in [mm]. Default is 1.0\n");
+				fprintf(stdout, "  --a260unit    : for dsDNA use 50, for ssDNA use 33 and for ssRNA use 40. Default is 50.\n");
+				fprintf(stdout, "Output:\n");
+				fprintf(stdout, "  INDEX OD_230 OD_260 OD_280 OD_340 CONCENTRATION COMMENT\n");
+				fprintf(stdout, "\n");
+				fprintf(stdout, "Usage: data generate [OPTIONS] FILE\n");
+				fprintf(stdout, "  Writes a data file with generated measurements in the format of save, e.g. for performance tests.\n");
+				fprintf(stdout, "  The measurements only depend on the options and the seed, so the formats hold the same measurements.\n");
+				fprintf(stdout, "  JSON files are written in batches, so files of any size can be generated.\n");
+				fprintf(stdout, "Options:\n");
+				fprintf(stdout, "  --count       : number of measurements. Default is 1000\n");
+				fprintf(stdout, "  --blanks      : number of blanks from the begining, they have an air measurement. Default is 1\n");
+				fprintf(stdout, "  --air         : fraction of the other measurements with an air measurement, 0 to 1. Default is 0\n");
+				fprintf(stdout, "  --noise       : none, uniform or gaussian noise of the counts. Default is gaussian\n");
+				fprintf(stdout, "  --level       : relative standard deviation (gaussian) or maximum (uniform) of the noise. Default is 0.01\n");
+				fprintf(stdout, "  --seed        : seed of the random numbers. Default is 1\n");
+				fprintf(stdout, "  --format      : pretty, compact or archive. Default is pretty\n");
 			}
 			else if(strcmp(argvCmd[1], "measure") == 0)
 			{
@@ -155,14 +341,27 @@ void help(int argcCmd, char **argvCmd)
 				fprintf(stdout, "Usage: colibri measure LAST\n");
 				fprintf(stdout, "  Retrives the last LAST measurement and print the values to stdout.\n");
 				fprintf(stdout, "  The last measurement is at 0, the second last 1.\n");
+				fprintf(stdout, "Usage: colibri measure --average N [--outlier-limit K]\n");
+				fprintf(stdout, "  Measures N times over one open port and prints the mean and the standard deviation of every channel.\n");
+				fprintf(stdout, "  A measurement is left out if one of its channels is more than K times the scaled median absolute deviation\n");
+				fprintf(stdout, "  (at least one count) away from the median of the channel. Default for K is 3.5. The number of measurements used is printed to stderr.\n");
 				fprintf(stdout, "Output: all units in [uV]\n");
 				fprintf(stdout, "  SAMPLE_230 REFERENCE_230 SAMPLE_260 REFERENCE_260 SAMPLE_280 REFERENCE_280 SAMPLE_340 REFERENCE_340\n");
+				fprintf(stdout, "  with --average a second line with the standard deviations in the same order\n");
 			}
 			else if(strcmp(argvCmd[1], "baseline") == 0)
 			{
-				fprintf(stdout, "Usage: colibri baseline\n");
+				fprintf(stdout, "Usage: colibri baseline [OPTIONS]\n");
 				fprintf(stdout, "  If a levelling is needed, the command levelling is executed before a measurement is started. For this measurement, the cuvette holder must be empty.\n");
 				fprintf(stdout, "  The firmware has an internal storage for up to ten measurements. The command baseline clears this storage.\n");
+				fprintf(stdout, "  With --auto-levelling the last levelling is reused unless it failed, it is older than --max-age or the baseline\n");
+				fprintf(stdout, "  is more than --max-drift off the setup target of a wavelength (index 80 to 83). Otherwise a levelling is run\n");
+				fprintf(stdout, "  and the baseline is repeated. The decision is printed to stderr.\n");
+				fprintf(stdout, "Options:\n");
+				fprintf(stdout, "  --auto-levelling  : run a levelling in front of the baseline only if needed\n");
+				fprintf(stdout, "  --max-age         : maximum age of the last levelling in [s], needs --levelling-state. Default is any age\n");
+				fprintf(stdout, "  --max-drift       : maximum deviation of the baseline from the setup targets in [%%]. Default is 10\n");
+				fprintf(stdout, "  --levelling-state : file with the time of the last levelling run with --auto-levelling\n");
 				fprintf(stdout, "Output: all units in [uV]\n");
 				fprintf(stdout, "  SAMPLE_230 REFERENCE_230 SAMPLE_260 REFERENCE_260 SAMPLE_280 REFERENCE_280 SAMPLE_340 REFERENCE_340\n");
 			}
@@ -178,6 +377,15 @@ void help(int argcCmd, char **argvCmd)
 				fprintf(stdout, "  If the result is not ok, the must common case is that the cuvette guide is blocking the optical path\n");
 				fprintf(stdout, "  or a cuvette is stuck in the cuvette guide.\n");
 			}
+			else if(strcmp(argvCmd[1], "feed") == 0)
+			{
+				fprintf(stdout, "Usage: colibri feed [--count N] NAME\n");
+				fprintf(stdout, "  Prints the measurements and baselines published with --publish NAME by other colibri processes as they arrive.\n");
+				fprintf(stdout, "  Runs until it is stopped, with --count until N records are printed. Use --format ndjson for a JSON record per line.\n");
+				fprintf(stdout, "  The shared memory ring and the reader functions are described in colibriFeed.h.\n");
+				fprintf(stdout, "Output: all units in [uV]\n");
+				fprintf(stdout, "  SAMPLE_230 REFERENCE_230 SAMPLE_260 REFERENCE_260 SAMPLE_280 REFERENCE_280 SAMPLE_340 REFERENCE_340\n");
+			}
 			else if(strcmp(argvCmd[1], "fwupdate") == 0)
 			{
 				fprintf(stdout, "Usage: colibri fwupdate SREC_FILE\n");
@@ -201,14 +409,64 @@ void help(int argcCmd, char **argvCmd)
 }
 
 
-int main(int argc, char *argv[])
+// Commands which talk to one device, they can run on several devices at once
+static bool isDeviceCommand(int argcCmd, char **argvCmd)
+{
+	return (strcmp(argvCmd[0], "get") == 0 && argcCmd >= 2) ||
+		   (strcmp(argvCmd[0], "set") == 0 && argcCmd >= 2) ||
+		   strcmp(argvCmd[0], "measure") == 0 ||
+		   strcmp(argvCmd[0], "baseline") == 0 ||
+		   strcmp(argvCmd[0], "levelling") == 0 ||
+		   strcmp(argvCmd[0], "selftest") == 0 ||
+		   (strcmp(argvCmd[0], "fwupdate") == 0 && argcCmd == 2) ||
+		   (strcmp(argvCmd[0], "command") == 0 && argcCmd == 2);
+}
+
+static Error_t deviceCommand(Colibri_t *colibri, int argcCmd, char **argvCmd)
+{
+	if (strcmp(argvCmd[0], "get") == 0)
+	{
+		return cmdGet(colibri, argcCmd, argvCmd);
+	}
+	else if (strcmp(argvCmd[0], "set") == 0)
+	{
+		return cmdSet(colibri, argcCmd, argvCmd);
+	}
+	else if (strcmp(argvCmd[0], "measure") == 0)
+	{
+		return cmdMeasure(colibri, argcCmd, argvCmd);
+	}
+	else if (strcmp(argvCmd[0], "baseline") == 0)
+	{
+		return cmdBaseline(colibri, argcCmd, argvCmd);
+	}
+	else if (strcmp(argvCmd[0], "levelling") == 0)
+	{
+		return cmdLevelling(colibri);
+	}
+	else if (strcmp(argvCmd[0], "selftest") == 0)
+	{
+		return cmdSelftest(colibri);
+	}
+	else if (strcmp(argvCmd[0], "fwupdate") == 0)
+	{
+		return cmdFwUpdate(colibri, argvCmd[1]);
+	}
+	else
+	{
+		return cmdCommand(colibri, argvCmd[1]);
+	}
+}
+
+// Parses the options and runs the command. The feed is set up here and
+// closed by main, whatever path this takes.
+static Error_t run(Colibri_t *colibri, ColibriFeed_t *feed, Fleet_t *fleet, int argc, char *argv[])
 {
 	Error_t ret = ERROR_COLIBRI_OK;
 	int argcCmd = argc;
 	char **argvCmd = argv;
 	bool options = true;
 	int i = 1;
-	Colibri_t colibri = {0};
 
 	while (i < argc && options)
 	{
@@ -216,21 +474,59 @@ int main(int argc, char *argv[])
 		{
 			if (strcmp(argv[i], "--verbose") == 0)
 			{
-				colibri.verbose = true;
+				colibri->verbose = true;
 			}
 			else if (strcmp(argv[i], "--use-checksum") == 0)
 			{
-				colibri.useChecksum = true;
+				colibri->useChecksum = true;
+			}
+			else if (strcmp(argv[i], "--no-arena") == 0)
+			{
+				colibriJsonUseArena(false);
 			}
 			else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0)
 			{
 				help(0, NULL);
 				return ERROR_COLIBRI_OK;
 			}
+			else if ((strcmp(argv[i], "--format") == 0) && (i + 1 < argc))
+			{
+				OutputFormat_t format;
+
+				i++;
+				if (!outputParseFormat(argv[i], &format))
+				{
+					return printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION, "Unknown format: %s\n", argv[i]);
+				}
+				outputSetFormat(format);
+			}
+			else if ((strcmp(argv[i], "--publish") == 0) && (i + 1 < argc))
+			{
+				i++;
+				if (colibri->feed)
+				{
+					colibriFeedClose(colibri->feed);
+					colibri->feed = NULL;
+				}
+				ret = colibriFeedCreate(feed, argv[i]);
+				if (ret != ERROR_COLIBRI_OK)
+				{
+					return printError(ret, "Could not create the feed %s\n", argv[i]);
+				}
+				colibri->feed = feed;
+			}
 			else if ((strcmp(argv[i], "--device") == 0) && (i + 1 < argc))
 			{
 				i++;
-				colibri.portName = argv[i];
+				colibri->portName = argv[i];
+				if (!fleetAdd(fleet, argv[i]))
+				{
+					return printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION, "More than %i devices\n", FLEET_MAX_DEVICES);
+				}
+			}
+			else if (strcmp(argv[i], "--all-devices") == 0)
+			{
+				fleet->isAllDevices = true;
 			}
 			else
 			{
@@ -247,51 +543,53 @@ int main(int argc, char *argv[])
 	argcCmd = argc - i;
 	argvCmd = argv + i;
 
+	if (colibri->feed && fleetIsFleet(fleet))
+	{
+		return printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION, "--publish can only be used with one device\n");
+	}
+
 	if (argcCmd > 0)
 	{
-		if (strcmp(argvCmd[0], "get") == 0 && argcCmd == 2)
+		if (isDeviceCommand(argcCmd, argvCmd) && fleetIsFleet(fleet))
 		{
-			return cmdGet(&colibri, argvCmd[1]);
+			return fleetRun(fleet, colibri, deviceCommand, argcCmd, argvCmd);
 		}
-		else if (strcmp(argvCmd[0], "set") == 0 && argcCmd == 3)
+		else if (isDeviceCommand(argcCmd, argvCmd))
 		{
-			return cmdSet(&colibri, argvCmd[1], argvCmd[2]);
+			return deviceCommand(colibri, argcCmd, argvCmd);
 		}
-		else if (strcmp(argvCmd[0], "measure") == 0)
+		else if (fleetIsFleet(fleet) && (strcmp(argvCmd[0], "save") == 0 || strcmp(argvCmd[0], "run") == 0 || strcmp(argvCmd[0], "batch") == 0 ||
+		                                   strcmp(argvCmd[0], "config") == 0))
 		{
-			return cmdMeasure(&colibri);
-		}
-		else if (strcmp(argvCmd[0], "baseline") == 0)
-		{
-			return cmdBaseline(&colibri);
-		}
-		else if (strcmp(argvCmd[0], "levelling") == 0)
-		{
-			return cmdLevelling(&colibri);
+			return printError(ERROR_COLIBRI_UNKOWN_COMMAND_LINE_ARGUMENT, "'%s' can only run on one device.\n", argvCmd[0]);
 		}
 		else if (strcmp(argvCmd[0], "version") == 0)
 		{
 			fprintf(stdout, "command-line interface:%s library:%s\n", VERSION_TOOL, colibriVersion());
 		}
-		else if (strcmp(argvCmd[0], "selftest") == 0)
+		else if (strcmp(argvCmd[0], "data") == 0)
 		{
-			return cmdSelftest(&colibri);
+			return cmdData(colibri, argcCmd, argvCmd);
 		}
-		else if (strcmp(argvCmd[0], "fwupdate") == 0 && argcCmd == 2)
+		else if (strcmp(argvCmd[0], "save") == 0)
 		{
-			return cmdFwUpdate(&colibri, argvCmd[1]);
+			return cmdSave(colibri, argcCmd, argvCmd);
 		}
-		else if (strcmp(argvCmd[0], "command") == 0 && argcCmd == 2)
+		else if (strcmp(argvCmd[0], "run") == 0)
 		{
-			return cmdCommand(&colibri, argvCmd[1]);
+			return cmdRun(colibri, argcCmd, argvCmd);
 		}
-		else if (strcmp(argvCmd[0], "data") == 0)
+		else if (strcmp(argvCmd[0], "batch") == 0)
 		{
-			return cmdData(&colibri, argcCmd, argvCmd);
+			return cmdBatch(colibri, argcCmd, argvCmd);
 		}
-		else if (strcmp(argvCmd[0], "save") == 0)
+		else if (strcmp(argvCmd[0], "config") == 0)
 		{
-			return cmdSave(&colibri, argcCmd, argvCmd);
+			return cmdConfig(colibri, argcCmd, argvCmd);
+		}
+		else if (strcmp(argvCmd[0], "feed") == 0)
+		{
+			return cmdFeed(colibri, argcCmd, argvCmd);
 		}
 		else if (strcmp(argvCmd[0], "help") == 0)
 		{
@@ -309,4 +607,22 @@ int main(int argc, char *argv[])
 	}
 
 	return ret;
-}
\ No newline at end of file
+}
+
+int main(int argc, char *argv[])
+{
+	Colibri_t colibri = {0};
+	ColibriFeed_t feed;
+	Fleet_t fleet;
+	Error_t ret;
+
+	atexit(outputClose);
+	fleetInit(&fleet);
+
+	ret = run(&colibri, &feed, &fleet, argc, argv);
+	if (colibri.feed)
+	{
+		colibriFeedClose(colibri.feed);
+	}
+	return ret;
+}
@@ -0,0 +1,509 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "numberformat.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+// Grisu2 after Florian Loitsch, "Printing Floating-Point Numbers Quickly and
+// Accurately with Integers" (PLDI 2010). The digits always parse back to the
+// same double and are the shortest possible in the vast majority of cases.
+
+static const char digitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static size_t formatUint64(char *buffer, uint64_t value)
+{
+    char tmp[20];
+    char *p = tmp + sizeof(tmp);
+    size_t length;
+
+    while (value >= 100)
+    {
+        unsigned int pair = (unsigned int)(value % 100);
+        value /= 100;
+        p -= 2;
+        memcpy(p, digitPairs + 2 * pair, 2);
+    }
+    if (value >= 10)
+    {
+        p -= 2;
+        memcpy(p, digitPairs + 2 * value, 2);
+    }
+    else
+    {
+        *--p = (char)('0' + value);
+    }
+
+    length = tmp + sizeof(tmp) - p;
+    memcpy(buffer, p, length);
+    buffer[length] = '\0';
+    return length;
+}
+
+size_t formatUint32(char *buffer, uint32_t value)
+{
+    return formatUint64(buffer, value);
+}
+
+size_t formatInt64(char *buffer, int64_t value)
+{
+    if (value < 0)
+    {
+        buffer[0] = '-';
+        return 1 + formatUint64(buffer + 1, 0 - (uint64_t)value);
+    }
+    return formatUint64(buffer, (uint64_t)value);
+}
+
+typedef struct
+{
+    uint64_t f;
+    int e;
+} DiyFp_t;
+
+typedef struct
+{
+    uint64_t f;
+    int e;
+    int k;
+} CachedPower_t;
+
+// Normalized 64 bit approximations of 10^k for k = -300, -292, ..., 324.
+static const CachedPower_t cachedPowers[] = {
+    {0xAB70FE17C79AC6CA, -1060, -300},
+    {0xFF77B1FCBEBCDC4F, -1034, -292},
+    {0xBE5691EF416BD60C, -1007, -284},
+    {0x8DD01FAD907FFC3C, -980, -276},
+    {0xD3515C2831559A83, -954, -268},
+    {0x9D71AC8FADA6C9B5, -927, -260},
+    {0xEA9C227723EE8BCB, -901, -252},
+    {0xAECC49914078536D, -874, -244},
+    {0x823C12795DB6CE57, -847, -236},
+    {0xC21094364DFB5637, -821, -228},
+    {0x9096EA6F3848984F, -794, -220},
+    {0xD77485CB25823AC7, -768, -212},
+    {0xA086CFCD97BF97F4, -741, -204},
+    {0xEF340A98172AACE5, -715, -196},
+    {0xB23867FB2A35B28E, -688, -188},
+    {0x84C8D4DFD2C63F3B, -661, -180},
+    {0xC5DD44271AD3CDBA, -635, -172},
+    {0x936B9FCEBB25C996, -608, -164},
+    {0xDBAC6C247D62A584, -582, -156},
+    {0xA3AB66580D5FDAF6, -555, -148},
+    {0xF3E2F893DEC3F126, -529, -140},
+    {0xB5B5ADA8AAFF80B8, -502, -132},
+    {0x87625F056C7C4A8B, -475, -124},
+    {0xC9BCFF6034C13053, -449, -116},
+    {0x964E858C91BA2655, -422, -108},
+    {0xDFF9772470297EBD, -396, -100},
+    {0xA6DFBD9FB8E5B88F, -369, -92},
+    {0xF8A95FCF88747D94, -343, -84},
+    {0xB94470938FA89BCF, -316, -76},
+    {0x8A08F0F8BF0F156B, -289, -68},
+    {0xCDB02555653131B6, -263, -60},
+    {0x993FE2C6D07B7FAC, -236, -52},
+    {0xE45C10C42A2B3B06, -210, -44},
+    {0xAA242499697392D3, -183, -36},
+    {0xFD87B5F28300CA0E, -157, -28},
+    {0xBCE5086492111AEB, -130, -20},
+    {0x8CBCCC096F5088CC, -103, -12},
+    {0xD1B71758E219652C, -77, -4},
+    {0x9C40000000000000, -50, 4},
+    {0xE8D4A51000000000, -24, 12},
+    {0xAD78EBC5AC620000, 3, 20},
+    {0x813F3978F8940984, 30, 28},
+    {0xC097CE7BC90715B3, 56, 36},
+    {0x8F7E32CE7BEA5C70, 83, 44},
+    {0xD5D238A4ABE98068, 109, 52},
+    {0x9F4F2726179A2245, 136, 60},
+    {0xED63A231D4C4FB27, 162, 68},
+    {0xB0DE65388CC8ADA8, 189, 76},
+    {0x83C7088E1AAB65DB, 216, 84},
+    {0xC45D1DF942711D9A, 242, 92},
+    {0x924D692CA61BE758, 269, 100},
+    {0xDA01EE641A708DEA, 295, 108},
+    {0xA26DA3999AEF774A, 322, 116},
+    {0xF209787BB47D6B85, 348, 124},
+    {0xB454E4A179DD1877, 375, 132},
+    {0x865B86925B9BC5C2, 402, 140},
+    {0xC83553C5C8965D3D, 428, 148},
+    {0x952AB45CFA97A0B3, 455, 156},
+    {0xDE469FBD99A05FE3, 481, 164},
+    {0xA59BC234DB398C25, 508, 172},
+    {0xF6C69A72A3989F5C, 534, 180},
+    {0xB7DCBF5354E9BECE, 561, 188},
+    {0x88FCF317F22241E2, 588, 196},
+    {0xCC20CE9BD35C78A5, 614, 204},
+    {0x98165AF37B2153DF, 641, 212},
+    {0xE2A0B5DC971F303A, 667, 220},
+    {0xA8D9D1535CE3B396, 694, 228},
+    {0xFB9B7CD9A4A7443C, 720, 236},
+    {0xBB764C4CA7A44410, 747, 244},
+    {0x8BAB8EEFB6409C1A, 774, 252},
+    {0xD01FEF10A657842C, 800, 260},
+    {0x9B10A4E5E9913129, 827, 268},
+    {0xE7109BFBA19C0C9D, 853, 276},
+    {0xAC2820D9623BF429, 880, 284},
+    {0x80444B5E7AA7CF85, 907, 292},
+    {0xBF21E44003ACDD2D, 933, 300},
+    {0x8E679C2F5E44FF8F, 960, 308},
+    {0xD433179D9C8CB841, 986, 316},
+    {0x9E19DB92B4E31BA9, 1013, 324},
+};
+
+#define DIYFP_ALPHA (-60)
+#define DIYFP_GAMMA (-32)
+#define CACHED_POWERS_MIN_DEC_EXP (-300)
+#define CACHED_POWERS_DEC_STEP 8
+
+static DiyFp_t diyFpMul(DiyFp_t x, DiyFp_t y)
+{
+    uint64_t uLo = x.f & 0xFFFFFFFFu;
+    uint64_t uHi = x.f >> 32;
+    uint64_t vLo = y.f & 0xFFFFFFFFu;
+    uint64_t vHi = y.f >> 32;
+
+    uint64_t p0 = uLo * vLo;
+    uint64_t p1 = uLo * vHi;
+    uint64_t p2 = uHi * vLo;
+    uint64_t p3 = uHi * vHi;
+
+    uint64_t q = (p0 >> 32) + (p1 & 0xFFFFFFFFu) + (p2 & 0xFFFFFFFFu);
+    DiyFp_t ret;
+
+    // round half up
+    q += (uint64_t)1 << 31;
+
+    ret.f = p3 + (p1 >> 32) + (p2 >> 32) + (q >> 32);
+    ret.e = x.e + y.e + 64;
+    return ret;
+}
+
+static DiyFp_t diyFpNormalize(DiyFp_t x)
+{
+    while ((x.f >> 63) == 0)
+    {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+// Splits a positive finite double into the value and the boundaries of its
+// rounding interval, all normalized to the exponent of the upper boundary.
+static void diyFpBoundaries(double value, DiyFp_t *w, DiyFp_t *minus, DiyFp_t *plus)
+{
+    uint64_t bits;
+    uint64_t fraction;
+    int exponent;
+    DiyFp_t v;
+    DiyFp_t m;
+    bool lowerBoundaryIsCloser;
+
+    memcpy(&bits, &value, sizeof(bits));
+    fraction = bits & (((uint64_t)1 << 52) - 1);
+    exponent = (int)(bits >> 52);
+
+    if (exponent == 0)
+    {
+        v.f = fraction;
+        v.e = 1 - 1075;
+    }
+    else
+    {
+        v.f = fraction + ((uint64_t)1 << 52);
+        v.e = exponent - 1075;
+    }
+
+    lowerBoundaryIsCloser = fraction == 0 && exponent > 1;
+
+    plus->f = 2 * v.f + 1;
+    plus->e = v.e - 1;
+    *plus = diyFpNormalize(*plus);
+
+    if (lowerBoundaryIsCloser)
+    {
+        m.f = 4 * v.f - 1;
+        m.e = v.e - 2;
+    }
+    else
+    {
+        m.f = 2 * v.f - 1;
+        m.e = v.e - 1;
+    }
+    minus->f = m.f << (m.e - plus->e);
+    minus->e = plus->e;
+
+    *w = diyFpNormalize(v);
+}
+
+static CachedPower_t cachedPowerForBinaryExponent(int e)
+{
+    int f = DIYFP_ALPHA - e - 1;
+    int k = (f * 78913) / (1 << 18) + (f > 0);
+    int index = (-CACHED_POWERS_MIN_DEC_EXP + k + (CACHED_POWERS_DEC_STEP - 1)) / CACHED_POWERS_DEC_STEP;
+
+    return cachedPowers[index];
+}
+
+static int largestPow10(uint32_t n, uint32_t *pow10)
+{
+    static const uint32_t powers[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+    int k = 10;
+
+    while (k > 1 && n < powers[k - 1])
+    {
+        k--;
+    }
+    *pow10 = powers[k - 1];
+    return k;
+}
+
+static void grisu2Round(char *buffer, int length, uint64_t dist, uint64_t delta, uint64_t rest, uint64_t tenK)
+{
+    while (rest < dist && delta - rest >= tenK && (rest + tenK < dist || dist - rest > rest + tenK - dist))
+    {
+        buffer[length - 1]--;
+        rest += tenK;
+    }
+}
+
+static int grisu2DigitGen(char *buffer, int *decimalExponent, DiyFp_t mMinus, DiyFp_t w, DiyFp_t mPlus)
+{
+    uint64_t delta = mPlus.f - mMinus.f;
+    uint64_t dist = mPlus.f - w.f;
+    int shift = -mPlus.e;
+    uint64_t one = (uint64_t)1 << shift;
+    uint32_t p1 = (uint32_t)(mPlus.f >> shift);
+    uint64_t p2 = mPlus.f & (one - 1);
+    uint32_t pow10;
+    int n = largestPow10(p1, &pow10);
+    int length = 0;
+    int m = 0;
+
+    while (n > 0)
+    {
+        uint32_t d = p1 / pow10;
+        uint64_t rest;
+
+        p1 = p1 % pow10;
+        buffer[length++] = (char)('0' + d);
+        n--;
+
+        rest = ((uint64_t)p1 << shift) + p2;
+        if (rest <= delta)
+        {
+            *decimalExponent += n;
+            grisu2Round(buffer, length, dist, delta, rest, (uint64_t)pow10 << shift);
+            return length;
+        }
+        pow10 /= 10;
+    }
+
+    for (;;)
+    {
+        p2 *= 10;
+        buffer[length++] = (char)('0' + (p2 >> shift));
+        p2 &= one - 1;
+        m++;
+        delta *= 10;
+        dist *= 10;
+        if (p2 <= delta)
+        {
+            break;
+        }
+    }
+
+    *decimalExponent -= m;
+    grisu2Round(buffer, length, dist, delta, p2, one);
+    return length;
+}
+
+// Writes the digits of a positive finite double to buffer (at most 17, no
+// terminating zero). The value is digits * 10^decimalExponent.
+static int grisu2(char *buffer, int *decimalExponent, double value)
+{
+    DiyFp_t w;
+    DiyFp_t minus;
+    DiyFp_t plus;
+    DiyFp_t c;
+    CachedPower_t cached;
+
+    diyFpBoundaries(value, &w, &minus, &plus);
+    cached = cachedPowerForBinaryExponent(plus.e);
+    c.f = cached.f;
+    c.e = cached.e;
+
+    w = diyFpMul(w, c);
+    minus = diyFpMul(minus, c);
+    plus = diyFpMul(plus, c);
+
+    // Shrink the interval by one unit on each side to stay within the exact
+    // rounding interval despite the error of the multiplication.
+    minus.f += 1;
+    plus.f -= 1;
+
+    *decimalExponent = -cached.k;
+    return grisu2DigitGen(buffer, decimalExponent, minus, w, plus);
+}
+
+size_t formatDouble(char *buffer, double value)
+{
+    char digits[18];
+    char *p = buffer;
+    int exponent;
+    int length;
+    int point;
+
+    if (!isfinite(value))
+    {
+        memcpy(buffer, "null", 5);
+        return 4;
+    }
+
+    if (fabs(value) < 9007199254740992.0 && value == (double)(int64_t)value)
+    {
+        return formatInt64(buffer, (int64_t)value);
+    }
+
+    if (value < 0)
+    {
+        *p++ = '-';
+        value = -value;
+    }
+
+    length = grisu2(digits, &exponent, value);
+    point = length + exponent;
+
+    if (length <= point && point <= 17)
+    {
+        // digits followed by zeros, only for integral values beyond 2^53
+        memcpy(p, digits, length);
+        memset(p + length, '0', point - length);
+        p += point;
+    }
+    else if (0 < point && point <= 17)
+    {
+        memcpy(p, digits, point);
+        p[point] = '.';
+        memcpy(p + point + 1, digits + point, length - point);
+        p += length + 1;
+    }
+    else if (-4 < point && point <= 0)
+    {
+        *p++ = '0';
+        *p++ = '.';
+        memset(p, '0', -point);
+        memcpy(p - point, digits, length);
+        p += length - point;
+    }
+    else
+    {
+        int e = point - 1;
+
+        *p++ = digits[0];
+        if (length > 1)
+        {
+            *p++ = '.';
+            memcpy(p, digits + 1, length - 1);
+            p += length - 1;
+        }
+        *p++ = 'e';
+        *p++ = e < 0 ? '-' : '+';
+        e = e < 0 ? -e : e;
+        if (e < 10)
+        {
+            *p++ = '0';
+        }
+        p += formatUint32(p, (uint32_t)e);
+    }
+
+    *p = '\0';
+    return p - buffer;
+}
+
+size_t formatFixed(char *buffer, double value)
+{
+    static const uint64_t powers[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+                                      10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull,
+                                      100000000000000ull, 1000000000000000ull, 10000000000000000ull, 100000000000000000ull};
+    char digits[18];
+    char *p = buffer;
+    double original = value;
+    uint64_t mantissa = 0;
+    uint64_t scaled;
+    int exponent;
+    int length;
+
+    // Beyond 1e9 the rounding interval of a double gets wider than 1e-7 and
+    // the rounding of the shortest digits may differ from the exact value.
+    if (!isfinite(value) || fabs(value) >= 1e9)
+    {
+        return snprintf(buffer, NUMBER_FORMAT_BUFFER_SIZE, "%f", value);
+    }
+
+    if (signbit(value))
+    {
+        *p++ = '-';
+        value = -value;
+    }
+
+    if (value == 0.0)
+    {
+        scaled = 0;
+    }
+    else
+    {
+        length = grisu2(digits, &exponent, value);
+        for (int i = 0; i < length; i++)
+        {
+            mantissa = mantissa * 10 + (digits[i] - '0');
+        }
+
+        if (exponent >= -6)
+        {
+            scaled = mantissa * powers[exponent + 6];
+        }
+        else if (-(exponent + 6) > 17)
+        {
+            scaled = 0;
+        }
+        else
+        {
+            uint64_t divisor = powers[-(exponent + 6)];
+            uint64_t rest = mantissa % divisor;
+            uint64_t half = divisor / 2;
+
+            // The digits may lie exactly on the rounding boundary while the
+            // double itself does not, let printf decide.
+            if (rest == half)
+            {
+                return snprintf(buffer, NUMBER_FORMAT_BUFFER_SIZE, "%f", original);
+            }
+            scaled = mantissa / divisor + (rest > half ? 1 : 0);
+        }
+    }
+
+    p += formatUint64(p, scaled / 1000000);
+    *p++ = '.';
+    memcpy(p, "000000", 6);
+    formatUint64(digits, scaled % 1000000);
+    length = (int)strlen(digits);
+    memcpy(p + 6 - length, digits, length);
+    p += 6;
+    *p = '\0';
+
+    return p - buffer;
+}
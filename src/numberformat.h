@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Large enough for every output of the functions below including the
+// terminating zero.
+#define NUMBER_FORMAT_BUFFER_SIZE 320
+
+size_t formatUint32(char *buffer, uint32_t value);
+size_t formatInt64(char *buffer, int64_t value);
+
+// Shortest representation that parses back to the same double (Grisu2).
+// Integral values are written without fraction, NaN and infinity as null.
+size_t formatDouble(char *buffer, double value);
+
+// Same output as printf("%f", value).
+size_t formatFixed(char *buffer, double value);
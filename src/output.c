@@ -0,0 +1,304 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "output.h"
+#include "colibriJson.h"
+#include "system.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+// Reserved at the begin of every record, so a binary record is never
+// flushed before its size is filled in.
+#define OUTPUT_MAX_RECORD_SIZE 4096
+
+const char *const outputChannelNames[8] = {"sample230", "reference230", "sample260", "reference260", "sample280", "reference280", "sample340", "reference340"};
+
+static const char *recordNames[] = {"", "measurement", "baseline", "levelling", "value", "selftest", "calculated", "average", "indexValue"};
+
+static OutputFormat_t format = OUTPUT_TEXT;
+static Buffer_t stdoutBuffer;
+
+// Every thread writes its records to stdout or to its own capture buffer
+static SYSTEM_THREAD_LOCAL struct
+{
+    Buffer_t *buffer;
+    bool isOpen;
+    const char *device;
+    size_t recordCount;
+    size_t fieldCount;
+    size_t recordStart;
+} output;
+
+bool outputParseFormat(const char *text, OutputFormat_t *parsed)
+{
+    static const char *names[] = {"text", "json", "ndjson", "binary"};
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (strcmp(text, names[i]) == 0)
+        {
+            *parsed = (OutputFormat_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void outputSetFormat(OutputFormat_t selected)
+{
+    format = selected;
+}
+
+OutputFormat_t outputFormat(void)
+{
+    return format;
+}
+
+void outputOpen(void)
+{
+    if (output.isOpen)
+    {
+        return;
+    }
+
+    output.buffer = &stdoutBuffer;
+    bufferInit(output.buffer);
+    bufferAttach(output.buffer, stdout);
+    bufferReserve(output.buffer, OUTPUT_BUFFER_SIZE);
+    output.isOpen = true;
+
+    if (format == OUTPUT_JSON)
+    {
+        bufferAppendString(output.buffer, "[\n");
+    }
+#if defined(_WIN32)
+    if (format == OUTPUT_BINARY)
+    {
+        _setmode(_fileno(stdout), _O_BINARY);
+    }
+#endif
+}
+
+void outputCapture(Buffer_t *capture, const char *device)
+{
+    output.buffer = capture;
+    output.isOpen = true;
+    output.device = device;
+    output.recordCount = 0;
+}
+
+void outputAppend(const Buffer_t *capture, const char *device)
+{
+    Buffer_t *buffer = outputBuffer();
+    const char *line = capture->data;
+    const char *end = capture->data + capture->size;
+
+    if (capture->size == 0)
+    {
+        return;
+    }
+
+    if (format != OUTPUT_TEXT)
+    {
+        if (format == OUTPUT_JSON && output.recordCount > 0)
+        {
+            bufferAppendString(buffer, ",\n");
+        }
+        bufferAppend(buffer, capture->data, capture->size);
+        output.recordCount++;
+        return;
+    }
+
+    // Text has no device field, every line starts with the device instead
+    while (line < end)
+    {
+        const char *next = memchr(line, '\n', end - line);
+
+        next = next ? next + 1 : end;
+        bufferAppendString(buffer, device);
+        bufferAppendChar(buffer, ' ');
+        bufferAppend(buffer, line, next - line);
+        line = next;
+    }
+}
+
+Buffer_t *outputBuffer(void)
+{
+    outputOpen();
+    return output.buffer;
+}
+
+void outputBegin(OutputRecord_t record)
+{
+    Buffer_t *buffer = outputBuffer();
+
+    bufferReserve(buffer, OUTPUT_MAX_RECORD_SIZE);
+    output.fieldCount = 0;
+
+    switch (format)
+    {
+        case OUTPUT_JSON:
+        case OUTPUT_NDJSON:
+            if (format == OUTPUT_JSON && output.recordCount > 0)
+            {
+                bufferAppendString(buffer, ",\n");
+            }
+            bufferAppendString(buffer, "{\"type\":\"");
+            bufferAppendString(buffer, recordNames[record]);
+            bufferAppendChar(buffer, '"');
+            break;
+        case OUTPUT_BINARY:
+        {
+            uint32_t header[2] = {(uint32_t)record, 0};
+
+            output.recordStart = buffer->size;
+            bufferAppend(buffer, (const char *)header, sizeof(header));
+            break;
+        }
+        default:
+            break;
+    }
+    output.recordCount++;
+
+    if (output.device && format != OUTPUT_TEXT)
+    {
+        outputString("device", output.device);
+    }
+}
+
+// Separator and name in front of a field in the text and JSON formats.
+static void beginField(const char *name)
+{
+    Buffer_t *buffer = output.buffer;
+
+    if (format == OUTPUT_TEXT)
+    {
+        if (output.fieldCount > 0)
+        {
+            bufferAppendChar(buffer, ' ');
+        }
+    }
+    else if (format != OUTPUT_BINARY)
+    {
+        bufferAppendChar(buffer, ',');
+        colibriJsonAppendString(buffer, name);
+        bufferAppendChar(buffer, ':');
+    }
+    output.fieldCount++;
+}
+
+void outputUint32(const char *name, uint32_t value)
+{
+    beginField(name);
+    if (format == OUTPUT_BINARY)
+    {
+        bufferAppend(output.buffer, (const char *)&value, sizeof(value));
+    }
+    else
+    {
+        bufferAppendUint32(output.buffer, value);
+    }
+}
+
+void outputDouble(const char *name, double value)
+{
+    beginField(name);
+    if (format == OUTPUT_BINARY)
+    {
+        bufferAppend(output.buffer, (const char *)&value, sizeof(value));
+    }
+    else if (format == OUTPUT_TEXT)
+    {
+        bufferAppendFixed(output.buffer, value);
+    }
+    else if (isnan(value) || isinf(value))
+    {
+        bufferAppendString(output.buffer, "null");
+    }
+    else
+    {
+        bufferAppendDouble(output.buffer, value);
+    }
+}
+
+void outputString(const char *name, const char *value)
+{
+    beginField(name);
+    if (format == OUTPUT_BINARY)
+    {
+        char text[OUTPUT_STRING_SIZE] = {0};
+
+        size_t length = value ? strlen(value) : 0;
+
+        memcpy(text, value ? value : "", length < sizeof(text) ? length : sizeof(text));
+        bufferAppend(output.buffer, text, sizeof(text));
+    }
+    else if (format == OUTPUT_TEXT)
+    {
+        bufferAppendString(output.buffer, value ? value : "");
+    }
+    else if (value)
+    {
+        colibriJsonAppendString(output.buffer, value);
+    }
+    else
+    {
+        bufferAppendString(output.buffer, "null");
+    }
+}
+
+void outputEnd(void)
+{
+    Buffer_t *buffer = output.buffer;
+
+    switch (format)
+    {
+        case OUTPUT_JSON:
+            bufferAppendChar(buffer, '}');
+            break;
+        case OUTPUT_NDJSON:
+            bufferAppendString(buffer, "}\n");
+            break;
+        case OUTPUT_BINARY:
+        {
+            uint32_t size = (uint32_t)(buffer->size - output.recordStart);
+
+            memcpy(buffer->data + output.recordStart + sizeof(uint32_t), &size, sizeof(size));
+            break;
+        }
+        default:
+            bufferAppendChar(buffer, '\n');
+            break;
+    }
+}
+
+void outputFlush(void)
+{
+    if (output.isOpen)
+    {
+        bufferFlush(output.buffer);
+        fflush(stdout);
+    }
+}
+
+void outputClose(void)
+{
+    if (!output.isOpen)
+    {
+        return;
+    }
+
+    if (format == OUTPUT_JSON)
+    {
+        bufferAppendString(output.buffer, output.recordCount > 0 ? "\n]\n" : "]\n");
+    }
+    bufferFlush(output.buffer);
+    fflush(stdout);
+    bufferFree(output.buffer);
+    output.isOpen = false;
+}
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#pragma once
+
+#include "buffer.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Results written to stdout in the format selected with --format. A result
+// is a record of named fields:
+//
+//   text    the fields separated by spaces, one record per line
+//   json    an array with one object per record, the type of the record is
+//           in the field "type"
+//   ndjson  one JSON object per line
+//   binary  fixed width records in the byte order of the host, without
+//           padding: uint32 type, uint32 size of the whole record, then the
+//           fields in their order as uint32, float64 or strings of
+//           OUTPUT_STRING_SIZE bytes, zero padded and cut if longer
+//
+// Commands whose text output is not a line of fields append it directly to
+// outputBuffer() for the text format.
+//
+// Commands run on several devices at once capture the output of every device
+// and append it afterwards. Then every record starts with the string field
+// device, in the text format every line starts with the device.
+
+#define OUTPUT_BUFFER_SIZE (1024 * 1024)
+#define OUTPUT_STRING_SIZE 64
+
+typedef enum
+{
+    OUTPUT_TEXT = 0,
+    OUTPUT_JSON = 1,
+    OUTPUT_NDJSON = 2,
+    OUTPUT_BINARY = 3,
+} OutputFormat_t;
+
+// The record types and their fields
+typedef enum
+{
+    OUTPUT_MEASUREMENT = 1, // sample230 reference230 ... sample340 reference340
+    OUTPUT_BASELINE = 2,    // as OUTPUT_MEASUREMENT
+    OUTPUT_LEVELLING = 3,   // result current amplificationSample amplificationReference for 230 ... 340
+    OUTPUT_VALUE = 4,       // value
+    OUTPUT_SELFTEST = 5,    // result, the SELFTEST_ bits which failed
+    OUTPUT_CALCULATED = 6,  // index od230 od260 od280 od340 concentration comment
+    OUTPUT_AVERAGE = 7,     // count rejected, then mean and stdDev per channel as OUTPUT_MEASUREMENT
+    OUTPUT_INDEX_VALUE = 8, // index value
+} OutputRecord_t;
+
+// Field names of the channels of OUTPUT_MEASUREMENT in their order
+extern const char *const outputChannelNames[8];
+
+bool outputParseFormat(const char *text, OutputFormat_t *format);
+void outputSetFormat(OutputFormat_t format);
+OutputFormat_t outputFormat(void);
+Buffer_t *outputBuffer(void);
+// Starts the output of a command, for the json format even if it has no
+// records. outputBegin() calls it.
+void outputOpen(void);
+void outputBegin(OutputRecord_t record);
+void outputUint32(const char *name, uint32_t value);
+// NAN is written as null in JSON
+void outputDouble(const char *name, double value);
+// NULL is written as null in JSON and as an empty string otherwise
+void outputString(const char *name, const char *value);
+void outputEnd(void);
+// Writes the records so far, for commands which run until they are stopped.
+void outputFlush(void);
+// The records of the calling thread go to capture instead of stdout.
+void outputCapture(Buffer_t *capture, const char *device);
+// Appends the records a thread captured to the output of the calling thread.
+void outputAppend(const Buffer_t *capture, const char *device);
+// Writes the rest of the output, registered with atexit() by main.
+void outputClose(void);
@@ -2,11 +2,23 @@
 // SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
 
 #include "printerror.h"
+#include "system.h"
 #include <stdlib.h>
 #include <stdio.h>
 
+static SYSTEM_THREAD_LOCAL const char *errorDevice = NULL;
+
+void printErrorDevice(const char *device)
+{
+    errorDevice = device;
+}
+
 Error_t printError(Error_t error, char * format, ...)
 {
+    if(errorDevice)
+    {
+      fprintf(stderr, "%s: ", errorDevice);
+    }
     if(format)
     {
       va_list args;
@@ -6,3 +6,5 @@
 #include "colibri.h"
 
 Error_t printError(Error_t error, char * format, ...);
+// Errors of the calling thread start with device, NULL for none.
+void printErrorDevice(const char *device);
@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Platform specific services of the command line tool. The implementations
+// are in system_unix.c and system_win.c.
+
+#if defined(_MSC_VER)
+#define SYSTEM_THREAD_LOCAL __declspec(thread)
+#else
+#define SYSTEM_THREAD_LOCAL _Thread_local
+#endif
+
+// Read only view of a whole file.
+typedef struct
+{
+    const void *data;
+    size_t size;
+    void *handle;
+} MappedFile_t;
+
+bool systemMapFile(MappedFile_t *self, const char *file);
+void systemUnmapFile(MappedFile_t *self);
+
+bool systemIsDirectory(const char *path);
+// Calls function for every regular file in directory, in no particular order.
+bool systemListDirectory(const char *directory, void (*function)(const char *path, void *context), void *context);
+// Replaces to with from in one step, so readers see either the old or the new file.
+bool systemReplaceFile(const char *from, const char *to);
+
+typedef struct
+{
+    void (*function)(void *argument);
+    void *argument;
+    void *handle;
+} SystemThread_t;
+
+bool systemThreadStart(SystemThread_t *self, void (*function)(void *argument), void *argument);
+void systemThreadJoin(SystemThread_t *self);
+// Returns the incremented value
+long systemAtomicIncrement(volatile long *value);
+int systemCpuCount(void);
+
+// Change notification for a file. Replacing the file, as saves do, counts
+// as a change.
+typedef struct
+{
+    void *handle;
+    char *directory;
+    const char *name;
+} SystemWatch_t;
+
+bool systemWatchStart(SystemWatch_t *self, const char *file);
+// Blocks until the file may have changed, false on errors.
+bool systemWatchWait(SystemWatch_t *self);
+void systemWatchStop(SystemWatch_t *self);
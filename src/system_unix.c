@@ -0,0 +1,299 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "system.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#endif
+
+bool systemMapFile(MappedFile_t *self, const char *file)
+{
+    struct stat st;
+    void *data;
+    int fd;
+
+    self->data = NULL;
+    self->size = 0;
+    self->handle = NULL;
+
+    fd = open(file, O_RDONLY);
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // The columns are read front to back, one after the other.
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    self->data = data;
+    self->size = st.st_size;
+    return true;
+}
+
+void systemUnmapFile(MappedFile_t *self)
+{
+    if (self->data)
+    {
+        munmap((void *)self->data, self->size);
+    }
+    self->data = NULL;
+    self->size = 0;
+}
+
+bool systemIsDirectory(const char *path)
+{
+    struct stat st;
+
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool systemListDirectory(const char *directory, void (*function)(const char *path, void *context), void *context)
+{
+    DIR *dir = opendir(directory);
+    struct dirent *entry;
+    char *path;
+    size_t size;
+
+    if (dir == NULL)
+    {
+        return false;
+    }
+
+    while ((entry = readdir(dir)) != NULL)
+    {
+        struct stat st;
+
+        size = strlen(directory) + strlen(entry->d_name) + 2;
+        path = malloc(size);
+        if (path == NULL)
+        {
+            closedir(dir);
+            return false;
+        }
+        snprintf(path, size, "%s/%s", directory, entry->d_name);
+
+        if (stat(path, &st) == 0 && S_ISREG(st.st_mode))
+        {
+            function(path, context);
+        }
+        free(path);
+    }
+
+    closedir(dir);
+    return true;
+}
+
+bool systemReplaceFile(const char *from, const char *to)
+{
+    return rename(from, to) == 0;
+}
+
+static void *threadMain(void *argument)
+{
+    SystemThread_t *self = argument;
+
+    self->function(self->argument);
+    return NULL;
+}
+
+bool systemThreadStart(SystemThread_t *self, void (*function)(void *argument), void *argument)
+{
+    pthread_t *thread = malloc(sizeof(pthread_t));
+
+    self->function = function;
+    self->argument = argument;
+    self->handle = thread;
+
+    if (thread == NULL || pthread_create(thread, NULL, threadMain, self) != 0)
+    {
+        free(thread);
+        self->handle = NULL;
+        return false;
+    }
+    return true;
+}
+
+void systemThreadJoin(SystemThread_t *self)
+{
+    if (self->handle)
+    {
+        pthread_join(*(pthread_t *)self->handle, NULL);
+        free(self->handle);
+        self->handle = NULL;
+    }
+}
+
+long systemAtomicIncrement(volatile long *value)
+{
+    return __atomic_add_fetch(value, 1, __ATOMIC_SEQ_CST);
+}
+
+int systemCpuCount(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return count > 0 ? (int)count : 1;
+}
+
+static bool watchSplit(SystemWatch_t *self, const char *file)
+{
+    const char *slash = strrchr(file, '/');
+    size_t length = slash ? (size_t)(slash - file) : 1;
+
+    self->handle = NULL;
+    self->directory = malloc(length + 1);
+    if (self->directory == NULL)
+    {
+        return false;
+    }
+    memcpy(self->directory, slash ? file : ".", length);
+    self->directory[length] = '\0';
+    self->name = slash ? slash + 1 : file;
+    return true;
+}
+
+#if defined(__linux__)
+
+// The directory is watched because a save replaces the file by a rename.
+bool systemWatchStart(SystemWatch_t *self, const char *file)
+{
+    int fd;
+
+    if (!watchSplit(self, file))
+    {
+        return false;
+    }
+
+    fd = inotify_init1(IN_CLOEXEC);
+    if (fd == -1 || inotify_add_watch(fd, self->directory[0] ? self->directory : "/", IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) == -1)
+    {
+        if (fd != -1)
+        {
+            close(fd);
+        }
+        free(self->directory);
+        self->directory = NULL;
+        return false;
+    }
+
+    self->handle = (void *)(intptr_t)(fd + 1);
+    return true;
+}
+
+bool systemWatchWait(SystemWatch_t *self)
+{
+    int fd = (int)(intptr_t)self->handle - 1;
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (true)
+    {
+        ssize_t size = read(fd, events, sizeof(events));
+
+        if (size <= 0)
+        {
+            return false;
+        }
+
+        for (char *event = events; event < events + size;)
+        {
+            const struct inotify_event *e = (const struct inotify_event *)event;
+
+            if (e->len > 0 && strcmp(e->name, self->name) == 0)
+            {
+                return true;
+            }
+            event += sizeof(struct inotify_event) + e->len;
+        }
+    }
+}
+
+void systemWatchStop(SystemWatch_t *self)
+{
+    if (self->handle)
+    {
+        close((int)(intptr_t)self->handle - 1);
+    }
+    free(self->directory);
+    self->directory = NULL;
+    self->handle = NULL;
+}
+
+#else
+
+// Without inotify the modification time and size are polled.
+typedef struct
+{
+    struct stat st;
+    char *file;
+} WatchPoll_t;
+
+bool systemWatchStart(SystemWatch_t *self, const char *file)
+{
+    WatchPoll_t *poll = calloc(1, sizeof(WatchPoll_t));
+
+    if (poll == NULL || !watchSplit(self, file) || (poll->file = strdup(file)) == NULL)
+    {
+        free(poll);
+        return false;
+    }
+    stat(file, &poll->st);
+    self->handle = poll;
+    return true;
+}
+
+bool systemWatchWait(SystemWatch_t *self)
+{
+    WatchPoll_t *poll = self->handle;
+
+    while (true)
+    {
+        struct stat st;
+
+        usleep(200000);
+        if (stat(poll->file, &st) == 0 &&
+            (st.st_mtime != poll->st.st_mtime || st.st_size != poll->st.st_size || st.st_ino != poll->st.st_ino))
+        {
+            poll->st = st;
+            return true;
+        }
+    }
+}
+
+void systemWatchStop(SystemWatch_t *self)
+{
+    WatchPoll_t *poll = self->handle;
+
+    if (poll)
+    {
+        free(poll->file);
+        free(poll);
+    }
+    free(self->directory);
+    self->directory = NULL;
+    self->handle = NULL;
+}
+
+#endif
@@ -0,0 +1,202 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "system.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <process.h>
+#include <windows.h>
+
+bool systemMapFile(MappedFile_t *self, const char *file)
+{
+    HANDLE hFile;
+    HANDLE hMapping;
+    LARGE_INTEGER size;
+    void *data = NULL;
+
+    self->data = NULL;
+    self->size = 0;
+    self->handle = NULL;
+
+    hFile = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    if (!GetFileSizeEx(hFile, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(hFile);
+        return false;
+    }
+
+    hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(hFile);
+    if (hMapping == NULL)
+    {
+        return false;
+    }
+
+    data = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == NULL)
+    {
+        CloseHandle(hMapping);
+        return false;
+    }
+
+    self->data = data;
+    self->size = (size_t)size.QuadPart;
+    self->handle = hMapping;
+    return true;
+}
+
+void systemUnmapFile(MappedFile_t *self)
+{
+    if (self->data)
+    {
+        UnmapViewOfFile(self->data);
+        CloseHandle((HANDLE)self->handle);
+    }
+    self->data = NULL;
+    self->size = 0;
+    self->handle = NULL;
+}
+
+bool systemIsDirectory(const char *path)
+{
+    DWORD attributes = GetFileAttributesA(path);
+
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+}
+
+bool systemListDirectory(const char *directory, void (*function)(const char *path, void *context), void *context)
+{
+    WIN32_FIND_DATAA entry;
+    HANDLE hFind;
+    char *path;
+    size_t size = strlen(directory) + MAX_PATH + 2;
+
+    path = malloc(size);
+    if (path == NULL)
+    {
+        return false;
+    }
+
+    snprintf(path, size, "%s\\*", directory);
+    hFind = FindFirstFileA(path, &entry);
+    if (hFind == INVALID_HANDLE_VALUE)
+    {
+        free(path);
+        return false;
+    }
+
+    do
+    {
+        if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+        {
+            snprintf(path, size, "%s\\%s", directory, entry.cFileName);
+            function(path, context);
+        }
+    } while (FindNextFileA(hFind, &entry));
+
+    FindClose(hFind);
+    free(path);
+    return true;
+}
+
+bool systemReplaceFile(const char *from, const char *to)
+{
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+static unsigned __stdcall threadMain(void *argument)
+{
+    SystemThread_t *self = argument;
+
+    self->function(self->argument);
+    return 0;
+}
+
+bool systemThreadStart(SystemThread_t *self, void (*function)(void *argument), void *argument)
+{
+    self->function = function;
+    self->argument = argument;
+    self->handle = (void *)_beginthreadex(NULL, 0, threadMain, self, 0, NULL);
+
+    return self->handle != NULL;
+}
+
+void systemThreadJoin(SystemThread_t *self)
+{
+    if (self->handle)
+    {
+        WaitForSingleObject((HANDLE)self->handle, INFINITE);
+        CloseHandle((HANDLE)self->handle);
+        self->handle = NULL;
+    }
+}
+
+long systemAtomicIncrement(volatile long *value)
+{
+    return InterlockedIncrement(value);
+}
+
+int systemCpuCount(void)
+{
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+// The directory is watched because a save replaces the file. The
+// notification does not name the file, so every change in the directory
+// is reported.
+bool systemWatchStart(SystemWatch_t *self, const char *file)
+{
+    const char *slash = strrchr(file, '\\');
+    const char *other = strrchr(file, '/');
+    size_t length;
+    HANDLE handle;
+
+    slash = (other && (!slash || other > slash)) ? other : slash;
+    length = slash ? (size_t)(slash - file) : 1;
+    self->handle = NULL;
+    self->directory = malloc(length + 1);
+    if (self->directory == NULL)
+    {
+        return false;
+    }
+    memcpy(self->directory, slash ? file : ".", length);
+    self->directory[length] = '\0';
+    self->name = slash ? slash + 1 : file;
+
+    handle = FindFirstChangeNotificationA(self->directory[0] ? self->directory : "\\", FALSE,
+                                          FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        free(self->directory);
+        self->directory = NULL;
+        return false;
+    }
+
+    self->handle = handle;
+    return true;
+}
+
+bool systemWatchWait(SystemWatch_t *self)
+{
+    return WaitForSingleObject((HANDLE)self->handle, INFINITE) == WAIT_OBJECT_0 && FindNextChangeNotification((HANDLE)self->handle);
+}
+
+void systemWatchStop(SystemWatch_t *self)
+{
+    if (self->handle)
+    {
+        FindCloseChangeNotification((HANDLE)self->handle);
+    }
+    free(self->directory);
+    self->directory = NULL;
+    self->handle = NULL;
+}
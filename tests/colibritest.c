@@ -0,0 +1,178 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "test.h"
+#include "cmdmeasure.h"
+#include "output.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const struct
+{
+    const char *name;
+    void (*run)(int argc, char **argv);
+} tests[] = {
+    {"loopback", testLoopback},
+    {"archive", testArchive},
+    {"expression", testExpression},
+    {"average", testAverage},
+    {"config", testConfig},
+    {"getset", testGetSet},
+    {"calc", testCalc},
+    {"levellingpolicy", testLevellingPolicy},
+    {"numberformat", testNumberFormat},
+#if !defined(_WIN32)
+    {"tcp", testTcp},
+#endif
+};
+
+static int failures = 0;
+
+bool testCheck(bool condition, const char *text, const char *file, int line)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, text);
+        failures++;
+    }
+    return condition;
+}
+
+static void testDevice(void *user, const char *command, char *response, size_t responseSize)
+{
+    TestDevice_t *self = (TestDevice_t *)user;
+    char *end;
+
+    self->commandCount++;
+    if (command[0] == 'V' && command[1] == ' ')
+    {
+        unsigned long index = strtoul(command + 2, &end, 10);
+
+        if (index >= TEST_DEVICE_INDICES)
+        {
+            snprintf(response, responseSize, "E 1");
+        }
+        else if (*end == ' ')
+        {
+            snprintf(self->values[index], TEST_DEVICE_VALUE_SIZE, "%s", end + 1);
+            snprintf(response, responseSize, "V");
+        }
+        else
+        {
+            snprintf(response, responseSize, "V %s", self->values[index]);
+        }
+    }
+    else if (strcmp(command, "M") == 0 && self->measurementCount > 0)
+    {
+        const uint32_t *v = self->measurements + MEASURE_CHANNELS * self->measurementNext;
+
+        snprintf(response, responseSize, "M %u %u %u %u %u %u %u %u", v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7]);
+        if (self->measurementNext + 1 < self->measurementCount)
+        {
+            self->measurementNext++;
+        }
+    }
+    else if (strcmp(command, "C") == 0 || strcmp(command, "C 0") == 0)
+    {
+        const Levelling_t *l = self->levelling;
+
+        if (command[1] == '\0')
+        {
+            for (int w = 0; w < 4; w++)
+            {
+                self->levelling[w].result = SETUPRESULT_OK;
+            }
+            self->levellingCount++;
+        }
+        snprintf(response, responseSize, "C %u %u %u %u %u %u %u %u %u %u %u %u %u %u %u %u",
+                 l[0].result, l[0].current, l[0].amplificationSample, l[0].amplificationReference,
+                 l[1].result, l[1].current, l[1].amplificationSample, l[1].amplificationReference,
+                 l[2].result, l[2].current, l[2].amplificationSample, l[2].amplificationReference,
+                 l[3].result, l[3].current, l[3].amplificationSample, l[3].amplificationReference);
+    }
+    else if (strcmp(command, "G") == 0)
+    {
+        const uint32_t *v = self->baseline;
+
+        snprintf(response, responseSize, "G %u %u %u %u %u %u %u %u", v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7]);
+        self->baselineCount++;
+    }
+    else
+    {
+        snprintf(response, responseSize, "E 1");
+    }
+}
+
+void testDeviceInit(TestDevice_t *self, Colibri_t *colibri)
+{
+    static const struct
+    {
+        uint32_t index;
+        const char *value;
+    } factory[] = {
+        {INDEX_VERSION, "1.2.3"},
+        {INDEX_SERIALNUMBER, "TEST1"},
+        {INDEX_HARDWARETYPE, "1"},
+        {INDEX_LAST_MEASUREMENT_COUNT, "0"},
+        {INDEX_LED230NM_MAX_CURRENT, "5000"},
+        {INDEX_LED260NM_MAX_CURRENT, "5000"},
+        {INDEX_LED280NM_MAX_CURRENT, "5000"},
+        {INDEX_LED340NM_MAX_CURRENT, "5000"},
+        {INDEX_AMPLIFIER_SAMPLEFACTOR___1_1, "1.1"},
+        {INDEX_AMPLIFIER_SAMPLEFACTOR__11_0, "11.0"},
+        {INDEX_AMPLIFIER_SAMPLEFACTOR_111_0, "111.0"},
+        {INDEX_AMPLIFIER_REFERENCEFACTOR___1_1, "1.1"},
+        {INDEX_AMPLIFIER_REFERENCEFACTOR__11_0, "11.0"},
+        {INDEX_AMPLIFIER_REFERENCEFACTOR_111_0, "111.0"},
+        {INDEX_SETUP_TARGET230, "1000000"},
+        {INDEX_SETUP_TARGET260, "1000000"},
+        {INDEX_SETUP_TARGET280, "1000000"},
+        {INDEX_SETUP_TARGET340, "1000000"},
+    };
+
+    memset(self, 0, sizeof(TestDevice_t));
+    for (size_t i = 0; i < TEST_DEVICE_INDICES; i++)
+    {
+        strcpy(self->values[i], "0");
+    }
+    for (size_t i = 0; i < sizeof(factory) / sizeof(factory[0]); i++)
+    {
+        strcpy(self->values[factory[i].index], factory[i].value);
+    }
+    // A good levelling and a baseline right on the setup targets
+    for (int w = 0; w < 4; w++)
+    {
+        self->levelling[w].current = 1000;
+        self->levelling[w].amplificationSample = 1;
+        self->levelling[w].amplificationReference = 1;
+    }
+    for (int channel = 0; channel < 8; channel++)
+    {
+        self->baseline[channel] = 1000000;
+    }
+
+    memset(colibri, 0, sizeof(Colibri_t));
+    colibri->portName = COLIBRI_LOOPBACK_PREFIX;
+    colibri->loopbackDevice = testDevice;
+    colibri->loopbackUser = self;
+}
+
+// colibritest NAME [ARGUMENTS] runs the test NAME, ctest runs every test.
+int main(int argc, char *argv[])
+{
+    atexit(outputClose);
+
+    for (size_t i = 0; argc >= 2 && i < sizeof(tests) / sizeof(tests[0]); i++)
+    {
+        if (strcmp(argv[1], tests[i].name) == 0)
+        {
+            tests[i].run(argc - 2, argv + 2);
+            fprintf(stderr, "%s: %d failed checks\n", tests[i].name, failures);
+            return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+        }
+    }
+
+    fprintf(stderr, "Usage: colibritest NAME [ARGUMENTS]\n");
+    return EXIT_FAILURE;
+}
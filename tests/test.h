@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#pragma once
+
+#include "colibri.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// A failed check is counted and printed with its location, the test goes on.
+#define CHECK(condition) testCheck((condition), #condition, __FILE__, __LINE__)
+
+bool testCheck(bool condition, const char *text, const char *file, int line);
+
+#define TEST_DEVICE_INDICES 100
+#define TEST_DEVICE_VALUE_SIZE 32
+
+// A device behind the loopback transport. V reads and writes the values of
+// the indices below TEST_DEVICE_INDICES, other indices are answered with
+// E 1. M answers with the next of the measurements, each MEASURE_CHANNELS
+// values, and with the last one when they are used up. C 0 answers with
+// levelling, C runs a levelling which clears the results of levelling and
+// G answers with baseline.
+typedef struct
+{
+    char values[TEST_DEVICE_INDICES][TEST_DEVICE_VALUE_SIZE];
+    const uint32_t *measurements;
+    size_t measurementCount;
+    size_t measurementNext;
+    Levelling_t levelling[4];
+    uint32_t baseline[8];
+    size_t levellingCount;
+    size_t baselineCount;
+    size_t commandCount;
+} TestDevice_t;
+
+// Sets the values of a device as it comes from the factory and connects
+// colibri to it over the loopback transport.
+void testDeviceInit(TestDevice_t *self, Colibri_t *colibri);
+
+// The tests, argv holds the arguments behind the name of the test.
+void testLoopback(int argc, char **argv);
+void testArchive(int argc, char **argv);
+void testExpression(int argc, char **argv);
+void testAverage(int argc, char **argv);
+void testConfig(int argc, char **argv);
+void testGetSet(int argc, char **argv);
+void testCalc(int argc, char **argv);
+void testLevellingPolicy(int argc, char **argv);
+void testNumberFormat(int argc, char **argv);
+#if !defined(_WIN32)
+void testTcp(int argc, char **argv);
+#endif
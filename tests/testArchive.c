@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "test.h"
+#include "colibriArchive.h"
+#include "colibriJson.h"
+#include "colibriReader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARCHIVE_FILE "roundtrip.colibri"
+#define ARCHIVE_FILE_AGAIN "roundtrip2.colibri"
+#define ARCHIVE_CHUNK_SIZE 3
+
+// Bitwise, so NAN equals NAN
+static bool sameDouble(double a, double b)
+{
+    return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+static bool sameString(const char *a, const char *b)
+{
+    return (a == NULL && b == NULL) || (a != NULL && b != NULL && strcmp(a, b) == 0);
+}
+
+static bool sameColumn(double *const columns[WAVELENGTH_COUNT], size_t i, double *const otherColumns[WAVELENGTH_COUNT], size_t j)
+{
+    bool isSame = true;
+
+    for (int w = 0; w < WAVELENGTH_COUNT; w++)
+    {
+        isSame = isSame && sameDouble(columns[w][i], otherColumns[w][j]);
+    }
+    return isSame;
+}
+
+// Record i of a against record j of b
+static void checkRecord(const DataFile_t *a, size_t i, const DataFile_t *b, size_t j)
+{
+    const Record_t *x = &a->records[i];
+    const Record_t *y = &b->records[j];
+
+    CHECK(sameString(dataFileString(a, x->comment), dataFileString(b, y->comment)));
+    CHECK(sameString(dataFileString(a, x->timestamp), dataFileString(b, y->timestamp)));
+    CHECK(x->hasLevelling == y->hasLevelling);
+    CHECK(x->hasCalculated == y->hasCalculated);
+    CHECK(x->hasOD == y->hasOD);
+    CHECK(x->hasConcentration == y->hasConcentration);
+    CHECK(a->measurements.hasAir[i] == b->measurements.hasAir[j]);
+
+    for (int w = 0; x->hasLevelling && w < WAVELENGTH_COUNT; w++)
+    {
+        const LevellingChannel_t *p = &x->levelling[w];
+        const LevellingChannel_t *q = &y->levelling[w];
+
+        CHECK(sameDouble(p->amplificationSample, q->amplificationSample));
+        CHECK(sameDouble(p->amplificationReference, q->amplificationReference));
+        CHECK(sameDouble(p->current, q->current));
+        CHECK(sameDouble(p->result, q->result));
+        CHECK(sameString(dataFileString(a, p->resultText), dataFileString(b, q->resultText)));
+    }
+    for (int r = 0; r < ROLE_COUNT; r++)
+    {
+        CHECK(sameColumn(a->measurements.sample[r], i, b->measurements.sample[r], j));
+        CHECK(sameColumn(a->measurements.reference[r], i, b->measurements.reference[r], j));
+    }
+    if (x->hasOD)
+    {
+        CHECK(sameColumn(a->calculated.od, i, b->calculated.od, j));
+    }
+    if (x->hasConcentration)
+    {
+        CHECK(sameDouble(a->calculated.concentration[i], b->calculated.concentration[j]));
+    }
+}
+
+static void checkFile(const DataFile_t *a, const DataFile_t *b)
+{
+    CHECK(a->count == b->count);
+    CHECK(sameString(dataFileString(a, a->serialNumber), dataFileString(b, b->serialNumber)));
+    CHECK(sameString(dataFileString(a, a->firmwareVersion), dataFileString(b, b->firmwareVersion)));
+    for (size_t i = 0; i < a->count && i < b->count; i++)
+    {
+        checkRecord(a, i, b, i);
+    }
+}
+
+// Reads file in chunks smaller than the file and compares every chunk to
+// data.
+static void checkReader(const char *file, const DataFile_t *data)
+{
+    ColibriReader_t reader;
+    size_t count = 0;
+
+    if (!CHECK(colibriReaderOpen(&reader, file, ARCHIVE_CHUNK_SIZE) == ERROR_COLIBRI_OK))
+    {
+        return;
+    }
+    while (CHECK(colibriReaderNext(&reader) == ERROR_COLIBRI_OK) && reader.chunk.count > 0)
+    {
+        CHECK(reader.first == count);
+        CHECK(sameString(dataFileString(&reader.chunk, reader.chunk.serialNumber), dataFileString(data, data->serialNumber)));
+        for (size_t i = 0; i < reader.chunk.count && reader.first + i < data->count; i++)
+        {
+            checkRecord(&reader.chunk, i, data, reader.first + i);
+        }
+        count += reader.chunk.count;
+    }
+    CHECK(count == data->count);
+    colibriReaderClose(&reader);
+}
+
+static char *readFile(const char *file, long *size)
+{
+    FILE *fin = fopen(file, "rb");
+    char *text = NULL;
+
+    *size = -1;
+    if (fin != NULL && fseek(fin, 0, SEEK_END) == 0 && (*size = ftell(fin)) >= 0 && fseek(fin, 0, SEEK_SET) == 0)
+    {
+        text = malloc(*size ? *size : 1);
+        if (text != NULL && fread(text, 1, *size, fin) != (size_t)*size)
+        {
+            free(text);
+            text = NULL;
+        }
+    }
+    if (fin != NULL)
+    {
+        fclose(fin);
+    }
+    return text;
+}
+
+// A JSON data file saved as archive and loaded again is the same to the bit,
+// whether loaded at once or in chunks, and saving it again gives the same
+// archive.
+void testArchive(int argc, char **argv)
+{
+    DataFile_t data = {0};
+    DataFile_t loaded = {0};
+    cJSON *json;
+    char *first;
+    char *again;
+    long firstSize;
+    long againSize;
+
+    if (!CHECK(argc == 1))
+    {
+        return;
+    }
+    json = colibriJsonLoad(argv[0], NULL);
+    if (!CHECK(json != NULL) || !CHECK(colibriJsonDecode(json, &data)))
+    {
+        colibriJsonRelease(json);
+        return;
+    }
+    CHECK(data.count == 4);
+    CHECK(!colibriArchiveProbe(argv[0]));
+
+    CHECK(colibriArchiveSave(ARCHIVE_FILE, &data) == ERROR_COLIBRI_OK);
+    CHECK(colibriArchiveProbe(ARCHIVE_FILE));
+    if (CHECK(colibriArchiveLoad(ARCHIVE_FILE, &loaded) == ERROR_COLIBRI_OK))
+    {
+        checkFile(&data, &loaded);
+        CHECK(colibriArchiveSave(ARCHIVE_FILE_AGAIN, &loaded) == ERROR_COLIBRI_OK);
+    }
+    checkReader(ARCHIVE_FILE, &data);
+    checkReader(argv[0], &data);
+
+    first = readFile(ARCHIVE_FILE, &firstSize);
+    again = readFile(ARCHIVE_FILE_AGAIN, &againSize);
+    CHECK(first != NULL && again != NULL && firstSize == againSize && memcmp(first, again, firstSize) == 0);
+
+    free(first);
+    free(again);
+    remove(ARCHIVE_FILE);
+    remove(ARCHIVE_FILE_AGAIN);
+    dataFileFree(&loaded);
+    dataFileFree(&data);
+    colibriJsonRelease(json);
+}
@@ -0,0 +1,175 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "test.h"
+#include "cmdmeasure.h"
+#include <math.h>
+#include <string.h>
+
+#define AVERAGE_ROWS 5
+
+static void fill(uint32_t *values, uint32_t count, uint32_t value)
+{
+    for (uint32_t i = 0; i < count * MEASURE_CHANNELS; i++)
+    {
+        values[i] = value;
+    }
+}
+
+// Below three measurements nothing is rejected, however far apart.
+static void averageFew(void)
+{
+    uint32_t values[2 * MEASURE_CHANNELS];
+    MeasureAverage_t average;
+
+    fill(values, 2, 1000);
+    CHECK(measureAverageValues(values, 1, MEASURE_OUTLIER_LIMIT, &average) == ERROR_COLIBRI_OK);
+    CHECK(average.count == 1 && average.rejected == 0);
+    CHECK(average.mean[0] == 1000.0);
+    CHECK(isnan(average.stdDev[0]));
+
+    values[MEASURE_CHANNELS] = 3000000;
+    CHECK(measureAverageValues(values, 2, MEASURE_OUTLIER_LIMIT, &average) == ERROR_COLIBRI_OK);
+    CHECK(average.count == 2 && average.rejected == 0);
+    CHECK(average.mean[0] == 1500500.0);
+}
+
+// Equal values have no spread, which must not reject all of them.
+static void averageEqual(void)
+{
+    uint32_t values[AVERAGE_ROWS * MEASURE_CHANNELS];
+    MeasureAverage_t average;
+
+    fill(values, AVERAGE_ROWS, 500000);
+    CHECK(measureAverageValues(values, AVERAGE_ROWS, MEASURE_OUTLIER_LIMIT, &average) == ERROR_COLIBRI_OK);
+    CHECK(average.rejected == 0);
+    for (int c = 0; c < MEASURE_CHANNELS; c++)
+    {
+        CHECK(average.mean[c] == 500000.0 && average.stdDev[c] == 0.0);
+    }
+}
+
+// Most counts equal, so the median absolute deviation is 0
+static void averageTie(void)
+{
+    uint32_t values[4 * MEASURE_CHANNELS];
+    MeasureAverage_t average;
+
+    fill(values, 4, 1000);
+    values[3 * MEASURE_CHANNELS] = 5000;
+    CHECK(measureAverageValues(values, 4, MEASURE_OUTLIER_LIMIT, &average) == ERROR_COLIBRI_OK);
+    CHECK(average.rejected == 1);
+    CHECK(average.mean[0] == 1000.0);
+
+    // A count next to the others is no outlier
+    values[3 * MEASURE_CHANNELS] = 1001;
+    CHECK(measureAverageValues(values, 4, MEASURE_OUTLIER_LIMIT, &average) == ERROR_COLIBRI_OK);
+    CHECK(average.rejected == 0);
+}
+
+// An outlier in one channel rejects the whole measurement.
+static void averageOutlier(void)
+{
+    static const uint32_t column[AVERAGE_ROWS] = {1000, 1002, 998, 1001, 999};
+    uint32_t values[AVERAGE_ROWS * MEASURE_CHANNELS];
+    MeasureAverage_t average;
+
+    for (uint32_t i = 0; i < AVERAGE_ROWS; i++)
+    {
+        for (int c = 0; c < MEASURE_CHANNELS; c++)
+        {
+            values[i * MEASURE_CHANNELS + c] = column[i] + 10 * c;
+        }
+    }
+    values[2 * MEASURE_CHANNELS + 5] = 2000;
+
+    CHECK(measureAverageValues(values, AVERAGE_ROWS, MEASURE_OUTLIER_LIMIT, &average) == ERROR_COLIBRI_OK);
+    CHECK(average.count == AVERAGE_ROWS && average.rejected == 1);
+    CHECK(average.mean[0] == 1000.5);
+    CHECK(average.mean[5] == 1050.5);
+
+    // A limit wide enough keeps it
+    CHECK(measureAverageValues(values, AVERAGE_ROWS, 1000.0, &average) == ERROR_COLIBRI_OK);
+    CHECK(average.rejected == 0);
+}
+
+// Every measurement is an outlier in another channel.
+static void averageAllRejected(void)
+{
+    uint32_t values[3 * MEASURE_CHANNELS];
+    MeasureAverage_t average;
+
+    fill(values, 3, 1000);
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        values[i * MEASURE_CHANNELS + i] = 5000;
+        values[((i + 1) % 3) * MEASURE_CHANNELS + i] = 1010;
+    }
+    CHECK(measureAverageValues(values, 3, MEASURE_OUTLIER_LIMIT, &average) == ERROR_COLIBRI_ALL_REJECTED);
+    CHECK(average.rejected == 3);
+}
+
+static Error_t parse(const char *option, const char *value, uint32_t *count, double *limit)
+{
+    char *argv[] = {"measure", (char *)option, (char *)value};
+    int i = 1;
+    Error_t ret = measureAverageParse(3, argv, &i, count, limit);
+
+    CHECK(ret == ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION ? i == 1 : i == 2);
+    return ret;
+}
+
+static void averageParse(void)
+{
+    uint32_t count = 0;
+    double limit = 0.0;
+
+    CHECK(parse("--average", "5", &count, &limit) == ERROR_COLIBRI_OK && count == 5);
+    CHECK(parse("--outlier-limit", "2.5", &count, &limit) == ERROR_COLIBRI_OK && limit == 2.5);
+    CHECK(parse("--average", "0", &count, &limit) == ERROR_COLIBRI_INVALID_NUMBER);
+    CHECK(parse("--average", "-1", &count, &limit) == ERROR_COLIBRI_INVALID_NUMBER);
+    CHECK(parse("--average", "12x", &count, &limit) == ERROR_COLIBRI_INVALID_NUMBER);
+    CHECK(parse("--average", "10001", &count, &limit) == ERROR_COLIBRI_INVALID_NUMBER);
+    CHECK(parse("--outlier-limit", "0", &count, &limit) == ERROR_COLIBRI_INVALID_NUMBER);
+    CHECK(parse("--outlier-limit", "nan", &count, &limit) == ERROR_COLIBRI_INVALID_NUMBER);
+    CHECK(parse("--outlier-limit", "inf", &count, &limit) == ERROR_COLIBRI_INVALID_NUMBER);
+    CHECK(parse("--air", "5", &count, &limit) == ERROR_COLIBRI_UNKOWN_COMMAND_LINE_OPTION);
+    CHECK(count == 5 && limit == 2.5);
+}
+
+// The measurements come from the device one after the other.
+static void averageDevice(void)
+{
+    uint32_t values[AVERAGE_ROWS * MEASURE_CHANNELS];
+    TestDevice_t device;
+    Colibri_t colibri;
+    MeasureAverage_t average;
+
+    for (uint32_t i = 0; i < AVERAGE_ROWS * MEASURE_CHANNELS; i++)
+    {
+        values[i] = 100000 + i / MEASURE_CHANNELS;
+    }
+    values[3 * MEASURE_CHANNELS] = 900000;
+    testDeviceInit(&device, &colibri);
+    device.measurements = values;
+    device.measurementCount = AVERAGE_ROWS;
+
+    CHECK(colibriOpen(&colibri) == ERROR_COLIBRI_OK);
+    CHECK(measureAverage(&colibri, AVERAGE_ROWS, MEASURE_OUTLIER_LIMIT, &average) == ERROR_COLIBRI_OK);
+    colibriClose(&colibri);
+
+    CHECK(device.commandCount == AVERAGE_ROWS);
+    CHECK(average.count == AVERAGE_ROWS && average.rejected == 1);
+    CHECK(average.mean[1] == 100001.75);
+}
+
+void testAverage(int argc, char **argv)
+{
+    averageFew();
+    averageEqual();
+    averageTie();
+    averageOutlier();
+    averageAllRejected();
+    averageParse();
+    averageDevice();
+}
@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "test.h"
+#include "colibriCalc.h"
+#include <math.h>
+#include <string.h>
+
+// Long enough for the vector loops, not a multiple of their width
+#define CALC_COUNT 1001
+#define CALC_CHUNK_SIZE 64
+#define CALC_PATH_LENGTH 1.0
+#define CALC_A260_UNIT 50.0
+
+static bool sameDoubles(const double *a, const double *b, size_t count)
+{
+    return memcmp(a, b, count * sizeof(double)) == 0;
+}
+
+// Counts around 1000000 like the module measures them, every third
+// measurement with air.
+static void calcFill(Measurements_t *measurements)
+{
+    uint32_t random = 12345;
+
+    for (size_t i = 0; i < measurements->count; i++)
+    {
+        measurements->hasAir[i] = i % 3 == 0;
+        for (int r = 0; r < ROLE_COUNT; r++)
+        {
+            for (int w = 0; w < WAVELENGTH_COUNT; w++)
+            {
+                random = random * 1103515245u + 12345u;
+                measurements->sample[r][w][i] = 900000.0 + (random >> 12) % 200000;
+                random = random * 1103515245u + 12345u;
+                measurements->reference[r][w][i] = 900000.0 + (random >> 12) % 200000;
+                if (r == ROLE_AIR && !measurements->hasAir[i])
+                {
+                    measurements->sample[r][w][i] = 1.0;
+                    measurements->reference[r][w][i] = 1.0;
+                }
+            }
+        }
+    }
+}
+
+// The measurements from first on, as a chunk read from a file.
+static Measurements_t calcChunk(const Measurements_t *measurements, size_t first)
+{
+    Measurements_t chunk = *measurements;
+
+    chunk.count = measurements->count - first;
+    chunk.hasAir += first;
+    for (int r = 0; r < ROLE_COUNT; r++)
+    {
+        for (int w = 0; w < WAVELENGTH_COUNT; w++)
+        {
+            chunk.sample[r][w] += first;
+            chunk.reference[r][w] += first;
+        }
+    }
+    return chunk;
+}
+
+static void calcBlanksChunked(const Measurements_t *measurements, size_t blanks, double factors[WAVELENGTH_COUNT])
+{
+    CalcBlanks_t calcBlanks;
+
+    calcBlanksInit(&calcBlanks);
+    for (size_t first = 0; first < measurements->count; first += CALC_CHUNK_SIZE)
+    {
+        Measurements_t chunk = calcChunk(measurements, first);
+        size_t count = chunk.count < CALC_CHUNK_SIZE ? chunk.count : CALC_CHUNK_SIZE;
+
+        calcBlanksAdd(&calcBlanks, &chunk, count, first, blanks);
+    }
+    calcBlanksFactors(&calcBlanks, factors);
+}
+
+// The factors and results of calcFactors() and calcResults(), the sweep and
+// CalcBlanks_t are the same to the bit, also with COLIBRI_VECTOR_MATH.
+void testCalc(int argc, char **argv)
+{
+    static const uint32_t blanksList[] = {0, 1, 2, 3, 7, 64, 65, 500, CALC_COUNT, CALC_COUNT + 1};
+    Measurements_t measurements;
+    Results_t results;
+    Results_t sweepResults;
+    CalcSweep_t sweep;
+
+    if (!CHECK(measurementsCreate(&measurements, CALC_COUNT)) || !CHECK(resultsCreate(&results, CALC_COUNT)) ||
+        !CHECK(resultsCreate(&sweepResults, CALC_COUNT)))
+    {
+        return;
+    }
+    calcFill(&measurements);
+    CHECK(calcSweepCreate(&sweep, &measurements));
+
+    for (size_t b = 0; b < sizeof(blanksList) / sizeof(blanksList[0]); b++)
+    {
+        uint32_t blanks = blanksList[b];
+        double factors[WAVELENGTH_COUNT];
+        double sweepFactors[WAVELENGTH_COUNT];
+        double blanksFactors[WAVELENGTH_COUNT];
+
+        calcFactors(&measurements, blanks, factors);
+        calcSweepFactors(&sweep, blanks, sweepFactors);
+        calcBlanksChunked(&measurements, blanks, blanksFactors);
+        CHECK(sameDoubles(factors, sweepFactors, WAVELENGTH_COUNT));
+        CHECK(sameDoubles(factors, blanksFactors, WAVELENGTH_COUNT));
+        CHECK(blanks > 0 || factors[WAVELENGTH_260] == 1.0);
+
+        CHECK(calcResults(&measurements, factors, CALC_PATH_LENGTH, CALC_A260_UNIT, &results));
+        calcSweepODs(&sweep, sweepFactors, &sweepResults);
+        calcSweepConcentration(&sweep, CALC_PATH_LENGTH, CALC_A260_UNIT, &sweepResults);
+        for (int w = 0; w < WAVELENGTH_COUNT; w++)
+        {
+            CHECK(sameDoubles(results.od[w], sweepResults.od[w], CALC_COUNT));
+        }
+        CHECK(sameDoubles(results.concentration, sweepResults.concentration, CALC_COUNT));
+        CHECK(isnan(results.concentration[1]) && !isnan(results.concentration[0]));
+    }
+
+    calcSweepFree(&sweep);
+    resultsFree(&sweepResults);
+    resultsFree(&results);
+    measurementsFree(&measurements);
+}
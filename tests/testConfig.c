@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "test.h"
+#include "cmdconfig.h"
+#include "colibriJson.h"
+#include <stdio.h>
+#include <string.h>
+
+#define CONFIG_FILE "config.json"
+#define CONFIG_EDITED_FILE "configEdited.json"
+
+static Error_t config(Colibri_t *colibri, const char *command, const char *file)
+{
+    char *argv[] = {"config", (char *)command, (char *)file};
+
+    return cmdConfig(colibri, 3, argv);
+}
+
+static bool writeFile(const char *file, const char *text)
+{
+    FILE *fout = fopen(file, "wb");
+    bool isWritten = fout != NULL && fputs(text, fout) >= 0;
+
+    return fout != NULL && fclose(fout) == 0 && isWritten;
+}
+
+static int arraySize(const cJSON *json, const char *name)
+{
+    return cJSON_GetArraySize(cJSON_GetObjectItem(json, name));
+}
+
+static bool hasIndex(const cJSON *json, const char *name, int index)
+{
+    const cJSON *entry;
+
+    cJSON_ArrayForEach(entry, cJSON_GetObjectItem(json, name))
+    {
+        const cJSON *value = cJSON_GetObjectItem(entry, "index");
+
+        if (cJSON_IsNumber(value) && value->valueint == index)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The settings changed after the dump are set back, equal numbers written
+// differently are left alone.
+static void configRoundTrip(void)
+{
+    TestDevice_t device;
+    Colibri_t colibri;
+    cJSON *json;
+
+    testDeviceInit(&device, &colibri);
+    CHECK(config(&colibri, "dump", CONFIG_FILE) == ERROR_COLIBRI_OK);
+
+    json = colibriJsonLoad(CONFIG_FILE, NULL);
+    if (CHECK(json != NULL))
+    {
+        CHECK(arraySize(json, "device") == 3);
+        CHECK(arraySize(json, "values") == 14);
+        CHECK(hasIndex(json, "device", INDEX_SERIALNUMBER));
+        CHECK(hasIndex(json, "values", INDEX_SETUP_TARGET340));
+        CHECK(!hasIndex(json, "device", INDEX_LAST_MEASUREMENT_COUNT) && !hasIndex(json, "values", INDEX_LAST_MEASUREMENT_COUNT));
+        colibriJsonRelease(json);
+    }
+
+    strcpy(device.values[INDEX_LED260NM_MAX_CURRENT], "1234");
+    strcpy(device.values[INDEX_AMPLIFIER_SAMPLEFACTOR__11_0], "11");
+    strcpy(device.values[INDEX_SERIALNUMBER], "OTHER");
+    device.commandCount = 0;
+    CHECK(config(&colibri, "restore", CONFIG_FILE) == ERROR_COLIBRI_OK);
+
+    CHECK(strcmp(device.values[INDEX_LED260NM_MAX_CURRENT], "5000") == 0);
+    CHECK(strcmp(device.values[INDEX_AMPLIFIER_SAMPLEFACTOR__11_0], "11") == 0);
+    CHECK(strcmp(device.values[INDEX_SERIALNUMBER], "OTHER") == 0);
+    // Read the settings, set the changed one and read it back
+    CHECK(device.commandCount == 14 + 1 + 1);
+}
+
+// A file which can not be restored as a whole is not restored at all.
+static void configRefused(const char *text)
+{
+    TestDevice_t device;
+    Colibri_t colibri;
+
+    testDeviceInit(&device, &colibri);
+    if (CHECK(writeFile(CONFIG_EDITED_FILE, text)))
+    {
+        CHECK(config(&colibri, "restore", CONFIG_EDITED_FILE) == ERROR_COLIBRI_INVALID_FILE_FORMAT);
+        CHECK(device.commandCount == 0);
+    }
+}
+
+void testConfig(int argc, char **argv)
+{
+    configRoundTrip();
+
+    // Read-only indices, unknown indices and values which are not one word
+    configRefused("{\"values\": [{\"index\": 23, \"value\": \"4000\"}, {\"index\": 1, \"value\": \"X\"}]}");
+    configRefused("{\"values\": [{\"index\": 23, \"value\": \"4000\"}, {\"index\": 10, \"value\": \"7\"}]}");
+    configRefused("{\"values\": [{\"index\": 23, \"value\": \"4000\"}, {\"index\": 24, \"value\": \"7\"}]}");
+    configRefused("{\"device\": [{\"index\": 23, \"value\": \"4000\"}]}");
+    configRefused("{\"values\": [{\"index\": 23, \"value\": \"40 00\"}]}");
+    configRefused("{\"device\": [{\"index\": 0, \"value\": \"1.2.3\"}]}");
+
+    remove(CONFIG_FILE);
+    remove(CONFIG_EDITED_FILE);
+}
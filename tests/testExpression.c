@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "test.h"
+#include "expression.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// More than two blocks, the last one not full
+#define EXPRESSION_TEST_COUNT (2 * EXPRESSION_BLOCK_SIZE + 89)
+
+static const char *const names[] = {"od230", "od260", "od280"};
+
+static bool near(double a, double b)
+{
+    return fabs(a - b) <= 1e-12 * fabs(b);
+}
+
+// Compiles text without variables and evaluates it once.
+static double constant(const char *text, size_t *length)
+{
+    Expression_t expression;
+    double result = NAN;
+
+    if (CHECK(expressionCompile(&expression, text, names, 3)))
+    {
+        CHECK(expressionEvaluate(&expression, NULL, 1, &result));
+        *length = expression.length;
+    }
+    return result;
+}
+
+static void checkConstant(const char *text, double expected)
+{
+    size_t length = 0;
+    double result = constant(text, &length);
+
+    if (!CHECK(near(result, expected)) || !CHECK(length == 1))
+    {
+        fprintf(stderr, "  %s: %g instead of %g, %zu instructions\n", text, result, expected, length);
+    }
+}
+
+// The error tells what is wrong and where.
+static void checkError(const char *text, const char *error)
+{
+    Expression_t expression;
+
+    if (!CHECK(!expressionCompile(&expression, text, names, 3)) || !CHECK(strcmp(expression.error, error) == 0))
+    {
+        fprintf(stderr, "  %s: '%s'\n", text, expression.error);
+    }
+}
+
+static void expressionPrecedence(void)
+{
+    checkConstant("1 + 2 * 3 ^ 2", 19.0);
+    checkConstant("-2 ^ 2", -4.0);
+    checkConstant("2 ^ 3 ^ 2", 512.0);
+    checkConstant("2 ^ -1", 0.5);
+    checkConstant("2 - 3 - 4", -5.0);
+    checkConstant("8 / 4 / 2", 1.0);
+    checkConstant("(1 + 2) * 3", 9.0);
+    checkConstant("--3 + +1", 4.0);
+    checkConstant("log10(1000) + ln(exp(2)) + sqrt(abs(-16))", 9.0);
+    checkConstant(".5e1", 5.0);
+}
+
+static void expressionErrors(void)
+{
+    char text[8 * EXPRESSION_MAX_CODE];
+
+    checkError("", "Expected a number, a name or ( at position 1");
+    checkError("od260 +", "Expected a number, a name or ( at position 8");
+    checkError("(od260", "Expected ) at position 7");
+    checkError("od261 / od280", "Unknown name at position 1");
+    checkError("sqrt od260", "Expected ( at position 6");
+    checkError("od260 od280", "Unexpected character at position 7");
+
+    // Every level of od230+(... needs one more value on the stack
+    text[0] = '\0';
+    for (int i = 0; i < EXPRESSION_MAX_DEPTH; i++)
+    {
+        strcat(text, "od230+(");
+    }
+    strcat(text, "od230");
+    for (int i = 0; i < EXPRESSION_MAX_DEPTH; i++)
+    {
+        strcat(text, ")");
+    }
+    checkError(text, "Expression nested too deeply at position 230");
+
+    // A variable and an addition per term
+    strcpy(text, "od230");
+    for (int i = 1; i <= EXPRESSION_MAX_CODE / 2; i++)
+    {
+        strcat(text, "+od230");
+    }
+    checkError(text, "Expression too long at position 390");
+}
+
+// Blocks of values give the same as one value at a time.
+static void expressionColumns(void)
+{
+    static double od230[EXPRESSION_TEST_COUNT];
+    static double od260[EXPRESSION_TEST_COUNT];
+    static double od280[EXPRESSION_TEST_COUNT];
+    static double result[EXPRESSION_TEST_COUNT];
+    const double *const variables[] = {od230, od260, od280};
+    Expression_t expression;
+    size_t wrong = 0;
+
+    for (size_t i = 0; i < EXPRESSION_TEST_COUNT; i++)
+    {
+        od230[i] = 0.1 + 0.001 * i;
+        od260[i] = 1.0 + 0.01 * i;
+        od280[i] = 0.5 + 0.003 * i;
+    }
+
+    if (!CHECK(expressionCompile(&expression, "od260 / od280 - 2 * 3 * log10(od230) ^ 2", names, 3)))
+    {
+        fprintf(stderr, "  %s\n", expression.error);
+        return;
+    }
+    CHECK(expression.depth == 4);
+    CHECK(expressionEvaluate(&expression, variables, EXPRESSION_TEST_COUNT, result));
+    for (size_t i = 0; i < EXPRESSION_TEST_COUNT; i++)
+    {
+        double expected = od260[i] / od280[i] - 6.0 * pow(log10(od230[i]), 2.0);
+
+        wrong += !near(result[i], expected);
+    }
+    CHECK(wrong == 0);
+}
+
+void testExpression(int argc, char **argv)
+{
+    expressionPrecedence();
+    expressionErrors();
+    expressionColumns();
+}
@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "test.h"
+#include "cmdget.h"
+#include "cmdset.h"
+#include "output.h"
+#include <stdio.h>
+#include <string.h>
+
+#define GETSET_MAX_ARGS (SET_MAX_VALUES + 2)
+
+static TestDevice_t device;
+static Colibri_t colibri;
+static Buffer_t capture;
+
+// Runs get or set with the arguments separated by spaces, the output of
+// get is in capture.
+static Error_t run(Error_t (*command)(Colibri_t *self, int argcCmd, char **argvCmd), const char *line)
+{
+    static char text[GETSET_MAX_ARGS * 8];
+    char *argv[GETSET_MAX_ARGS];
+    int argc = 0;
+
+    snprintf(text, sizeof(text), "%s", line);
+    for (char *token = strtok(text, " "); token != NULL && argc < GETSET_MAX_ARGS; token = strtok(NULL, " "))
+    {
+        argv[argc++] = token;
+    }
+
+    testDeviceInit(&device, &colibri);
+    bufferClear(&capture);
+    return command(&colibri, argc, argv);
+}
+
+static bool printed(const char *text)
+{
+    if (strcmp(capture.data ? capture.data : "", text) != 0)
+    {
+        fprintf(stderr, "  printed '%s' instead of '%s'\n", capture.data, text);
+        return false;
+    }
+    return true;
+}
+
+static void getValues(void)
+{
+    char line[GETSET_MAX_ARGS * 8] = "get";
+
+    CHECK(run(cmdGet, "get 1") == ERROR_COLIBRI_OK);
+    CHECK(printed("TEST1\n"));
+
+    CHECK(run(cmdGet, "get 0-2 23 60-61") == ERROR_COLIBRI_OK);
+    CHECK(printed("0 1.2.3\n1 TEST1\n2 1\n23 5000\n60 1.1\n61 11.0\n"));
+    CHECK(device.commandCount == 6);
+
+    // The values which can be read are printed, the error is returned
+    CHECK(run(cmdGet, "get 23 150 33") == 1);
+    CHECK(printed("23 5000\n33 5000\n"));
+
+    // Nothing is read before all indices are valid
+    CHECK(run(cmdGet, "get 23 5-3") == ERROR_COLIBRI_INVALID_NUMBER);
+    CHECK(run(cmdGet, "get 23 1-") == ERROR_COLIBRI_INVALID_NUMBER);
+    CHECK(run(cmdGet, "get 23 x") == ERROR_COLIBRI_INVALID_NUMBER);
+    CHECK(run(cmdGet, "get 0-256") == ERROR_COLIBRI_INVALID_PARAMETER);
+    for (int i = 0; i < GET_MAX_INDICES; i++)
+    {
+        strcat(line, " 1");
+    }
+    CHECK(run(cmdGet, line) == ERROR_COLIBRI_OK);
+    CHECK(device.commandCount == GET_MAX_INDICES);
+    strcat(line, " 1");
+    CHECK(run(cmdGet, line) == ERROR_COLIBRI_INVALID_PARAMETER);
+    CHECK(device.commandCount == 0);
+}
+
+static void setValues(void)
+{
+    char line[GETSET_MAX_ARGS * 8] = "set";
+
+    CHECK(run(cmdSet, "set 23 4000") == ERROR_COLIBRI_OK);
+    CHECK(strcmp(device.values[23], "4000") == 0);
+
+    CHECK(run(cmdSet, "set 23=4100 33=4200 80=900000") == ERROR_COLIBRI_OK);
+    CHECK(strcmp(device.values[23], "4100") == 0 && strcmp(device.values[33], "4200") == 0 && strcmp(device.values[80], "900000") == 0);
+    CHECK(device.commandCount == 3);
+
+    // Every value is written, the error is returned
+    CHECK(run(cmdSet, "set 23=1 150=2 33=3") == 1);
+    CHECK(strcmp(device.values[23], "1") == 0 && strcmp(device.values[33], "3") == 0);
+
+    // Nothing is written before all pairs are valid
+    CHECK(run(cmdSet, "set 23=1 33=") == ERROR_COLIBRI_INVALID_NUMBER);
+    CHECK(run(cmdSet, "set 23=1 =5") == ERROR_COLIBRI_INVALID_NUMBER);
+    CHECK(run(cmdSet, "set 23=1 x=5") == ERROR_COLIBRI_INVALID_NUMBER);
+    CHECK(run(cmdSet, "set 23=1 -1=5") == ERROR_COLIBRI_INVALID_NUMBER);
+    CHECK(run(cmdSet, "set 23:1") == ERROR_COLIBRI_INVALID_NUMBER);
+    CHECK(device.commandCount == 0);
+    for (int i = 0; i <= SET_MAX_VALUES; i++)
+    {
+        strcat(line, " 1=2");
+    }
+    CHECK(run(cmdSet, line) == ERROR_COLIBRI_INVALID_PARAMETER);
+    CHECK(device.commandCount == 0);
+}
+
+void testGetSet(int argc, char **argv)
+{
+    bufferInit(&capture);
+    outputCapture(&capture, NULL);
+
+    getValues();
+    setValues();
+
+    // Frees capture
+    outputClose();
+}
@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "test.h"
+#include "levellingpolicy.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define POLICY_STATE_FILE "levelling.state"
+#define POLICY_MAX_AGE 60.0
+
+// Records a levelling at the given time as levellingPolicyBaseline() does
+static void policyStateWrite(time_t at, const Levelling_t *levelling)
+{
+    FILE *fout = fopen(POLICY_STATE_FILE, "w");
+
+    if (!CHECK(fout != NULL))
+    {
+        return;
+    }
+    fprintf(fout, "colibri-levelling 1 %lld", (long long)at);
+    for (int w = 0; w < 4; w++)
+    {
+        fprintf(fout, " %u %u %u %u", levelling[w].result, levelling[w].current, levelling[w].amplificationSample, levelling[w].amplificationReference);
+    }
+    fprintf(fout, "\n");
+    fclose(fout);
+}
+
+// Runs the policy once against device and checks whether it levelled.
+static void policyRun(TestDevice_t *device, Colibri_t *colibri, LevellingPolicy_t *policy, bool expectLevelled)
+{
+    Levelling_t levelling[4];
+    uint32_t baseline[8];
+    bool isLevelled = !expectLevelled;
+    size_t levellingCount = device->levellingCount;
+
+    CHECK(levellingPolicyBaseline(colibri, policy, levelling, baseline, &isLevelled) == ERROR_COLIBRI_OK);
+    CHECK(isLevelled == expectLevelled);
+    CHECK(device->levellingCount == levellingCount + (expectLevelled ? 1 : 0));
+    CHECK(memcmp(levelling, device->levelling, sizeof(levelling)) == 0);
+    CHECK(memcmp(baseline, device->baseline, sizeof(baseline)) == 0);
+}
+
+static void policyReuse(void)
+{
+    TestDevice_t device;
+    Colibri_t colibri;
+    LevellingPolicy_t policy;
+
+    testDeviceInit(&device, &colibri);
+    levellingPolicyInit(&policy);
+    policyRun(&device, &colibri, &policy, false);
+    CHECK(device.baselineCount == 1);
+
+    // Later baselines neither read the targets nor the last levelling again
+    device.commandCount = 0;
+    policyRun(&device, &colibri, &policy, false);
+    CHECK(device.commandCount == 1);
+}
+
+static void policyFailed(void)
+{
+    TestDevice_t device;
+    Colibri_t colibri;
+    LevellingPolicy_t policy;
+
+    testDeviceInit(&device, &colibri);
+    device.levelling[1].result = SETUPRESULT_AMPLIFICATION_NOT_FOUND;
+    levellingPolicyInit(&policy);
+    policyRun(&device, &colibri, &policy, true);
+    CHECK(device.levelling[1].result == SETUPRESULT_OK);
+    // The baseline is only measured with the new levelling
+    CHECK(device.baselineCount == 1);
+}
+
+static void policyAgeUnknown(void)
+{
+    TestDevice_t device;
+    Colibri_t colibri;
+    LevellingPolicy_t policy;
+
+    testDeviceInit(&device, &colibri);
+    levellingPolicyInit(&policy);
+    policy.maxAge = POLICY_MAX_AGE;
+    policyRun(&device, &colibri, &policy, true);
+}
+
+static void policyAge(void)
+{
+    TestDevice_t device;
+    Colibri_t colibri;
+    LevellingPolicy_t policy;
+
+    testDeviceInit(&device, &colibri);
+    remove(POLICY_STATE_FILE);
+
+    // Recorded within maxAge
+    policyStateWrite(time(NULL) - 10, device.levelling);
+    levellingPolicyInit(&policy);
+    policy.maxAge = POLICY_MAX_AGE;
+    policy.stateFile = POLICY_STATE_FILE;
+    policyRun(&device, &colibri, &policy, false);
+
+    // Recorded before maxAge, the new levelling is recorded for the next run
+    policyStateWrite(time(NULL) - 2 * (time_t)POLICY_MAX_AGE, device.levelling);
+    levellingPolicyInit(&policy);
+    policy.maxAge = POLICY_MAX_AGE;
+    policy.stateFile = POLICY_STATE_FILE;
+    policyRun(&device, &colibri, &policy, true);
+
+    levellingPolicyInit(&policy);
+    policy.maxAge = POLICY_MAX_AGE;
+    policy.stateFile = POLICY_STATE_FILE;
+    policyRun(&device, &colibri, &policy, false);
+
+    remove(POLICY_STATE_FILE);
+}
+
+// A state file of a levelling someone else ran since does not tell the age
+static void policyStateMismatch(void)
+{
+    TestDevice_t device;
+    Colibri_t colibri;
+    LevellingPolicy_t policy;
+    Levelling_t other[4];
+
+    testDeviceInit(&device, &colibri);
+    memcpy(other, device.levelling, sizeof(other));
+    other[2].current++;
+    policyStateWrite(time(NULL) - 10, other);
+
+    levellingPolicyInit(&policy);
+    policy.maxAge = POLICY_MAX_AGE;
+    policy.stateFile = POLICY_STATE_FILE;
+    policyRun(&device, &colibri, &policy, true);
+
+    remove(POLICY_STATE_FILE);
+}
+
+static void policyDrift(void)
+{
+    TestDevice_t device;
+    Colibri_t colibri;
+    LevellingPolicy_t policy;
+
+    testDeviceInit(&device, &colibri);
+    levellingPolicyInit(&policy);
+
+    // 5 % is within the default of 10 %
+    device.baseline[3] = 1050000;
+    policyRun(&device, &colibri, &policy, false);
+
+    // 20 % drift, the baseline is measured again after the levelling
+    device.baselineCount = 0;
+    device.baseline[3] = 1200000;
+    policyRun(&device, &colibri, &policy, true);
+    CHECK(device.baselineCount == 2);
+
+    policy.maxDrift = 25.0;
+    policyRun(&device, &colibri, &policy, false);
+}
+
+void testLevellingPolicy(int argc, char **argv)
+{
+    policyReuse();
+    policyFailed();
+    policyAgeUnknown();
+    policyAge();
+    policyStateMismatch();
+    policyDrift();
+}
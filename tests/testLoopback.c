@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "test.h"
+#include <stdio.h>
+#include <string.h>
+
+#define LOOPBACK_COMMANDS 40
+
+// Without a device every command is answered with itself.
+static void loopbackEcho(void)
+{
+    Colibri_t colibri = {0};
+    ColibriResponse_t *response = colibriCreateResponse();
+
+    colibri.portName = COLIBRI_LOOPBACK_PREFIX;
+    CHECK(colibriCommand(&colibri, "X 1 2", response) == ERROR_COLIBRI_OK);
+    CHECK(response->argc == 3);
+    CHECK(response->argc == 3 && strcmp(response->argv[0], "X") == 0 && strcmp(response->argv[2], "2") == 0);
+    colibriFreeResponse(response);
+}
+
+static void loopbackValues(bool useChecksum)
+{
+    TestDevice_t device;
+    Colibri_t colibri;
+    char value[COLIBRI_MAX_LINE_LENGTH];
+
+    testDeviceInit(&device, &colibri);
+    colibri.useChecksum = useChecksum;
+
+    CHECK(colibriGet(&colibri, INDEX_SERIALNUMBER, value, sizeof(value)) == ERROR_COLIBRI_OK);
+    CHECK(strcmp(value, "TEST1") == 0);
+    CHECK(colibriSet(&colibri, INDEX_SETUP_TARGET230, "900000") == ERROR_COLIBRI_OK);
+    CHECK(strcmp(device.values[INDEX_SETUP_TARGET230], "900000") == 0);
+    CHECK(colibriGet(&colibri, TEST_DEVICE_INDICES, value, sizeof(value)) == 1);
+}
+
+// More commands than COLIBRI_PIPELINE_DEPTH over one open port, every
+// response belongs to its command.
+static void loopbackPipeline(void)
+{
+    TestDevice_t device;
+    Colibri_t colibri;
+    char commands[LOOPBACK_COMMANDS][16];
+    const char *pointers[LOOPBACK_COMMANDS];
+    ColibriResponse_t responses[LOOPBACK_COMMANDS];
+
+    testDeviceInit(&device, &colibri);
+    for (int i = 0; i < LOOPBACK_COMMANDS; i++)
+    {
+        snprintf(device.values[i], TEST_DEVICE_VALUE_SIZE, "value%d", i);
+        snprintf(commands[i], sizeof(commands[i]), "V %d", i);
+        pointers[i] = commands[i];
+    }
+
+    CHECK(colibriOpen(&colibri) == ERROR_COLIBRI_OK);
+    CHECK(colibriCommands(&colibri, pointers, LOOPBACK_COMMANDS, responses) == ERROR_COLIBRI_OK);
+    colibriClose(&colibri);
+
+    CHECK(device.commandCount == LOOPBACK_COMMANDS);
+    for (int i = 0; i < LOOPBACK_COMMANDS; i++)
+    {
+        CHECK(responses[i].argc == 2 && strcmp(responses[i].argv[1], device.values[i]) == 0);
+    }
+}
+
+void testLoopback(int argc, char **argv)
+{
+    loopbackEcho();
+    loopbackValues(false);
+    loopbackValues(true);
+    loopbackPipeline();
+}
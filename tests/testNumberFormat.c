@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "test.h"
+#include "numberformat.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUMBER_FORMAT_RANDOM 200000
+
+// xorshift64, the same numbers on every platform
+static uint64_t randomNext(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// Random bit patterns cover every exponent, the finite ones must parse back
+// to the same bits.
+static void numberRoundTrip(void)
+{
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    char buffer[NUMBER_FORMAT_BUFFER_SIZE];
+
+    for (int i = 0; i < NUMBER_FORMAT_RANDOM; i++)
+    {
+        uint64_t bits = randomNext(&state);
+        double value;
+        double parsed;
+
+        memcpy(&value, &bits, sizeof(value));
+        if (!isfinite(value))
+        {
+            continue;
+        }
+        formatDouble(buffer, value);
+        parsed = strtod(buffer, NULL);
+        if (!CHECK(memcmp(&parsed, &value, sizeof(value)) == 0))
+        {
+            fprintf(stderr, "%.17g written as %s\n", value, buffer);
+            break;
+        }
+    }
+}
+
+static void numberShortest(void)
+{
+    static const struct
+    {
+        double value;
+        const char *text;
+    } cases[] = {
+        {0.1, "0.1"},
+        {-1.5, "-1.5"},
+        {42.0, "42"},
+        {1e21, "1e+21"},
+        {1.25e-7, "1.25e-07"},
+        {0.001, "0.001"},
+        {5e-324, "5e-324"},
+        {1.7976931348623157e308, "1.7976931348623157e+308"},
+        {-0.0, "0"},
+    };
+    char buffer[NUMBER_FORMAT_BUFFER_SIZE];
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        size_t length = formatDouble(buffer, cases[i].value);
+
+        if (!CHECK(strcmp(buffer, cases[i].text) == 0 && length == strlen(buffer)))
+        {
+            fprintf(stderr, "expected %s, got %s\n", cases[i].text, buffer);
+        }
+    }
+}
+
+// JSON has neither NaN nor infinity
+static void numberNull(void)
+{
+    char buffer[NUMBER_FORMAT_BUFFER_SIZE];
+
+    CHECK(formatDouble(buffer, NAN) == 4 && strcmp(buffer, "null") == 0);
+    CHECK(formatDouble(buffer, INFINITY) == 4 && strcmp(buffer, "null") == 0);
+    CHECK(formatDouble(buffer, -INFINITY) == 4 && strcmp(buffer, "null") == 0);
+}
+
+static void numberFixedCompare(double value)
+{
+    char buffer[NUMBER_FORMAT_BUFFER_SIZE];
+    char expected[NUMBER_FORMAT_BUFFER_SIZE];
+    size_t length = formatFixed(buffer, value);
+
+    snprintf(expected, sizeof(expected), "%f", value);
+    if (!CHECK(strcmp(buffer, expected) == 0 && length == strlen(expected)))
+    {
+        fprintf(stderr, "%.17g written as %s instead of %s\n", value, buffer, expected);
+    }
+}
+
+// The same text as printf("%f"), also on the rounding boundaries of the
+// sixth decimal and beyond the fast path.
+static void numberFixed(void)
+{
+    static const double cases[] = {0.0, -0.0, 0.5e-6, 1.5e-6, 2.5e-6, -0.0000005, 0.1234565, 1e-7, 999999999.9999995, 1e9, -1e15, 1e300, NAN, INFINITY, -INFINITY};
+    uint64_t state = 0x2545F4914F6CDD1Dull;
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        numberFixedCompare(cases[i]);
+    }
+
+    for (int i = 0; i < NUMBER_FORMAT_RANDOM; i++)
+    {
+        uint64_t bits = randomNext(&state);
+        // Mantissas of 53 bits scaled from 1e-8 to 1e10
+        double value = (double)(bits >> 11) / 9007199254740992.0 * pow(10.0, (double)(int)(bits % 19) - 8.0);
+
+        numberFixedCompare(bits & 1 ? -value : value);
+        // Values with few digits often lie on a boundary
+        numberFixedCompare((double)(int64_t)(bits % 2000000001) / 1e7);
+    }
+}
+
+static void numberIntegers(void)
+{
+    char buffer[NUMBER_FORMAT_BUFFER_SIZE];
+
+    CHECK(formatUint32(buffer, 0) == 1 && strcmp(buffer, "0") == 0);
+    CHECK(formatUint32(buffer, 4294967295u) == 10 && strcmp(buffer, "4294967295") == 0);
+    CHECK(formatInt64(buffer, -9223372036854775807ll - 1) == 20 && strcmp(buffer, "-9223372036854775808") == 0);
+    CHECK(formatInt64(buffer, 9223372036854775807ll) == 19 && strcmp(buffer, "9223372036854775807") == 0);
+}
+
+void testNumberFormat(int argc, char **argv)
+{
+    numberRoundTrip();
+    numberShortest();
+    numberNull();
+    numberFixed();
+    numberIntegers();
+}
@@ -0,0 +1,203 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: © 2024 HSE AG, <opensource@hseag.com>
+
+#include "test.h"
+#include "system.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define TCP_COMMANDS 20
+#define TCP_DEADLINE 100
+
+// What the server does with the connection it accepts next
+typedef enum
+{
+    TCP_ANSWER,
+    TCP_SILENT,
+    TCP_CLOSE,
+} TcpMode_t;
+
+// Accepts one connection per mode on 127.0.0.1. TCP_ANSWER answers V i
+// with V value<i> until the peer closes, every response in two pieces so
+// the client has to put it together. TCP_SILENT never answers and
+// TCP_CLOSE closes after the first command.
+typedef struct
+{
+    int listener;
+    const TcpMode_t *modes;
+    size_t modeCount;
+    size_t commandCount;
+} TcpServer_t;
+
+static void tcpSendPieces(int socket, const char *response)
+{
+    size_t size = strlen(response);
+    size_t half = size / 2;
+
+    send(socket, response, half, MSG_NOSIGNAL);
+    usleep(2000);
+    send(socket, response + half, size - half, MSG_NOSIGNAL);
+}
+
+static void tcpServe(TcpServer_t *self, int socket, TcpMode_t mode)
+{
+    char line[COLIBRI_MAX_LINE_LENGTH];
+    size_t length = 0;
+    char rx[256];
+    ssize_t size;
+
+    while ((size = recv(socket, rx, sizeof(rx), 0)) > 0)
+    {
+        for (ssize_t i = 0; i < size; i++)
+        {
+            char response[COLIBRI_MAX_LINE_LENGTH];
+
+            if (rx[i] != '\n')
+            {
+                if (length < sizeof(line) - 1)
+                {
+                    line[length++] = rx[i];
+                }
+                continue;
+            }
+            line[length] = 0;
+            length = 0;
+            self->commandCount++;
+
+            if (mode == TCP_CLOSE)
+            {
+                return;
+            }
+            if (mode == TCP_ANSWER)
+            {
+                if (strncmp(line, ":V ", 3) == 0)
+                {
+                    snprintf(response, sizeof(response), ":V value%.16s\n", line + 3);
+                }
+                else
+                {
+                    snprintf(response, sizeof(response), ":E 1\n");
+                }
+                tcpSendPieces(socket, response);
+            }
+        }
+    }
+}
+
+static void tcpServer(void *argument)
+{
+    TcpServer_t *self = argument;
+
+    for (size_t m = 0; m < self->modeCount; m++)
+    {
+        int socket = accept(self->listener, NULL, NULL);
+
+        if (socket == -1)
+        {
+            return;
+        }
+        tcpServe(self, socket, self->modes[m]);
+        close(socket);
+    }
+}
+
+// Returns the port of a listener on 127.0.0.1, 0 on errors.
+static unsigned tcpListen(int *listener)
+{
+    struct sockaddr_in address = {0};
+    socklen_t size = sizeof(address);
+
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+
+    *listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (*listener == -1)
+    {
+        return 0;
+    }
+    if (bind(*listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(*listener, 4) != 0 ||
+        getsockname(*listener, (struct sockaddr *)&address, &size) != 0)
+    {
+        close(*listener);
+        return 0;
+    }
+    return ntohs(address.sin_port);
+}
+
+void testTcp(int argc, char **argv)
+{
+    static const TcpMode_t modes[] = {TCP_ANSWER, TCP_ANSWER, TCP_SILENT, TCP_CLOSE};
+    TcpServer_t server = {0};
+    SystemThread_t thread;
+    char portName[64];
+    Colibri_t colibri = {0};
+    ColibriResponse_t response;
+    char commands[TCP_COMMANDS][16];
+    const char *pointers[TCP_COMMANDS];
+    ColibriResponse_t responses[TCP_COMMANDS];
+    ColibriTransport_t transport = {0};
+    char rx[64];
+    unsigned port = tcpListen(&server.listener);
+    uint64_t start;
+
+    if (!CHECK(port != 0))
+    {
+        return;
+    }
+    server.modes = modes;
+    server.modeCount = sizeof(modes) / sizeof(modes[0]);
+    if (!CHECK(systemThreadStart(&thread, tcpServer, &server)))
+    {
+        close(server.listener);
+        return;
+    }
+
+    snprintf(portName, sizeof(portName), "%s127.0.0.1:%u", COLIBRI_TCP_PREFIX, port);
+    colibri.portName = portName;
+
+    // A single command opens its own connection, the response comes in pieces
+    CHECK(colibriCommand(&colibri, "V 7", &response) == ERROR_COLIBRI_OK);
+    CHECK(response.argc == 2 && strcmp(response.argv[1], "value7") == 0);
+
+    // More commands than COLIBRI_PIPELINE_DEPTH over one open connection
+    for (int i = 0; i < TCP_COMMANDS; i++)
+    {
+        snprintf(commands[i], sizeof(commands[i]), "V %d", i);
+        pointers[i] = commands[i];
+    }
+    CHECK(colibriOpen(&colibri) == ERROR_COLIBRI_OK);
+    CHECK(colibriCommands(&colibri, pointers, TCP_COMMANDS, responses) == ERROR_COLIBRI_OK);
+    colibriClose(&colibri);
+    for (int i = 0; i < TCP_COMMANDS; i++)
+    {
+        char value[16];
+
+        snprintf(value, sizeof(value), "value%d", i);
+        CHECK(responses[i].argc == 2 && strcmp(responses[i].argv[1], value) == 0);
+    }
+
+    // Without data the read returns 0 at the deadline
+    transport.ops = &colibriTcpTransport;
+    CHECK(transport.ops->open(&transport, portName + strlen(COLIBRI_TCP_PREFIX)));
+    CHECK(transport.ops->write(&transport, ":V 1\n"));
+    start = colibriMilliseconds();
+    CHECK(transport.ops->read(&transport, rx, sizeof(rx), start + TCP_DEADLINE) == 0);
+    CHECK(colibriMilliseconds() - start >= TCP_DEADLINE - 10);
+    CHECK(transport.ops->read(&transport, rx, sizeof(rx), start) == 0);
+    transport.ops->close(&transport);
+
+    // A peer closing without a response is an error, not a timeout
+    CHECK(colibriCommand(&colibri, "V 1", &response) == ERROR_COLIBRI_PROTOCOL_ERROR);
+
+    systemThreadJoin(&thread);
+    CHECK(server.commandCount == 1 + TCP_COMMANDS + 1 + 1);
+    close(server.listener);
+
+    // Nobody listens any more
+    CHECK(colibriCommand(&colibri, "V 1", &response) == ERROR_COLIBRI_NOT_FOUND);
+}